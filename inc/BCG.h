@@ -26,7 +26,11 @@
 #include "mbed.h"
 #include "LSM6DSLSensor.h"
 #include "BusControl.h"
-#include "../iir-filter-kit/BiQuad.h"
+#include "SensorSession.h"
+#include "CapCalc.h"
+#include "Checkpoint.h"
+#include "StaticVector.h"
+#include "BCGFilter.h"
 
 using namespace std::chrono;
 
@@ -42,7 +46,13 @@ public:
     BCG(SPI *spi, PinName int1_pin, PinName cs);
     ~BCG();
 
-    bool bcg(const seconds num_seconds);
+    bool bcg(const seconds num_seconds, SensorSession* session = nullptr);
+
+    /**
+     * True if the last bcg() call stopped early because the supercap ran
+     * low. Its state was checkpointed and the next call resumes it.
+     */
+    bool is_suspended() { return _suspended; };
     float get_frequency() { return G_FREQUENCY; }
 
     uint8_t get_buffer_size() { return _HR.size(); };
@@ -56,32 +66,41 @@ private:
     LowPowerTimer _sample_timer;
 
     Logger* _logger;
+    CapCalc* _cap_calc;
+    Checkpoint* _checkpoint;
+    bool _suspended = false;
 
-    const uint8_t HR_BUFFER_SIZE = 20; // how many heart rates we want to store on device
-    vector<HR_t> _HR;
+    static const uint8_t HR_BUFFER_SIZE = 20; // how many heart rates we want to store on device
+    BoundedVector<HR_t, HR_BUFFER_SIZE> _HR;
 
     const uint8_t IMU_TIMEOUT = 2; // seconds
-    const float G_FREQUENCY = 51.0; // Hz
+    const float G_FREQUENCY = BCGFilter::FREQUENCY; // Hz, what the filters are designed for
     const float G_FULL_SCALE = 124.0; // max sensitivity
 
+    const float OUTLIER_THRESHOLD = 3.0; // standard deviations
+
+    static const uint8_t MAX_RATES = 40; // ~2.5 per second for a 15 s capture
+
     /**
-     * These next two variables will control
-     * our "bcg valid" detection. NUM_EVENTS
-     * describes how many sequential samples
-     * we want to have a std deviation below
-     * STD_DEV_THRESHOLD before we calculate 
-     * a heart rate based on them.
+     * Everything bcg() needs to carry on after a brownout. The filters
+     * aren't in it: after an outage of seconds their delay lines hold a
+     * signal that's moved on, and priming them on the first new sample
+     * does at least as well (tools/host/checkpoint_bench.cpp measures the
+     * resume). The crosses go too, as the one before the outage and the
+     * one after don't bound a heartbeat.
      */
-    uint8_t NUM_EVENTS = 6; // number of sequential events
-    const float STD_DEV_THRESHOLD = 20.0; // in BPM
-    const float OUTLIER_THRESHOLD = 3.0; // standard deviations
+    typedef struct
+    {
+        uint32_t elapsed_ms; // capture time already done
+        uint8_t num_rates;
+        double rates[MAX_RATES];
+    } State_t;
 
-    const uint8_t MIN_HR = 45; // BPM below this limit are filtered out during the HR_isolation stage
-    const uint8_t MAX_HR = 150; // BPM above this limit are filtered out during the HR_isolation stage
+    static_assert(sizeof(State_t) <= Checkpoint::MAX_STATE_SIZE, "BCG state must fit a checkpoint slot");
 
-    double _l2norm(double x, double y, double z);
     void _init_imu(LSM6DSLSensor& imu);
     void _reset_imu(LSM6DSLSensor& imu);
+    bool _wait_for_imu(LSM6DSLSensor& imu);
 };
 
 #endif //BCG_H_
@@ -0,0 +1,118 @@
+/**
+ * @file BCGFilter.h
+ * @author agent agent@local
+ * @brief Ballistocardiogram filters and heartbeat (zero-cross) rate detection
+ * @version 0.1
+ * @date 2026-10-19
+ * 
+ * @copyright Copyright (c) 2026 Ka Moamoa
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, version 3 of the license.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef BCGFILTER_H_
+#define BCGFILTER_H_
+
+#include <stdint.h>
+#include "StaticVector.h"
+#include "../iir-filter-kit/BiQuad.h"
+
+/**
+ * The signal chain of BCG::bcg(), without the IMU: each gyroscope axis
+ * through a 10-13 Hz band-pass, their L2 norm through a 0.75-2.5 Hz
+ * band-pass, and a heart rate from every run of NUM_EVENTS descending
+ * zero-crosses that agree with each other.
+ */
+class BCGFilter
+{
+public:
+    static const uint8_t FREQUENCY = 51; // hz, the gyroscope's data rate
+
+    /**
+     * These next two variables will control
+     * our "bcg valid" detection. NUM_EVENTS
+     * describes how many sequential samples
+     * we want to have a std deviation below
+     * STD_DEV_THRESHOLD before we calculate
+     * a heart rate based on them.
+     */
+    static const uint8_t NUM_EVENTS = 6; // number of sequential events
+    const float STD_DEV_THRESHOLD = 20.0; // in BPM
+
+    const uint8_t MIN_HR = 45; // BPM below this limit are filtered out during the HR_isolation stage
+    const uint8_t MAX_HR = 150; // BPM above this limit are filtered out during the HR_isolation stage
+
+    BCGFilter();
+    BCGFilter(BCGFilter &other) = delete;
+    void operator=(const BCGFilter &) = delete;
+
+    /**
+     * @brief Filter one gyroscope sample. The first sample also primes
+     * the filters, so they don't ring for the first few seconds.
+     *
+     * @param timestamp seconds, in capture time
+     * @return true if the sample completes a run of crosses with an
+     * in-bounds heart rate, from get_rate()
+     */
+    bool step(double x, double y, double z, double timestamp);
+
+    float get_value() { return _last; };
+    bool is_descending_cross() { return _descending; };
+    float get_rate() { return _rate; }; // BPM
+    float get_std_dev() { return _std_dev; }; // of the last run's beat-to-beat rates
+
+private:
+    /**
+     * @brief 4th order bandpass (10-13 Hz) Butterworth filters
+     *
+     * We need 3 of them (one per axis) since we're doing this real-time.
+     *
+     * Documentation can be found in BiQuad.h. BiQuads were
+     * generated with MATLAB assuming 104 Hz sampling frequency.
+     */
+    BiQuad _bqx1 = BiQuad( 6.76087639e-04,  1.35217528e-03,  6.76087639e-04,  1.00000000e+00, -2.16739514e-01,  7.10632547e-01);
+    BiQuad _bqx2 = BiQuad( 1.00000000e+00,  2.00000000e+00,  1.00000000e+00,  1.00000000e+00, -4.54393846e-01,  7.17539837e-01);
+    BiQuad _bqx3 = BiQuad( 1.00000000e+00, -2.00000000e+00,  1.00000000e+00,  1.00000000e+00, -5.35180090e-02,  8.69556033e-01);
+    BiQuad _bqx4 = BiQuad( 1.00000000e+00, -2.00000000e+00,  1.00000000e+00,  1.00000000e+00, -6.64197076e-01,  8.77428070e-01);
+
+    BiQuad _bqy1 = BiQuad( 6.76087639e-04,  1.35217528e-03,  6.76087639e-04,  1.00000000e+00, -2.16739514e-01,  7.10632547e-01);
+    BiQuad _bqy2 = BiQuad( 1.00000000e+00,  2.00000000e+00,  1.00000000e+00,  1.00000000e+00, -4.54393846e-01,  7.17539837e-01);
+    BiQuad _bqy3 = BiQuad( 1.00000000e+00, -2.00000000e+00,  1.00000000e+00,  1.00000000e+00, -5.35180090e-02,  8.69556033e-01);
+    BiQuad _bqy4 = BiQuad( 1.00000000e+00, -2.00000000e+00,  1.00000000e+00,  1.00000000e+00, -6.64197076e-01,  8.77428070e-01);
+
+    BiQuad _bqz1 = BiQuad( 6.76087639e-04,  1.35217528e-03,  6.76087639e-04,  1.00000000e+00, -2.16739514e-01,  7.10632547e-01);
+    BiQuad _bqz2 = BiQuad( 1.00000000e+00,  2.00000000e+00,  1.00000000e+00,  1.00000000e+00, -4.54393846e-01,  7.17539837e-01);
+    BiQuad _bqz3 = BiQuad( 1.00000000e+00, -2.00000000e+00,  1.00000000e+00,  1.00000000e+00, -5.35180090e-02,  8.69556033e-01);
+    BiQuad _bqz4 = BiQuad( 1.00000000e+00, -2.00000000e+00,  1.00000000e+00,  1.00000000e+00, -6.64197076e-01,  8.77428070e-01);
+
+    // 2nd order bandpass (0.75-2.5 Hz) Butterworth filter
+    BiQuad _bq5 = BiQuad( 0.00952329,  0.01904657,  0.00952329,  1., -1.74516121,  0.8078649 );
+    BiQuad _bq6 = BiQuad( 1.,          -2.,         1.,          1., -1.91061565,  0.92055723 );
+
+    BiQuadChain _bcg_isolation_x;
+    BiQuadChain _bcg_isolation_y;
+    BiQuadChain _bcg_isolation_z;
+    BiQuadChain _hr_isolation;
+
+    static const uint16_t PRIME_SAMPLES = FREQUENCY * 5;
+
+    float _last = -1.0;
+    bool _primed = false;
+    bool _descending = false;
+
+    BoundedVector<double, NUM_EVENTS> _crosses;
+    float _rate = 0;
+    float _std_dev = 0;
+};
+
+#endif // BCGFILTER_H_
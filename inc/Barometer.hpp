@@ -26,6 +26,10 @@
 #include "LPS22HBSensor.h"
 #include "Logger.h"
 #include "BusControl.h"
+#include "SampleClock.h"
+#include "StaticVector.h"
+
+class WaveformStreamer;
 
 class Barometer
 {
@@ -33,18 +37,25 @@ public:
     Barometer(SPI *spi, PinName cs_pin, PinName int_pin);
     ~Barometer();
 
-    const uint16_t MAX_ALLOWABLE_SIZE = 200; //This is a little arbitrary, just want to have a cap on the buffer size.
+    static const uint16_t MAX_ALLOWABLE_SIZE = 200; //This is a little arbitrary, just want to have a cap on the buffer size.
 
-    bool initialize();
+    bool initialize(bool low_current = false);
+    void stop();
+    bool is_ready(); // WHO_AM_I probe, used after power up
     bool set_frequency(uint8_t frequency);
     uint8_t get_frequency() { return _frequency; }
     bool update(bool force = false);
 
     bool set_fifo_full_interrupt(bool enable);
+    bool set_fifo_watermark_interrupt(uint8_t batch_size);
+    uint8_t get_batch_size() { return _batch_size; };
+    bool wait_for_data(std::chrono::milliseconds timeout);
     bool enable_pressure_threshold(bool enable, bool high_pressure, bool low_pressure);
     bool set_pressure_threshold(int16_t hPa);
 
     bool get_high_pressure_event_flag() { return _high_pressure_event_flag; };
+    bool get_overrun_flag() { return _overrun_flag; };
+    void clear_overrun_flag() { _overrun_flag = false; };
 
     void set_max_buffer_size(uint16_t size);
     uint16_t get_max_buffer_size() { return _max_buffer_size; };
@@ -54,7 +65,9 @@ public:
     uint8_t get_temp_buffer_size() { return _temperature_buffer.size(); };
     uint16_t* get_pressure_array() { return _pressure_buffer.data(); };
     uint16_t* get_temperature_array() { return _temperature_buffer.data(); };
-    void clear_buffers() { _temperature_buffer.clear(); _pressure_buffer.clear(); };
+    void clear_buffers() { _temperature_buffer.clear(); _pressure_buffer.clear(); _buffer_start_index = _samples_read; };
+    uint32_t get_buffer_start_index() { return _buffer_start_index; };
+    SampleClock& get_sample_clock() { return _sample_clock; };
     uint64_t get_delta_timestamp(bool broadcast);
     uint32_t get_measurement_frequencyx100() { return _measurement_frequencyx100; };
 
@@ -63,27 +76,38 @@ public:
 private:
     bool _initialized = false;
     bool _bar_data_ready = false;
-    std::vector<uint16_t> _pressure_buffer;
-    std::vector<uint16_t> _temperature_buffer;
+    // a FIFO read lands in full before the buffers are trimmed back to _max_buffer_size
+    BoundedVector<uint16_t, MAX_ALLOWABLE_SIZE + FIFO_LENGTH> _pressure_buffer;
+    BoundedVector<uint16_t, MAX_ALLOWABLE_SIZE + FIFO_LENGTH> _temperature_buffer;
     bool _high_pressure_event_flag = false;
+    bool _overrun_flag = false; // samples were lost to a late read since the last clear
     uint16_t _max_buffer_size = 96; // by default
     uint64_t _drdy_timestamp;
+    bool _drdy_timestamp_valid = false;
     uint64_t _last_timestamp = 0;
     uint64_t _last_broadcast_timestamp = 0;
     uint32_t _measurement_frequencyx100;
     uint8_t _frequency = 24.0; // default value, can change
+    uint8_t _batch_size = BAROMETER_FIFO_SIZE; // samples per interrupt
+
+    SampleClock _sample_clock;
+    uint32_t _samples_read = 0; // total samples read out of the FIFO since initialize()
+    uint32_t _buffer_start_index = 0; // sample index of the first element in the buffers
 
     BusControl *_bus_control;
     LPS22HBSensor _barometer;
     InterruptIn _int_pin;
     LowPowerTimer _t_barometer;
+    EventFlags _data_ready_flags;
 
     Logger* _logger;
+    WaveformStreamer* _streamer;
 
     void bar_data_ready();
-    bool read_buffered_data();
+    bool read_buffered_data(uint8_t num_samples);
 
-    const uint8_t BAROMETER_FIFO_SIZE = 32;
+    static const uint8_t BAROMETER_FIFO_SIZE = 32;
+    static const uint32_t DATA_READY_FLAG = 1;
 };
 
 #endif //BAROMETER_H_
\ No newline at end of file
@@ -0,0 +1,116 @@
+/**
+ * @file BreathFilter.h
+ * @author agent agent@local
+ * @brief Breathing band-pass filter and breath (zero-cross) detection
+ * @version 0.1
+ * @date 2026-10-19
+ * 
+ * @copyright Copyright (c) 2026 Ka Moamoa
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, version 3 of the license.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef BREATHFILTER_H_
+#define BREATHFILTER_H_
+
+#include <stdint.h>
+#include "../iir-filter-kit/BiQuad.h"
+
+/**
+ * 2nd order bandpass (1/15-1 Hz) Butterworth filter with the zero-cross
+ * detection that mask detection, mask fit and respiratory rate all run
+ * on its output.
+ * 
+ * A breath runs from one descending zero-cross of the filtered signal to
+ * the next. The first cross only marks where the first whole breath
+ * starts, so step() reports breaths from the second cross on.
+ */
+class BreathFilter
+{
+public:
+    static const uint8_t FREQUENCY = 10; // hz, the biquads are designed for 10 Hz
+    static const uint8_t NUM_BIQUADS = 2;
+
+    /**
+     * Everything needed to carry on filtering after a brownout. The
+     * BiQuads are saved byte-for-byte, they have no accessors for their
+     * delay line.
+     */
+    typedef struct
+    {
+        uint8_t biquads[NUM_BIQUADS][sizeof(BiQuad)];
+        double last;
+        float peak;
+        float trough;
+        uint16_t length;
+        bool primed;
+        bool crossed;
+    } State_t;
+
+    BreathFilter();
+
+    /**
+     * @brief Settle the filter on a constant input so it doesn't ring
+     * for the first few breaths. Call with the first sample.
+     */
+    void prime(double sample);
+    bool is_primed() { return _primed; };
+
+    /**
+     * @brief Filter one sample
+     * 
+     * @return true if the sample ends a breath. get_peak(), get_trough()
+     * and get_length() then describe that breath.
+     */
+    bool step(double sample);
+
+    double get_value() { return _last; };
+    bool is_descending_cross() { return _descending; };
+    bool is_ascending_cross() { return _ascending; };
+
+    float get_peak() { return _breath_peak; };
+    float get_trough() { return _breath_trough; };
+    uint16_t get_length() { return _breath_length; }; // samples
+
+    void save(State_t &state);
+    void restore(const State_t &state);
+
+private:
+    /**
+     * Documentation can be found in BiQuad.h. BiQuads were 
+     * generated with filter-designer.py assuming 10 Hz sampling frequency.
+     */
+    BiQuad _bq1 = BiQuad( 0.06004382,  0.12008764,  0.06004382,  1.,         -1.21246615,  0.46367415);
+    BiQuad _bq2 = BiQuad( 1.,         -2.,          1.,          1.,         -1.94162756,  0.94354483);
+
+    static const uint16_t PRIME_SAMPLES = FREQUENCY * 200;
+
+    double _last = -1.0;
+    bool _primed = false;
+    bool _crossed = false; // seen the first descending cross
+
+    // the breath in progress
+    float _peak = 0;
+    float _trough = 0;
+    uint16_t _length = 0;
+
+    // the last breath step() reported
+    float _breath_peak = 0;
+    float _breath_trough = 0;
+    uint16_t _breath_length = 0;
+
+    bool _descending = false;
+    bool _ascending = false;
+};
+
+#endif // BREATHFILTER_H_
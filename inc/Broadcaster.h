@@ -0,0 +1,125 @@
+/**
+ * @file Broadcaster.h
+ * @author agent agent@local
+ * @brief Connectionless sync of the latest readings in advertising data
+ * @version 0.1
+ * @date 2026-10-19
+ * 
+ * @copyright Copyright (c) 2026 Ka Moamoa
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, version 3 of the license.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef BROADCASTER_H_
+#define BROADCASTER_H_
+
+#include "mbed.h"
+#include "rtos.h"
+#include "events/mbed_events.h"
+#include "ble/BLE.h"
+#include "Logger.h"
+
+using namespace std::chrono;
+
+/**
+ * Connectionless sync: the latest readings go out in manufacturer specific
+ * advertising data, so a phone that is only scanning still collects them.
+ * A GATT connection is then only needed for bulk backfill.
+ *
+ * The manufacturer data (after the 2-byte company ID) is
+ *
+ *     version (u8) | sequence (u8) | mask state (u8) | reference timestamp (u32 LE) | records
+ *
+ * with records in the RecordStream varint format, oldest first. The
+ * reference is the oldest record's timestamp, in seconds since the epoch
+ * as on RECORDS (see SmartPPEService.h). The payload only changes with
+ * the readings, so it is rebuilt when the sequence number goes up (every
+ * new reading or mask state) and when the phone sets the time, never on
+ * a timer. The sequence lets the phone tell a new payload from a repeat.
+ * The history always carries the newest reading of each type, then as
+ * many recent ones as fit.
+ *
+ * The broadcast uses its own non-connectable legacy advertising set, next
+ * to the BLE process's connectable one, and pauses while the supercap is
+ * below the energy monitor's low threshold. Controllers with a single set
+ * get it in the scan response instead (active scanners only), which only
+ * goes out while a sync window is open.
+ */
+class Broadcaster
+{
+public:
+    static const uint8_t VERSION = 2;
+    static const uint16_t COMPANY_ID = 0xFFFF; // reserved for testing
+    static const uint8_t HISTORY_SIZE = 8;
+
+    Broadcaster(events::EventQueue &queue);
+    ~Broadcaster();
+
+    // safe from any thread; each one queues a payload rebuild
+    void add_reading(uint8_t type, uint16_t value);
+    void set_mask_state(uint8_t state);
+    void refresh(); // the wall time changed
+
+    /**
+     * @brief Pause our advertising set below the energy monitor's low
+     * threshold, resume once it's back above the OK one. Safe from any
+     * thread.
+     */
+    void set_energy_low(bool low);
+
+    /**
+     * @brief Start broadcasting. Call from the BLE thread once the stack
+     * is initialised.
+     */
+    void start(BLE &ble);
+    void stop(); // safe from any thread
+
+    uint8_t get_sequence() { return _sequence; };
+
+private:
+    typedef struct
+    {
+        uint8_t type;
+        uint16_t value;
+        uint32_t timestamp; // monotonic s
+    } Reading_t;
+
+    void _schedule_refresh();
+    void _refresh();
+    void _update_advertising();
+    uint8_t _build(uint8_t *data, uint8_t max_length);
+    uint8_t _encode(const Reading_t *candidates, const bool *chosen, uint8_t count, uint8_t *records, int16_t *oldest);
+    uint32_t _now();
+
+    events::EventQueue &_queue;
+    BLE *_ble = nullptr;
+    Logger* _logger;
+    Mutex _history_mutex;
+
+    ble::advertising_handle_t _handle = ble::LEGACY_ADVERTISING_HANDLE;
+    bool _own_set = false;
+    bool _energy_low = false;
+    volatile bool _refresh_pending = false;
+
+    Reading_t _history[HISTORY_SIZE];
+    uint8_t _history_count = 0;
+    uint8_t _history_next = 0;
+    uint8_t _sequence = 0;
+    uint8_t _mask_state = 0;
+
+    const milliseconds ADVERTISING_INTERVAL = 1000ms;
+    static const uint8_t MAX_DATA_SIZE = 31 - 3 - 2; // manufacturer data with company ID: advertising data less the flags and the AD header
+    static const uint8_t HEADER_SIZE = 2 + 7; // company ID + our header
+};
+
+#endif // BROADCASTER_H_
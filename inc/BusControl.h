@@ -50,13 +50,53 @@ public:
 
     void init(void);
 
-    void set_power_lock(Devices device, bool lock);
-
-    void spi_power(bool power);
-    void i2c_power(bool power);
+    /**
+     * @brief Reference-counted per-device power. A rail is switched on by the
+     * first acquire() and off by the matching last release(); the shared bus
+     * is up while any of its devices holds it.
+     * 
+     * @return true if this call switched the rail on (the device needs its
+     * power-up time), false if it was already on
+     */
+    bool acquire(Devices device);
+    void release(Devices device);
+    void power_cycle(Devices device); // off and back on regardless of holders, e.g. to reset a wedged chip
+    bool is_powered(Devices device);
+
+    /**
+     * @brief acquire() the device and wait until it answers its ready probe
+     * (WHO_AM_I, RDID, ...) instead of sleeping for a fixed time. Only the
+     * first caller after the rail switches on probes; anyone acquiring it
+     * while that's under way waits for the outcome, and later callers
+     * return at once.
+     * 
+     * @return false if the device didn't answer within READY_TIMEOUT. The
+     * rail is still held, so the caller must release() it either way.
+     */
+    bool power_up(Devices device, Callback<bool()> probe);
+
+    /**
+     * @brief Wait out the device's minimum power-up time, counted from when
+     * its rail switched on, then poll probe until it returns true.
+     */
+    bool wait_until_ready(Devices device, Callback<bool()> probe);
+
+    microseconds get_rail_on_time(Devices device); // total time the rail has been on since init()
+    void reset_rail_on_time();
+    void log_rail_on_time();
     
-    void blink_led(milliseconds length);
+    /**
+     * @brief Blink the status LED set_led_blinks() times every period, timed
+     * by a LowPowerTicker (no thread). Blinks are shortened when stored
+     * energy is low and skipped when it is critical; feed the latest
+     * CapCalc reading with set_indicator_energy().
+     */
+    void start_indicator(milliseconds period, milliseconds blink_length);
+    void stop_indicator();
     void set_led_blinks(uint8_t num_blinks) { _num_blinks = num_blinks; };
+    void set_indicator_energy(float joules) { _available_energy = joules; };
+    float get_led_energy() { return _led_energy; }; // joules spent on the LED since start_indicator()
+    uint32_t get_skipped_blinks() { return _skipped_blinks; };
 
     bool get_spi_power();
     bool get_i2c_power();
@@ -88,25 +128,69 @@ private:
     DigitalOut _led; // must be high drive
     uint8_t _num_blinks = 1;
 
+    LowPowerTicker _indicator_ticker;
+    LowPowerTimeout _led_timeout;
+    milliseconds _blink_length = 10ms;
+    milliseconds _current_blink_length = 10ms;
+    volatile uint8_t _blinks_remaining = 0;
+    volatile float _available_energy = -1; // joules, < 0 until the first reading
+    float _led_energy = 0;
+    uint32_t _skipped_blinks = 0;
+
+    void _indicator_tick();
+    void _led_on();
+    void _led_off();
+
     // Initialized flag
     bool _initialized = false;
 
-    struct power_lock_t
+    typedef enum
     {
-        bool fram;
-        bool magnetometer;
-        bool barometer;
-        bool imu;
-        bool thermometer;
-        bool voc;
+        RAIL_OFF,
+        RAIL_ON, // readiness unknown: switched on by acquire(), or the last probe failed
+        RAIL_PROBING, // a power_up() caller is waiting for the device
+        RAIL_READY
+    } RailState_t;
+
+    uint8_t _holders[DEVICES_LAST] = {0};
+    bool _rail_on[DEVICES_LAST] = {false};
+    RailState_t _rail_state[DEVICES_LAST] = {RAIL_OFF};
+    EventFlags _ready_flags; // bit per device, set when a probe finishes
+    microseconds _rail_on_since[DEVICES_LAST];
+    microseconds _rail_on_time[DEVICES_LAST];
+    LowPowerTimer _uptime;
+    Mutex _power_mutex;
+
+    /**
+     * Turning the I2C rails off actually results in _higher_ current
+     * consumption than leaving them on, which is why the original firmware
+     * never switched that bus off. Their rails stay up after the last
+     * release().
+     */
+    const bool I2C_KEEP_ON = true;
+
+    // earliest time after rail-on that a probe is worth sending, per device
+    const microseconds READY_MIN_WAIT[DEVICES_LAST] = {
+        250us, // FRAM: power-up time tPU
+        1ms,   // MAGNETOMETER
+        2ms,   // BAROMETER: boot
+        5ms,   // IMU: boot
+        1ms,   // THERMOMETER: NACKs until powered up, so just poll
+        1ms    // VOC
     };
+    const milliseconds READY_TIMEOUT = 100ms;
 
-    power_lock_t power_lock;
+    bool _is_i2c(Devices device) { return device == THERMOMETER || device == VOC; }
+    void _set_rail(Devices device, bool power);
 
     static BusControl* _instance;
     static Mutex _mutex;
 
-    const float LED_ENERGY = 0.001;
+    const float LED_ENERGY = 0.001; // joules per nominal (10 ms) blink
+    const milliseconds LED_NOMINAL_BLINK = 10ms;
+    const milliseconds LED_BLINK_GAP = 250ms;
+    const float INDICATOR_LOW_ENERGY = 10 * LED_ENERGY; // below this, a single short blink
+    const float INDICATOR_MIN_ENERGY = 3 * LED_ENERGY; // below this, don't blink at all
 
     bool _spi_power = false;
     bool _i2c_power = false;
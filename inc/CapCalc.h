@@ -32,6 +32,37 @@ public:
 
     float read_voltage();
     float calc_joules();
+    float calc_joules(float voltage); // usable energy at a voltage already read, no SAADC sample
+
+    /**
+     * Arms the LPCOMP on the capacitor divider with a hysteresis band.
+     * While the energy is OK the comparator watches for the voltage
+     * dropping below low_v; once it has, it watches for it climbing back
+     * above high_v. Each crossing fires an interrupt, so the firmware is
+     * woken without polling the SAADC. The comparator reference is a
+     * sixteenth of VDD, so the thresholds are rounded to the nearest step;
+     * get_low_threshold()/get_high_threshold() return what was armed.
+     * The divider stays enabled while monitoring.
+     */
+    bool start_monitor(float low_v, float high_v);
+    void stop_monitor();
+
+    /**
+     * Sleeps for at most duration, returning early (true) if the capacitor
+     * crossed a monitor threshold in the meantime.
+     */
+    bool wait_for_crossing(Kernel::Clock::duration_u32 duration);
+
+    bool is_energy_low() { return _energy_low; };
+    float get_low_threshold() { return _low_threshold; };
+    float get_high_threshold() { return _high_threshold; };
+    uint32_t get_crossing_count() { return _crossing_count; };
+
+    /**
+     * EWMA of dV/dt in volts per second, updated on every read_voltage().
+     * Positive when the harvester is out-pacing the load.
+     */
+    float get_charge_rate() { return _charge_rate; };
 
     CapCalc(CapCalc &other) = delete;
     void operator=(const CapCalc &) = delete;
@@ -43,9 +74,33 @@ private:
     static CapCalc *_instance;
     static Mutex _mutex;
 
+    static void _lpcomp_irq();
+    float _read_vdd();
+    void _arm_lpcomp(bool rising);
+
     AnalogIn _cap_voltage;
     DigitalOut _cap_voltage_en;
     uint32_t _capacitance_uF = 3000;
+
+    const float DIVIDER_RATIO = 2.80;
+    const uint8_t VDD_CHANNEL = 2; // channel 1 is the capacitor divider
+    const float CHARGE_RATE_ALPHA = 0.25; // weight of the newest dV/dt sample
+    const uint32_t CROSSING_FLAG = (1UL << 0);
+
+    EventFlags _crossing_flags;
+    LowPowerTimer _rate_timer;
+    std::chrono::microseconds _last_read_time = 0us;
+    float _last_voltage = 0;
+    bool _has_last_voltage = false;
+    float _charge_rate = 0;
+
+    bool _monitoring = false;
+    volatile bool _energy_low = false;
+    volatile uint32_t _crossing_count = 0;
+    float _low_threshold = 0;
+    float _high_threshold = 0;
+    uint32_t _low_refsel = 0;
+    uint32_t _high_refsel = 0;
 };
 
 #endif // CAPCALC_H_
\ No newline at end of file
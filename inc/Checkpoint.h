@@ -0,0 +1,112 @@
+/**
+ * @file Checkpoint.h
+ * @author agent agent@local
+ * @brief Just-in-time checkpoints of in-progress captures in FRAM
+ * @version 0.1
+ * @date 2026-10-19
+ * 
+ * @copyright Copyright (c) 2026 Ka Moamoa
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, version 3 of the license.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef CHECKPOINT_H_
+#define CHECKPOINT_H_
+
+#include "mbed.h"
+#include "rtos.h"
+#include "FRAM.h"
+#include "Logger.h"
+
+/**
+ * Just-in-time checkpoints of an in-progress capture. When the supercap
+ * crosses the low threshold, a capture saves its state here and stops;
+ * the next run of the same task (in this boot or after a brownout) loads
+ * it and carries on instead of starting over.
+ *
+ * There are two slots in FRAM, written alternately, each with a sequence
+ * number and CRC. A save that is cut off by the brownout leaves the
+ * previous slot intact, so we never resume from a half-written state.
+ */
+class Checkpoint
+{
+public:
+    enum Task_t
+    {
+        TASK_NONE = 0,
+        TASK_HEART_RATE,
+        TASK_RESPIRATORY_RATE
+    };
+
+    static const uint16_t MAX_STATE_SIZE = 2048 - 16; // slot minus header
+
+    Checkpoint(Checkpoint &other) = delete;
+    void operator=(const Checkpoint &) = delete;
+
+    static Checkpoint* get_instance();
+
+    /**
+     * @brief Find the newest valid slot in FRAM.
+     */
+    bool initialize(FRAM* fram);
+
+    bool save(Task_t task, const void* state, uint16_t length);
+
+    /**
+     * @brief Copy the pending checkpoint into state. Fails if there is
+     * none, or it belongs to another task or has a different size
+     * (i.e. was written by other firmware).
+     */
+    bool load(Task_t task, void* state, uint16_t length);
+
+    bool discard(Task_t task); // only if the pending checkpoint is task's
+
+    Task_t get_pending() { return (Task_t)_header.task; }
+    uint32_t get_save_count() { return _save_count; }
+
+private:
+    Checkpoint();
+    ~Checkpoint();
+
+    typedef struct __attribute__((packed))
+    {
+        uint32_t magic;
+        uint32_t sequence;
+        uint8_t task;
+        uint8_t reserved;
+        uint16_t length;
+        uint32_t crc; // over the rest of the header and the state, so a torn header can't pass either
+    } Header_t;
+
+    static const uint32_t SLOTS_ADDR = 0x18000; // after the event log ring
+    static const uint16_t SLOT_SIZE = 2048;
+    static const uint32_t MAGIC = 0xFBC4EC20;
+
+    uint32_t _slot_addr(uint8_t slot) { return SLOTS_ADDR + slot * SLOT_SIZE; }
+    bool _read_slot(uint8_t slot, Header_t &header);
+    uint32_t _crc(const Header_t &header, const void* data, uint16_t length);
+    bool _write(Task_t task, const void* state, uint16_t length);
+
+    static Checkpoint* _instance;
+    static Mutex _mutex;
+
+    Logger* _logger;
+    FRAM* _fram = nullptr;
+    Mutex _checkpoint_mutex;
+
+    Header_t _header = {0, 0, TASK_NONE, 0, 0, 0}; // newest valid slot
+    uint8_t _slot = 0; // where _header lives
+    uint32_t _save_count = 0;
+};
+
+#endif // CHECKPOINT_H_
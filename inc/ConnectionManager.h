@@ -0,0 +1,154 @@
+/**
+ * @file ConnectionManager.h
+ * @author agent agent@local
+ * @brief Connection parameter policy and sync windows for the BLE link
+ * @version 0.1
+ * @date 2026-10-19
+ * 
+ * @copyright Copyright (c) 2026 Ka Moamoa
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, version 3 of the license.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef CONNECTIONMANAGER_H_
+#define CONNECTIONMANAGER_H_
+
+#include "mbed.h"
+#include "events/mbed_events.h"
+#include "ble/BLE.h"
+#include "Logger.h"
+
+/**
+ * Connection parameter policy for sync. Bulk transfers want a short
+ * connection interval so they finish in few connection events; the rest of
+ * the connection (handshakes, time sync, waiting on the phone) wants a long
+ * interval with slave latency, so the radio mostly sleeps.
+ *
+ * The stack stays up between syncs. A sync opens a window (connectable
+ * advertising), waits for the phone, and closes it again by disconnecting
+ * and going quiet, so between syncs the radio is off without a reboot.
+ *
+ * Gap only takes one event handler, so the manager stands in for the BLE
+ * process's handler and forwards every event to it.
+ */
+class ConnectionManager : public ble::Gap::EventHandler
+{
+public:
+    enum Profile_t
+    {
+        PROFILE_IDLE,
+        PROFILE_BULK
+    };
+
+    ConnectionManager(events::EventQueue &queue);
+    ~ConnectionManager();
+
+    /**
+     * @brief Install the manager as Gap's event handler, forwarding to
+     * chained. Call from the BLE thread once the stack is initialised.
+     */
+    void attach(BLE &ble, ble::Gap::EventHandler *chained);
+
+    /**
+     * @brief Called from the BLE thread each time the link goes down, for
+     * the GATT side, which doesn't hear about it from the stack.
+     */
+    void on_disconnection(mbed::Callback<void()> callback) { _on_disconnection = callback; };
+
+    /**
+     * @brief Ask for a profile. Safe from any thread; the request runs on
+     * the BLE event queue, and is applied on connection if there is none.
+     * Only one update is in flight at a time: a profile asked for while
+     * the link is still applying the last one (several connection events,
+     * seconds at the idle interval) goes out once that completes.
+     */
+    void request(Profile_t profile);
+
+    /**
+     * @brief Start connectable advertising, unless already connected.
+     * Safe from any thread.
+     */
+    void open();
+
+    /**
+     * @brief Disconnect, if connected, and stop advertising. Safe from any
+     * thread; wait_for_disconnection() tells when the link is down. A
+     * connection the phone had already asked for completes regardless,
+     * and is dropped as soon as it does.
+     */
+    void close();
+
+    bool is_attached() { return _attached; };
+    bool is_connected() { return _connected; };
+    bool wait_for_attach(Kernel::Clock::duration_u32 timeout);
+    bool wait_for_connection(Kernel::Clock::duration_u32 timeout);
+    bool wait_for_disconnection(Kernel::Clock::duration_u32 timeout);
+
+    uint16_t get_interval_units() { return _interval; } // 1.25 ms
+    uint16_t get_latency() { return _latency; }
+    uint16_t get_timeout_units() { return _timeout; } // 10 ms
+
+private:
+    void _apply();
+    void _log_parameters(const char *reason);
+    void _set_advertising(bool enable);
+    bool _wait_for(uint32_t flag, Kernel::Clock::duration_u32 timeout);
+
+    void onConnectionComplete(const ble::ConnectionCompleteEvent &event) override;
+    void onDisconnectionComplete(const ble::DisconnectionCompleteEvent &event) override;
+    void onConnectionParametersUpdateComplete(const ble::ConnectionParametersUpdateCompleteEvent &event) override;
+    void onUpdateConnectionParametersRequest(const ble::UpdateConnectionParametersRequestEvent &event) override;
+    void onDataLengthChange(ble::connection_handle_t connectionHandle, uint16_t txSize, uint16_t rxSize) override;
+    void onPhyUpdateComplete(ble_error_t status, ble::connection_handle_t connectionHandle, ble::phy_t txPhy, ble::phy_t rxPhy) override;
+    void onReadPhy(ble_error_t status, ble::connection_handle_t connectionHandle, ble::phy_t txPhy, ble::phy_t rxPhy) override;
+    void onAdvertisingEnd(const ble::AdvertisingEndEvent &event) override;
+
+    events::EventQueue &_queue;
+    BLE *_ble = nullptr;
+    ble::Gap::EventHandler *_chained = nullptr;
+    mbed::Callback<void()> _on_disconnection;
+    Logger* _logger;
+
+    volatile bool _attached = false;
+    volatile bool _connected = false;
+    bool _open = false; // advertising wanted, the BLE process restarts it on disconnect regardless
+    ble::connection_handle_t _handle = 0;
+    Profile_t _profile = PROFILE_IDLE; // wanted
+    Profile_t _link_profile = PROFILE_IDLE; // last one asked of the link
+    bool _link_profile_valid = false; // false until we've asked for one on this connection
+    bool _updating = false; // waiting for onConnectionParametersUpdateComplete
+
+    // negotiated values, in the units the link layer uses
+    uint16_t _interval = 0;
+    uint16_t _latency = 0;
+    uint16_t _timeout = 0;
+
+    EventFlags _link_flags;
+    static const uint32_t ATTACHED_FLAG = 1 << 0;
+    static const uint32_t CONNECTED_FLAG = 1 << 1;
+    static const uint32_t DISCONNECTED_FLAG = 1 << 2;
+
+    // 7.5-15 ms, no latency
+    const uint16_t BULK_MIN_INTERVAL = 6;
+    const uint16_t BULK_MAX_INTERVAL = 12;
+    const uint16_t BULK_LATENCY = 0;
+    const uint16_t BULK_TIMEOUT = 400; // 4 s
+
+    // 400-500 ms, the phone can go 4 intervals without hearing from us
+    const uint16_t IDLE_MIN_INTERVAL = 320;
+    const uint16_t IDLE_MAX_INTERVAL = 400;
+    const uint16_t IDLE_LATENCY = 4;
+    const uint16_t IDLE_TIMEOUT = 600; // 6 s, above (1 + latency) * interval * 2
+};
+
+#endif // CONNECTIONMANAGER_H_
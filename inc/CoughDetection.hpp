@@ -0,0 +1,120 @@
+/**
+ * @file CoughDetection.hpp
+ * @author agent agent@local
+ * @brief Cough detection on a high-rate barometer stream
+ * @version 0.1
+ * @date 2026-10-19
+ * 
+ * @copyright Copyright (c) 2026 Ka Moamoa
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, version 3 of the license.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef COUGHDETECTION_H_
+#define COUGHDETECTION_H_
+
+#include <stdint.h>
+#include "SampleClock.h"
+
+/**
+ * Streaming cough detector for the barometer stream SensorSession runs
+ * while the mask is on. The session hands over each FIFO burst; this
+ * only keeps per-sample features and a queue of accepted events, so it
+ * runs on the host as well (see tools/host/cough_bench.cpp).
+ */
+class CoughDetection
+{
+public:
+    typedef struct
+    {
+        uint32_t timestamp; // s, on the clock passed to start()
+        uint16_t peak; // Pa above baseline
+        uint8_t duration; // 10 ms units
+        uint8_t peak_count;
+    } CoughEvent_t;
+
+    static const uint8_t EVENT_QUEUE_SIZE = 16;
+    static const uint8_t SAMPLING_FREQUENCY = 50; // hz, the LPS22HB's next step up is 75 Hz
+
+    CoughDetection();
+    ~CoughDetection();
+
+    void start(SampleClock* clock, uint32_t start_timestamp);
+    void restart();
+    void process(const uint16_t* pressure, uint16_t size, uint32_t start_index);
+
+    bool get_event(CoughEvent_t &event);
+    uint8_t get_num_events() { return _num_events; };
+    uint32_t get_num_candidates() { return _num_candidates; };
+
+private:
+    SampleClock* _clock = nullptr;
+    uint32_t _start_timestamp = 0;
+
+    // oldest events are dropped if nobody collects them
+    CoughEvent_t _events[EVENT_QUEUE_SIZE];
+    uint8_t _first_event = 0;
+    uint8_t _num_events = 0;
+    uint32_t _num_candidates = 0;
+
+    // streaming feature state
+    bool _initialized = false;
+    float _baseline = 0;
+    float _breath = 0;
+    float _breath_slow = 0;
+    float _energy = 0;
+    float _background = 0; // of the energy, outside candidates
+    float _last_pressure = 0;
+    float _last_deviation = 0;
+    float _last_last_deviation = 0;
+    float _slope_hold = 0; // decaying max of the rise slope, since energy lags the onset
+
+    // candidate event state
+    bool _in_event = false;
+    uint32_t _event_start_index = 0;
+    uint32_t _event_length = 0;
+    float _event_peak = 0;
+    float _event_max_slope = 0;
+    uint8_t _event_peak_count = 0;
+    float _off_threshold = 0; // set from the background at the start
+    float _peak_threshold = 0;
+
+    void _end_event();
+
+    /**
+     * Energy and peaks are taken on the signal less its breath (a
+     * second-order high pass), and a candidate has to stand out from the
+     * running energy of what's left rather than clear a fixed level: heavy
+     * breathing leaks through with several times the energy of a weak
+     * cough at rest. The floors keep sensor noise out when the wearer is
+     * still. Tuned on tools/host/cough_bench.cpp's synthetic traces, so
+     * retune as we collect recorded coughs. Pressures are in Pa
+     * (barometer raw units).
+     */
+    const float BASELINE_ALPHA = 0.01; // ~2 s time constant at 50 Hz, follows breathing drift
+    const float BREATH_ALPHA = 0.2; // ~1.6 Hz per pole, above 40 breaths/min
+    const float ENERGY_ALPHA = 0.2; // ~100 ms short-time energy window
+    const float BACKGROUND_ALPHA = 0.005; // ~4 s, frozen during a candidate
+    const float ENERGY_ON_FLOOR = 7.0 * 7.0; // Pa^2
+    const float ENERGY_OFF_FLOOR = 5.0 * 5.0; // Pa^2
+    const float ON_RATIO = 12; // start of a candidate, times the background energy
+    const float OFF_RATIO = 2; // end of a candidate (hysteresis)
+    const float PEAK_RATIO = 0.8; // of the on threshold's amplitude, for a local max to count as a peak
+    const float SLOPE_RATIO = 0.3; // of the peak threshold per sample, coughs rise much faster than breaths
+    const float SLOPE_DECAY = 0.8; // per sample
+    const uint8_t MAX_PEAKS = 4; // more than this is talking or movement
+    const uint16_t MIN_EVENT_SAMPLES = 10; // 200 ms
+    const uint16_t MAX_EVENT_SAMPLES = 75; // 1.5 s
+};
+
+#endif // COUGHDETECTION_H_
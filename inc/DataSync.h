@@ -0,0 +1,111 @@
+/**
+ * @file DataSync.h
+ * @author agent agent@local
+ * @brief One sync of the buffered readings, coughs and event log with the phone
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026 Ka Moamoa
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, version 3 of the license.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef DATASYNC_H_
+#define DATASYNC_H_
+
+#include "mbed.h"
+#include "rtos.h"
+#include "Logger.h"
+#include "SmartPPEService.h"
+#include "ConnectionManager.h"
+#include "RecordStream.h"
+#include "CoughDetection.hpp"
+#include "EventLog.h"
+#include "TimeBase.h"
+
+using namespace std::chrono;
+
+/**
+ * The GATT side of a sync, once the window is open: wait for the phone,
+ * then the MASK_ON handshake and the time, then the buffered records,
+ * coughs and event log. Each payload is announced on DATA_READY and
+ * repeated until the phone acknowledges it (see
+ * SmartPPEService::getDataReady()), and only leaves its buffer then, so a
+ * sync that times out part way sends just the rest next time.
+ *
+ * FaceBitState owns the buffers and the stack; this only needs the
+ * service and the connection manager, so tools/host/sync_bench.cpp runs
+ * it against a scripted phone.
+ */
+class DataSync
+{
+public:
+    // RecordStream types, as FaceBitState::FACEBIT_DATA_TYPES_t
+    enum RecordType_t
+    {
+        RECORD_HEART_RATE,
+        RECORD_RESPIRATORY_RATE,
+        RECORD_MASK_FIT,
+        RECORD_TYPE_LAST
+    };
+
+    typedef CircularBuffer<CoughDetection::CoughEvent_t, 32> CoughBuffer_t; // oldest events are dropped if we can't sync
+
+    DataSync(SmartPPEService *service, ConnectionManager &conn_manager, RecordStream &records, CoughBuffer_t &coughs);
+    ~DataSync();
+
+    /**
+     * @brief Called once the phone has set a new time, for whatever holds
+     * timestamps on the old offset.
+     */
+    void on_time_set(mbed::Callback<void()> callback) { _on_time_set = callback; };
+
+    /**
+     * @brief Wait for the phone (the window must be open) and send it
+     * everything. mask_state_change_ts is monotonic seconds. Returns false
+     * on a timeout, which goes in the event log.
+     */
+    bool run(uint16_t mask_state, uint32_t mask_state_change_ts);
+
+    /**
+     * @brief Close the window and wait for the link to go down. Returns
+     * false (and logs the timeout) if it doesn't.
+     */
+    bool close();
+
+    const milliseconds CONNECTION_TIMEOUT = 5000ms;
+    const milliseconds DRDY_TIMEOUT = 5000ms; // for the phone to acknowledge each payload
+    const milliseconds DISCONNECT_TIMEOUT = 2000ms;
+    const milliseconds MASK_ON_POLL = 500ms;
+    const milliseconds DATA_POLL = 1000ms;
+
+private:
+    bool _announce(SmartPPEService::data_ready_t type, milliseconds poll, EventLog::Timeout_t timeout, const char *name);
+    bool _send_records();
+    bool _send_coughs();
+    bool _send_event_log();
+    void _record_timeout(EventLog::Timeout_t timeout);
+    void _log_throughput(microseconds duration);
+
+    SmartPPEService* _service;
+    ConnectionManager &_conn_manager;
+    RecordStream &_records;
+    CoughBuffer_t &_coughs;
+    mbed::Callback<void()> _on_time_set;
+
+    Logger* _logger;
+    EventLog* _event_log;
+    TimeBase* _time_base;
+};
+
+#endif // DATASYNC_H_
@@ -0,0 +1,130 @@
+/**
+ * @file EventLog.h
+ * @author agent agent@local
+ * @brief Persistent binary event log in FRAM for post-mortem analysis
+ * @version 0.1
+ * @date 2026-10-19
+ * 
+ * @copyright Copyright (c) 2026 Ka Moamoa
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, version 3 of the license.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef EVENTLOG_H_
+#define EVENTLOG_H_
+
+#include "mbed.h"
+#include "rtos.h"
+#include "FRAM.h"
+#include "Logger.h"
+
+/**
+ * Persistent binary event log for post-mortem analysis of field units.
+ * Events are staged in RAM and written to a ring in FRAM one batch at a
+ * time, so the rail is powered once per batch. The ring survives resets
+ * and is drained over BLE during sync.
+ */
+class EventLog
+{
+public:
+    enum EventType_t
+    {
+        EVENT_RESET = 1,    // arg: unused, value: RESETREAS (pin/dog/sreq/lockup in bits 0-3, off/lpcomp/dif/nfc in 4-7)
+        EVENT_MASK,         // arg: new mask state
+        EVENT_TASK,         // arg: task started
+        EVENT_CAPTURE,      // arg: task, value: duration in 100 ms units
+        EVENT_SENSOR_ERROR, // arg: task (or TASK_STATE_LAST for the off-face mask check)
+        EVENT_TIMEOUT,      // arg: Timeout_t
+        EVENT_ENERGY,       // arg: 1 if the capacitor dropped below the low threshold, 0 if it recovered, value: voltage in mV
+        EVENT_SYNC,         // arg: ATT MTU (capped at 255), value: payload throughput in bytes/s
+        EVENT_SYNC_CYCLE,   // arg: 1 if the BLE stack was brought up for it, value: whole sync cycle in 10 ms units
+        EVENT_TYPE_LAST
+    };
+
+    enum Timeout_t
+    {
+        TIMEOUT_BLE_CONNECTION,
+        TIMEOUT_BLE_MASK_ON,
+        TIMEOUT_BLE_DATA,
+        TIMEOUT_BLE_COUGH,
+        TIMEOUT_BLE_EVENT_LOG,
+        TIMEOUT_BLE_DISCONNECT
+    };
+
+    typedef struct __attribute__((packed))
+    {
+        uint32_t timestamp; // time(NULL) when recorded
+        uint8_t type;
+        uint8_t arg;
+        uint16_t value;
+    } Event_t;
+
+    static const uint16_t CAPACITY = 2048; // events in the FRAM ring (16 KB)
+
+    EventLog(EventLog &other) = delete;
+    void operator=(const EventLog &) = delete;
+
+    static EventLog* get_instance();
+
+    /**
+     * @brief Load the ring header from FRAM (formatting it on first use)
+     * and record why we reset.
+     */
+    bool initialize(FRAM* fram);
+
+    void record(EventType_t type, uint8_t arg = 0, uint16_t value = 0);
+    bool flush(); // write staged events and the header in one power cycle
+
+    uint32_t get_count() { return _header.count + _num_staged; } // total events ever recorded
+    uint32_t get_synced() { return _header.synced; }
+    bool set_synced(uint32_t synced);
+
+    /**
+     * @brief Read num_events events starting at index (an absolute count,
+     * as returned by get_synced()). Events that have been overwritten or
+     * not yet flushed are not available.
+     */
+    bool read(uint32_t index, Event_t* events, uint16_t num_events);
+    uint32_t get_oldest() { return _header.count > CAPACITY ? _header.count - CAPACITY : 0; }
+
+private:
+    EventLog();
+    ~EventLog();
+
+    typedef struct __attribute__((packed))
+    {
+        uint32_t magic;
+        uint32_t count;  // events written to FRAM since formatting
+        uint32_t synced; // events already sent over BLE
+    } Header_t;
+
+    static const uint32_t HEADER_ADDR = 0x10000; // upper half of the FRAM
+    static const uint32_t EVENTS_ADDR = HEADER_ADDR + 16;
+    static const uint32_t MAGIC = 0xFB0E1060;
+    static const uint8_t STAGE_SIZE = 16;
+
+    bool _write_header();
+
+    static EventLog* _instance;
+    static Mutex _mutex;
+
+    Logger* _logger;
+    FRAM* _fram = nullptr;
+    Mutex _log_mutex;
+
+    Header_t _header = {0, 0, 0};
+    Event_t _staged[STAGE_SIZE];
+    uint8_t _num_staged = 0;
+};
+
+#endif // EVENTLOG_H_
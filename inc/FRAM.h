@@ -14,11 +14,23 @@ public:
 
     bool write_bytes(uint32_t address, const char *tx_buffer, int tx_bytes);
     uint8_t read_bytes(uint32_t address, char *rx_buffer, int rx_bytes);
+
+    /**
+     * @brief Keep the SPI rail up across several read/write calls so a batch
+     * pays for one power cycle instead of one per call.
+     */
+    void hold_power(bool hold);
+
+    bool is_ready(); // RDID probe, used after power up
 private:
     SPI *_spi;
     DigitalOut _fram_cs;
     BusControl* _bus_control;
     Logger* _logger;
+    bool _power_held = false;
+
+    void _power_up();
+    void _power_down();
 
     bool _write_opcode(uint8_t opcode);
 
@@ -32,6 +32,18 @@
 #include "SmartPPEService.h"
 #include "Logger.h"
 #include "FRAM.h"
+#include "EventLog.h"
+#include "Checkpoint.h"
+#include "TimeBase.h"
+#include "MemoryStats.h"
+#include "RecordStream.h"
+#include "ConnectionManager.h"
+#include "DataSync.h"
+#include "Broadcaster.h"
+#include "CapCalc.h"
+#include "SensorSession.h"
+#include "CoughDetection.hpp"
+#include "MaskFit.hpp"
 
 using namespace std::chrono;
 
@@ -69,15 +81,24 @@ public:
 private:
     SPI _spi;
     I2C _i2c;
+    SensorSession _session; // barometer stream for coughs and mask checks while the mask is on
     BusControl* _bus_control;
     Logger* _logger;
-    // FRAM _fram;
+    FRAM _fram;
+    EventLog* _event_log;
+    Checkpoint* _checkpoint;
+    TimeBase* _time_base;
+    MemoryStats* _memory_stats;
     LowPowerTimer _state_timer;
 
 
     SmartPPEService* _smart_ppe_ble;
     static Thread _ble_thread;
     static events::EventQueue ble_queue;
+    GattServerProcess _ble_process; // started once, idles between syncs
+    bool _ble_started = false;
+    ConnectionManager _conn_manager; // fast interval for bulk transfers, slow otherwise, opens and closes the sync window
+    Broadcaster _broadcaster; // latest readings in advertising data, for phones that don't connect
     bool _force_update;
 
     DigitalIn _imu_cs;
@@ -91,7 +112,9 @@ private:
         uint16_t value;
     };
 
-    vector<FaceBitData> data_buffer;
+    RecordStream _records; // packed FaceBitData, see RecordStream.h
+    DataSync::CoughBuffer_t _cough_buffer;
+    DataSync _data_sync; // after the buffers it sends from
 
     MASK_STATE_t _mask_state = MASK_STATE_LAST;
     MASK_STATE_t _next_mask_state = OFF_FACE;
@@ -108,20 +131,30 @@ private:
 
     const uint32_t RR_PERIOD = 1000; // 1 second
     const uint32_t HR_PERIOD = 1000; // 1 second
+    const uint32_t MF_PERIOD = 10 * 60 * 1000; // 10 min, fit doesn't change much once the mask is on
     const uint32_t BLE_BROADCAST_PERIOD = 2 * 60 * 1000; // 2 min
 
-    const uint32_t BLE_CONNECTION_TIMEOUT = 5000;
-    const uint32_t BLE_DRDY_TIMEOUT = 5000;
+    // supercap band watched by the LPCOMP, see CapCalc::start_monitor. Captures checkpoint and stop below the low threshold
+    const float ENERGY_LOW_THRESHOLD = 2.4; // V
+    const float ENERGY_OK_THRESHOLD = 3.0; // V
+    const uint32_t INDICATOR_ENERGY_PERIOD = 5 * 60 * 1000; // 5 min, refreshes the LED's energy reading between crossings
 
-    uint64_t _mask_state_change_ts = 0; 
+    // per sync cycle, from opening the window to the link being down again
+    LowPowerTimer _sync_cycle_timer;
+    float _sync_start_joules = 0;
+    bool _sync_cold = false;
+
+    uint32_t _mask_state_change_ts = 0; // monotonic s
 
     uint32_t _last_rr_ts = 0;
     uint32_t _last_hr_ts = 0;
     uint32_t _last_mf_ts = 0;
     uint32_t _last_ble_ts = 0;
+    uint32_t _last_energy_ts = 0;
 
     const uint8_t RESP_RATE_FAILURE = 1;
     const uint8_t HR_FAILURE = 1;
+    const uint16_t MF_FAILURE = 0xFFFF; // scores are 0-100
 
     bool _ble_initialized = false;
 
@@ -132,6 +165,15 @@ private:
     const char INITIALIZE_STR[4] = {0xAB, 0xAF, 0xFA, 0xAA};
 
     bool _get_imu_int();
+    bool _end_check(bool suspended = false);
+    bool _sleep(CapCalc *cap_calc);
+    void _collect_coughs();
+    void _record_capture(TASK_STATE_t task, uint32_t start_ms);
+    void _store_record(const FaceBitData &data);
+    void _on_ble_init(BLE &ble, events::EventQueue &queue);
+    void _start_streaming();
+    void _start_ble();
+    void _end_sync();
     bool _sync_data();
     // bool _store_data_buffer();
     // uint64_t _retrieve_time();
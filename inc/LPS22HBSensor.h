@@ -94,18 +94,19 @@ class LPS22HBSensor : public PressureSensor, public TempSensor
     int read_reg(uint8_t reg, uint8_t *data);
     int write_reg(uint8_t reg, uint8_t data);
     int sw_reset(void);
+    int set_low_current(bool low_current);
     int enable_fifo(void);
     int get_fifo_enabled(uint8_t *enabled);
     int fifo_full_interrupt(bool enable);
     int set_interrupt_level(uint8_t intr);
-    int enable_fifo_watermark(void);
+    int enable_fifo_watermark(bool enable = true);
     int set_fifo_watermark(uint8_t level);
     int get_fifo_watermark(uint8_t *level);
-    int enable_fifo_watermark_interrupt(void);
+    int enable_fifo_watermark_interrupt(bool enable = true);
     int set_fifo_mode(uint8_t mode);
     int get_fifo_mode(uint8_t *mode);
     int get_fifo_status(LPS22HB_FifoStatus_st *status);
-    int get_fifo(std::vector<uint16_t> &pressure_buffer, std::vector<uint16_t> &temperature_buffer);
+    int get_fifo(uint16_t *pressure_buffer, uint16_t *temperature_buffer, uint8_t num_samples = FIFO_LENGTH);
     int get_pressure_fifo(float *pfData);
     int get_temperature_fifo(float *pfData);
     int differential_interrupt(bool enable, bool high_pressure, bool low_pressure);
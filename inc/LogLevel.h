@@ -0,0 +1,72 @@
+/**
+ * @file LogLevel.h
+ * @author agent agent@local
+ * @brief Log levels and the compile-time filtered LOG() macro
+ * @version 0.1
+ * @date 2026-10-19
+ * 
+ * @copyright Copyright (c) 2026 Ka Moamoa
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, version 3 of the license.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef LOGLEVEL_H_
+#define LOGLEVEL_H_
+
+typedef enum
+{
+    TRACE_TRACE,
+    TRACE_DEBUG,
+    TRACE_INFO,
+    TRACE_WARNING,
+    TRACE_LAST
+} trace_level_t;
+
+/**
+ * Build-time minimum log level. Calls below this level made through LOG()
+ * are removed by the preprocessor, arguments included, so they cost nothing
+ * in hot loops. Set through the "log-level" config option in mbed_app.json
+ * (0 = TRACE, 1 = DEBUG, 2 = INFO, 3 = WARNING). The runtime level passed to
+ * Logger::initialize() still filters whatever is compiled in.
+ */
+#ifndef FACEBIT_LOG_LEVEL
+#define FACEBIT_LOG_LEVEL 0
+#endif
+
+#define LOG(logger, level, ...) LOG_##level(logger, __VA_ARGS__)
+
+#if FACEBIT_LOG_LEVEL <= 0
+#define LOG_TRACE_TRACE(logger, ...) (logger)->log(TRACE_TRACE, __VA_ARGS__)
+#else
+#define LOG_TRACE_TRACE(logger, ...) ((void)0)
+#endif
+
+#if FACEBIT_LOG_LEVEL <= 1
+#define LOG_TRACE_DEBUG(logger, ...) (logger)->log(TRACE_DEBUG, __VA_ARGS__)
+#else
+#define LOG_TRACE_DEBUG(logger, ...) ((void)0)
+#endif
+
+#if FACEBIT_LOG_LEVEL <= 2
+#define LOG_TRACE_INFO(logger, ...) (logger)->log(TRACE_INFO, __VA_ARGS__)
+#else
+#define LOG_TRACE_INFO(logger, ...) ((void)0)
+#endif
+
+#if FACEBIT_LOG_LEVEL <= 3
+#define LOG_TRACE_WARNING(logger, ...) (logger)->log(TRACE_WARNING, __VA_ARGS__)
+#else
+#define LOG_TRACE_WARNING(logger, ...) ((void)0)
+#endif
+
+#endif // LOGLEVEL_H_
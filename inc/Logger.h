@@ -27,16 +27,19 @@
 #include "rtos.h"
 #include "UnbufferedSerial.h"
 #include "SWO.h"
+#include "UarteLogTransport.h"
+#include "LogLevel.h"
 
-typedef enum
-{
-    TRACE_TRACE,
-    TRACE_DEBUG,
-    TRACE_INFO,
-    TRACE_WARNING,
-    TRACE_LAST
-} trace_level_t;
-
+/**
+ * Deferred logging keeps each call down to a format-string scan and a copy of
+ * the raw argument words into a fixed ring of records. A low-priority thread
+ * does the formatting and output later. Arguments are stored as 32-bit words,
+ * with 64-bit integers and doubles taking two. %s arguments are stored as
+ * pointers, so they must point at string literals or other static storage.
+ */
+#define LOGGER_QUEUE_SIZE 32 // must be a power of two
+#define LOGGER_MAX_ARG_WORDS 8
+#define LOGGER_DRAIN_STACK_SIZE 1024
 
 class Logger
 {
@@ -46,17 +49,62 @@ public:
 
     static Logger* get_instance();
     void initialize(UnbufferedSerial* serial, trace_level_t trace_level);
+    void initialize(UarteLogTransport* uarte, trace_level_t trace_level);
     void initialize(SWO_Channel* swo, trace_level_t trace_level);
     void log(trace_level_t level, const char *msg, ...);
 
+    /**
+     * @brief Switch log() to deferred mode. Records are formatted on-target
+     * and printed as text by the drain thread. With binary set, the drain thread
+     * emits raw frames instead. tools/decode_log.py turns these back into
+     * text using the firmware ELF.
+     */
+    bool enable_deferred(bool binary = false);
+    void flush(); // drain pending records and transport buffers, e.g. before a reset
+    uint32_t get_dropped_count(); // lines lost to a full deferred queue or a full UARTE buffer
+    uint32_t get_cycles_per_line(); // average log() cost, only counted with LOGGER_PROFILING
+
 private:
     Logger();
     ~Logger();
 
+    typedef struct
+    {
+        const char* fmt;
+        uint8_t level;
+        uint8_t num_words;
+        volatile bool ready;
+        uint32_t words[LOGGER_MAX_ARG_WORDS];
+    } LogRecord_t;
+
+    static const uint8_t BINARY_SYNC = 0xA5;
+    static const uint32_t DRAIN_FLAG = 1;
+
+    void _record(trace_level_t level, const char* msg, va_list args);
+    void _drain();
+    void _drain_thread();
+    void _emit_text(const LogRecord_t& record);
+    void _emit_binary(const LogRecord_t& record);
+    void _write(const char* data, size_t length);
+
+    LogRecord_t _queue[LOGGER_QUEUE_SIZE];
+    uint32_t _head = 0; // next slot to reserve (producers)
+    uint32_t _tail = 0; // next slot to drain (consumer)
+    uint32_t _dropped = 0;
+    bool _deferred = false;
+    bool _binary = false;
+    Thread* _drain_thread_handle = nullptr;
+    EventFlags _drain_flags;
+    Mutex _drain_mutex;
+
+    uint64_t _profile_cycles = 0;
+    uint32_t _profile_lines = 0;
+
     static Mutex _mutex;
     static Logger* _instance;
     UnbufferedSerial* _serial = nullptr;
     SWO_Channel* _swo = nullptr;
+    UarteLogTransport* _uarte = nullptr;
     trace_level_t _trace_level = TRACE_TRACE;
     const char _trace_char[TRACE_LAST] = {'T', 'D', 'I', 'W'};
     bool _uart = false;
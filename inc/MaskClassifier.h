@@ -0,0 +1,102 @@
+/**
+ * @file MaskClassifier.h
+ * @author agent agent@local
+ * @brief Mask on/off decisions from the pressure and temperature traces
+ * @version 0.1
+ * @date 2026-10-19
+ * 
+ * @copyright Copyright (c) 2026 Ka Moamoa
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, version 3 of the license.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef MASKCLASSIFIER_H_
+#define MASKCLASSIFIER_H_
+
+#include <stdint.h>
+
+/**
+ * Let a cool, flat thermometer pre-check decide OFF without the
+ * barometer. The thresholds are a first guess, so until
+ * tools/host/mask_check_bench agrees with the barometer on recorded
+ * traces a cool pre-check only stops the thermometer early.
+ */
+// #define PRECHECK_TRUST_OFF
+
+/**
+ * The decisions MaskStateDetection makes, apart from the sensors that
+ * feed them, so the host tools can run traces through the same code.
+ */
+class MaskClassifier
+{
+public:
+    typedef enum
+    {
+        UNDECIDED,
+        ON,
+        OFF,
+        AMBIGUOUS
+    } Verdict_t;
+
+    /**
+     * @brief Barometer check over one detection window
+     * 
+     * @param pressure raw barometer samples (Pa above 800 hPa) at BreathFilter::FREQUENCY
+     * @return ON if any whole breath swings both ways past ON_THRESHOLD, otherwise OFF
+     */
+    static Verdict_t classify_pressure(const uint16_t* pressure, uint16_t size);
+
+    /**
+     * Thermometer pre-check, fed one sample at a time at
+     * PRECHECK_FREQUENCY. Returns UNDECIDED until it can say ON, or
+     * knows it won't.
+     */
+    void reset();
+    Verdict_t add_temperature(int16_t tempx100);
+
+    uint8_t get_num_samples() { return _num_samples; };
+    uint8_t get_num_invalid() { return _num_invalid; };
+    float get_mean() { return _mean; };
+    float get_slope() { return _slope; };
+    float get_amplitude() { return _amplitude; };
+    uint8_t get_crosses() { return _crosses; };
+
+    static const uint8_t PRECHECK_FREQUENCY = 4; // hz
+    static const uint8_t PRECHECK_SAMPLES = 32; // 8 s, the most it waits for breathing
+    static const uint8_t MIN_PRECHECK_SAMPLES = 8; // 2 s before the trend means anything
+    static const uint8_t MAX_INVALID = 4; // failed or out-of-range reads before giving up
+    static const uint16_t ON_THRESHOLD = 10; // 0.15 mbar, this from https://gitlab.com/ka-moamoa/smart-ppe/facebit-companion-ios/-/blob/master/data-exploration/mask-on-off.ipynb
+
+private:
+    void _fit();
+
+    const int16_t MIN_TEMPX100 = -4000; // the Si7051's range, anything outside is a failed read
+    const int16_t MAX_TEMPX100 = 12500;
+    const float SKIN_TEMP_THRESHOLD = 30.0; // C, mean temperature at or above this is on-face warm
+    const float AMBIENT_TEMP_THRESHOLD = 27.0; // C, mean temperature below this is likely off-face
+    const float WARMING_THRESHOLD = 0.05; // C/s, mask was just put on and is still warming up
+    const float BREATH_AMPLITUDE_THRESHOLD = 0.15; // C peak-to-peak (detrended) for a breath
+    const float FLAT_AMPLITUDE_THRESHOLD = 0.05; // C peak-to-peak (detrended), no breathing
+    const uint8_t MIN_BREATH_CROSSES = 2; // descending crosses of the trend line
+
+    float _samples[PRECHECK_SAMPLES];
+    uint8_t _num_samples = 0;
+    uint8_t _num_invalid = 0;
+
+    float _mean = 0;
+    float _slope = 0;
+    float _amplitude = 0;
+    uint8_t _crosses = 0;
+};
+
+#endif // MASKCLASSIFIER_H_
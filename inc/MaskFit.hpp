@@ -0,0 +1,65 @@
+/**
+ * @file MaskFit.hpp
+ * @author agent agent@local
+ * @brief Mask fit estimation from the breath pressure waveform
+ * @version 0.1
+ * @date 2026-10-19
+ * 
+ * @copyright Copyright (c) 2026 Ka Moamoa
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, version 3 of the license.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef MASKFIT_H_
+#define MASKFIT_H_
+
+#include "mbed.h"
+#include "SensorSession.h"
+#include "MaskStateDetection.hpp"
+#include "Logger.h"
+#include "StaticVector.h"
+#include "BreathFilter.h"
+
+/**
+ * A well-sealed mask sees large pressure swings in both directions as
+ * the wearer breathes. With a leak, air bypasses the filter and the
+ * swings shrink, most of all on inhalation when the mask is pulled into
+ * the face. The fit score (0-100) is the mean per-breath peak-to-trough
+ * amplitude relative to a well-fitted reference, scaled down by the
+ * inhale/exhale asymmetry.
+ */
+class MaskFit
+{
+public:
+    MaskFit();
+    ~MaskFit();
+
+    int8_t measure(SensorSession* session);
+    MaskStateDetection::MASK_STATE_t get_mask_state() { return _mask_state; };
+
+private:
+    Logger* _logger;
+
+    MaskStateDetection::MASK_STATE_t _mask_state = MaskStateDetection::PENDING;
+
+    int8_t _score(uint16_t* pressure_buffer, uint16_t size);
+
+    const int SAMPLING_FREQUENCY = BreathFilter::FREQUENCY; // hz
+    const int FIT_WINDOW = 20; // seconds, fills the session's window (SensorSession::MAX_WINDOW_SIZE)
+    const uint8_t MIN_BREATHS = 2; // the first cross only starts a breath; 20 s holds at least 2 whole breaths from 10 breaths/min up
+    static const uint8_t MAX_BREATHS = 20; // FIT_WINDOW at 60 breaths/min, the most BreathFilter passes
+    const float REFERENCE_AMPLITUDE = 60.0; // Pa peak-to-trough for a well-fitted mask, first guess
+    const float MIN_AMPLITUDE = 10.0; // Pa, below this it isn't a breath (same as MaskClassifier::ON_THRESHOLD)
+};
+
+#endif // MASKFIT_H_
@@ -24,29 +24,50 @@
 #define MASKSTATEDETECTION_H_
 
 #include "Barometer.hpp"
+#include "Si7051.h"
+#include "BreathFilter.h"
+#include "MaskClassifier.h"
 
 class MaskStateDetection
 {
 public:
-    MaskStateDetection(Barometer* barometer);
+    MaskStateDetection(Barometer* barometer, Si7051* thermometer = nullptr);
     ~MaskStateDetection();
 
     typedef enum 
     {
         ON,
         OFF,
-        ERROR
+        ERROR,
+        AMBIGUOUS,
+        PENDING
     } MASK_STATE_t;
 
     MASK_STATE_t is_on();
 
+    bool start();
+    void stop();
+    MASK_STATE_t poll(bool read = true);
+
+    void start_precheck();
+    MASK_STATE_t update_precheck();
+    bool is_precheck_running() { return _precheck_running; };
+    MASK_STATE_t detect(uint16_t* pressure_buffer, uint16_t size);
+
 private:
     Barometer* _barometer;
+    Si7051* _thermometer;
     Logger* _logger;
 
+    MaskClassifier _classifier;
+    bool _precheck_running = false;
+
+    void _stop_precheck();
+
     const float DETECTION_WINDOW = 10.0; // seconds
-    const int SAMPLING_FREQUENCY = 10; // hz
-    const uint16_t ON_THRESHOLD = 10; // 0.15 mbar, this from https://gitlab.com/ka-moamoa/smart-ppe/facebit-companion-ios/-/blob/master/data-exploration/mask-on-off.ipynb
+    const float PRECHECK_DELAY = (float)MaskClassifier::MIN_PRECHECK_SAMPLES / MaskClassifier::PRECHECK_FREQUENCY; // seconds before the barometer joins the pre-check
+    const int SAMPLING_FREQUENCY = BreathFilter::FREQUENCY; // hz
+    const uint8_t BATCH_SIZE = 10; // samples per barometer interrupt, keeps us from overshooting the window by most of a FIFO
 };
 
 
@@ -0,0 +1,81 @@
+/**
+ * @file MemoryStats.h
+ * @author agent agent@local
+ * @brief Heap and thread stack high-water marks from the mbed stats hooks
+ * @version 0.1
+ * @date 2026-10-19
+ * 
+ * @copyright Copyright (c) 2026 Ka Moamoa
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, version 3 of the license.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef MEMORYSTATS_H_
+#define MEMORYSTATS_H_
+
+#include "mbed.h"
+#include "rtos.h"
+#include "Logger.h"
+
+/**
+ * Heap and per-thread stack high-water marks from the mbed stats hooks
+ * (platform.*-stats-enabled). Logged after each sync, which is as busy
+ * as the mask gets, so the worst case shows up in a day of wear rather
+ * than a debugger session.
+ *
+ * Built with static-memory, everything after startup should live in
+ * fixed buffers; any heap allocation between two calls to log() is
+ * flagged as a warning.
+ */
+class MemoryStats
+{
+public:
+    MemoryStats(MemoryStats &other) = delete;
+    void operator=(const MemoryStats &) = delete;
+
+    static MemoryStats* get_instance();
+
+    /**
+     * @brief Take the current figures as the baseline, once the startup
+     * allocations (singletons, BLE stack) are done.
+     */
+    void mark_startup();
+
+    /**
+     * @brief Log heap use and each thread's stack high-water mark.
+     * @return false if the heap was allocated from since the last call
+     * in a static-memory build, or an allocation ever failed.
+     */
+    bool log();
+
+    uint32_t heap_current() { return _heap.current_size; };
+    uint32_t heap_max() { return _heap.max_size; };
+
+private:
+    MemoryStats();
+    ~MemoryStats();
+
+    void _update();
+
+    static const uint8_t MAX_THREADS = 8;
+
+    static MemoryStats* _instance;
+    static Mutex _mutex;
+
+    Logger* _logger;
+
+    mbed_stats_heap_t _heap = {};
+    uint32_t _last_total_size = 0; // total_size counts every allocation, freed or not
+};
+
+#endif // MEMORYSTATS_H_
@@ -0,0 +1,103 @@
+/**
+ * @file RecordStream.h
+ * @author agent agent@local
+ * @brief Delta/varint packed stream of physiological readings
+ * @version 0.1
+ * @date 2026-10-19
+ * 
+ * @copyright Copyright (c) 2026 Ka Moamoa
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, version 3 of the license.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef RECORDSTREAM_H_
+#define RECORDSTREAM_H_
+
+#include <stdint.h>
+
+/**
+ * Packed stream of physiological readings, used both for the on-device
+ * buffer and (sliced on record boundaries) on the wire.
+ *
+ * Each record is two unsigned LEB128 varints:
+ *
+ *     (timestamp delta << TYPE_BITS) | type,  value
+ *
+ * The delta is seconds since the previous record (the first record is
+ * relative to the stream's base timestamp, which is its own, or after
+ * consume() the last consumed record's). Readings
+ * taken together cost one byte of timestamp, and small values one byte.
+ * A typical HR/RR/fit reading is 3-4 bytes, against 16 for the old
+ * padded struct in RAM and 10 on the wire.
+ */
+class RecordStream
+{
+public:
+    typedef struct
+    {
+        uint8_t type;
+        uint64_t timestamp;
+        uint16_t value;
+    } Record_t;
+
+    static const uint8_t TYPE_BITS = 2;
+    static const uint8_t MAX_RECORD_SIZE = 5 + 3; // 32-bit varint + 16-bit varint
+    static const uint16_t CAPACITY = 512; // bytes
+
+    RecordStream();
+    ~RecordStream();
+
+    /**
+     * @brief Append a reading. If the stream is full, the oldest records
+     * make room for it, as the cough buffer does: after a long time
+     * without a phone the newest readings matter most. Returns false if
+     * any had to go, or (dropping this one) if type doesn't fit in
+     * TYPE_BITS.
+     */
+    bool append(uint8_t type, uint64_t timestamp, uint16_t value);
+    void clear();
+
+    /**
+     * @brief Drop the first num_bytes, once the phone has them. The cut
+     * must fall on a record boundary; the record before it becomes the
+     * base the rest are relative to. Returns false (and keeps everything)
+     * if it doesn't.
+     */
+    bool consume(uint16_t num_bytes);
+
+    /**
+     * @brief Decode the record at offset. reference_ts is the timestamp of
+     * the previous record (get_base_timestamp() for offset 0) and is
+     * advanced to this one. Returns the bytes consumed, or 0 at the end.
+     */
+    uint16_t read(uint16_t offset, uint64_t &reference_ts, Record_t &record);
+
+    uint16_t get_num_records() { return _num_records; };
+    uint16_t get_num_bytes() { return _num_bytes; };
+    const uint8_t* get_bytes() { return _bytes; };
+    uint64_t get_base_timestamp() { return _base_ts; };
+    uint32_t get_dropped_count() { return _dropped; }; // records
+
+    static uint8_t write_varint(uint32_t value, uint8_t* out);
+    static uint8_t read_varint(const uint8_t* in, uint16_t length, uint32_t &value); // 0 if truncated
+
+private:
+    uint8_t _bytes[CAPACITY];
+    uint16_t _num_bytes = 0;
+    uint16_t _num_records = 0;
+    uint64_t _base_ts = 0;
+    uint64_t _last_ts = 0;
+    uint32_t _dropped = 0;
+};
+
+#endif // RECORDSTREAM_H_
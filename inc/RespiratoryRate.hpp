@@ -27,7 +27,11 @@
 #include "BusControl.h"
 #include "Barometer.hpp"
 #include "Logger.h"
-#include "../iir-filter-kit/BiQuad.h"
+#include "SensorSession.h"
+#include "CapCalc.h"
+#include "Checkpoint.h"
+#include "StaticVector.h"
+#include "BreathFilter.h"
 
 using namespace std::chrono;
 
@@ -52,7 +56,14 @@ public:
     RR_t get_buffer_element();
     uint8_t get_buffer_size() { return respiratory_rate_buffer.size(); };
 
-    float respiratory_rate(const uint8_t num_seconds, RespSource_t source);
+    float respiratory_rate(const uint8_t num_seconds, RespSource_t source, SensorSession* session = nullptr);
+
+    /**
+     * True if the last respiratory_rate() call stopped early because the
+     * supercap ran low. Its state was checkpointed and the next call with
+     * the same source resumes it.
+     */
+    bool is_suspended() { return _suspended; };
     
 private:
     Si7051 &_temp;
@@ -60,12 +71,41 @@ private:
 
     BusControl *_bus_control;
     Logger* _logger;
+    CapCalc* _cap_calc;
+    Checkpoint* _checkpoint;
+    bool _suspended = false;
 
-    vector<RR_t> respiratory_rate_buffer;
+    static const uint8_t RR_BUFFER_SIZE = 10;
+    BoundedVector<RR_t, RR_BUFFER_SIZE> respiratory_rate_buffer;
 
     const int8_t ERROR = -1;
     const uint8_t BUFFER = 0; // second
-    const uint8_t FREQUENCY = 10; // hz
+    const uint8_t FREQUENCY = BreathFilter::FREQUENCY; // hz
+
+    static const uint8_t MAX_CROSSES = 64; // 60 breaths/min for a minute
+
+    /**
+     * Everything respiratory_rate() needs to carry on after a brownout.
+     * Breaths are kept as periods rather than zero-cross indices, since
+     * the sensor's sample clock starts over with the new capture, and
+     * the cross before the outage and the one after don't bound a breath.
+     */
+    typedef struct
+    {
+        BreathFilter::State_t filter;
+        uint32_t elapsed_ms; // capture time already done
+        uint8_t source;
+        uint16_t num_periods;
+        double periods[MAX_CROSSES]; // seconds
+    } State_t;
+
+    static_assert(sizeof(State_t) <= Checkpoint::MAX_STATE_SIZE, "RR state must fit a checkpoint slot");
+
+    /**
+     * @brief Append the periods between consecutive breaths, converting
+     * zero-cross indices with the clock's fitted sample period.
+     */
+    void _append_periods(BoundedVector<double, 2 * MAX_CROSSES> &periods, BoundedVector<uint32_t, MAX_CROSSES> &zc_indices, SampleClock &clock);
 };
 
 
@@ -104,6 +104,24 @@ public:
   * @return true if succeeded, else false
   */  
   bool claim(FILE *stream = stdout);
+
+  /** Write a buffer. Bytes are collected in a line buffer that goes out
+   * on newline, when full, or on sync(), packing 4 bytes into each ITM
+   * stimulus write, so short writes don't pay a stimulus poll each.
+   *
+   * @param data   The bytes to write
+   * @param length Number of bytes
+   * @return length (bytes are silently dropped if ITM is not enabled, as with putc)
+   */
+  size_t write(const char *data, size_t length);
+
+  /** Stream override, so printf output also uses the line buffer
+   */
+  virtual ssize_t write(const void *buffer, size_t length);
+
+  /** Send whatever is in the line buffer
+   */
+  virtual int sync();
   
 #if DOXYGEN_ONLY
   /** Write a character to the display
@@ -124,9 +142,17 @@ protected:
   // Stream implementation functions
   virtual int _putc(int value);
   virtual int _getc();
+  virtual void lock();
+  virtual void unlock();
 
 private:
+  static const size_t BUFFER_SIZE = 64;
 
+  void _flush(); // with the lock held
+
+  PlatformMutex _mutex;
+  char _buffer[BUFFER_SIZE];
+  size_t _buffered;
 };
 
 
@@ -186,4 +212,15 @@ void SWO_PrintChar  (char c);
 */
 void SWO_PrintString(const char *s);
 
+
+/**
+*
+* SWO_PrintBuffer()
+*
+* @brief Print a buffer via SWO, one 32-bit stimulus write per 4 bytes.
+* @param *data The bytes to be printed.
+* @param length Number of bytes.
+*/
+void SWO_PrintBuffer(const char *data, size_t length);
+
 #endif
\ No newline at end of file
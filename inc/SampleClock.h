@@ -0,0 +1,66 @@
+/**
+ * @file SampleClock.h
+ * @author agent agent@local
+ * @brief Reconstructs per-sample timestamps for batched sensor data
+ * @version 0.1
+ * @date 2026-10-19
+ * 
+ * @copyright Copyright (c) 2026 Ka Moamoa
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, version 3 of the license.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef SAMPLECLOCK_H_
+#define SAMPLECLOCK_H_
+
+#include <stdint.h>
+
+/**
+ * The sensors' real output data rates drift by several percent from
+ * the nominal ones, and FIFO batches only give us one timestamp per
+ * interrupt. SampleClock fits sample_index -> timestamp with a running
+ * least-squares line, so every sample gets a time based on the measured
+ * sample period instead of the nominal frequency.
+ */
+class SampleClock
+{
+public:
+    SampleClock(float nominal_frequency = 10.0);
+    ~SampleClock();
+
+    void reset();
+    void set_nominal_frequency(float frequency);
+
+    void add_point(uint32_t sample_index, uint64_t timestamp_ms);
+
+    double get_sample_period_ms();
+    float get_frequency() { return 1000.0 / get_sample_period_ms(); };
+    double get_sample_time_ms(uint32_t sample_index);
+    uint32_t get_num_points() { return _n; };
+
+private:
+    double _nominal_period_ms;
+
+    // running sums for the regression, relative to the first point
+    uint32_t _n = 0;
+    uint32_t _x0 = 0;
+    uint64_t _y0 = 0;
+    double _sum_x = 0;
+    double _sum_y = 0;
+    double _sum_xx = 0;
+    double _sum_xy = 0;
+
+    const float MAX_DRIFT = 0.2; // fits further than this from nominal are assumed to be bad data
+};
+
+#endif // SAMPLECLOCK_H_
@@ -0,0 +1,102 @@
+/**
+ * @file SensorSession.h
+ * @author agent agent@local
+ * @brief Owns the mask sensors and runs the barometer stream for cough detection and mask checks
+ * @version 0.1
+ * @date 2026-10-19
+ * 
+ * @copyright Copyright (c) 2026 Ka Moamoa
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, version 3 of the license.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef SENSORSESSION_H_
+#define SENSORSESSION_H_
+
+#include "mbed.h"
+#include "Barometer.hpp"
+#include "Si7051.h"
+#include "MaskStateDetection.hpp"
+#include "CoughDetection.hpp"
+#include "BreathFilter.h"
+#include "BusControl.h"
+#include "Logger.h"
+
+/**
+ * While the mask is on, the session keeps the barometer streaming at
+ * the cough detector's rate, read a FIFO burst at a time. Every burst
+ * goes through CoughDetection, so coughs are caught whatever task is
+ * running, and is decimated to the breathing filter's rate for mask
+ * checks. A check (before each task, or mask fit's longer window)
+ * collects a window from the stream instead of powering the barometer
+ * up for itself. Tasks call update() from their sampling loops and stop
+ * early once it returns false (mask off).
+ *
+ * The session owns the one Barometer and Si7051 the tasks share, so
+ * nothing is allocated per task and only one InterruptIn is ever
+ * attached to the barometer's DRDY pin.
+ */
+class SensorSession
+{
+public:
+    SensorSession(SPI *spi, I2C *i2c);
+    ~SensorSession();
+
+    static const uint8_t DECIMATION = CoughDetection::SAMPLING_FREQUENCY / BreathFilter::FREQUENCY;
+    static const uint16_t DETECTION_WINDOW_SIZE = 10 * BreathFilter::FREQUENCY; // 10 s, as MaskStateDetection
+    static const uint16_t MAX_WINDOW_SIZE = 20 * BreathFilter::FREQUENCY; // mask fit's window
+
+    bool open();
+    void close();
+    void check(bool precheck = true, uint16_t window_size = DETECTION_WINDOW_SIZE);
+    bool update();
+    bool wait(std::chrono::milliseconds timeout);
+
+    bool is_open() { return _open; };
+    Barometer* get_barometer() { return &_barometer; };
+    Si7051* get_thermometer() { return &_thermometer; };
+    MaskStateDetection* get_mask_detection() { return &_mask_detection; };
+    MaskStateDetection::MASK_STATE_t get_mask_state() { return _mask_state; };
+
+    uint16_t* get_window() { return _window; };
+    uint16_t get_window_size() { return _window_size; };
+    bool get_cough_event(CoughDetection::CoughEvent_t &event) { return _cough.get_event(event); };
+
+private:
+    Barometer _barometer;
+    Si7051 _thermometer;
+    MaskStateDetection _mask_detection;
+    CoughDetection _cough;
+
+    BusControl* _bus_control;
+    Logger* _logger;
+
+    bool _open = false;
+    bool _holding_power = false; // barometer rail acquired from BusControl
+    MaskStateDetection::MASK_STATE_t _mask_state = MaskStateDetection::PENDING;
+
+    // decimated stream for the current check
+    bool _checking = false;
+    uint16_t _window[MAX_WINDOW_SIZE];
+    uint16_t _window_size = 0;
+    uint16_t _window_target = DETECTION_WINDOW_SIZE;
+    uint32_t _decimation_sum = 0;
+    uint8_t _decimation_count = 0;
+
+    uint32_t _num_overruns = 0;
+
+    void _process();
+    void _update_check();
+};
+
+#endif // SENSORSESSION_H_
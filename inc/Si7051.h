@@ -35,6 +35,10 @@ THE SOFTWARE.
 #include "mbed.h"
 #include <vector>
 #include "Logger.h"
+#include "SampleClock.h"
+#include "StaticVector.h"
+
+class WaveformStreamer;
 
 #define SI7051_ADDRESS (0x40 << 1)
 
@@ -58,25 +62,31 @@ public:
 	void stop();
 	void setResolution(uint8_t resolution);
 	
-	void setFrequency(uint8_t frequency_Hz) { _measurement_frequency_hz = frequency_Hz; };
+	void setFrequency(uint8_t frequency_Hz) { _measurement_frequency_hz = frequency_Hz; _sample_clock.set_nominal_frequency(frequency_Hz); };
 	uint32_t getFrequencyx100();
 
 	void reset();
 
 	uint8_t readFirmwareVersion();
+	bool isReady(); // firmware revision probe, used after power up
 
 	float readTemperature();
 	bool update();
 	bool getBufferFull() { return _tempx100_array.size() >= MAX_BUFFER_SIZE; };
-	void clearBuffer() { _tempx100_array.clear(); };
+	void clearBuffer() { _buffer_start_index += _tempx100_array.size(); _tempx100_array.clear(); };
+	uint32_t getBufferStartIndex() { return _buffer_start_index; };
+	SampleClock& getSampleClock() { return _sample_clock; };
 	uint8_t getBufferSize() { return _tempx100_array.size(); };
-	uint16_t* getBuffer() { return _tempx100_array.data(); };
+	int16_t* getBuffer() { return _tempx100_array.data(); };
 	uint64_t getDeltaTimestamp(bool broadcast);
 	uint8_t getMeasurementFrequency(){ return _measurement_frequency_hz;}
 private:
 	uint8_t _address;
 	I2C *_i2c;
-	std::vector<uint16_t> _tempx100_array;
+	static const uint8_t MAX_BUFFER_SIZE = 200; // this is kind of arbitrary. Just want to keep it from growing without bound.
+	static constexpr float MIN_TEMPERATURE = -40.0; // C, the sensor's range. Reads outside it failed
+	static constexpr float MAX_TEMPERATURE = 125.0;
+	BoundedVector<int16_t, MAX_BUFFER_SIZE + 1> _tempx100_array; // one over while the oldest is dropped
 	uint8_t _measurement_frequency_hz = 10; // Hz
 	LowPowerTimer _frequency_timer;
 	LowPowerTimer _timer;
@@ -85,7 +95,12 @@ private:
 	uint64_t _last_broadcast_timestamp = 0;
 	uint32_t _actual_frequencyx100 = 0;
 
+	SampleClock _sample_clock;
+	uint32_t _samples_taken = 0;
+	uint32_t _buffer_start_index = 0; // sample index of the first element in the buffer
+
 	Logger* _logger;
+	WaveformStreamer* _streamer;
 
 	const char MEASURE_HOLD = 0xE3;
 	const char MEASURE_NOHOLD = 0xF3;
@@ -95,13 +110,13 @@ private:
 	const char READ_ID1[2] = {0xFA, 0x0F};
 	const char READ_ID2[2] = {0xFC, 0xC9};
 	const char READ_FW_REV[2] = {0x84, 0xB8};
+	const uint8_t FW_REV_1_0 = 0xFF;
+	const uint8_t FW_REV_2_0 = 0x20;
 	
 	const char WRITE = 0x00;
 	const char READ = 0x01;
 	
 	const uint8_t MEASUREMENT_TIMEOUT_MS = 20; 
-
-	const uint8_t MAX_BUFFER_SIZE = 200; // this is kind of arbitrary. Just want to keep it from growing without bound.
 };
 
 #endif
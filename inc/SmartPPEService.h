@@ -26,6 +26,7 @@
 #include "mbed.h"
 #include "events/mbed_events.h"
 #include "ble/BLE.h"
+#include "Logger.h"
 
 class SmartPPEService : ble::GattServer::EventHandler {
 
@@ -36,6 +37,10 @@ class SmartPPEService : ble::GattServer::EventHandler {
     const char* BCG_UUID = "0F1F34A3-4567-484C-ACA2-CC8F662E8785";
     const char* ON_UUID = "0F1F34A3-4567-484C-ACA2-CC8F662E8786";
     const char* TIME_UUID = "0F1F34A3-4567-484C-ACA2-CC8F662E8787";
+    const char* COUGH_UUID = "0F1F34A3-4567-484C-ACA2-CC8F662E8788";
+    const char* MASK_FIT_UUID = "0F1F34A3-4567-484C-ACA2-CC8F662E8789";
+    const char* EVENT_LOG_UUID = "0F1F34A3-4567-484C-ACA2-CC8F662E878A";
+    const char* RECORDS_UUID = "0F1F34A3-4567-484C-ACA2-CC8F662E878B";
 
 public:
     enum data_ready_t
@@ -47,53 +52,36 @@ public:
         MASK_ON = 5,
         COUGH_SAMPLE = 6,
         HEART_RATE = 7,
-        NO_DATA = 8
+        NO_DATA = 8,
+        MASK_FIT = 9,
+        EVENT_LOG = 10,
+        RECORDS = 11
     };
 
-    SmartPPEService()
+    static const uint8_t EVENT_LOG_MAX_EVENTS = 16; // 8 bytes each
+    static const uint8_t RECORDS_MAX_BYTES = 241; // of RecordStream records, one read response at a 247-byte MTU
+    static const uint16_t DEFAULT_ATT_MTU = 23;
+    static const uint8_t WAVEFORM_HEADER_SIZE = 13; // timestamp, frequency x100, sample count
+    static const uint8_t WAVEFORM_SIZE = WAVEFORM_HEADER_SIZE + 2 * 100;
+
+    // characteristics live in the object rather than on the heap
+    SmartPPEService() :
+    _pressure(UUID(PRESSURE_UUID), &_initial_value_uint8_t, GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_NOTIFY), // streamed in research mode
+    _temperature(UUID(TEMPERATURE_UUID), &_initial_value_uint8_t, GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_NOTIFY),
+    _respiratory_rate(UUID(RESPIRATORY_RATE_UUID), &_initial_value_uint8_t),
+    _bcg(UUID(BCG_UUID), &_initial_value_uint8_t),
+    _mask_on(UUID(ON_UUID), &_initial_value_uint8_t),
+    _data_ready(UUID(DATA_READY_UUID), &_initial_value_data_ready, GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_NOTIFY),
+    _time(UUID(TIME_UUID), &_initial_value_uint64_t),
+    _cough(UUID(COUGH_UUID), &_initial_value_uint8_t),
+    _mask_fit(UUID(MASK_FIT_UUID), &_initial_value_uint8_t),
+    _event_log(UUID(EVENT_LOG_UUID), &_initial_value_uint8_t),
+    _records(UUID(RECORDS_UUID), &_initial_value_uint8_t)
     {
-        const UUID pressure_uuid(PRESSURE_UUID);
-        const UUID temp_uuid(TEMPERATURE_UUID);
-        const UUID rr_uuid(RESPIRATORY_RATE_UUID);
-        const UUID bcg_uuid(BCG_UUID);
-        const UUID on_uuid(ON_UUID);
-        const UUID data_ready_uuid(DATA_READY_UUID);
-        const UUID time_uuid(TIME_UUID);
-
-        _pressure = new ReadOnlyArrayGattCharacteristic<uint8_t, 213> (pressure_uuid, &_initial_value_uint8_t);
-        if (!_pressure) {
-            printf("Allocation of pressure characteristic failed\r\n");
-        }
-
-        _temperature = new ReadOnlyArrayGattCharacteristic<uint8_t, 213> (temp_uuid, &_initial_value_uint8_t);
-        if (!_temperature) {
-            printf("Allocation of temperature characteristic failed\r\n");
-        }
-
-        _respiratory_rate = new ReadOnlyArrayGattCharacteristic<uint8_t, 10> (rr_uuid, &_initial_value_uint8_t);
-        if (!_respiratory_rate) {
-            printf("Allocation of magnetometer characteristic failed\r\n");
-        }
-
-        _bcg = new ReadOnlyArrayGattCharacteristic<uint8_t, 10> (bcg_uuid, &_initial_value_uint8_t);
-        if (!_bcg) {
-            printf("Allocation of imu characteristic failed\r\n");
-        }
-
-        _mask_on = new ReadOnlyArrayGattCharacteristic<uint8_t, 10> (on_uuid, &_initial_value_uint8_t);
-        if (!_mask_on) {
-            printf("Allocation of mic characteristic failed\r\n");
-        }
-
-        _data_ready = new ReadWriteGattCharacteristic<uint8_t> (data_ready_uuid, &_initial_value_data_ready, GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_NOTIFY);
-        if (!_data_ready) {
-            printf("Allocation of data quality characteristic failed\r\n");
-        }
-
-        _time = new ReadWriteGattCharacteristic<uint64_t> (time_uuid, &_initial_value_uint64_t);
-        if (!_time) {
-            printf("Allocation of time characteristic failed\r\n");
-        }
+        // see getDataReady()
+        _cough.setReadAuthorizationCallback(this, &SmartPPEService::_on_payload_read);
+        _event_log.setReadAuthorizationCallback(this, &SmartPPEService::_on_payload_read);
+        _records.setReadAuthorizationCallback(this, &SmartPPEService::_on_payload_read);
     }
 
     ~SmartPPEService()
@@ -104,16 +92,21 @@ public:
     {
         const UUID uuid = "6243fabc-23e9-4b79-bd30-1dc57b8005d6";
         GattCharacteristic* charTable[] = { 
-            _pressure,  
-            _temperature,
-            _respiratory_rate,
-            _bcg,
-            _mask_on,
-            _data_ready,
-            _time};
-
-        GattService smart_ppe_service(uuid, charTable, 7);
-
+            &_pressure,  
+            &_temperature,
+            &_respiratory_rate,
+            &_bcg,
+            &_mask_on,
+            &_data_ready,
+            &_time,
+            &_cough,
+            &_mask_fit,
+            &_event_log,
+            &_records};
+
+        GattService smart_ppe_service(uuid, charTable, 11);
+
+        _ble = &ble;
         _server = &ble.gattServer();
 
         _server->addService(smart_ppe_service);
@@ -123,14 +116,23 @@ public:
         printf("FaceBit service added with UUID 6243fabc-23e9-4b79-bd30-1dc57b8005d6\r\n");
     }
 
-    void updatePressure(uint64_t data_timestamp, uint32_t measurement_frequencyx100, uint16_t *pressure_array, uint8_t size)
+    /**
+     * Waveform notifications. GattServer::write() stores the value and
+     * queues a notification without saying whether the stack had room
+     * for it, so only one goes out per characteristic at a time: these
+     * return false while isNotifying(), and the notify callback reports
+     * each one as sent (from onDataSent) or lost (on disconnection). They
+     * also return false if the phone isn't subscribed or the write fails,
+     * in which case nothing goes out and no callback follows.
+     */
+    bool updatePressure(uint64_t data_timestamp, uint32_t measurement_frequencyx100, uint16_t *pressure_array, uint8_t size)
     {
         if (size > 100)
         {
             size = 100;
         }
 
-        uint8_t bytearray[208] = {0};
+        uint8_t bytearray[WAVEFORM_SIZE] = {0};
         uint64_t timestamp = data_timestamp;
         std::memcpy(bytearray, &timestamp, 8);
 
@@ -145,17 +147,17 @@ public:
             bytearray[13 + i*2] = (uint8_t)((pressure_array[i] >> 8) & 0xFF);
             bytearray[13 + (i*2)+1] = (uint8_t)(pressure_array[i] & 0xFF);
         }
-        _server->write(_pressure->getValueHandle(), bytearray, (size * 2) + 13);
+        return _notify(PRESSURE, _pressure, bytearray, (size * 2) + WAVEFORM_HEADER_SIZE);
     }
 
-    void updateTemperature(uint64_t data_timestamp, uint32_t measurement_frequencyx100, uint16_t *temperature_array, uint8_t size)
+    bool updateTemperature(uint64_t data_timestamp, uint32_t measurement_frequencyx100, uint16_t *temperature_array, uint8_t size)
     {
         if (size > 100)
         {
             size = 100;
         }
 
-        uint8_t bytearray[208] = {0};
+        uint8_t bytearray[WAVEFORM_SIZE] = {0};
         uint64_t timestamp = data_timestamp;
         std::memcpy(bytearray, &timestamp, 8);
 
@@ -170,9 +172,18 @@ public:
             bytearray[13 + i*2] = (uint8_t)((temperature_array[i] >> 8) & 0xFF);
             bytearray[13 + (i*2)+1] = (uint8_t)(temperature_array[i] & 0xFF);
         }
-        _server->write(_temperature->getValueHandle(), bytearray, (size * 2) + 13);
+        return _notify(TEMPERATURE, _temperature, bytearray, (size * 2) + WAVEFORM_HEADER_SIZE);
     }
 
+    /**
+     * The per-type characteristics below (and the matching data_ready_t
+     * values) are from before RECORDS. They're no longer announced on
+     * DATA_READY; each sync leaves the newest reading of its type in them.
+     *
+     * Timestamps here, on COUGH and in RECORDS are seconds since the
+     * epoch. A device the phone has never given a time to can only count
+     * its own on-time, so it sends that instead; it's well before 2020.
+     */
     void updateRespiratoryRate(uint64_t data_timestamp, uint16_t respiratory_rate)
     {
         uint8_t bytearray[10] = {0};
@@ -182,7 +193,7 @@ public:
         uint16_t value = respiratory_rate;
         std::memcpy(&bytearray[8], &value, 2);
 
-        _server->write(_respiratory_rate->getValueHandle(), bytearray, 10);
+        _write(_respiratory_rate.getValueHandle(), bytearray, 10);
     }
 
     void updateHeartRate(uint64_t data_timestamp, uint16_t heart_rate)
@@ -194,7 +205,7 @@ public:
         uint16_t value = heart_rate;
         std::memcpy(&bytearray[8], &value, 2);
 
-        _server->write(_bcg->getValueHandle(), bytearray, 10);
+        _write(_bcg.getValueHandle(), bytearray, 10);
     }
 
     void updateMaskOn(uint64_t data_timestamp, uint16_t mask_on)
@@ -206,24 +217,113 @@ public:
         uint16_t value = mask_on;
         std::memcpy(&bytearray[8], &value, 2);
 
-        _server->write(_mask_on->getValueHandle(), bytearray, 10);
+        _write(_mask_on.getValueHandle(), bytearray, 10);
+    }
+
+    void updateMaskFit(uint64_t data_timestamp, uint16_t mask_fit)
+    {
+        uint8_t bytearray[10] = {0};
+        uint64_t timestamp = data_timestamp;
+        std::memcpy(bytearray, &timestamp, 8);
+
+        uint16_t value = mask_fit;
+        std::memcpy(&bytearray[8], &value, 2);
+
+        _write(_mask_fit.getValueHandle(), bytearray, 10);
+    }
+
+    void updateCough(uint64_t data_timestamp, uint16_t peak, uint8_t duration, uint8_t peak_count)
+    {
+        uint8_t bytearray[12] = {0};
+        uint64_t timestamp = data_timestamp;
+        std::memcpy(bytearray, &timestamp, 8);
+
+        uint16_t value = peak;
+        std::memcpy(&bytearray[8], &value, 2);
+
+        bytearray[10] = duration;
+        bytearray[11] = peak_count;
+
+        _write_payload(_cough.getValueHandle(), bytearray, 12);
+    }
+
+    void updateEventLog(uint32_t first_index, const uint8_t *events, uint8_t num_events)
+    {
+        if (num_events > EVENT_LOG_MAX_EVENTS)
+        {
+            num_events = EVENT_LOG_MAX_EVENTS;
+        }
+
+        uint8_t bytearray[5 + 8 * EVENT_LOG_MAX_EVENTS] = {0};
+        uint32_t index = first_index;
+        std::memcpy(bytearray, &index, 4);
+
+        bytearray[4] = num_events;
+        std::memcpy(&bytearray[5], events, 8 * num_events);
+
+        _write_payload(_event_log.getValueHandle(), bytearray, 5 + 8 * num_events);
+    }
+
+    /**
+     * A slice of a RecordStream, cut on record boundaries:
+     * reference timestamp (u32) | length (u8) | records. The reference is
+     * the record before the slice (the first record itself for the first
+     * slice). Each record's delta is added to the running timestamp to
+     * get its own.
+     */
+    void updateRecords(uint32_t reference_timestamp, const uint8_t *records, uint8_t num_bytes)
+    {
+        if (num_bytes > RECORDS_MAX_BYTES)
+        {
+            num_bytes = RECORDS_MAX_BYTES;
+        }
+
+        uint8_t bytearray[5 + RECORDS_MAX_BYTES] = {0};
+        uint32_t timestamp = reference_timestamp;
+        std::memcpy(bytearray, &timestamp, 4);
+
+        bytearray[4] = num_bytes;
+        std::memcpy(&bytearray[5], records, num_bytes);
+
+        _write_payload(_records.getValueHandle(), bytearray, 5 + num_bytes);
     }
 
     void updateDataReady(data_ready_t type)
     {
+        _announced = type;
         uint8_t tmp = (uint8_t)type;
-        _server->write(_data_ready->getValueHandle(), &tmp, 1);
+        _server->write(_data_ready.getValueHandle(), &tmp, 1); // handshake, not payload
     }
 
+    /**
+     * The phone acknowledges a payload by writing NO_DATA. We repeat the
+     * notification while we wait, so a repeat can reach the phone after
+     * its ack, and a phone that acts on it without reading DATA_READY back
+     * acks again, clearing the next payload unread. So an ack only counts
+     * once the payload announced has been read; until then this returns
+     * what we announced, and the caller's next updateDataReady() puts it
+     * back.
+     */
     data_ready_t getDataReady()
     {
         uint16_t length = 1;
         uint8_t data_ready = -1;
-        _server->read(_data_ready->getValueHandle(), &data_ready, &length);
+        _server->read(_data_ready.getValueHandle(), &data_ready, &length);
+
+        if (data_ready == NO_DATA && _unread_payload != GattAttribute::INVALID_HANDLE)
+        {
+            return _announced;
+        }
 
         return static_cast<data_ready_t>( data_ready );
     }
 
+    /**
+     * TIME: the device's wall time as the sync starts, if it still trusts
+     * it, or 0 to ask for one. The phone compares it with its own clock as
+     * of the MASK_ON announcement and writes its time only if they're more
+     * than a couple of seconds apart; a write of the same value is ignored.
+     */
     void updateTime(uint64_t epoch_time)
     {
         uint8_t bytearray[8] = {0};
@@ -231,7 +331,7 @@ public:
         uint64_t time = epoch_time;
         std::memcpy(bytearray, &time, 8);
 
-        _server->write(_time->getValueHandle(), bytearray, 8);
+        _write(_time.getValueHandle(), bytearray, 8);
     }
 
     uint64_t getTime()
@@ -239,23 +339,205 @@ public:
         uint16_t length = 8;
         uint8_t epoch_time_array[8];
 
-        _server->read(_time->getValueHandle(), epoch_time_array, &length);
+        _server->read(_time.getValueHandle(), epoch_time_array, &length);
         uint64_t epoch_time = 0;
         std::memcpy(&epoch_time, epoch_time_array, 8);
 
         return epoch_time;
     }
 
+    /**
+     * Forget the last connection's MTU and transfer counters. Call before
+     * each sync.
+     */
+    void resetConnection()
+    {
+        _att_mtu = DEFAULT_ATT_MTU;
+        _mtu_requested = false;
+        _tx_bytes = 0;
+        _unread_payload = GattAttribute::INVALID_HANDLE;
+    }
+
+    uint16_t getAttMtu() { return _att_mtu; }
+    uint32_t getTxBytes() { return _tx_bytes; }
+
+    /**
+     * How much of a characteristic value the phone gets in one ATT read
+     * response. A central that never exchanged MTUs still reads the whole
+     * value with read blob requests, so in that case we keep the full size
+     * rather than cutting every transfer into 22-byte packets.
+     */
+    uint16_t getMaxPayload(uint16_t characteristic_size)
+    {
+        if (_att_mtu <= DEFAULT_ATT_MTU)
+        {
+            return characteristic_size;
+        }
+
+        uint16_t payload = _att_mtu - 1; // read response opcode
+        return payload < characteristic_size ? payload : characteristic_size;
+    }
+
+    /**
+     * How much of a value fits one notification. Unlike reads there's no
+     * fallback, anything past this is cut off.
+     */
+    uint16_t getMaxNotifyPayload(uint16_t characteristic_size)
+    {
+        uint16_t payload = _att_mtu - 3; // notification opcode and handle
+        return payload < characteristic_size ? payload : characteristic_size;
+    }
+
+    uint8_t getRecordsPayload() { return getMaxPayload(5 + RECORDS_MAX_BYTES) - 5; }
+
+    // PRESSURE or TEMPERATURE
+    bool isNotifying(data_ready_t type) { return _notifying[type - PRESSURE]; }
+
+    // called from the BLE thread, with the waveform type and whether its notification went out
+    void setNotifyCallback(mbed::Callback<void(data_ready_t, bool)> callback) { _notify_callback = callback; }
+
+    /**
+     * The link is down, so notifications still in flight will never be
+     * confirmed. Call from the BLE thread.
+     */
+    void onDisconnection()
+    {
+        for (int i = 0; i < 2; i++)
+        {
+            if (_notifying[i])
+            {
+                _notifying[i] = false;
+                if (_notify_callback) _notify_callback((data_ready_t)(PRESSURE + i), false);
+            }
+        }
+    }
+
 private:
-    GattServer* _server = nullptr;
+    /**
+     * Most phones exchange MTUs as soon as they connect. For the ones that
+     * don't, ask once from our side on the first request that tells us the
+     * connection handle; a central that can't go higher leaves it at 23.
+     * Data length extension is requested by the stack itself (see the
+     * cordio settings in mbed_app.json).
+     */
+    void onAttMtuChange(ble::connection_handle_t connectionHandle, uint16_t attMtuSize) override
+    {
+        _att_mtu = attMtuSize;
+        LOG(Logger::get_instance(), TRACE_INFO, "ATT MTU changed to %u", attMtuSize);
+    }
+
+    void onUpdatesEnabled(const GattUpdatesEnabledCallbackParams &params) override
+    {
+        _request_mtu(params.connHandle);
+    }
+
+    void onDataWritten(const GattWriteCallbackParams &params) override
+    {
+        _request_mtu(params.connHandle);
+    }
+
+    void onDataSent(const GattDataSentCallbackParams &params) override
+    {
+        data_ready_t type;
+        if (params.attHandle == _pressure.getValueHandle())
+        {
+            type = PRESSURE;
+        }
+        else if (params.attHandle == _temperature.getValueHandle())
+        {
+            type = TEMPERATURE;
+        }
+        else
+        {
+            return; // DATA_READY, repeated until acknowledged anyway
+        }
+
+        if (_notifying[type - PRESSURE])
+        {
+            _notifying[type - PRESSURE] = false;
+            if (_notify_callback) _notify_callback(type, true);
+        }
+    }
 
-    ReadOnlyArrayGattCharacteristic<uint8_t, 213>* _pressure = nullptr;
-    ReadOnlyArrayGattCharacteristic<uint8_t, 213>* _temperature = nullptr;
-    ReadOnlyArrayGattCharacteristic<uint8_t, 10>* _respiratory_rate = nullptr;
-    ReadOnlyArrayGattCharacteristic<uint8_t, 10>* _bcg = nullptr;
-    ReadOnlyArrayGattCharacteristic<uint8_t, 10>* _mask_on = nullptr;
-    ReadWriteGattCharacteristic<uint8_t>* _data_ready = nullptr;
-    ReadWriteGattCharacteristic<uint64_t>* _time = nullptr;
+    void _request_mtu(ble::connection_handle_t connection)
+    {
+        if (_mtu_requested || _att_mtu > DEFAULT_ATT_MTU)
+        {
+            return;
+        }
+
+        _mtu_requested = true;
+        _ble->gattClient().negotiateAttMtu(connection);
+    }
+
+    bool _write(GattAttribute::Handle_t handle, const uint8_t *data, uint16_t length)
+    {
+        if (_server->write(handle, data, length) != BLE_ERROR_NONE)
+        {
+            return false;
+        }
+
+        _tx_bytes += length;
+        return true;
+    }
+
+    bool _notify(data_ready_t type, GattCharacteristic &characteristic, const uint8_t *data, uint16_t length)
+    {
+        bool subscribed = false;
+        if (_notifying[type - PRESSURE] || _server->areUpdatesEnabled(characteristic, &subscribed) != BLE_ERROR_NONE || !subscribed)
+        {
+            return false;
+        }
+
+        _notifying[type - PRESSURE] = true;
+        if (!_write(characteristic.getValueHandle(), data, length))
+        {
+            _notifying[type - PRESSURE] = false;
+            return false;
+        }
+
+        return true;
+    }
+
+    // a payload the phone has to read before its ack counts
+    bool _write_payload(GattAttribute::Handle_t handle, const uint8_t *data, uint16_t length)
+    {
+        _unread_payload = handle;
+        return _write(handle, data, length);
+    }
+
+    // authorizes every read; the stack still serves the stored value, this only notes it was read
+    void _on_payload_read(GattReadAuthCallbackParams *params)
+    {
+        if (params->handle == _unread_payload)
+        {
+            _unread_payload = GattAttribute::INVALID_HANDLE;
+        }
+
+        params->authorizationReply = AUTH_CALLBACK_REPLY_SUCCESS;
+    }
+
+    BLE* _ble = nullptr;
+    GattServer* _server = nullptr;
+    volatile uint16_t _att_mtu = DEFAULT_ATT_MTU; // updated from the BLE thread
+    volatile bool _mtu_requested = false;
+    volatile uint32_t _tx_bytes = 0;
+    volatile GattAttribute::Handle_t _unread_payload = GattAttribute::INVALID_HANDLE; // cleared from the BLE thread
+    data_ready_t _announced = NO_DATA;
+    volatile bool _notifying[2] = {false, false}; // PRESSURE, TEMPERATURE
+    mbed::Callback<void(data_ready_t, bool)> _notify_callback;
+
+    ReadOnlyArrayGattCharacteristic<uint8_t, WAVEFORM_SIZE> _pressure;
+    ReadOnlyArrayGattCharacteristic<uint8_t, WAVEFORM_SIZE> _temperature;
+    ReadOnlyArrayGattCharacteristic<uint8_t, 10> _respiratory_rate;
+    ReadOnlyArrayGattCharacteristic<uint8_t, 10> _bcg;
+    ReadOnlyArrayGattCharacteristic<uint8_t, 10> _mask_on;
+    ReadWriteGattCharacteristic<uint8_t> _data_ready;
+    ReadWriteGattCharacteristic<uint64_t> _time;
+    ReadOnlyArrayGattCharacteristic<uint8_t, 12> _cough;
+    ReadOnlyArrayGattCharacteristic<uint8_t, 10> _mask_fit;
+    ReadOnlyArrayGattCharacteristic<uint8_t, 5 + 8 * EVENT_LOG_MAX_EVENTS> _event_log;
+    ReadOnlyArrayGattCharacteristic<uint8_t, 5 + RECORDS_MAX_BYTES> _records;
 
     uint8_t _initial_value_data_ready = NO_DATA;
     uint8_t _initial_value_uint8_t = 0;
@@ -0,0 +1,134 @@
+/**
+ * @file StaticVector.h
+ * @author agent agent@local
+ * @brief Fixed-capacity vector for the heap-free (static-memory) build
+ * @version 0.1
+ * @date 2026-10-19
+ * 
+ * @copyright Copyright (c) 2026 Ka Moamoa
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, version 3 of the license.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef STATICVECTOR_H_
+#define STATICVECTOR_H_
+
+#include <stddef.h>
+#include <vector>
+#include <algorithm>
+#include <type_traits>
+
+/**
+ * The part of std::vector the captures use, in a fixed array. Callers
+ * keep within N themselves (the same checks bound the std::vector build),
+ * so a push onto a full vector is a bug; it's dropped rather than
+ * written past the end.
+ */
+template <typename T, size_t N>
+class StaticVector
+{
+public:
+    typedef T value_type;
+    typedef T* iterator;
+    typedef const T* const_iterator;
+
+    StaticVector() {}
+
+    template <size_t M>
+    StaticVector(const StaticVector<T, M> &other) { assign(other.begin(), other.end()); }
+
+    size_t size() const { return _size; }
+    size_t capacity() const { return N; }
+    bool empty() const { return _size == 0; }
+    bool full() const { return _size >= N; }
+
+    T* data() { return _items; }
+    iterator begin() { return _items; }
+    iterator end() { return _items + _size; }
+    const_iterator begin() const { return _items; }
+    const_iterator end() const { return _items + _size; }
+
+    T& operator[](size_t i) { return _items[i]; }
+    const T& operator[](size_t i) const { return _items[i]; }
+    T& at(size_t i) { return _items[i]; }
+    T& front() { return _items[0]; }
+    T& back() { return _items[_size - 1]; }
+
+    void push_back(const T &item)
+    {
+        if (_size < N)
+        {
+            _items[_size++] = item;
+        }
+    }
+
+    void pop_back() { if (_size > 0) _size--; }
+    void clear() { _size = 0; }
+
+    void resize(size_t size, const T &fill = T())
+    {
+        size = std::min(size, N);
+        for (size_t i = _size; i < size; i++)
+        {
+            _items[i] = fill;
+        }
+        _size = size;
+    }
+
+    iterator erase(iterator position)
+    {
+        if (position >= end())
+        {
+            return end();
+        }
+
+        std::copy(position + 1, end(), position);
+        _size--;
+        return position;
+    }
+
+    template <typename InputIt, typename = typename std::enable_if<!std::is_integral<InputIt>::value>::type>
+    void assign(InputIt first, InputIt last)
+    {
+        clear();
+        for (; first != last && _size < N; ++first)
+        {
+            _items[_size++] = *first;
+        }
+    }
+
+    void assign(size_t count, const T &value)
+    {
+        clear();
+        resize(count, value);
+    }
+
+private:
+    T _items[N];
+    size_t _size = 0;
+};
+
+/**
+ * Capture buffers with a known worst case. FACEBIT_STATIC_MEMORY (see
+ * mbed_app.json) puts them in fixed storage; otherwise they're ordinary
+ * vectors, and N only documents the bound the code keeps to.
+ */
+#if FACEBIT_STATIC_MEMORY
+template <typename T, size_t N>
+using BoundedVector = StaticVector<T, N>;
+#else
+template <typename T, size_t N>
+using BoundedVector = std::vector<T>;
+#endif
+
+#endif // STATICVECTOR_H_
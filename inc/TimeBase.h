@@ -0,0 +1,132 @@
+/**
+ * @file TimeBase.h
+ * @author agent agent@local
+ * @brief Monotonic and wall clock time that survive resets and brownouts
+ * @version 0.1
+ * @date 2026-10-19
+ * 
+ * @copyright Copyright (c) 2026 Ka Moamoa
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, version 3 of the license.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef TIMEBASE_H_
+#define TIMEBASE_H_
+
+#include "mbed.h"
+#include "rtos.h"
+#include "FRAM.h"
+#include "Logger.h"
+
+using namespace std::chrono;
+
+/**
+ * A clock that survives resets. The monotonic time is the RTC-driven
+ * kernel clock plus whatever earlier boots counted up to their last
+ * checkpoint; wall time is that plus the offset the phone last gave us.
+ *
+ * The state lives in retained RAM, which covers soft resets (system_reset,
+ * watchdog, lockup) with at most one checkpoint period lost, and in two
+ * alternating FRAM slots for brownouts. After a brownout the monotonic
+ * time picks up where FRAM left it, but we don't know how long we were
+ * off, so the wall time is only a lower bound and not trusted until the
+ * phone sets it again.
+ */
+class TimeBase
+{
+public:
+    TimeBase(TimeBase &other) = delete;
+    void operator=(const TimeBase &) = delete;
+
+    static TimeBase* get_instance();
+
+    /**
+     * @brief Restore from retained RAM, or FRAM if RAM was lost, and set
+     * the mbed RTC so time(NULL) is right straight away.
+     */
+    bool initialize(FRAM* fram);
+
+    uint64_t monotonic_ms();
+    uint32_t monotonic_s() { return monotonic_ms() / 1000; };
+
+    bool has_epoch() { return _state.flags & FLAG_EPOCH; };
+
+    /**
+     * @brief Set by the phone within TRUST_PERIOD, with no power loss
+     * since. A sync can skip the time write-back while this holds.
+     */
+    bool is_trusted();
+
+    time_t get_epoch(); // seconds, 0 if never set
+    void set_epoch(time_t epoch);
+
+    /**
+     * @brief The wall time, in seconds since the epoch, of a reading
+     * stamped with monotonic_s() this boot. Without an epoch there's no
+     * wall time to give, so it returns monotonic_s as it is, which is
+     * well before any real date.
+     */
+    uint32_t to_epoch_s(uint32_t monotonic_s);
+
+    /**
+     * @brief Refresh retained RAM, and FRAM if it's been FRAM_PERIOD or
+     * force is set (e.g. when the supercap runs low).
+     */
+    void checkpoint(bool force = false);
+
+private:
+    TimeBase();
+    ~TimeBase();
+
+    typedef struct __attribute__((packed))
+    {
+        uint32_t magic;
+        uint32_t sequence;
+        uint64_t monotonic_ms; // at the time of the checkpoint
+        int64_t epoch_offset_ms; // epoch - monotonic
+        uint64_t set_ms; // monotonic time the phone last set the epoch
+        uint32_t flags;
+        uint32_t crc; // over everything above
+    } State_t;
+
+    static const uint32_t FLAG_EPOCH = 1 << 0;
+    static const uint32_t FLAG_TRUSTED = 1 << 1;
+
+    static const uint32_t SLOTS_ADDR = 0x19000; // after the checkpoint slots
+    static const uint16_t SLOT_SIZE = 64;
+    static const uint32_t MAGIC = 0xFB71E0B5;
+
+    const milliseconds FRAM_PERIOD = 10min;
+    const milliseconds TRUST_PERIOD = 24h; // ~2 s of drift on the 20 ppm crystal
+
+    uint32_t _crc(const State_t &state);
+    bool _valid(const State_t &state);
+    bool _read_slot(uint8_t slot, State_t &state);
+    bool _write_fram();
+    uint64_t _boot_ms();
+
+    static TimeBase* _instance;
+    static Mutex _mutex;
+    static State_t _retained; // .noinit, kept across soft resets
+
+    Logger* _logger;
+    FRAM* _fram = nullptr;
+    Mutex _time_mutex;
+
+    State_t _state = {0, 0, 0, 0, 0, 0, 0};
+    uint64_t _base_ms = 0; // monotonic time at this boot
+    uint64_t _last_fram_ms = 0;
+    uint8_t _slot = 1; // where the newest FRAM copy lives
+};
+
+#endif // TIMEBASE_H_
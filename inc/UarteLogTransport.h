@@ -0,0 +1,87 @@
+/**
+ * @file UarteLogTransport.h
+ * @author agent agent@local
+ * @brief Buffered UARTE0 EasyDMA log and console output
+ * @version 0.1
+ * @date 2026-10-19
+ * 
+ * @copyright Copyright (c) 2026 Ka Moamoa
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, version 3 of the license.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef UARTE_LOG_TRANSPORT_H_
+#define UARTE_LOG_TRANSPORT_H_
+
+#include "mbed.h"
+#include <errno.h>
+
+/**
+ * Buffered log output over UARTE0 EasyDMA. Bytes are queued in RAM and sent
+ * in the background; the peripheral is only enabled while a burst is on the
+ * wire, so it does not hold the high-frequency clock between log lines.
+ *
+ * Completion is polled from a LowPowerTimeout rather than the UARTE interrupt,
+ * which mbed's serial driver owns. The transport is a FileHandle so it can
+ * also be the console (see mbed_override_console in main.cpp); nothing else
+ * may construct a serial object on the same pins while it is in use.
+ *
+ * Writes never block. Bytes that don't fit while a burst is on the wire are
+ * dropped and counted, both in bytes and in writes that lost some.
+ */
+class UarteLogTransport : public FileHandle
+{
+public:
+    UarteLogTransport(PinName tx);
+    ~UarteLogTransport();
+
+    ssize_t write(const void* buffer, size_t size) override; // always reports size written
+    ssize_t read(void* buffer, size_t size) override { return -EBADF; } // transmit only
+    off_t seek(off_t offset, int whence = SEEK_SET) override { return -ESPIPE; }
+    int close() override { return 0; }
+    int isatty() override { return true; }
+    int sync() override { flush(); return 0; }
+
+    void flush(); // block until everything queued has been sent
+
+    uint32_t get_dropped_count() { return _dropped_bytes; } // bytes
+    uint32_t get_dropped_writes() { return _dropped_writes; } // writes that lost some or all of their bytes
+    uint32_t get_bytes_sent() { return _bytes_sent; }
+    uint64_t get_active_time_us() { return _active_time_us; } // time the peripheral was enabled
+
+private:
+    static const uint16_t BUFFER_SIZE = 255; // TXD.MAXCNT is 8 bits on the nRF52832
+    static const uint32_t BAUD_RATE = 115200;
+
+    void _start();
+    void _on_tx_timeout();
+    void _on_tx_stopped();
+
+    uint8_t _buffers[2][BUFFER_SIZE]; // EasyDMA can only read from RAM
+    uint8_t _fill_buffer = 0;
+    uint16_t _fill_length = 0;
+    uint16_t _tx_length = 0;
+    volatile bool _busy = false;
+    bool _stopping = false; // STOPTX issued, waiting for TXSTOPPED before disabling
+
+    uint32_t _tx_pin;
+    uint32_t _dropped_bytes = 0;
+    uint32_t _dropped_writes = 0;
+    uint32_t _bytes_sent = 0;
+    uint64_t _active_time_us = 0;
+
+    LowPowerTimeout _tx_timeout;
+    LowPowerTimer _active_timer;
+};
+
+#endif // UARTE_LOG_TRANSPORT_H_
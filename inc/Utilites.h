@@ -41,21 +41,23 @@ namespace Utilities
         return floor(val + 0.5);
     }
 
-    inline double std_dev(vector<double>& v)
+    // these take any vector-like container, so they work on BoundedVector in both builds
+
+    template <typename Container>
+    inline double std_dev(Container& v)
     {    
         double sum = std::accumulate(v.begin(), v.end(), 0.0);
         double mean = sum / v.size();
 
-        std::vector<double> diff(v.size());
-        std::transform(v.begin(), v.end(), diff.begin(),
-                    std::bind2nd(std::minus<double>(), mean));
-        double sq_sum = std::inner_product(diff.begin(), diff.end(), diff.begin(), 0.0);
+        double sq_sum = std::accumulate(v.begin(), v.end(), 0.0,
+                    [mean](double acc, double x){ return acc + (x - mean) * (x - mean); });
         double stdev = std::sqrt(sq_sum / v.size());
 
         return stdev;
     }
 
-    inline double mean(vector<double>& v)
+    template <typename Container>
+    inline double mean(Container& v)
     {
         double sum = std::accumulate(v.begin(), v.end(), 0.0);
         double mean = sum / v.size();
@@ -64,13 +66,15 @@ namespace Utilities
     }
 
     //From http://www.richelbilderbeek.nl/CppReciprocal.htm
-    inline void reciprocal(vector<double>& c)
+    template <typename Container>
+    inline void reciprocal(Container& c)
     {
     std::transform(c.begin(),c.end(),c.begin(),
-        std::bind1st(std::divides<double>(),1.0));    
+        [](double x){ return 1.0 / x; });    
     }
 
-    inline void multiply(vector<double>& v, double k)
+    template <typename Container>
+    inline void multiply(Container& v, double k)
     {
         std::transform(v.begin(), v.end(), v.begin(), [k](double &c){ return c*k; });
     }
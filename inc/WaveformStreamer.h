@@ -0,0 +1,120 @@
+/**
+ * @file WaveformStreamer.h
+ * @author agent agent@local
+ * @brief Streams raw pressure and temperature waveforms over BLE notifications
+ * @version 0.1
+ * @date 2026-10-19
+ * 
+ * @copyright Copyright (c) 2026 Ka Moamoa
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, version 3 of the license.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef WAVEFORMSTREAMER_H_
+#define WAVEFORMSTREAMER_H_
+
+#include "mbed.h"
+#include "rtos.h"
+#include "events/mbed_events.h"
+#include "SmartPPEService.h"
+#include "Logger.h"
+
+using namespace std::chrono;
+
+/**
+ * Research mode: raw barometer pressure and Si7051 temperature go out as
+ * notifications on the pressure/temperature characteristics while the
+ * capture carries on.
+ *
+ * Each source has two batch buffers. The sensor code fills one while the
+ * BLE thread sends the other, so acquisition never waits on the radio. If
+ * a batch fills up while the other is still waiting to go out, the new
+ * batch is dropped and counted instead.
+ *
+ * A batch goes out as MTU-sized notifications, one in flight per source:
+ * the next is only written once the stack reports the last as sent. A
+ * batch counts as sent once all of its notifications have been; if the
+ * phone isn't subscribed, a write fails, or the link drops with one in
+ * flight, the rest of the batch is dropped and counted.
+ */
+class WaveformStreamer
+{
+public:
+    enum Source_t
+    {
+        PRESSURE,
+        TEMPERATURE,
+        SOURCE_LAST
+    };
+
+    static const uint8_t BATCH_SIZE = 100; // samples, the most a characteristic holds
+
+    WaveformStreamer(WaveformStreamer &other) = delete;
+    void operator=(const WaveformStreamer &) = delete;
+
+    static WaveformStreamer* get_instance();
+
+    void enable(SmartPPEService *service, events::EventQueue *queue);
+    void disable();
+    bool is_enabled() { return _enabled; };
+
+    /**
+     * @brief Queue samples from the sensor thread. Never blocks.
+     * timestamp_ms is the first sample's time on the sensor's clock.
+     */
+    void push(Source_t source, uint64_t timestamp_ms, float frequency, const uint16_t *samples, uint16_t num_samples);
+
+    uint32_t get_sent_count() { return _sent; }; // batches
+    uint32_t get_dropped_count() { return _dropped; }; // batches
+
+private:
+    WaveformStreamer();
+    ~WaveformStreamer();
+
+    typedef struct
+    {
+        uint16_t samples[BATCH_SIZE];
+        uint8_t num_samples;
+        uint64_t timestamp_ms;
+        float frequency;
+        volatile bool ready; // handed to the BLE thread, not to be touched until it clears this
+    } Batch_t;
+
+    void _schedule_send();
+    void _send();
+    void _send_next(Source_t source);
+    void _on_notified(SmartPPEService::data_ready_t type, bool sent);
+    void _finish(Source_t source, Batch_t &batch, bool sent);
+    void _report_dropped();
+    Batch_t* _ready_batch(Source_t source);
+
+    static WaveformStreamer* _instance;
+    static Mutex _mutex;
+
+    Logger* _logger;
+    SmartPPEService *_service = nullptr;
+    events::EventQueue *_queue = nullptr;
+    volatile bool _enabled = false;
+
+    Batch_t _batches[SOURCE_LAST][2];
+    uint8_t _filling[SOURCE_LAST] = {0};
+    uint8_t _next_sample[SOURCE_LAST] = {0}; // how much of the batch being sent the stack has confirmed
+    uint8_t _in_flight[SOURCE_LAST] = {0}; // samples in the notification awaiting confirmation
+
+    volatile uint32_t _sent = 0;
+    volatile uint32_t _dropped = 0;
+    uint32_t _reported_dropped = 0;
+    volatile bool _send_pending = false;
+};
+
+#endif // WAVEFORMSTREAMER_H_
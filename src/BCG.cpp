@@ -23,7 +23,6 @@
 #include "BCG.h"
 #include "Logger.h"
 #include "Utilites.h"
-#include <numeric>
 
 // #define BCG_LOGGING
 
@@ -36,6 +35,8 @@ _g_drdy(int1_pin)
     _spi = spi;
     _cs = cs;
     _logger = Logger::get_instance();
+    _cap_calc = CapCalc::get_instance();
+    _checkpoint = Checkpoint::get_instance();
 }
 
 BCG::~BCG()
@@ -49,65 +50,37 @@ BCG::HR_t BCG::get_buffer_element()
     return tmp;
 }
 
-bool BCG::bcg(const seconds num_seconds)
+bool BCG::bcg(const seconds num_seconds, SensorSession* session)
 {
-    // turn on SPI bus
-    _bus_control->spi_power(true);
-
-    // Give time for the chip to turn on
-    ThisThread::sleep_for(10ms);
-
-    /**
-     * @brief Init 4th order bandpass (10-13 Hz) Butterworth filters
-     * 
-     * We need 3 of them (one per axis) since we're doing this real-time.
-     * 
-     * Documentation can be found in BiQuad.h. BiQuads were 
-     * generated with MATLAB assuming 104 Hz sampling frequency.
-     */
-    BiQuadChain bcg_isolation_x;
-    BiQuad bqx1( 6.76087639e-04,  1.35217528e-03,  6.76087639e-04,  1.00000000e+00, -2.16739514e-01,  7.10632547e-01);
-    BiQuad bqx2( 1.00000000e+00,  2.00000000e+00,  1.00000000e+00,  1.00000000e+00, -4.54393846e-01,  7.17539837e-01);
-    BiQuad bqx3( 1.00000000e+00, -2.00000000e+00,  1.00000000e+00,  1.00000000e+00, -5.35180090e-02,  8.69556033e-01);
-    BiQuad bqx4( 1.00000000e+00, -2.00000000e+00,  1.00000000e+00,  1.00000000e+00, -6.64197076e-01,  8.77428070e-01);
-
-    BiQuadChain bcg_isolation_y;
-    BiQuad bqy1( 6.76087639e-04,  1.35217528e-03,  6.76087639e-04,  1.00000000e+00, -2.16739514e-01,  7.10632547e-01);
-    BiQuad bqy2( 1.00000000e+00,  2.00000000e+00,  1.00000000e+00,  1.00000000e+00, -4.54393846e-01,  7.17539837e-01);
-    BiQuad bqy3( 1.00000000e+00, -2.00000000e+00,  1.00000000e+00,  1.00000000e+00, -5.35180090e-02,  8.69556033e-01);
-    BiQuad bqy4( 1.00000000e+00, -2.00000000e+00,  1.00000000e+00,  1.00000000e+00, -6.64197076e-01,  8.77428070e-01);
-
-    BiQuadChain bcg_isolation_z;
-    BiQuad bqz1( 6.76087639e-04,  1.35217528e-03,  6.76087639e-04,  1.00000000e+00, -2.16739514e-01,  7.10632547e-01);
-    BiQuad bqz2( 1.00000000e+00,  2.00000000e+00,  1.00000000e+00,  1.00000000e+00, -4.54393846e-01,  7.17539837e-01);
-    BiQuad bqz3( 1.00000000e+00, -2.00000000e+00,  1.00000000e+00,  1.00000000e+00, -5.35180090e-02,  8.69556033e-01);
-    BiQuad bqz4( 1.00000000e+00, -2.00000000e+00,  1.00000000e+00,  1.00000000e+00, -6.64197076e-01,  8.77428070e-01);
-
-    bcg_isolation_x.add( &bqx1 ).add( &bqx2 ).add( &bqx3 ).add( &bqx4 );
-    bcg_isolation_y.add( &bqy1 ).add( &bqy2 ).add( &bqy3 ).add( &bqy4 );
-    bcg_isolation_z.add( &bqz1 ).add( &bqz2 ).add( &bqz3 ).add( &bqz4 );
-
-    // Init 2nd order bandpass (0.75-2.5 Hz) Butterworth filter
-    BiQuadChain hr_isolation;
-    BiQuad bq5( 0.00952329,  0.01904657,  0.00952329,  1., -1.74516121,  0.8078649 );
-    BiQuad bq6( 1.,          -2.,         1.,          1., -1.91061565,  0.92055723 );
-
-    hr_isolation.add( &bq5 ).add ( &bq6 );
+    // turn on the IMU
+    bool switched_on = _bus_control->acquire(BusControl::IMU);
+
+    // 10-13 Hz per axis, then 0.75-2.5 Hz on the magnitude, and the zero-cross rates
+    BCGFilter filter;
 
     // Set up gyroscope
     LSM6DSLSensor imu(_spi, _cs);
+    if (switched_on)
+    {
+        _wait_for_imu(imu); // the sensor object talks SPI, so it can only exist once the rail is up
+    }
     _init_imu(imu);
 
     // init some tracker variables
-    float last_bcg_val = -1.0;
-    vector<double> last_crosses;
-    vector<double> rates;
-    vector<double> last_maxes;
-    vector<double> last_mins;
+    BoundedVector<double, MAX_RATES> rates;
     bool new_hr_reading = false;
-    bool initialized = false;
-    float max = 0;
-    float min = 0;
+    double elapsed_before = 0; // seconds of capture done before a brownout
+
+    _suspended = false;
+
+    static State_t state; // off the main thread's stack; only one capture runs at a time
+    if (_checkpoint->get_pending() == Checkpoint::TASK_HEART_RATE && _checkpoint->load(Checkpoint::TASK_HEART_RATE, &state, sizeof(state)))
+    {
+        elapsed_before = state.elapsed_ms / 1000.0;
+        rates.assign(state.rates, state.rates + state.num_rates);
+
+        _logger->log(TRACE_INFO, "Resuming BCG at %0.1fs with %u rates", elapsed_before, rates.size());
+    }
 
     LowPowerTimer timeout;
     timeout.start();
@@ -116,7 +89,7 @@ bool BCG::bcg(const seconds num_seconds)
 
     #ifdef BCG_LOGGING
     {
-        _logger->log(TRACE_WARNING, "ts, g_x, g_y, g_z, x_filt, y_filt, z_filt, l2norm, bcg");
+        _logger->log(TRACE_WARNING, "ts, g_x, g_y, g_z, bcg, rate, std_dev");
     }
     #endif // BCG_LOGGING
 
@@ -132,7 +105,7 @@ bool BCG::bcg(const seconds num_seconds)
     }
 
     // acquire and process samples until num_seconds has elapsed
-    while(zc_timer.elapsed_time() <= duration_cast<microseconds>(num_seconds))
+    while(zc_timer.read() + elapsed_before <= num_seconds.count())
     {
         if (_g_drdy.read())        
         {   
@@ -141,103 +114,46 @@ bool BCG::bcg(const seconds num_seconds)
             // get samples
             float gyr[3] = {0};
             imu.get_g_axes_f(gyr);
-            double x = gyr[0];
-            double y = gyr[1];
-            double z = gyr[2];
 
-            if (!initialized) // prime the bcg isolation filters
+            // seconds into the capture, not counting any brownout
+            double zc_ts = elapsed_before + zc_timer.read();
+            if (filter.step(gyr[0], gyr[1], gyr[2], zc_ts))
             {
-                for (int i = 0; i < G_FREQUENCY * 5; i++)
+                if (rates.size() >= MAX_RATES)
                 {
-                    bcg_isolation_x.step(x);
-                    bcg_isolation_y.step(y);
-                    bcg_isolation_z.step(z);
-                }
-            }
-
-            // put each axis through bcg features isolation filter
-            double xfilt = bcg_isolation_x.step(x);
-            double yfilt = bcg_isolation_y.step(y);
-            double zfilt = bcg_isolation_z.step(z);
-            
-            // l2norm the signal
-            double mag = _l2norm(xfilt, yfilt, zfilt);
-
-            // prime the hr isolation filter
-            if (!initialized)
-            {
-                for (int i = 0; i < G_FREQUENCY * 5; i++)
-                {
-                    hr_isolation.step(mag);
-                }
-
-                initialized = true;
-            } 
-
-            // send l2norm through hr isolation filter
-            float next_bcg_val = hr_isolation.step(mag);
-
-            // look for a descending zero-cross
-            float rate_raw = 0;
-            float std_dev = 0;
-            if (last_bcg_val > 0 && next_bcg_val <= 0)
-            {
-
-                double zc_ts = (double)zc_timer.read();
-                last_crosses.push_back(zc_ts);
-                last_maxes.push_back(max);
-                last_mins.push_back(min);
-
-                max = 0;
-                min = 0;
-
-                if (last_crosses.size() >= NUM_EVENTS)
-                {
-                    /**
-                     * Now see if the last NUM_EVENTS crosses warrant a heart rate calculation,
-                     * by checking the standard deviation of the instantaneous heart rates 
-                     * derived from them. If the standard deviation falls below our STD_DEV_THRESHOLD,
-                     * use them to calculate a heart rate and save to the vector.
-                     */
-                    vector<double> crosses_copy = last_crosses;
-
-                    std::adjacent_difference(crosses_copy.begin(), crosses_copy.end(), crosses_copy.begin());
-                    crosses_copy.erase(crosses_copy.begin());
-
-                    Utilities::reciprocal(crosses_copy); // get element-wise frequency
-                    Utilities::multiply(crosses_copy, 60.0); // get element-wise heart rate
-                    std_dev = Utilities::std_dev(crosses_copy); // calculate standard deviation across the heart rates
-                    
-                    if (std_dev < STD_DEV_THRESHOLD) // we have some stable readings! calculate heart rate
-                    {
-                        rate_raw = Utilities::mean(crosses_copy);
-
-                        // bounds checking
-                        if (rate_raw >= MIN_HR && rate_raw <= MAX_HR)
-                        {
-                            rates.push_back(rate_raw);
-                            _logger->log(TRACE_DEBUG, "New HR reading --> rate: %0.1f, time: %lli", rate_raw, time(NULL));
-                        }
-                    }
-
-                    // now remove first element from last_crosses vector to keep it at NUM_EVENTS length
-                    while(last_crosses.size() >= NUM_EVENTS)
-                    {
-                        last_crosses.erase(last_crosses.begin());
-                        last_maxes.erase(last_maxes.begin());
-                        last_mins.erase(last_mins.begin());
-                    }
+                    rates.erase(rates.begin()); // not at a 15 s capture, but keep the newest if it happens
                 }
+                rates.push_back(filter.get_rate());
+                LOG(_logger, TRACE_DEBUG, "New HR reading --> rate: %0.1f, time: %lli", filter.get_rate(), time(NULL));
             }
 
             #ifdef BCG_LOGGING
             {
-                _logger->log(TRACE_WARNING, "%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f", x, y, z, xfilt, yfilt, zfilt, mag, next_bcg_val, rate_raw, std_dev);
+                _logger->log(TRACE_WARNING, "%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f", zc_ts, gyr[0], gyr[1], gyr[2], filter.get_value(), filter.get_rate(), filter.get_std_dev());
             }
             #endif // BCG_LOGGING
+        }
+
+        if (session != nullptr && !session->update())
+        {
+            _logger->log(TRACE_INFO, "%s", "Mask off, stopping BCG");
+            rates.clear();
+            break;
+        }
+
+        if (_cap_calc->is_energy_low())
+        {
+            state.elapsed_ms = (elapsed_before + zc_timer.read()) * 1000;
+
+            // keep the newest rates if there are more than fit
+            state.num_rates = rates.size() < MAX_RATES ? rates.size() : MAX_RATES;
+            std::copy(rates.end() - state.num_rates, rates.end(), state.rates);
 
+            _suspended = _checkpoint->save(Checkpoint::TASK_HEART_RATE, &state, sizeof(state));
+            _logger->log(TRACE_INFO, "Energy low, %s BCG at %0.1fs", _suspended ? "checkpointed" : "abandoned", state.elapsed_ms / 1000.0);
 
-            last_bcg_val = next_bcg_val;
+            rates.clear(); // the result comes from the resumed capture
+            break;
         }
         
         ThisThread::sleep_for(1ms);
@@ -258,7 +174,7 @@ bool BCG::bcg(const seconds num_seconds)
         for (int i = 0; i < rates.size(); i++)
         {
             float z_score = (rates[i] - average_rate) / std_dev_rate;
-            _logger->log(TRACE_TRACE, "rate = %0.1f, z-score = %0.1f --> %s", rates[i], z_score, z_score > OUTLIER_THRESHOLD ? "ERASE" : "KEEP");
+            LOG(_logger, TRACE_TRACE, "rate = %0.1f, z-score = %0.1f --> %s", rates[i], z_score, z_score > OUTLIER_THRESHOLD ? "ERASE" : "KEEP");
             if (z_score > OUTLIER_THRESHOLD) rates.erase(rates.begin() + i); // delete any outliers
         }
 
@@ -280,19 +196,18 @@ bool BCG::bcg(const seconds num_seconds)
         new_hr_reading = true;
     }
 
-    _bus_control->spi_power(false);
+    if (!_suspended)
+    {
+        _checkpoint->discard(Checkpoint::TASK_HEART_RATE); // finished (or abandoned), don't resume it again
+    }
+
+    _bus_control->release(BusControl::IMU);
     zc_timer.stop(); 
     timeout.stop();
 
     return new_hr_reading;
 }
 
-double BCG::_l2norm(double x, double y, double z)
-{
-    double result = sqrt( (x * x) + (y * y) + (z * z) );
-    return result;
-}
-
 void BCG::_init_imu(LSM6DSLSensor& imu)
 {
     imu.init(NULL);
@@ -302,12 +217,18 @@ void BCG::_init_imu(LSM6DSLSensor& imu)
     imu.enable_int1_drdy_g();
 }
 
+bool BCG::_wait_for_imu(LSM6DSLSensor& imu)
+{
+    return _bus_control->wait_until_ready(BusControl::IMU, [&imu]() {
+        uint8_t id = 0;
+        return imu.read_id(&id) == 0 && id == LSM6DSL_ACC_GYRO_WHO_AM_I;
+    });
+}
+
 void BCG::_reset_imu(LSM6DSLSensor& imu)
 {
-    _bus_control->spi_power(false);
-    ThisThread::sleep_for(10ms);
-    _bus_control->spi_power(true);
-    ThisThread::sleep_for(10ms);
+    _bus_control->power_cycle(BusControl::IMU);
+    _wait_for_imu(imu);
 
     _init_imu(imu);
 }
@@ -0,0 +1,112 @@
+/**
+ * @file BCGFilter.cpp
+ * @author agent agent@local
+ * @brief Ballistocardiogram filters and heartbeat (zero-cross) rate detection
+ * @version 0.1
+ * @date 2026-10-19
+ * 
+ * @copyright Copyright (c) 2026 Ka Moamoa
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, version 3 of the license.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "BCGFilter.h"
+#include "Utilites.h"
+#include <math.h>
+#include <numeric>
+
+BCGFilter::BCGFilter()
+{
+    _bcg_isolation_x.add( &_bqx1 ).add( &_bqx2 ).add( &_bqx3 ).add( &_bqx4 );
+    _bcg_isolation_y.add( &_bqy1 ).add( &_bqy2 ).add( &_bqy3 ).add( &_bqy4 );
+    _bcg_isolation_z.add( &_bqz1 ).add( &_bqz2 ).add( &_bqz3 ).add( &_bqz4 );
+
+    _hr_isolation.add( &_bq5 ).add ( &_bq6 );
+}
+
+bool BCGFilter::step(double x, double y, double z, double timestamp)
+{
+    if (!_primed) // prime the bcg isolation filters
+    {
+        for (int i = 0; i < PRIME_SAMPLES; i++)
+        {
+            _bcg_isolation_x.step(x);
+            _bcg_isolation_y.step(y);
+            _bcg_isolation_z.step(z);
+        }
+    }
+
+    // put each axis through bcg features isolation filter
+    double xfilt = _bcg_isolation_x.step(x);
+    double yfilt = _bcg_isolation_y.step(y);
+    double zfilt = _bcg_isolation_z.step(z);
+
+    // l2norm the signal
+    double mag = sqrt( (xfilt * xfilt) + (yfilt * yfilt) + (zfilt * zfilt) );
+
+    // prime the hr isolation filter
+    if (!_primed)
+    {
+        for (int i = 0; i < PRIME_SAMPLES; i++)
+        {
+            _hr_isolation.step(mag);
+        }
+
+        _primed = true;
+    }
+
+    // send l2norm through hr isolation filter
+    float next_bcg_val = _hr_isolation.step(mag);
+
+    // look for a descending zero-cross
+    _descending = _last > 0 && next_bcg_val <= 0;
+    _last = next_bcg_val;
+
+    if (!_descending)
+    {
+        return false;
+    }
+
+    _crosses.push_back(timestamp);
+    if (_crosses.size() < NUM_EVENTS)
+    {
+        return false;
+    }
+
+    /**
+     * Now see if the last NUM_EVENTS crosses warrant a heart rate calculation,
+     * by checking the standard deviation of the instantaneous heart rates
+     * derived from them. If the standard deviation falls below our STD_DEV_THRESHOLD,
+     * use them to calculate a heart rate.
+     */
+    BoundedVector<double, NUM_EVENTS> rates = _crosses;
+
+    std::adjacent_difference(rates.begin(), rates.end(), rates.begin());
+    rates.erase(rates.begin());
+
+    Utilities::reciprocal(rates); // get element-wise frequency
+    Utilities::multiply(rates, 60.0); // get element-wise heart rate
+    _std_dev = Utilities::std_dev(rates); // calculate standard deviation across the heart rates
+
+    // now remove first element to keep the next run at NUM_EVENTS crosses
+    _crosses.erase(_crosses.begin());
+
+    if (_std_dev >= STD_DEV_THRESHOLD)
+    {
+        return false;
+    }
+
+    // we have some stable readings! calculate heart rate, with bounds checking
+    _rate = Utilities::mean(rates);
+    return _rate >= MIN_HR && _rate <= MAX_HR;
+}
@@ -1,5 +1,6 @@
 #include "Barometer.hpp"
 #include "Utilites.h"
+#include "WaveformStreamer.h"
 
 using namespace std::chrono;
 
@@ -8,13 +9,25 @@ _barometer(spi, cs_pin),
 _int_pin(int_pin, PullNone)
 {
     _logger = Logger::get_instance();
+    _streamer = WaveformStreamer::get_instance();
 }
 
 Barometer::~Barometer()
 {
 }
 
-bool Barometer::initialize()
+bool Barometer::is_ready()
+{
+    uint8_t id = 0;
+    return _barometer.read_id(&id) == 0 && id == LPS22HB_WHO_AM_I_VAL;
+}
+
+/**
+ * @brief Configure the (powered) barometer. Low current mode draws a
+ * quarter of the supply current (3 vs 12 uA at 1 Hz) for more noise,
+ * which suits streams that run all the time.
+ */
+bool Barometer::initialize(bool low_current)
 {
     if (_initialized)
     {
@@ -24,9 +37,9 @@ bool Barometer::initialize()
 
     _bus_control = BusControl::get_instance();
 
-    if (_bus_control->get_spi_power() == false)
+    if (_bus_control->is_powered(BusControl::BAROMETER) == false)
     {
-        _logger->log(TRACE_WARNING, "%s", "SPI bus not powered, cannot initialize");
+        _logger->log(TRACE_WARNING, "%s", "Barometer not powered, cannot initialize");
         return false;
     }
 
@@ -35,6 +48,11 @@ bool Barometer::initialize()
         return false;
     }
 
+    if (_barometer.set_low_current(low_current)) // only while it's powered down
+    {
+        return false;
+    }
+
     if (_barometer.set_odr(_frequency) == LPS22HB_ERROR)
     {
         return false;
@@ -55,6 +73,12 @@ bool Barometer::initialize()
         return false;
     }
 
+    _sample_clock.reset();
+    _sample_clock.set_nominal_frequency(_frequency);
+    _samples_read = 0;
+    _overrun_flag = false;
+    clear_buffers();
+
     _int_pin.rise(callback(this, &Barometer::bar_data_ready));
 
     _logger->log(TRACE_TRACE, "%s", "Barometer initialized successfully");
@@ -63,6 +87,21 @@ bool Barometer::initialize()
     return true;
 }
 
+/**
+ * @brief Detach the data ready interrupt and mark the barometer for
+ * re-initialization. Call before releasing the rail, so the same
+ * Barometer can be initialized again on the next power up.
+ */
+void Barometer::stop()
+{
+    _int_pin.rise(nullptr);
+    _t_barometer.stop();
+    _bar_data_ready = false;
+    _drdy_timestamp_valid = false;
+    _data_ready_flags.clear(DATA_READY_FLAG);
+    _initialized = false;
+}
+
 bool Barometer::set_frequency(uint8_t frequency)
 {
     if (_barometer.set_odr((float)frequency - 0.1) == LPS22HB_ERROR) // - 0.1 because they try to compare floats in the driver 
@@ -71,6 +110,7 @@ bool Barometer::set_frequency(uint8_t frequency)
     }
 
     _frequency = frequency;
+    _sample_clock.set_nominal_frequency(_frequency);
     return true;
 }
 
@@ -80,10 +120,80 @@ bool Barometer::set_fifo_full_interrupt(bool enable)
     {
         return false;
     }
+
+    if (enable)
+    {
+        if (_barometer.enable_fifo_watermark_interrupt(false) == LPS22HB_ERROR)
+        {
+            return false;
+        }
+
+        // STOP_ON_FTH would otherwise still cap the FIFO at the old watermark, so it never fills
+        if (_barometer.enable_fifo_watermark(false) == LPS22HB_ERROR)
+        {
+            return false;
+        }
+
+        _batch_size = BAROMETER_FIFO_SIZE;
+    }
     
     return true;
 }
 
+/**
+ * @brief Interrupt once every batch_size samples instead of waiting
+ * for the FIFO to fill. Smaller batches mean lower latency (e.g. for
+ * quick mask checks) at the cost of more wake-ups; a batch size of 0
+ * or >= 32 falls back on the FIFO full interrupt.
+ */
+bool Barometer::set_fifo_watermark_interrupt(uint8_t batch_size)
+{
+    if (batch_size == 0 || batch_size >= BAROMETER_FIFO_SIZE)
+    {
+        return set_fifo_full_interrupt(true);
+    }
+
+    if (_barometer.fifo_full_interrupt(false) == LPS22HB_ERROR)
+    {
+        return false;
+    }
+
+    if (_barometer.set_fifo_watermark(batch_size) == LPS22HB_ERROR)
+    {
+        return false;
+    }
+
+    if (_barometer.enable_fifo_watermark() == LPS22HB_ERROR)
+    {
+        return false;
+    }
+
+    if (_barometer.enable_fifo_watermark_interrupt(true) == LPS22HB_ERROR)
+    {
+        return false;
+    }
+
+    _batch_size = batch_size;
+    return true;
+}
+
+/**
+ * @brief Sleep until the barometer interrupts with a new batch (or the
+ * timeout expires), then read it out. Returns true if new data was read.
+ */
+bool Barometer::wait_for_data(milliseconds timeout)
+{
+    if (!_bar_data_ready)
+    {
+        _data_ready_flags.wait_any_for(DATA_READY_FLAG, timeout);
+    }
+
+    // check the FIFO status even if we timed out, in case we missed an edge
+    _bar_data_ready = true;
+
+    return update();
+}
+
 bool Barometer::update(bool force)
 {
     // if the interrupt has been triggered, read the data
@@ -91,9 +201,11 @@ bool Barometer::update(bool force)
     {
         LPS22HB_FifoStatus_st fifo_status;
         _barometer.get_fifo_status(&fifo_status);
-        if (!fifo_status.FIFO_FULL && !force)
+        bool batch_ready = _batch_size >= BAROMETER_FIFO_SIZE ? fifo_status.FIFO_FULL : fifo_status.FIFO_FTH;
+        if (!batch_ready && !force)
         {
-            _logger->log(TRACE_DEBUG, "%s", "FIFO not full, but interrupt triggered");
+            LOG(_logger, TRACE_DEBUG, "%s", "batch not ready, but interrupt triggered");
+            _bar_data_ready = false;
             return false;
         }
 
@@ -104,10 +216,28 @@ bool Barometer::update(bool force)
             _high_pressure_event_flag = true;
         }
 
-        if (!read_buffered_data())
+        if (fifo_status.FIFO_OVR)
+        {
+            /**
+             * The FIFO overwrote samples we never read, so the sample
+             * count no longer matches the interrupt timestamps. Start
+             * the fit over from this read.
+             */
+            _overrun_flag = true;
+            _drdy_timestamp_valid = false;
+            _sample_clock.reset();
+        }
+
+        if (!read_buffered_data(fifo_status.FIFO_LEVEL))
         {
             return false;
         }
+
+        if (_sample_clock.get_num_points() == 0)
+        {
+            // the newest sample in the FIFO is at most a sample period old
+            _sample_clock.add_point(_samples_read - 1, duration_cast<milliseconds>(_t_barometer.elapsed_time()).count());
+        }
         
         return true;
     }
@@ -141,10 +271,12 @@ void Barometer::bar_data_ready()
     uint64_t delta_timestamp = _drdy_timestamp - _last_timestamp;
     _last_timestamp = _drdy_timestamp;
     
-    float measurement_frequency = 1000 * (float)BAROMETER_FIFO_SIZE / ((float)delta_timestamp);
+    float measurement_frequency = 1000 * (float)_batch_size / ((float)delta_timestamp);
     _measurement_frequencyx100 = Utilities::round(measurement_frequency * 100);
 
     _bar_data_ready = true;
+    _drdy_timestamp_valid = true;
+    _data_ready_flags.set(DATA_READY_FLAG);
 }
 
 uint64_t Barometer::get_delta_timestamp(bool broadcast)
@@ -162,14 +294,47 @@ float Barometer::convert_to_hpa(uint16_t raw_data)
   return ((float)raw_data + 80000.0) / 100.0;
 }
 
-bool Barometer::read_buffered_data()
+bool Barometer::read_buffered_data(uint8_t num_samples)
 {
-    if (_barometer.get_fifo(_pressure_buffer, _temperature_buffer) == LPS22HB_ERROR)
+    /**
+     * The interrupt fired when sample number _batch_size of this batch
+     * landed in the FIFO, so that's the sample its timestamp belongs to.
+     * Forced reads have no interrupt timestamp to contribute.
+     */
+    bool triggered = _drdy_timestamp_valid && num_samples >= _batch_size;
+    uint16_t pre_read_size = _pressure_buffer.size();
+
+    if (num_samples > FIFO_LENGTH)
     {
+        num_samples = FIFO_LENGTH;
+    }
+
+    _pressure_buffer.resize(pre_read_size + num_samples);
+    _temperature_buffer.resize(pre_read_size + num_samples);
+
+    if (_barometer.get_fifo(_pressure_buffer.data() + pre_read_size, _temperature_buffer.data() + pre_read_size, num_samples) == LPS22HB_ERROR)
+    {
+        _pressure_buffer.resize(pre_read_size);
+        _temperature_buffer.resize(pre_read_size);
         _logger->log(TRACE_WARNING, "%s", "Unable to read barometer data");
         return false;
     }
 
+    if (triggered)
+    {
+        _sample_clock.add_point(_samples_read + _batch_size - 1, _drdy_timestamp);
+    }
+
+    uint16_t new_samples = _pressure_buffer.size() - pre_read_size;
+    if (_streamer->is_enabled() && new_samples > 0)
+    {
+        // hand over before the buffer gets trimmed, push() only copies
+        _streamer->push(WaveformStreamer::PRESSURE, _sample_clock.get_sample_time_ms(_samples_read),
+            _sample_clock.get_frequency(), &_pressure_buffer[pre_read_size], new_samples);
+    }
+
+    _samples_read += new_samples;
+
     if (_pressure_buffer.size() > _max_buffer_size)
     {
         _pressure_buffer.resize(_max_buffer_size);
@@ -181,6 +346,8 @@ bool Barometer::read_buffered_data()
     }
 
     _bar_data_ready = false;
+    _drdy_timestamp_valid = false;
+    _data_ready_flags.clear(DATA_READY_FLAG);
     return true;
 }
 
@@ -0,0 +1,100 @@
+/**
+ * @file BreathFilter.cpp
+ * @author agent agent@local
+ * @brief Breathing band-pass filter and breath (zero-cross) detection
+ * @version 0.1
+ * @date 2026-10-19
+ * 
+ * @copyright Copyright (c) 2026 Ka Moamoa
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, version 3 of the license.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "BreathFilter.h"
+#include <string.h>
+#include <type_traits>
+
+static_assert(std::is_trivially_copyable<BiQuad>::value, "BiQuad state is checkpointed byte-for-byte");
+
+BreathFilter::BreathFilter()
+{
+}
+
+void BreathFilter::prime(double sample)
+{
+    for (int i = 0; i < PRIME_SAMPLES; i++)
+    {
+        _bq2.step(_bq1.step(sample));
+    }
+
+    _primed = true;
+}
+
+bool BreathFilter::step(double sample)
+{
+    double filtered = _bq2.step(_bq1.step(sample));
+
+    if (filtered > _peak) _peak = filtered;
+    if (filtered < _trough) _trough = filtered;
+    _length++;
+
+    _descending = _last > 0 && filtered < 0;
+    _ascending = _last < 0 && filtered > 0;
+    _last = filtered;
+
+    if (!_descending)
+    {
+        return false;
+    }
+
+    bool breath = _crossed;
+    if (breath)
+    {
+        _breath_peak = _peak;
+        _breath_trough = _trough;
+        _breath_length = _length;
+    }
+
+    _crossed = true;
+    _peak = 0;
+    _trough = 0;
+    _length = 0;
+
+    return breath;
+}
+
+void BreathFilter::save(State_t &state)
+{
+    memcpy(state.biquads[0], &_bq1, sizeof(BiQuad));
+    memcpy(state.biquads[1], &_bq2, sizeof(BiQuad));
+    state.last = _last;
+    state.peak = _peak;
+    state.trough = _trough;
+    state.length = _length;
+    state.primed = _primed;
+    state.crossed = _crossed;
+}
+
+void BreathFilter::restore(const State_t &state)
+{
+    memcpy(&_bq1, state.biquads[0], sizeof(BiQuad));
+    memcpy(&_bq2, state.biquads[1], sizeof(BiQuad));
+    _last = state.last;
+    _peak = state.peak;
+    _trough = state.trough;
+    _length = state.length;
+    _primed = state.primed;
+    _crossed = state.crossed;
+    _descending = false;
+    _ascending = false;
+}
@@ -0,0 +1,314 @@
+/**
+ * @file Broadcaster.cpp
+ * @author agent agent@local
+ * @brief Connectionless sync of the latest readings in advertising data
+ * @version 0.1
+ * @date 2026-10-19
+ * 
+ * @copyright Copyright (c) 2026 Ka Moamoa
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, version 3 of the license.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "Broadcaster.h"
+#include "RecordStream.h"
+#include "TimeBase.h"
+
+Broadcaster::Broadcaster(events::EventQueue &queue) :
+_queue(queue)
+{
+    _logger = Logger::get_instance();
+}
+
+Broadcaster::~Broadcaster()
+{
+}
+
+void Broadcaster::add_reading(uint8_t type, uint16_t value)
+{
+    _history_mutex.lock();
+
+    Reading_t &reading = _history[_history_next];
+    reading.type = type;
+    reading.value = value;
+    reading.timestamp = _now();
+
+    _history_next = (_history_next + 1) % HISTORY_SIZE;
+    if (_history_count < HISTORY_SIZE)
+    {
+        _history_count++;
+    }
+    _sequence++;
+
+    _history_mutex.unlock();
+
+    _schedule_refresh();
+}
+
+void Broadcaster::set_mask_state(uint8_t state)
+{
+    _history_mutex.lock();
+
+    bool changed = state != _mask_state;
+    if (changed)
+    {
+        _mask_state = state;
+        _sequence++;
+    }
+
+    _history_mutex.unlock();
+
+    if (changed)
+    {
+        _schedule_refresh();
+    }
+}
+
+void Broadcaster::refresh()
+{
+    // same readings, new times; a phone that skips repeats needs to see it as new
+    _history_mutex.lock();
+    _sequence++;
+    _history_mutex.unlock();
+
+    _schedule_refresh();
+}
+
+void Broadcaster::set_energy_low(bool low)
+{
+    _queue.call([this, low]() {
+        _energy_low = low;
+        _update_advertising();
+    });
+}
+
+void Broadcaster::start(BLE &ble)
+{
+    _ble = &ble;
+    ble::Gap &gap = _ble->gap();
+
+    _own_set = false;
+    if (gap.isFeatureSupported(ble::controller_supported_features_t::LE_EXTENDED_ADVERTISING) && gap.getMaxAdvertisingSetNumber() > 1)
+    {
+        ble::AdvertisingParameters params(
+            ble::advertising_type_t::NON_CONNECTABLE_UNDIRECTED,
+            ble::adv_interval_t(ble::millisecond_t(ADVERTISING_INTERVAL.count())));
+        params.setUseLegacyPDU(true); // so phones that only scan legacy PDUs see it
+
+        _own_set = gap.createAdvertisingSet(&_handle, params) == BLE_ERROR_NONE;
+    }
+
+    if (!_own_set)
+    {
+        _handle = ble::LEGACY_ADVERTISING_HANDLE;
+        _logger->log(TRACE_DEBUG, "%s", "No spare advertising set, broadcasting in the scan response");
+    }
+
+    _refresh();
+    _update_advertising();
+}
+
+void Broadcaster::stop()
+{
+    _queue.call([this]() {
+        if (_ble != nullptr && _own_set)
+        {
+            _ble->gap().stopAdvertising(_handle);
+            _ble->gap().destroyAdvertisingSet(_handle);
+            _own_set = false;
+        }
+    });
+}
+
+void Broadcaster::_schedule_refresh()
+{
+    if (core_util_atomic_exchange_bool(&_refresh_pending, true))
+    {
+        return;
+    }
+
+    if (_queue.call(callback(this, &Broadcaster::_refresh)) == 0)
+    {
+        // the BLE queue is full; the next change tries again
+        core_util_atomic_store_bool(&_refresh_pending, false);
+    }
+}
+
+/**
+ * @brief Start or stop our advertising set to match the energy state. The
+ * scan response of the single-set fallback rides on the BLE process's
+ * advertising, which only runs during a sync.
+ */
+void Broadcaster::_update_advertising()
+{
+    if (_ble == nullptr || !_own_set)
+    {
+        return;
+    }
+
+    ble::Gap &gap = _ble->gap();
+    bool advertising = gap.isAdvertisingActive(_handle);
+    if (advertising == !_energy_low)
+    {
+        return;
+    }
+
+    ble_error_t error = _energy_low ? gap.stopAdvertising(_handle) : gap.startAdvertising(_handle);
+    if (error != BLE_ERROR_NONE)
+    {
+        _logger->log(TRACE_WARNING, "Unable to %s broadcast: %u", _energy_low ? "pause" : "start", error);
+        return;
+    }
+
+    _logger->log(TRACE_DEBUG, "Broadcast %s", _energy_low ? "paused, energy low" : "started");
+}
+
+void Broadcaster::_refresh()
+{
+    core_util_atomic_store_bool(&_refresh_pending, false);
+
+    if (_ble == nullptr)
+    {
+        return; // start() builds the first payload
+    }
+
+    uint8_t data[MAX_DATA_SIZE];
+    uint8_t length = _build(data, sizeof(data));
+
+    uint8_t buffer[ble::LEGACY_ADVERTISING_MAX_SIZE];
+    ble::AdvertisingDataBuilder builder(buffer);
+
+    ble_error_t error;
+    if (_own_set)
+    {
+        builder.setFlags(ble::adv_data_flags_t::BREDR_NOT_SUPPORTED);
+        builder.setManufacturerSpecificData(mbed::make_Span(data, length));
+        error = _ble->gap().setAdvertisingPayload(_handle, builder.getAdvertisingData());
+    }
+    else
+    {
+        builder.setManufacturerSpecificData(mbed::make_Span(data, length)); // no flags in a scan response
+        error = _ble->gap().setAdvertisingScanResponse(_handle, builder.getAdvertisingData());
+    }
+
+    if (error != BLE_ERROR_NONE)
+    {
+        _logger->log(TRACE_WARNING, "Broadcast payload update failed: %u", error);
+    }
+}
+
+uint8_t Broadcaster::_build(uint8_t *data, uint8_t max_length)
+{
+    _history_mutex.lock();
+
+    data[0] = COMPANY_ID & 0xFF;
+    data[1] = COMPANY_ID >> 8;
+    data[2] = VERSION;
+    data[3] = _sequence;
+    data[4] = _mask_state;
+
+    // newest first
+    Reading_t candidates[HISTORY_SIZE];
+    for (uint8_t i = 0; i < _history_count; i++)
+    {
+        candidates[i] = _history[(_history_next + HISTORY_SIZE - 1 - i) % HISTORY_SIZE];
+    }
+
+    // the newest of each type goes in first, then whatever else fits
+    bool chosen[HISTORY_SIZE] = {false};
+    bool type_seen[1 << RecordStream::TYPE_BITS] = {false};
+    for (uint8_t i = 0; i < _history_count; i++)
+    {
+        if (!type_seen[candidates[i].type])
+        {
+            type_seen[candidates[i].type] = true;
+            chosen[i] = true;
+        }
+    }
+
+    uint8_t records[HISTORY_SIZE * RecordStream::MAX_RECORD_SIZE];
+
+    // then whatever else fits, newest first
+    for (uint8_t i = 0; i < _history_count; i++)
+    {
+        if (chosen[i]) continue;
+
+        chosen[i] = true;
+        if (HEADER_SIZE + _encode(candidates, chosen, _history_count, records, nullptr) > max_length)
+        {
+            chosen[i] = false;
+        }
+    }
+
+    // a reading from hours ago has a long delta; drop the oldest until the rest fit
+    int16_t oldest = -1;
+    uint8_t length = HEADER_SIZE + _encode(candidates, chosen, _history_count, records, &oldest);
+    while (length > max_length && oldest >= 0)
+    {
+        chosen[oldest] = false;
+        length = HEADER_SIZE + _encode(candidates, chosen, _history_count, records, &oldest);
+    }
+
+    memcpy(&data[HEADER_SIZE], records, length - HEADER_SIZE);
+
+    uint32_t reference_timestamp = oldest >= 0 ? TimeBase::get_instance()->to_epoch_s(candidates[oldest].timestamp) : 0;
+    memcpy(&data[5], &reference_timestamp, sizeof(reference_timestamp)); // little endian, as on RECORDS
+
+    _history_mutex.unlock();
+
+    return length;
+}
+
+/**
+ * @brief Encode the chosen readings (candidates are newest first) oldest
+ * first in the RecordStream format. records must have room for
+ * HISTORY_SIZE records; the caller checks the length against the payload.
+ */
+uint8_t Broadcaster::_encode(const Reading_t *candidates, const bool *chosen, uint8_t count, uint8_t *records, int16_t *oldest)
+{
+    uint8_t length = 0;
+    bool first = true;
+    uint32_t last_ts = 0;
+
+    if (oldest != nullptr)
+    {
+        *oldest = -1;
+    }
+
+    for (int16_t i = count - 1; i >= 0; i--)
+    {
+        if (!chosen[i]) continue;
+
+        if (first)
+        {
+            first = false;
+            last_ts = candidates[i].timestamp;
+            if (oldest != nullptr)
+            {
+                *oldest = i;
+            }
+        }
+
+        uint32_t delta = candidates[i].timestamp > last_ts ? candidates[i].timestamp - last_ts : 0;
+        length += RecordStream::write_varint((delta << RecordStream::TYPE_BITS) | candidates[i].type, &records[length]);
+        length += RecordStream::write_varint(candidates[i].value, &records[length]);
+        last_ts += delta;
+    }
+
+    return length;
+}
+
+uint32_t Broadcaster::_now()
+{
+    return TimeBase::get_instance()->monotonic_s();
+}
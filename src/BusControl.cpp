@@ -74,10 +74,16 @@ void BusControl::init(void)
         NRF_GPIO->PIN_CNF[MAG_VCC] |= (GPIO_PIN_CNF_DRIVE_S0H1 << GPIO_PIN_CNF_DRIVE_Pos); // set to high drive mode
         NRF_GPIO->PIN_CNF[LED1] |= (GPIO_PIN_CNF_DRIVE_S0H1 << GPIO_PIN_CNF_DRIVE_Pos); // set to high drive mode
     
-        power_lock.fram = false;
-        power_lock.magnetometer = false;
-        power_lock.barometer = false;
-        power_lock.imu = false;
+        for (int i = 0; i < DEVICES_LAST; i++)
+        {
+            _holders[i] = 0;
+            _rail_on[i] = false;
+            _rail_state[i] = RAIL_OFF;
+            _rail_on_since[i] = 0us;
+            _rail_on_time[i] = 0us;
+        }
+
+        _uptime.start();
 
         _spi_power = false;
         _i2c_power = false;
@@ -86,90 +92,295 @@ void BusControl::init(void)
     _initialized = true;
 }
 
-void BusControl::set_power_lock(Devices device, bool lock)
+bool BusControl::acquire(Devices device)
+{
+    if (!_initialized)
+    {
+        _logger->log(TRACE_WARNING, "%s", "Bus Control has not been initialized. Please run init().");
+        return false;
+    }
+
+    _power_mutex.lock();
+
+    bool switched_on = false;
+    if (_holders[device]++ == 0 && !_rail_on[device])
+    {
+        _set_rail(device, true);
+        switched_on = true;
+    }
+
+    _power_mutex.unlock();
+
+    return switched_on;
+}
+
+void BusControl::release(Devices device)
+{
+    if (!_initialized)
+    {
+        _logger->log(TRACE_WARNING, "%s", "Bus Control has not been initialized. Please run init().");
+        return;
+    }
+
+    _power_mutex.lock();
+
+    if (_holders[device] == 0)
+    {
+        _logger->log(TRACE_WARNING, "release of device %i without acquire", device);
+    }
+    else if (--_holders[device] == 0 && !(_is_i2c(device) && I2C_KEEP_ON))
+    {
+        _set_rail(device, false);
+    }
+
+    _power_mutex.unlock();
+}
+
+void BusControl::power_cycle(Devices device)
+{
+    _power_mutex.lock();
+    _set_rail(device, false);
+    _power_mutex.unlock();
+
+    ThisThread::sleep_for(10ms);
+
+    _power_mutex.lock();
+    _set_rail(device, true);
+    _power_mutex.unlock();
+}
+
+bool BusControl::is_powered(Devices device)
+{
+    return _rail_on[device];
+}
+
+bool BusControl::power_up(Devices device, Callback<bool()> probe)
+{
+    if (!_initialized)
+    {
+        _logger->log(TRACE_WARNING, "%s", "Bus Control has not been initialized. Please run init().");
+        return false;
+    }
+
+    _power_mutex.lock();
+
+    _holders[device]++;
+    _set_rail(device, true);
+
+    RailState_t state = _rail_state[device];
+    if (state == RAIL_ON) // nobody has checked on it yet, so it's ours to probe
+    {
+        _rail_state[device] = RAIL_PROBING;
+        _ready_flags.clear(1UL << device);
+    }
+
+    _power_mutex.unlock();
+
+    if (state == RAIL_READY)
+    {
+        return true;
+    }
+
+    if (state == RAIL_PROBING) // another holder switched it on and is still waiting for it
+    {
+        _ready_flags.wait_any_for(1UL << device, duration_cast<Kernel::Clock::duration_u32>(READY_MIN_WAIT[device] + READY_TIMEOUT) + 10ms, false);
+        return _rail_state[device] == RAIL_READY;
+    }
+
+    bool ready = wait_until_ready(device, probe);
+
+    _power_mutex.lock();
+    if (_rail_state[device] == RAIL_PROBING) // not cycled in the meantime
+    {
+        _rail_state[device] = ready ? RAIL_READY : RAIL_ON; // a failed probe is retried by the next caller
+    }
+    _power_mutex.unlock();
+
+    _ready_flags.set(1UL << device);
+
+    return ready;
+}
+
+bool BusControl::wait_until_ready(Devices device, Callback<bool()> probe)
 {
+    microseconds on_for = _uptime.elapsed_time() - _rail_on_since[device];
+    if (on_for < READY_MIN_WAIT[device])
+    {
+        microseconds remaining = READY_MIN_WAIT[device] - on_for;
+        if (remaining < 1ms)
+        {
+            wait_us(remaining.count()); // too short to be worth a context switch
+        }
+        else
+        {
+            ThisThread::sleep_for(milliseconds((remaining.count() + 999) / 1000));
+        }
+    }
+
+    LowPowerTimer timeout;
+    timeout.start();
+    while (!probe())
+    {
+        if (timeout.elapsed_time() > READY_TIMEOUT)
+        {
+            _logger->log(TRACE_WARNING, "device %i not ready after power up", device);
+            return false;
+        }
+
+        ThisThread::sleep_for(1ms);
+    }
+
+    _logger->log(TRACE_TRACE, "device %i ready after %lli us", device, (_uptime.elapsed_time() - _rail_on_since[device]).count());
+
+    return true;
+}
+
+void BusControl::_set_rail(Devices device, bool power)
+{
+    if (_rail_on[device] == power) return;
+
+    // CS lines follow VCC: high (deselected) when powered, low so we don't back-power an unpowered chip
     switch(device)
     {
         case FRAM:
-            power_lock.fram = lock;
+            _fram_vcc = power;
+            _fram_cs = power;
             break;
         case MAGNETOMETER:
-            power_lock.magnetometer = lock;
+            _mag_vcc = power;
+            _mag_cs = power;
             break;
         case BAROMETER:
-            power_lock.barometer = lock;
+            _bar_vcc = power;
+            _bar_cs = power;
             break;
         case IMU:
-            power_lock.imu = lock;
+            _imu_vcc = power;
+            _imu_cs = power;
             break;
         case THERMOMETER:
-            power_lock.thermometer = lock;
+            _temp_vcc = power;
             break;
         case VOC:
-            power_lock.voc = lock;
+            _voc_vcc = power;
             break;
+        default:
+            return;
     }
-}
 
-void BusControl::spi_power(bool power)
-{
-    if (!_initialized)
+    microseconds now = _uptime.elapsed_time();
+    _rail_state[device] = power ? RAIL_ON : RAIL_OFF;
+    if (power)
     {
-        _logger->log(TRACE_WARNING, "%s", "Bus Control has not been initialized. Please run init().");
-        return;
+        _rail_on_since[device] = now;
     }
-
-    if (!power_lock.fram)
+    else
     {
-        _fram_vcc = power;
-        _fram_cs = power;
+        _rail_on_time[device] += now - _rail_on_since[device];
     }
+    _rail_on[device] = power;
+
+    _spi_power = _rail_on[FRAM] || _rail_on[MAGNETOMETER] || _rail_on[BAROMETER] || _rail_on[IMU];
+    _i2c_power = _rail_on[THERMOMETER] || _rail_on[VOC];
+    _i2c_pu = _i2c_power;
+}
+
+microseconds BusControl::get_rail_on_time(Devices device)
+{
+    _power_mutex.lock();
 
-    if (!power_lock.barometer)
+    microseconds on_time = _rail_on_time[device];
+    if (_rail_on[device])
     {
-        _bar_vcc = power;
-        _bar_cs = power;
+        on_time += _uptime.elapsed_time() - _rail_on_since[device];
     }
 
-    if (!power_lock.magnetometer)
+    _power_mutex.unlock();
+
+    return on_time;
+}
+
+void BusControl::reset_rail_on_time()
+{
+    _power_mutex.lock();
+
+    microseconds now = _uptime.elapsed_time();
+    for (int i = 0; i < DEVICES_LAST; i++)
     {
-        _mag_vcc = power;
-        _mag_cs = power;
+        _rail_on_time[i] = 0us;
+        _rail_on_since[i] = now;
     }
 
-    if (!power_lock.imu)
+    _power_mutex.unlock();
+}
+
+void BusControl::log_rail_on_time()
+{
+    const char* names[DEVICES_LAST] = {"fram", "mag", "bar", "imu", "temp", "voc"};
+
+    for (int i = 0; i < DEVICES_LAST; i++)
     {
-        _imu_vcc = power;
-        _imu_cs = power;
+        _logger->log(TRACE_INFO, "rail on time %s: %lli ms (%u holders)", names[i], duration_cast<milliseconds>(get_rail_on_time((Devices)i)).count(), _holders[i]);
     }
 
-    _spi_power = power;
+    _logger->log(TRACE_INFO, "led energy: %0.4f J, %lu blinks skipped", _led_energy, _skipped_blinks);
 }
 
+void BusControl::start_indicator(milliseconds period, milliseconds blink_length)
+{
+    _blink_length = blink_length;
+    _led_energy = 0;
+    _skipped_blinks = 0;
+    _indicator_ticker.attach(callback(this, &BusControl::_indicator_tick), period);
+}
 
-void BusControl::i2c_power(bool power)
+void BusControl::stop_indicator()
 {
-    if (!_initialized)
+    _indicator_ticker.detach();
+    _led_timeout.detach();
+    _blinks_remaining = 0;
+    _led = 0;
+}
+
+void BusControl::_indicator_tick()
+{
+    if (_blinks_remaining > 0) return; // previous pattern still running
+
+    float energy = _available_energy;
+    if (energy >= 0 && energy < INDICATOR_MIN_ENERGY)
     {
-        _logger->log(TRACE_WARNING, "%s", "Bus Control has not been initialized. Please run init().");
+        _skipped_blinks += _num_blinks;
         return;
     }
+    else if (energy >= 0 && energy < INDICATOR_LOW_ENERGY)
+    {
+        _skipped_blinks += _num_blinks - 1;
+        _blinks_remaining = 1;
+        _current_blink_length = _blink_length / 2;
+    }
+    else
+    {
+        _blinks_remaining = _num_blinks;
+        _current_blink_length = _blink_length;
+    }
 
-    _temp_vcc = power;
-    _voc_vcc = power;
-    _i2c_pu = power;
+    if (_blinks_remaining > 0) _led_on();
+}
 
-    _i2c_power = power;
+void BusControl::_led_on()
+{
+    _led = 1;
+    _led_energy += LED_ENERGY * _current_blink_length.count() / LED_NOMINAL_BLINK.count();
+    _led_timeout.attach(callback(this, &BusControl::_led_off), _current_blink_length);
 }
 
-void BusControl::blink_led(milliseconds length)
+void BusControl::_led_off()
 {
-    for (int i = 0; i < _num_blinks; i++)
+    _led = 0;
+
+    if (--_blinks_remaining > 0)
     {
-        _led = 1;
-        ThisThread::sleep_for(length);
-        _led = 0;
-        ThisThread::sleep_for(250ms);
+        _led_timeout.attach(callback(this, &BusControl::_led_on), LED_BLINK_GAP);
     }
 }
 
@@ -50,6 +50,8 @@ _cap_voltage(VCAP)
     MBED_ASSERT(result == NRFX_SUCCESS);
 
     _cap_voltage.set_reference_voltage(2.4); // this is internal reference / gain = 0.6 / (1/4)
+
+    _rate_timer.start();
 }
 
 CapCalc::~CapCalc()
@@ -73,21 +75,202 @@ CapCalc* CapCalc::get_instance()
 
 float CapCalc::read_voltage()
 {
-    _cap_voltage_en = 1;
-    ThisThread::sleep_for(1ms);
+    if (!_monitoring) // the divider is already up and settled while the LPCOMP watches it
+    {
+        _cap_voltage_en = 1;
+        ThisThread::sleep_for(1ms);
+    }
 
-    float voltage = _cap_voltage.read_voltage() * 2.80; // 2.80 is a factor that arises from the voltage divider
+    float voltage = _cap_voltage.read_voltage() * DIVIDER_RATIO; // 2.80 is a factor that arises from the voltage divider
     
-    _cap_voltage_en = 0;
+    if (!_monitoring)
+    {
+        _cap_voltage_en = 0;
+    }
+
+    std::chrono::microseconds now = _rate_timer.elapsed_time();
+    if (_has_last_voltage && now > _last_read_time)
+    {
+        float dt = (now - _last_read_time).count() / 1000000.0;
+        float rate = (voltage - _last_voltage) / dt;
+        _charge_rate = CHARGE_RATE_ALPHA * rate + (1 - CHARGE_RATE_ALPHA) * _charge_rate;
+    }
+
+    _last_voltage = voltage;
+    _last_read_time = now;
+    _has_last_voltage = true;
 
     return voltage;
 }
 
 float CapCalc::calc_joules()
 {
-    float voltage = read_voltage();
+    return calc_joules(read_voltage());
+}
 
+float CapCalc::calc_joules(float voltage)
+{
     float joules = 0.5 * ((float)_capacitance_uF / 1000000.0) * (voltage * voltage - 1.8*1.8);//the point at which the processor can run
 
     return joules;
-}
\ No newline at end of file
+}
+
+bool CapCalc::start_monitor(float low_v, float high_v)
+{
+    if (low_v >= high_v)
+    {
+        return false;
+    }
+
+    stop_monitor();
+
+    float vdd = _read_vdd();
+    if (vdd <= 0)
+    {
+        return false;
+    }
+
+    // the comparator sees the divided voltage against k/16 of VDD
+    float step = vdd * DIVIDER_RATIO / 16;
+    int32_t low_k = (int32_t)(low_v / step + 0.5);
+    int32_t high_k = (int32_t)(high_v / step + 0.5);
+
+    if (low_k < 1 || high_k > 15)
+    {
+        return false;
+    }
+
+    if (high_k <= low_k) // both thresholds rounded onto the same step
+    {
+        high_k = low_k + 1;
+        if (high_k > 15)
+        {
+            return false;
+        }
+    }
+
+    // REFSEL 0..6 are the eighths (even sixteenths), 8..15 the odd sixteenths
+    _low_refsel = (low_k % 2 == 0) ? (low_k / 2 - 1) : (8 + (low_k - 1) / 2);
+    _high_refsel = (high_k % 2 == 0) ? (high_k / 2 - 1) : (8 + (high_k - 1) / 2);
+    _low_threshold = low_k * step;
+    _high_threshold = high_k * step;
+
+    _energy_low = read_voltage() < _low_threshold;
+
+    _cap_voltage_en = 1;
+    _monitoring = true;
+    wait_us(1000); // let the divider settle before the comparator samples it
+
+    NVIC_SetVector(COMP_LPCOMP_IRQn, (uintptr_t)&CapCalc::_lpcomp_irq);
+    NVIC_ClearPendingIRQ(COMP_LPCOMP_IRQn);
+    NVIC_EnableIRQ(COMP_LPCOMP_IRQn);
+
+    _arm_lpcomp(_energy_low);
+
+    return true;
+}
+
+void CapCalc::stop_monitor()
+{
+    if (!_monitoring)
+    {
+        return;
+    }
+
+    NVIC_DisableIRQ(COMP_LPCOMP_IRQn);
+
+    NRF_LPCOMP->TASKS_STOP = 1;
+    NRF_LPCOMP->INTENCLR = LPCOMP_INTENCLR_UP_Msk | LPCOMP_INTENCLR_DOWN_Msk;
+    NRF_LPCOMP->ENABLE = LPCOMP_ENABLE_ENABLE_Disabled << LPCOMP_ENABLE_ENABLE_Pos;
+
+    _monitoring = false;
+    _cap_voltage_en = 0;
+}
+
+bool CapCalc::wait_for_crossing(Kernel::Clock::duration_u32 duration)
+{
+    uint32_t result = _crossing_flags.wait_any_for(CROSSING_FLAG, duration);
+
+    return (result & osFlagsError) == 0;
+}
+
+void CapCalc::_arm_lpcomp(bool rising)
+{
+    // configuration registers may only be written while the comparator is disabled
+    NRF_LPCOMP->TASKS_STOP = 1;
+    NRF_LPCOMP->ENABLE = LPCOMP_ENABLE_ENABLE_Disabled << LPCOMP_ENABLE_ENABLE_Pos;
+
+    NRF_LPCOMP->PSEL = LPCOMP_PSEL_PSEL_AnalogInput1 << LPCOMP_PSEL_PSEL_Pos; // VCAP divider
+    NRF_LPCOMP->REFSEL = rising ? _high_refsel : _low_refsel;
+    NRF_LPCOMP->HYST = LPCOMP_HYST_HYST_Hyst50mV << LPCOMP_HYST_HYST_Pos;
+    NRF_LPCOMP->ANADETECT = rising ? LPCOMP_ANADETECT_ANADETECT_Up : LPCOMP_ANADETECT_ANADETECT_Down;
+
+    NRF_LPCOMP->EVENTS_UP = 0;
+    NRF_LPCOMP->EVENTS_DOWN = 0;
+    NRF_LPCOMP->INTENCLR = LPCOMP_INTENCLR_UP_Msk | LPCOMP_INTENCLR_DOWN_Msk;
+    NRF_LPCOMP->INTENSET = rising ? LPCOMP_INTENSET_UP_Msk : LPCOMP_INTENSET_DOWN_Msk;
+
+    NRF_LPCOMP->ENABLE = LPCOMP_ENABLE_ENABLE_Enabled << LPCOMP_ENABLE_ENABLE_Pos;
+    NRF_LPCOMP->TASKS_START = 1;
+}
+
+void CapCalc::_lpcomp_irq()
+{
+    CapCalc *self = _instance;
+
+    if (NRF_LPCOMP->EVENTS_DOWN)
+    {
+        NRF_LPCOMP->EVENTS_DOWN = 0;
+        self->_energy_low = true;
+    }
+    else if (NRF_LPCOMP->EVENTS_UP)
+    {
+        NRF_LPCOMP->EVENTS_UP = 0;
+        self->_energy_low = false;
+    }
+    else
+    {
+        return;
+    }
+
+    self->_crossing_count++;
+
+    // watch the other edge of the band
+    self->_arm_lpcomp(self->_energy_low);
+
+    self->_crossing_flags.set(self->CROSSING_FLAG);
+}
+
+float CapCalc::_read_vdd()
+{
+    nrf_saadc_channel_config_t channel_config = 
+    {
+        .resistor_p = NRF_SAADC_RESISTOR_DISABLED,
+        .resistor_n = NRF_SAADC_RESISTOR_DISABLED,
+        .gain       = NRF_SAADC_GAIN1_6,
+        .reference  = NRF_SAADC_REFERENCE_INTERNAL, // 0.6 / (1/6) = 3.6V full scale
+        .acq_time   = NRF_SAADC_ACQTIME_10US,
+        .mode       = NRF_SAADC_MODE_SINGLE_ENDED,
+        .burst      = NRF_SAADC_BURST_DISABLED,
+        .pin_p      = NRF_SAADC_INPUT_VDD,
+        .pin_n      = NRF_SAADC_INPUT_DISABLED
+    };
+
+    if (nrfx_saadc_channel_init(VDD_CHANNEL, &channel_config) != NRFX_SUCCESS)
+    {
+        return 0;
+    }
+
+    nrf_saadc_value_t value = 0;
+    ret_code_t result = nrfx_saadc_sample_convert(VDD_CHANNEL, &value);
+    nrfx_saadc_channel_uninit(VDD_CHANNEL);
+
+    if (result != NRFX_SUCCESS || value <= 0)
+    {
+        return 0;
+    }
+
+    uint32_t bits = 8 + 2 * NRF_SAADC->RESOLUTION; // 0 = 8 bit, 1 = 10 bit, ...
+
+    return value * 3.6 / (1 << bits);
+}
@@ -0,0 +1,226 @@
+/**
+ * @file Checkpoint.cpp
+ * @author agent agent@local
+ * @brief Just-in-time checkpoints of in-progress captures in FRAM
+ * @version 0.1
+ * @date 2026-10-19
+ * 
+ * @copyright Copyright (c) 2026 Ka Moamoa
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, version 3 of the license.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "Checkpoint.h"
+
+Checkpoint* Checkpoint::_instance = nullptr;
+Mutex Checkpoint::_mutex;
+
+Checkpoint::Checkpoint()
+{
+    _logger = Logger::get_instance();
+}
+
+Checkpoint::~Checkpoint()
+{
+}
+
+Checkpoint* Checkpoint::get_instance()
+{
+    _mutex.lock();
+
+    if (_instance == nullptr)
+    {
+        _instance = new Checkpoint();
+    }
+
+    _mutex.unlock();
+
+    return _instance;
+}
+
+bool Checkpoint::initialize(FRAM* fram)
+{
+    _fram = fram;
+
+    Header_t headers[2];
+    bool valid[2];
+
+    _fram->hold_power(true);
+    valid[0] = _read_slot(0, headers[0]);
+    valid[1] = _read_slot(1, headers[1]);
+    _fram->hold_power(false);
+
+    _header = {0, 0, TASK_NONE, 0, 0, 0};
+
+    if (valid[0] && (!valid[1] || (int32_t)(headers[0].sequence - headers[1].sequence) > 0))
+    {
+        _header = headers[0];
+        _slot = 0;
+    }
+    else if (valid[1])
+    {
+        _header = headers[1];
+        _slot = 1;
+    }
+    else
+    {
+        _slot = 1; // so the first save lands in slot 0
+    }
+
+    if (_header.task != TASK_NONE)
+    {
+        _logger->log(TRACE_INFO, "Checkpoint pending for task %u (%u bytes)", _header.task, _header.length);
+    }
+
+    return true;
+}
+
+bool Checkpoint::save(Task_t task, const void* state, uint16_t length)
+{
+    if (length > MAX_STATE_SIZE)
+    {
+        _logger->log(TRACE_WARNING, "Checkpoint too large: %u bytes", length);
+        return false;
+    }
+
+    bool success = _write(task, state, length);
+    if (success)
+    {
+        _save_count++;
+    }
+
+    return success;
+}
+
+bool Checkpoint::load(Task_t task, void* state, uint16_t length)
+{
+    if (_fram == nullptr) return false;
+
+    _checkpoint_mutex.lock();
+
+    if (_header.task != task || _header.length != length)
+    {
+        _checkpoint_mutex.unlock();
+        return false;
+    }
+
+    bool success = _fram->read_bytes(_slot_addr(_slot) + sizeof(Header_t), (char*)state, length);
+    success = success && _crc(_header, state, length) == _header.crc;
+
+    _checkpoint_mutex.unlock();
+
+    if (!success)
+    {
+        _logger->log(TRACE_WARNING, "%s", "CHECKPOINT READ FAILED");
+    }
+
+    return success;
+}
+
+bool Checkpoint::discard(Task_t task)
+{
+    if (_header.task == TASK_NONE || _header.task != task)
+    {
+        return true;
+    }
+
+    return _write(TASK_NONE, nullptr, 0); // a newer, empty slot hides the old one
+}
+
+bool Checkpoint::_write(Task_t task, const void* state, uint16_t length)
+{
+    if (_fram == nullptr) return false;
+
+    _checkpoint_mutex.lock();
+
+    uint8_t slot = _slot ^ 1; // never overwrite the newest valid slot
+
+    Header_t header;
+    header.magic = MAGIC;
+    header.sequence = _header.sequence + 1;
+    header.task = task;
+    header.reserved = 0;
+    header.length = length;
+    header.crc = _crc(header, state, length);
+
+    _fram->hold_power(true);
+
+    // state first, then the header that makes it valid
+    bool success = length == 0 || _fram->write_bytes(_slot_addr(slot) + sizeof(Header_t), (const char*)state, length);
+    success = success && _fram->write_bytes(_slot_addr(slot), (const char*)&header, sizeof(header));
+
+    _fram->hold_power(false);
+
+    if (success)
+    {
+        _header = header;
+        _slot = slot;
+    }
+    else
+    {
+        _logger->log(TRACE_WARNING, "%s", "CHECKPOINT WRITE FAILED");
+    }
+
+    _checkpoint_mutex.unlock();
+
+    return success;
+}
+
+bool Checkpoint::_read_slot(uint8_t slot, Header_t &header)
+{
+    if (!_fram->read_bytes(_slot_addr(slot), (char*)&header, sizeof(header)))
+    {
+        return false;
+    }
+
+    if (header.magic != MAGIC || header.length > MAX_STATE_SIZE)
+    {
+        return false;
+    }
+
+    // a slot is only as good as its state; check it now so a torn save falls back to the other slot
+    uint8_t buffer[64];
+    MbedCRC<POLY_32BIT_ANSI, 32> ct;
+    uint32_t crc = 0;
+
+    ct.compute_partial_start(&crc);
+    ct.compute_partial(&header, offsetof(Header_t, crc), &crc);
+    for (uint16_t offset = 0; offset < header.length; offset += sizeof(buffer))
+    {
+        uint16_t chunk = header.length - offset < (uint16_t)sizeof(buffer) ? header.length - offset : sizeof(buffer);
+        if (!_fram->read_bytes(_slot_addr(slot) + sizeof(Header_t) + offset, (char*)buffer, chunk))
+        {
+            return false;
+        }
+        ct.compute_partial(buffer, chunk, &crc);
+    }
+    ct.compute_partial_stop(&crc);
+
+    return crc == header.crc;
+}
+
+uint32_t Checkpoint::_crc(const Header_t &header, const void* data, uint16_t length)
+{
+    MbedCRC<POLY_32BIT_ANSI, 32> ct;
+    uint32_t crc = 0;
+
+    ct.compute_partial_start(&crc);
+    ct.compute_partial(&header, offsetof(Header_t, crc), &crc);
+    if (length > 0)
+    {
+        ct.compute_partial(data, length, &crc);
+    }
+    ct.compute_partial_stop(&crc);
+
+    return crc;
+}
@@ -0,0 +1,273 @@
+/**
+ * @file ConnectionManager.cpp
+ * @author agent agent@local
+ * @brief Connection parameter policy and sync windows for the BLE link
+ * @version 0.1
+ * @date 2026-10-19
+ * 
+ * @copyright Copyright (c) 2026 Ka Moamoa
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, version 3 of the license.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "ConnectionManager.h"
+
+ConnectionManager::ConnectionManager(events::EventQueue &queue) :
+_queue(queue)
+{
+    _logger = Logger::get_instance();
+}
+
+ConnectionManager::~ConnectionManager()
+{
+}
+
+void ConnectionManager::attach(BLE &ble, ble::Gap::EventHandler *chained)
+{
+    _ble = &ble;
+    _chained = chained;
+    _connected = false;
+    _open = true; // the BLE process advertises as soon as it's up
+    _ble->gap().setEventHandler(this);
+
+    _attached = true;
+    _link_flags.set(ATTACHED_FLAG | DISCONNECTED_FLAG);
+}
+
+void ConnectionManager::request(Profile_t profile)
+{
+    _queue.call([this, profile]() {
+        _profile = profile;
+        _apply();
+    });
+}
+
+void ConnectionManager::open()
+{
+    _queue.call([this]() {
+        _open = true;
+        if (!_connected)
+        {
+            _set_advertising(true);
+        }
+    });
+}
+
+void ConnectionManager::close()
+{
+    _queue.call([this]() {
+        _open = false;
+        if (_connected)
+        {
+            // advertising gets stopped once the disconnection is through
+            ble_error_t error = _ble->gap().disconnect(_handle, ble::local_disconnection_reason_t::USER_TERMINATION);
+            if (error != BLE_ERROR_NONE)
+            {
+                _logger->log(TRACE_WARNING, "Disconnect failed: %u", error);
+            }
+        }
+        else
+        {
+            _set_advertising(false);
+        }
+    });
+}
+
+bool ConnectionManager::wait_for_attach(Kernel::Clock::duration_u32 timeout)
+{
+    return _wait_for(ATTACHED_FLAG, timeout);
+}
+
+bool ConnectionManager::wait_for_connection(Kernel::Clock::duration_u32 timeout)
+{
+    return _wait_for(CONNECTED_FLAG, timeout);
+}
+
+bool ConnectionManager::wait_for_disconnection(Kernel::Clock::duration_u32 timeout)
+{
+    return _wait_for(DISCONNECTED_FLAG, timeout);
+}
+
+bool ConnectionManager::_wait_for(uint32_t flag, Kernel::Clock::duration_u32 timeout)
+{
+    // these are states rather than events, so leave them set
+    uint32_t result = _link_flags.wait_any_for(flag, timeout, false);
+    return (result & osFlagsError) == 0;
+}
+
+void ConnectionManager::_set_advertising(bool enable)
+{
+    if (_ble == nullptr)
+    {
+        return;
+    }
+
+    ble::Gap &gap = _ble->gap();
+    bool advertising = gap.isAdvertisingActive(ble::LEGACY_ADVERTISING_HANDLE);
+    if (advertising == enable)
+    {
+        return;
+    }
+
+    ble_error_t error = enable ? gap.startAdvertising(ble::LEGACY_ADVERTISING_HANDLE) : gap.stopAdvertising(ble::LEGACY_ADVERTISING_HANDLE);
+    if (error != BLE_ERROR_NONE)
+    {
+        _logger->log(TRACE_WARNING, "Unable to %s advertising: %u", enable ? "start" : "stop", error);
+        return;
+    }
+
+    _logger->log(TRACE_DEBUG, "Advertising %s", enable ? "started" : "stopped");
+}
+
+void ConnectionManager::_apply()
+{
+    if (!_connected || _ble == nullptr)
+    {
+        return; // applied once we're connected
+    }
+
+    if (_updating)
+    {
+        return; // applied once the update in flight completes
+    }
+
+    if (_link_profile_valid && _link_profile == _profile)
+    {
+        return; // asked for already; not asked again if the phone turned it down
+    }
+
+    bool bulk = _profile == PROFILE_BULK;
+
+    ble_error_t error = _ble->gap().updateConnectionParameters(
+        _handle,
+        ble::conn_interval_t(bulk ? BULK_MIN_INTERVAL : IDLE_MIN_INTERVAL),
+        ble::conn_interval_t(bulk ? BULK_MAX_INTERVAL : IDLE_MAX_INTERVAL),
+        ble::slave_latency_t(bulk ? BULK_LATENCY : IDLE_LATENCY),
+        ble::supervision_timeout_t(bulk ? BULK_TIMEOUT : IDLE_TIMEOUT));
+
+    if (error != BLE_ERROR_NONE)
+    {
+        _logger->log(TRACE_WARNING, "Connection parameter request failed: %u", error);
+    }
+    else
+    {
+        _updating = true;
+        _link_profile = _profile;
+        _link_profile_valid = true;
+        _logger->log(TRACE_DEBUG, "Requested %s connection parameters", bulk ? "bulk" : "idle");
+    }
+}
+
+void ConnectionManager::_log_parameters(const char *reason)
+{
+    // interval is in 1.25 ms units, timeout in 10 ms units
+    _logger->log(TRACE_INFO, "%s: interval %u.%02u ms, latency %u, timeout %u ms", reason, 
+        _interval * 5 / 4, (_interval * 125) % 100, _latency, _timeout * 10);
+}
+
+void ConnectionManager::onConnectionComplete(const ble::ConnectionCompleteEvent &event)
+{
+    if (event.getStatus() == BLE_ERROR_NONE)
+    {
+        _connected = true;
+        _handle = event.getConnectionHandle();
+        _interval = event.getConnectionInterval().value();
+        _latency = event.getConnectionLatency().value();
+        _timeout = event.getSupervisionTimeout().value();
+        _log_parameters("Connected");
+
+        _updating = false;
+        _link_profile_valid = false;
+
+        if (_open)
+        {
+            _apply(); // whatever was asked for before the phone showed up
+        }
+        else
+        {
+            // the phone's connect request was on air as the window closed; close() has been and gone
+            _logger->log(TRACE_INFO, "%s", "Connected after close, disconnecting");
+            _ble->gap().disconnect(_handle, ble::local_disconnection_reason_t::USER_TERMINATION);
+        }
+
+        _link_flags.clear(DISCONNECTED_FLAG);
+        _link_flags.set(CONNECTED_FLAG);
+    }
+
+    if (_chained) _chained->onConnectionComplete(event);
+}
+
+void ConnectionManager::onDisconnectionComplete(const ble::DisconnectionCompleteEvent &event)
+{
+    _connected = false;
+    _updating = false;
+
+    if (_on_disconnection) _on_disconnection();
+    if (_chained) _chained->onDisconnectionComplete(event);
+
+    if (!_open)
+    {
+        // queued, so it lands after the BLE process has restarted advertising
+        _queue.call([this]() { _set_advertising(false); });
+    }
+
+    _link_flags.clear(CONNECTED_FLAG);
+    _link_flags.set(DISCONNECTED_FLAG);
+}
+
+void ConnectionManager::onConnectionParametersUpdateComplete(const ble::ConnectionParametersUpdateCompleteEvent &event)
+{
+    if (event.getStatus() == BLE_ERROR_NONE)
+    {
+        _interval = event.getConnectionInterval().value();
+        _latency = event.getSlaveLatency().value();
+        _timeout = event.getSupervisionTimeout().value();
+        _log_parameters("Connection parameters updated");
+    }
+    else
+    {
+        _logger->log(TRACE_WARNING, "Connection parameter update rejected: %u", event.getStatus());
+    }
+
+    _updating = false;
+    _apply(); // whatever was asked for while this one was in flight
+
+    if (_chained) _chained->onConnectionParametersUpdateComplete(event);
+}
+
+void ConnectionManager::onUpdateConnectionParametersRequest(const ble::UpdateConnectionParametersRequestEvent &event)
+{
+    if (_chained) _chained->onUpdateConnectionParametersRequest(event);
+}
+
+void ConnectionManager::onDataLengthChange(ble::connection_handle_t connectionHandle, uint16_t txSize, uint16_t rxSize)
+{
+    _logger->log(TRACE_INFO, "Data length: tx %u, rx %u bytes", txSize, rxSize);
+
+    if (_chained) _chained->onDataLengthChange(connectionHandle, txSize, rxSize);
+}
+
+void ConnectionManager::onPhyUpdateComplete(ble_error_t status, ble::connection_handle_t connectionHandle, ble::phy_t txPhy, ble::phy_t rxPhy)
+{
+    if (_chained) _chained->onPhyUpdateComplete(status, connectionHandle, txPhy, rxPhy);
+}
+
+void ConnectionManager::onReadPhy(ble_error_t status, ble::connection_handle_t connectionHandle, ble::phy_t txPhy, ble::phy_t rxPhy)
+{
+    if (_chained) _chained->onReadPhy(status, connectionHandle, txPhy, rxPhy);
+}
+
+void ConnectionManager::onAdvertisingEnd(const ble::AdvertisingEndEvent &event)
+{
+    if (_chained) _chained->onAdvertisingEnd(event);
+}
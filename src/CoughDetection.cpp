@@ -0,0 +1,183 @@
+/**
+ * @file CoughDetection.cpp
+ * @author agent agent@local
+ * @brief Cough detection on a high-rate barometer stream
+ * @version 0.1
+ * @date 2026-10-19
+ * 
+ * @copyright Copyright (c) 2026 Ka Moamoa
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, version 3 of the license.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "CoughDetection.hpp"
+#include "Utilites.h"
+
+#include <algorithm>
+
+CoughDetection::CoughDetection()
+{
+}
+
+CoughDetection::~CoughDetection()
+{
+}
+
+/**
+ * @brief Start a new stream. Event timestamps are start_timestamp plus
+ * the sample time on clock, which should be the clock of the sample
+ * indices passed to process(). Without a clock, the nominal frequency
+ * is used.
+ */
+void CoughDetection::start(SampleClock* clock, uint32_t start_timestamp)
+{
+    _clock = clock;
+    _start_timestamp = start_timestamp;
+    restart();
+}
+
+/**
+ * @brief Forget the feature state, e.g. after samples were lost. Queued
+ * events are kept.
+ */
+void CoughDetection::restart()
+{
+    _initialized = false;
+    _in_event = false;
+}
+
+bool CoughDetection::get_event(CoughEvent_t &event)
+{
+    if (_num_events == 0)
+    {
+        return false;
+    }
+
+    event = _events[_first_event];
+    _first_event = (_first_event + 1) % EVENT_QUEUE_SIZE;
+    _num_events--;
+    return true;
+}
+
+/**
+ * @brief Streaming cough features, one pass per sample: baseline
+ * (slow EMA), short-time energy of the deviation from it, rise slope
+ * and peak count. Only candidates that pass all the checks in
+ * _end_event() are queued.
+ */
+void CoughDetection::process(const uint16_t* pressure, uint16_t size, uint32_t start_index)
+{
+    for (int i = 0; i < size; i++)
+    {
+        float sample = pressure[i];
+
+        if (!_initialized)
+        {
+            _baseline = sample;
+            _breath = sample;
+            _breath_slow = sample;
+            _last_pressure = sample;
+            _energy = 0;
+            _background = 0;
+            _slope_hold = 0;
+            _last_deviation = 0;
+            _last_last_deviation = 0;
+            _initialized = true;
+        }
+
+        if (!_in_event)
+        {
+            _baseline += BASELINE_ALPHA * (sample - _baseline); // freeze the baseline during a candidate
+        }
+
+        // the breath is what two cascaded BREATH_ALPHA low passes keep; what's left is fast enough to be a cough
+        _breath += BREATH_ALPHA * (sample - _breath);
+        _breath_slow += BREATH_ALPHA * (_breath - _breath_slow);
+        float deviation = sample - 2 * _breath + _breath_slow;
+        _energy += ENERGY_ALPHA * (deviation * deviation - _energy);
+
+        float slope = sample - _last_pressure;
+        _slope_hold *= SLOPE_DECAY;
+        if (slope > _slope_hold) _slope_hold = slope;
+
+        if (!_in_event)
+        {
+            _background += BACKGROUND_ALPHA * (_energy - _background);
+        }
+
+        float on_threshold = std::max(ENERGY_ON_FLOOR, ON_RATIO * _background);
+        if (!_in_event && _energy > on_threshold)
+        {
+            _in_event = true;
+            _event_start_index = start_index + i;
+            _event_length = 0;
+            _event_peak = 0;
+            _event_max_slope = _slope_hold;
+            _event_peak_count = 0;
+            _off_threshold = std::max(ENERGY_OFF_FLOOR, OFF_RATIO * _background);
+            _peak_threshold = PEAK_RATIO * sqrtf(on_threshold);
+        }
+
+        if (_in_event)
+        {
+            _event_length++;
+
+            float rise = sample - _baseline;
+            if (fabs(rise) > _event_peak) _event_peak = fabs(rise);
+            if (slope > _event_max_slope) _event_max_slope = slope;
+
+            // local max of the deviation, one sample back
+            if (_last_deviation > _peak_threshold && _last_deviation > _last_last_deviation && _last_deviation >= deviation)
+            {
+                _event_peak_count++;
+            }
+
+            if (_energy < _off_threshold)
+            {
+                _end_event();
+            }
+        }
+
+        _last_last_deviation = _last_deviation;
+        _last_deviation = deviation;
+        _last_pressure = sample;
+    }
+}
+
+void CoughDetection::_end_event()
+{
+    _in_event = false;
+    _num_candidates++;
+
+    if (_event_length < MIN_EVENT_SAMPLES || _event_length > MAX_EVENT_SAMPLES || _event_max_slope < SLOPE_RATIO * _peak_threshold || _event_peak_count == 0 || _event_peak_count > MAX_PEAKS)
+    {
+        return;
+    }
+
+    double start_ms = _clock != nullptr ? _clock->get_sample_time_ms(_event_start_index) : _event_start_index * 1000.0 / SAMPLING_FREQUENCY;
+
+    CoughEvent_t event;
+    event.timestamp = _start_timestamp + Utilities::round(start_ms / 1000.0);
+    event.peak = std::min(_event_peak, 65535.0f);
+    event.duration = std::min(_event_length * 100 / SAMPLING_FREQUENCY, (uint32_t)255);
+    event.peak_count = _event_peak_count;
+
+    if (_num_events >= EVENT_QUEUE_SIZE)
+    {
+        _first_event = (_first_event + 1) % EVENT_QUEUE_SIZE; // overwrite the oldest
+        _num_events--;
+    }
+
+    _events[(_first_event + _num_events) % EVENT_QUEUE_SIZE] = event;
+    _num_events++;
+}
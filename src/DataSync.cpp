@@ -0,0 +1,285 @@
+/**
+ * @file DataSync.cpp
+ * @author agent agent@local
+ * @brief One sync of the buffered readings, coughs and event log with the phone
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @copyright Copyright (c) 2026 Ka Moamoa
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, version 3 of the license.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "DataSync.h"
+
+#include <algorithm>
+
+DataSync::DataSync(SmartPPEService *service, ConnectionManager &conn_manager, RecordStream &records, CoughBuffer_t &coughs) :
+_service(service),
+_conn_manager(conn_manager),
+_records(records),
+_coughs(coughs)
+{
+    _logger = Logger::get_instance();
+    _event_log = EventLog::get_instance();
+    _time_base = TimeBase::get_instance();
+}
+
+DataSync::~DataSync()
+{
+}
+
+bool DataSync::run(uint16_t mask_state, uint32_t mask_state_change_ts)
+{
+    /**
+     * Handshakes and time sync are mostly waiting on the phone, which the
+     * idle profile is for. But a parameter update takes several connection
+     * events to apply, seconds at the idle interval, so with bulk to send
+     * we go straight to the bulk profile rather than have it queue behind
+     * an idle one. Asked for before the phone connects, so the manager
+     * doesn't open with whatever the last sync left.
+     */
+    bool bulk_pending = _records.get_num_records() > 0 || !_coughs.empty()
+        || _event_log->get_count() > std::max(_event_log->get_synced(), _event_log->get_oldest());
+    _conn_manager.request(bulk_pending ? ConnectionManager::PROFILE_BULK : ConnectionManager::PROFILE_IDLE);
+
+    if (!_conn_manager.wait_for_connection(CONNECTION_TIMEOUT))
+    {
+        _logger->log(TRACE_INFO, "%s", "TIMEOUT BEFORE BLE CONNECTION");
+        _record_timeout(EventLog::TIMEOUT_BLE_CONNECTION);
+        return false;
+    }
+
+    LowPowerTimer sync_timer; // from connection, for the throughput metric
+    sync_timer.start();
+
+    // publish our time if we still trust it, so the phone can skip writing it back; zero asks for it
+    uint64_t published_time = _time_base->is_trusted() ? _time_base->get_epoch() : 0;
+    _service->updateTime(published_time);
+
+    _service->updateMaskOn(_time_base->to_epoch_s(mask_state_change_ts), mask_state);
+    if (!_announce(SmartPPEService::MASK_ON, MASK_ON_POLL, EventLog::TIMEOUT_BLE_MASK_ON, "MASK ON"))
+    {
+        return false;
+    }
+
+    // a new time from the phone; if it left ours alone there's nothing to do
+    uint64_t new_time = _service->getTime();
+    if (new_time != 0 && new_time != published_time)
+    {
+        _time_base->set_epoch(new_time);
+        if (_on_time_set) _on_time_set();
+        _logger->log(TRACE_INFO, "Time set to %lli", time(NULL));
+    }
+
+    if (!_send_records() || !_send_coughs() || !_send_event_log())
+    {
+        return false;
+    }
+
+    // no idle profile to finish: close() takes the link down straight away
+    _log_throughput(sync_timer.elapsed_time());
+
+    return true;
+}
+
+bool DataSync::close()
+{
+    _conn_manager.close();
+    if (!_conn_manager.wait_for_disconnection(DISCONNECT_TIMEOUT))
+    {
+        _logger->log(TRACE_WARNING, "%s", "TIMEOUT WAITING FOR BLE DISCONNECTION");
+        _record_timeout(EventLog::TIMEOUT_BLE_DISCONNECT);
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief Announce a payload on DATA_READY and wait for the phone to write
+ * back NO_DATA, repeating the announcement every poll in case a
+ * notification was missed.
+ */
+bool DataSync::_announce(SmartPPEService::data_ready_t type, milliseconds poll, EventLog::Timeout_t timeout, const char *name)
+{
+    _service->updateDataReady(type);
+
+    LowPowerTimer ble_timeout;
+    ble_timeout.start();
+    while (_service->getDataReady() != SmartPPEService::NO_DATA)
+    {
+        _service->updateDataReady(type);
+        if (ble_timeout.elapsed_time() > DRDY_TIMEOUT)
+        {
+            _logger->log(TRACE_INFO, "BLE DATA READY TIMEOUT (%s)", name);
+            _record_timeout(timeout);
+            return false;
+        }
+        ThisThread::sleep_for(poll);
+    }
+
+    return true;
+}
+
+/**
+ * @brief Send the buffered readings as RecordStream slices, cut on record
+ * boundaries so the phone can decode each packet on its own. Each slice
+ * leaves the buffer as soon as the phone acknowledges it, so a sync that
+ * fails later on only sends the rest again.
+ *
+ * The buffers hold monotonic stamps and don't outlive a reset, so every
+ * reading in them is from this boot and goes out as wall time on this
+ * boot's epoch offset, including a correction the phone made at the
+ * start of the sync.
+ */
+bool DataSync::_send_records()
+{
+    if (_records.get_num_records() == 0)
+    {
+        _logger->log(TRACE_DEBUG, "%s", "NO PHYSIO DATA TO SEND");
+        return true;
+    }
+
+    _logger->log(TRACE_DEBUG, "WRITING %u RECORDS IN %u BYTES", _records.get_num_records(), _records.get_num_bytes());
+
+    uint8_t payload_size = _service->getRecordsPayload(); // sized to the negotiated MTU
+
+    // the newest reading of each type, for the per-type characteristics
+    RecordStream::Record_t newest[RECORD_TYPE_LAST];
+    bool have_newest[RECORD_TYPE_LAST] = {false};
+
+    while (_records.get_num_bytes() > 0)
+    {
+        uint64_t packet_reference_ts = _records.get_base_timestamp();
+        uint64_t reference_ts = packet_reference_ts;
+        uint16_t offset = 0;
+
+        RecordStream::Record_t record;
+        while (true)
+        {
+            uint64_t next_ts = reference_ts;
+            uint16_t size = _records.read(offset, next_ts, record);
+            if (size == 0 || offset + size > payload_size)
+            {
+                break;
+            }
+
+            offset += size;
+            reference_ts = next_ts;
+
+            if (record.type < RECORD_TYPE_LAST)
+            {
+                newest[record.type] = record;
+                have_newest[record.type] = true;
+            }
+        }
+
+        if (offset == 0)
+        {
+            _logger->log(TRACE_WARNING, "%s", "RECORD STREAM CORRUPT");
+            return false;
+        }
+
+        _service->updateRecords(_time_base->to_epoch_s(packet_reference_ts), _records.get_bytes(), offset);
+        if (!_announce(SmartPPEService::RECORDS, DATA_POLL, EventLog::TIMEOUT_BLE_DATA, "DATA"))
+        {
+            return false;
+        }
+
+        _records.consume(offset); // the phone has these
+    }
+
+    // phones that predate RECORDS still find the latest reading of each type where they used to
+    if (have_newest[RECORD_HEART_RATE])
+    {
+        _service->updateHeartRate(_time_base->to_epoch_s(newest[RECORD_HEART_RATE].timestamp), newest[RECORD_HEART_RATE].value);
+    }
+    if (have_newest[RECORD_RESPIRATORY_RATE])
+    {
+        _service->updateRespiratoryRate(_time_base->to_epoch_s(newest[RECORD_RESPIRATORY_RATE].timestamp), newest[RECORD_RESPIRATORY_RATE].value);
+    }
+    if (have_newest[RECORD_MASK_FIT])
+    {
+        _service->updateMaskFit(_time_base->to_epoch_s(newest[RECORD_MASK_FIT].timestamp), newest[RECORD_MASK_FIT].value);
+    }
+
+    return true;
+}
+
+bool DataSync::_send_coughs()
+{
+    CoughDetection::CoughEvent_t cough_event;
+    while (_coughs.peek(cough_event))
+    {
+        _logger->log(TRACE_DEBUG, "WRITING COUGH = %u, TS: %lu", cough_event.peak, cough_event.timestamp);
+        _service->updateCough(_time_base->to_epoch_s(cough_event.timestamp), cough_event.peak, cough_event.duration, cough_event.peak_count);
+        if (!_announce(SmartPPEService::COUGH_SAMPLE, DATA_POLL, EventLog::TIMEOUT_BLE_COUGH, "COUGH"))
+        {
+            return false;
+        }
+
+        _coughs.pop(cough_event); // only drop it once the phone has it
+    }
+
+    return true;
+}
+
+// the event log up to now, in batches
+bool DataSync::_send_event_log()
+{
+    _event_log->flush();
+    EventLog::Event_t events[SmartPPEService::EVENT_LOG_MAX_EVENTS];
+    uint32_t next_event = std::max(_event_log->get_synced(), _event_log->get_oldest());
+    while (next_event < _event_log->get_count())
+    {
+        uint16_t num_events = std::min(_event_log->get_count() - next_event, (uint32_t)SmartPPEService::EVENT_LOG_MAX_EVENTS);
+        if (!_event_log->read(next_event, events, num_events))
+        {
+            _logger->log(TRACE_WARNING, "%s", "EVENT LOG READ FAILED");
+            break;
+        }
+
+        _logger->log(TRACE_DEBUG, "WRITING EVENTS %lu-%lu", next_event, next_event + num_events - 1);
+        _service->updateEventLog(next_event, (uint8_t*)events, num_events);
+        if (!_announce(SmartPPEService::EVENT_LOG, DATA_POLL, EventLog::TIMEOUT_BLE_EVENT_LOG, "EVENT LOG"))
+        {
+            return false;
+        }
+
+        next_event += num_events;
+        _event_log->set_synced(next_event);
+    }
+
+    return true;
+}
+
+/**
+ * @brief Record a BLE timeout and get it into FRAM straight away, in case
+ * the supercap doesn't last to the next flush.
+ */
+void DataSync::_record_timeout(EventLog::Timeout_t timeout)
+{
+    _event_log->record(EventLog::EVENT_TIMEOUT, timeout);
+    _event_log->flush();
+}
+
+void DataSync::_log_throughput(microseconds duration)
+{
+    uint32_t bytes = _service->getTxBytes();
+    uint16_t mtu = _service->getAttMtu();
+    uint32_t bytes_per_second = duration.count() > 0 ? (uint64_t)bytes * 1000000 / duration.count() : 0;
+
+    _logger->log(TRACE_INFO, "SYNC: %lu bytes in %lli ms (%lu B/s), ATT MTU %u", bytes, duration_cast<milliseconds>(duration).count(), bytes_per_second, mtu);
+    _event_log->record(EventLog::EVENT_SYNC, mtu > 0xFF ? 0xFF : mtu, bytes_per_second > 0xFFFF ? 0xFFFF : bytes_per_second);
+}
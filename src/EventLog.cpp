@@ -0,0 +1,193 @@
+/**
+ * @file EventLog.cpp
+ * @author agent agent@local
+ * @brief Persistent binary event log in FRAM for post-mortem analysis
+ * @version 0.1
+ * @date 2026-10-19
+ * 
+ * @copyright Copyright (c) 2026 Ka Moamoa
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, version 3 of the license.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "EventLog.h"
+
+EventLog* EventLog::_instance = nullptr;
+Mutex EventLog::_mutex;
+
+EventLog::EventLog()
+{
+    _logger = Logger::get_instance();
+}
+
+EventLog::~EventLog()
+{
+}
+
+EventLog* EventLog::get_instance()
+{
+    _mutex.lock();
+
+    if (_instance == nullptr)
+    {
+        _instance = new EventLog();
+    }
+
+    _mutex.unlock();
+
+    return _instance;
+}
+
+bool EventLog::initialize(FRAM* fram)
+{
+    _fram = fram;
+
+    if (!_fram->read_bytes(HEADER_ADDR, (char*)&_header, sizeof(_header)))
+    {
+        _logger->log(TRACE_WARNING, "%s", "EVENT LOG HEADER READ FAILED");
+        _fram = nullptr;
+        return false;
+    }
+
+    if (_header.magic != MAGIC || _header.synced > _header.count)
+    {
+        _logger->log(TRACE_INFO, "%s", "Event log not initialized, formatting...");
+        _header.magic = MAGIC;
+        _header.count = 0;
+        _header.synced = 0;
+        if (!_write_header())
+        {
+            _fram = nullptr;
+            return false;
+        }
+    }
+
+    uint32_t reset_reason = NRF_POWER->RESETREAS;
+    NRF_POWER->RESETREAS = reset_reason; // bits are cleared by writing 1
+    record(EVENT_RESET, 0, (reset_reason & 0xF) | (((reset_reason >> 16) & 0xF) << 4));
+
+    _logger->log(TRACE_INFO, "Event log: %lu events, %lu synced", _header.count, _header.synced);
+
+    return true;
+}
+
+void EventLog::record(EventType_t type, uint8_t arg, uint16_t value)
+{
+    _log_mutex.lock();
+
+    if (_num_staged >= STAGE_SIZE && !flush())
+    {
+        _num_staged = 0; // FRAM is gone, don't wedge; drop the batch
+    }
+
+    Event_t& event = _staged[_num_staged++];
+    event.timestamp = time(NULL);
+    event.type = type;
+    event.arg = arg;
+    event.value = value;
+
+    _log_mutex.unlock();
+}
+
+bool EventLog::flush()
+{
+    if (_fram == nullptr) return false;
+
+    _log_mutex.lock();
+
+    if (_num_staged == 0)
+    {
+        _log_mutex.unlock();
+        return true;
+    }
+
+    _fram->hold_power(true);
+
+    bool success = true;
+    uint8_t written = 0;
+    while (written < _num_staged)
+    {
+        // split the batch where it wraps around the ring
+        uint16_t slot = (_header.count + written) % CAPACITY;
+        uint16_t chunk = _num_staged - written;
+        if (slot + chunk > CAPACITY) chunk = CAPACITY - slot;
+
+        success &= _fram->write_bytes(EVENTS_ADDR + slot * sizeof(Event_t), (const char*)&_staged[written], chunk * sizeof(Event_t));
+        written += chunk;
+    }
+
+    _header.count += _num_staged;
+    if (_header.count - _header.synced > CAPACITY)
+    {
+        _header.synced = _header.count - CAPACITY; // unsynced events were overwritten
+    }
+    success &= _write_header();
+
+    _fram->hold_power(false);
+
+    _num_staged = 0;
+
+    _log_mutex.unlock();
+
+    return success;
+}
+
+bool EventLog::set_synced(uint32_t synced)
+{
+    if (_fram == nullptr) return false;
+
+    _log_mutex.lock();
+    _header.synced = synced > _header.count ? _header.count : synced;
+    bool success = _write_header();
+    _log_mutex.unlock();
+
+    return success;
+}
+
+bool EventLog::read(uint32_t index, Event_t* events, uint16_t num_events)
+{
+    if (_fram == nullptr) return false;
+
+    _log_mutex.lock();
+
+    if (index < get_oldest() || index + num_events > _header.count)
+    {
+        _log_mutex.unlock();
+        return false;
+    }
+
+    _fram->hold_power(true);
+
+    bool success = true;
+    uint16_t read = 0;
+    while (read < num_events)
+    {
+        uint16_t slot = (index + read) % CAPACITY;
+        uint16_t chunk = num_events - read;
+        if (slot + chunk > CAPACITY) chunk = CAPACITY - slot;
+
+        success &= _fram->read_bytes(EVENTS_ADDR + slot * sizeof(Event_t), (char*)&events[read], chunk * sizeof(Event_t));
+        read += chunk;
+    }
+
+    _fram->hold_power(false);
+
+    _log_mutex.unlock();
+
+    return success;
+}
+
+bool EventLog::_write_header()
+{
+    return _fram->write_bytes(HEADER_ADDR, (const char*)&_header, sizeof(_header));
+}
@@ -31,8 +31,7 @@ bool FRAM::write_bytes(uint32_t address, const char *tx_buffer, int tx_bytes)
 
     const char write_address[3] = {unpack.bytes[2], unpack.bytes[1], unpack.bytes[0]}; // flip endianness
     
-    _bus_control->spi_power(true);
-    ThisThread::sleep_for(10ms); // let spi bus turn on
+    _power_up();
 
     _fram_cs = 0; // CS assert
     _write_opcode(OP_WREN);
@@ -44,8 +43,7 @@ bool FRAM::write_bytes(uint32_t address, const char *tx_buffer, int tx_bytes)
     _spi->write(tx_buffer, tx_bytes, NULL, 0); // This is the actual data transmission
     _fram_cs = 1; // CS deassert
 
-    ThisThread::sleep_for(1ms);
-    _bus_control->spi_power(false);
+    _power_down();
 
     return true;
 }
@@ -63,8 +61,7 @@ uint8_t FRAM::read_bytes(uint32_t address, char *rx_buffer, int rx_bytes)
 
     const char read_address[3] = {unpack.bytes[2], unpack.bytes[1], unpack.bytes[0]}; // flip endianness
 
-    _bus_control->spi_power(true);
-    ThisThread::sleep_for(10ms); // let spi bus turn on
+    _power_up();
 
     _fram_cs = 0; // CS assert
     
@@ -74,12 +71,61 @@ uint8_t FRAM::read_bytes(uint32_t address, char *rx_buffer, int rx_bytes)
 
     _fram_cs = 1; // CS deassert
 
-    ThisThread::sleep_for(1ms);
-    _bus_control->spi_power(false);
+    _power_down();
 
      return true; // TODO add SPI error checking
 }
 
+void FRAM::hold_power(bool hold)
+{
+    if (hold && !_power_held)
+    {
+        _power_up();
+        _power_held = true;
+    }
+    else if (!hold && _power_held)
+    {
+        _power_held = false;
+        _power_down();
+    }
+}
+
+void FRAM::_power_up()
+{
+    if (_power_held) return;
+
+    // F-RAM is ready within microseconds, so don't sleep for a fixed time
+    _bus_control->power_up(BusControl::FRAM, callback(this, &FRAM::is_ready));
+}
+
+void FRAM::_power_down()
+{
+    if (_power_held) return;
+
+    _bus_control->release(BusControl::FRAM);
+}
+
+bool FRAM::is_ready()
+{
+    char id[9] = {0};
+
+    _fram_cs = 0;
+    _spi->write(OP_RDID);
+    _spi->write(NULL, 0, id, sizeof(id));
+    _fram_cs = 1;
+
+    // an unpowered (or still booting) chip reads back as all 0x00 or all 0xFF
+    bool all_low = true;
+    bool all_high = true;
+    for (int i = 0; i < sizeof(id); i++)
+    {
+        all_low &= id[i] == 0x00;
+        all_high &= id[i] == (char)0xFF;
+    }
+
+    return !all_low && !all_high;
+}
+
 bool FRAM::_write_opcode(uint8_t opcode)
 {
     _spi->write(opcode);
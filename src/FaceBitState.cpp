@@ -34,19 +34,42 @@
 #include "LowPowerTimer.h"
 #include "TARGET_SMARTPPE/PinNames.h"
 #include "Utilites.h"
-
+#include "WaveformStreamer.h"
+
+#if FACEBIT_STATIC_MEMORY
+MBED_ALIGN(8) static unsigned char ble_queue_buffer[16 * EVENTS_EVENT_SIZE];
+MBED_ALIGN(8) static unsigned char ble_thread_stack[4096];
+events::EventQueue FaceBitState::ble_queue(sizeof(ble_queue_buffer), ble_queue_buffer);
+Thread FaceBitState::_ble_thread(osPriorityNormal, sizeof(ble_thread_stack), ble_thread_stack, "ble");
+#else
 events::EventQueue FaceBitState::ble_queue(16 * EVENTS_EVENT_SIZE);
-Thread FaceBitState::_ble_thread(osPriorityNormal, 4096);
+Thread FaceBitState::_ble_thread(osPriorityNormal, 4096, nullptr, "ble");
+#endif
+
+static_assert(DataSync::RECORD_HEART_RATE == FaceBitState::HEART_RATE && DataSync::RECORD_RESPIRATORY_RATE == FaceBitState::RESPIRATORY_RATE
+    && DataSync::RECORD_MASK_FIT == FaceBitState::MASK_FIT, "DataSync sends records by FaceBitState's types");
 
 FaceBitState::FaceBitState(SmartPPEService *smart_ppe_ble, bool *imu_interrupt) :
 _spi(SPI_MOSI, SPI_MISO, SPI_SCK),
 _i2c(I2C_SDA0, I2C_SCL0),
+_session(&_spi, &_i2c),
+_fram(&_spi, (PinName)FRAM_CS),
+_ble_process(ble_queue, BLE::Instance()),
+_conn_manager(ble_queue),
+_broadcaster(ble_queue),
 _imu_cs(IMU_CS),
 _smart_ppe_ble(smart_ppe_ble),
-_imu_interrupt(imu_interrupt)
+_imu_interrupt(imu_interrupt),
+_data_sync(smart_ppe_ble, _conn_manager, _records, _cough_buffer)
 {
     _logger = Logger::get_instance();
     _bus_control = BusControl::get_instance();
+    _event_log = EventLog::get_instance();
+    _checkpoint = Checkpoint::get_instance();
+    _time_base = TimeBase::get_instance();
+    _memory_stats = MemoryStats::get_instance();
+
+    _data_sync.on_time_set(callback(&_broadcaster, &Broadcaster::refresh)); // its timestamps are on the new offset
 }
 
 FaceBitState::~FaceBitState()
@@ -57,22 +80,65 @@ void FaceBitState::run()
 {
     _spi.frequency(8000000); // fast, to reduce transaction time
 
+    _time_base->initialize(&_fram); // first, so the reset event gets a real timestamp
+    _event_log->initialize(&_fram);
+    _checkpoint->initialize(&_fram); // a capture cut off by a brownout resumes once the mask is back on
+
+    CapCalc *cap_calc = CapCalc::get_instance();
+    if (!cap_calc->start_monitor(ENERGY_LOW_THRESHOLD, ENERGY_OK_THRESHOLD))
+    {
+        _logger->log(TRACE_WARNING, "%s", "ENERGY MONITOR NOT ARMED");
+    }
+
     _state_timer.start();
     _force_update = true;
 
+    _bus_control->set_indicator_energy(cap_calc->calc_joules());
+    _broadcaster.set_energy_low(cap_calc->is_energy_low()); // runs once the stack is up
+
+#if FACEBIT_STREAMING
+    _start_streaming();
+#endif
+
     while(1)
     {
         update_state();
         _bus_control->set_led_blinks((uint8_t)_mask_state + 1);
+
+        // the LPCOMP reports crossings below; between them, an occasional reading is plenty for the LED
+        if (_state_timer.read_ms() - _last_energy_ts > INDICATOR_ENERGY_PERIOD)
+        {
+            _bus_control->set_indicator_energy(cap_calc->calc_joules());
+            _last_energy_ts = _state_timer.read_ms();
+        }
         
-        if (_state_timer.read_ms() > BLE_BROADCAST_PERIOD)
+#if !FACEBIT_STREAMING
+        if (_state_timer.read_ms() - _last_ble_ts > BLE_BROADCAST_PERIOD)
         {
             _sync_data();
             _last_ble_ts = _state_timer.read_ms();
         }
+#endif
 
         _logger->log(TRACE_TRACE, "sleeping for %lli", static_cast<long long int>(_sleep_duration.count()));
-        ThisThread::sleep_for(_sleep_duration);
+        if (_sleep(cap_calc))
+        {
+            float voltage = cap_calc->read_voltage();
+            bool low = cap_calc->is_energy_low();
+
+            _logger->log(TRACE_INFO, "ENERGY %s: %0.2fV, %0.3fV/s", low ? "LOW" : "OK", voltage, cap_calc->get_charge_rate());
+            _event_log->record(EventLog::EVENT_ENERGY, low ? 1 : 0, (uint16_t)(voltage * 1000));
+            _bus_control->set_indicator_energy(cap_calc->calc_joules(voltage));
+            _broadcaster.set_energy_low(low);
+            _last_energy_ts = _state_timer.read_ms();
+
+            if (low)
+            {
+                _time_base->checkpoint(true); // a brownout may be next
+            }
+        }
+
+        _time_base->checkpoint();
     }
 }
 
@@ -87,11 +153,8 @@ void FaceBitState::update_state()
                 _sleep_duration = OFF_SLEEP_DURATION;
             }
 
-            Barometer barometer(&_spi, (PinName)BAR_CS, (PinName)BAR_DRDY);
-            MaskStateDetection mask_state(&barometer);
-
             MaskStateDetection::MASK_STATE_t mask_status;
-            mask_status = mask_state.is_on(); // blocking call for ~5s
+            mask_status = _session.get_mask_detection()->is_on(); // blocking call for ~5s
 
             if (mask_status == MaskStateDetection::ON)
             {
@@ -105,6 +168,7 @@ void FaceBitState::update_state()
             else if (mask_status == MaskStateDetection::ERROR)
             {
                 _logger->log(TRACE_WARNING, "%s", "MASK DETECTION ERROR");
+                _event_log->record(EventLog::EVENT_SENSOR_ERROR, TASK_STATE_LAST);
             }
 
             break;
@@ -113,20 +177,65 @@ void FaceBitState::update_state()
         {
             _sleep_duration = ON_FACE_SLEEP_DURATION;
 
+            // the barometer stream (coughs, mask checks) runs whenever there's energy for it
+            bool energy_low = CapCalc::get_instance()->is_energy_low();
+            if (energy_low && _session.is_open())
+            {
+                _session.close();
+            }
+            else if (!energy_low && !_session.is_open() && !_session.open())
+            {
+                _event_log->record(EventLog::EVENT_SENSOR_ERROR, TASK_STATE_LAST);
+            }
+
             switch(_task_state)
             {
                 case IDLE:
                 {
+                    if (energy_low)
+                    {
+                        break; // don't start a capture we'd only have to checkpoint
+                    }
+
+                    // finish a checkpointed capture before anything else
+                    if (_checkpoint->get_pending() == Checkpoint::TASK_HEART_RATE)
+                    {
+                        _next_task_state = MEASURE_HEART_RATE;
+                        break;
+                    }
+                    else if (_checkpoint->get_pending() == Checkpoint::TASK_RESPIRATORY_RATE)
+                    {
+                        _next_task_state = MEASURE_RESPIRATION_RATE;
+                        break;
+                    }
+
                     uint32_t rr_time_over = _state_timer.read_ms() - _last_rr_ts;
                     uint32_t hr_time_over = _state_timer.read_ms() - _last_hr_ts;
+                    uint32_t mf_time_over = _state_timer.read_ms() - _last_mf_ts;
+
+                    // run whichever due task has been waiting the longest
+                    uint32_t longest_wait = 0;
 
-                    if (_state_timer.read_ms() - _last_rr_ts >= RR_PERIOD && (rr_time_over >= hr_time_over))
+                    if (rr_time_over >= RR_PERIOD && rr_time_over >= longest_wait)
                     {
                         _next_task_state = MEASURE_RESPIRATION_RATE;
+                        longest_wait = rr_time_over;
                     }
-                    else if (_state_timer.read_ms() - _last_hr_ts >= HR_PERIOD && (hr_time_over >= rr_time_over))
+
+                    if (hr_time_over >= HR_PERIOD && hr_time_over > longest_wait)
                     {
                         _next_task_state = MEASURE_HEART_RATE;
+                        longest_wait = hr_time_over;
+                    }
+
+                    /**
+                     * RR and HR are due every second, so they'd always
+                     * have waited longer. Mask fit jumps the queue once its
+                     * (much longer) period has passed.
+                     */
+                    if (mf_time_over >= MF_PERIOD)
+                    {
+                        _next_task_state = MEASURE_MASK_FIT;
                     }
 
                     break;
@@ -134,36 +243,49 @@ void FaceBitState::update_state()
 
                 case MEASURE_RESPIRATION_RATE:
                 {
-                    Si7051 temp(&_i2c);
-                    Barometer barometer(&_spi, BAR_CS, BAR_DRDY);
-                    RespiratoryRate resp_rate(temp, barometer);
+                    RespiratoryRate resp_rate(*_session.get_thermometer(), *_session.get_barometer()); // RR runs off the thermometer, the session streams the barometer
 
                     _logger->log(TRACE_INFO, "RESP RATE MEASUREMENT");
 
                     _last_rr_ts = _state_timer.read_ms();
 
-                    float rate = resp_rate.respiratory_rate(30, RespiratoryRate::THERMOMETER);
+                    float rate = resp_rate.respiratory_rate(30, RespiratoryRate::THERMOMETER, &_session);
+                    _record_capture(MEASURE_RESPIRATION_RATE, _last_rr_ts);
+
+                    if (!_end_check(resp_rate.is_suspended()))
+                    {
+                        _next_task_state = IDLE;
+                        break;
+                    }
+
+                    if (resp_rate.is_suspended())
+                    {
+                        _logger->log(TRACE_INFO, "%s", "RR checkpointed");
+                        _next_task_state = IDLE;
+                        break;
+                    }
 
                     if(rate > 0)
                     {
                         FaceBitData rr_data;
                         rr_data.data_type = RESPIRATORY_RATE;
-                        rr_data.timestamp = Utilities::round(_state_timer.read());
+                        rr_data.timestamp = _time_base->monotonic_s();
                         rr_data.value = Utilities::round(rate * 10);
 
                         _logger->log(TRACE_INFO, "RR ts: %llu, value: %lu", rr_data.timestamp, rate);
 
-                        data_buffer.push_back(rr_data);
+                        _store_record(rr_data);
                     }
                     else
                     {
                         _logger->log(TRACE_INFO, "Respiratory rate failure");
+                        _event_log->record(EventLog::EVENT_SENSOR_ERROR, MEASURE_RESPIRATION_RATE);
                         FaceBitData rr_failure;
                         rr_failure.data_type = RESPIRATORY_RATE;
-                        rr_failure.timestamp = Utilities::round(_state_timer.read());
+                        rr_failure.timestamp = _time_base->monotonic_s();
                         rr_failure.value = RESP_RATE_FAILURE;
 
-                        data_buffer.push_back(rr_failure);
+                        _store_record(rr_failure);
                     }
 
                     // _store_data_buffer();
@@ -179,7 +301,23 @@ void FaceBitState::update_state()
                     _last_hr_ts = _state_timer.read_ms();
                     BCG bcg(&_spi, (PinName)IMU_INT1, (PinName)IMU_CS);
 
-                    if(bcg.bcg(15s)) // blocking
+                    bool hr_captured = bcg.bcg(15s, &_session); // blocking
+                    _record_capture(MEASURE_HEART_RATE, _last_hr_ts);
+
+                    if (!_end_check(bcg.is_suspended()))
+                    {
+                        _next_task_state = IDLE;
+                        break;
+                    }
+
+                    if (bcg.is_suspended())
+                    {
+                        _logger->log(TRACE_INFO, "%s", "HR checkpointed");
+                        _next_task_state = IDLE;
+                        break;
+                    }
+
+                    if(hr_captured)
                     {
                         _logger->log(TRACE_DEBUG, "%s", "HR CAPTURED!");
                         for(int i = 0; i < bcg.get_buffer_size(); i++)
@@ -188,22 +326,23 @@ void FaceBitState::update_state()
                             BCG::HR_t hr = bcg.get_buffer_element();
 
                             hr_data.data_type = HEART_RATE;
-                            hr_data.timestamp = Utilities::round(_state_timer.read());
+                            hr_data.timestamp = _time_base->monotonic_s();
                             hr_data.value = hr.rate;
 
-                            data_buffer.push_back(hr_data);
+                            _store_record(hr_data);
                         }
                     }
                     else
                     {
                         _logger->log(TRACE_INFO, "%s", "HR FAILURE!");
+                        _event_log->record(EventLog::EVENT_SENSOR_ERROR, MEASURE_HEART_RATE);
                         FaceBitData hr_data;
 
                         hr_data.data_type = HEART_RATE;
-                        hr_data.timestamp = _state_timer.read();
+                        hr_data.timestamp = _time_base->monotonic_s();
                         hr_data.value = HR_FAILURE;
 
-                        data_buffer.push_back(hr_data);                       
+                        _store_record(hr_data);                       
                     }
 
                     // _store_data_buffer();
@@ -212,6 +351,44 @@ void FaceBitState::update_state()
 
                     break;
                 }
+                case MEASURE_MASK_FIT:
+                {
+                    _logger->log(TRACE_INFO, "%s", "MEASURING MASK FIT");
+                    _last_mf_ts = _state_timer.read_ms();
+
+                    MaskFit mask_fit;
+
+                    int8_t score = mask_fit.measure(&_session); // blocking
+                    _record_capture(MEASURE_MASK_FIT, _last_mf_ts);
+
+                    MaskStateDetection::MASK_STATE_t mask_status = mask_fit.get_mask_state();
+                    if (mask_status == MaskStateDetection::OFF)
+                    {
+                        _logger->log(TRACE_INFO, "%s", "MASK OFF");
+                        _next_mask_state = OFF_FACE;
+                    }
+                    else if (mask_status == MaskStateDetection::ON)
+                    {
+                        FaceBitData mf_data;
+                        mf_data.data_type = MASK_FIT;
+                        mf_data.timestamp = _time_base->monotonic_s();
+                        mf_data.value = score >= 0 ? score : MF_FAILURE;
+
+                        _logger->log(TRACE_INFO, "MF ts: %llu, value: %u", mf_data.timestamp, mf_data.value);
+
+                        _store_record(mf_data);
+                    }
+                    else
+                    {
+                        _logger->log(TRACE_WARNING, "%s", "MASK DETECTION ERROR");
+                        _event_log->record(EventLog::EVENT_SENSOR_ERROR, MEASURE_MASK_FIT);
+                    }
+
+                    _next_task_state = IDLE;
+
+                    break;
+                }
+
                 default:
                     _next_task_state = IDLE;
                     break;
@@ -228,31 +405,30 @@ void FaceBitState::update_state()
     if (_mask_state == ON_FACE && _task_state != _next_task_state)
     {
         if (_next_task_state != IDLE)
+        {
+            _event_log->record(EventLog::EVENT_TASK, _next_task_state);
+        }
+
+        if (_next_task_state != IDLE && _next_task_state != MEASURE_MASK_FIT) // mask fit checks its own window
         {
             /**
              * We want to run mask on/off detection before every
              * new task, so we don't waste energy on the task (and get
-             * an inaccurate result) if the mask is off.
+             * an inaccurate result) if the mask is off. Rather than
+             * a separate blocking check, start a check on the sensor
+             * session's stream: the mask state is decided from the
+             * next detection window while the task runs, and the task
+             * stops early if the mask is off. RR needs the thermometer
+             * for itself, so its check goes without the pre-check.
              */
-            Barometer barometer(&_spi, (PinName)BAR_CS, (PinName)BAR_DRDY);
-            MaskStateDetection mask_state(&barometer);
-
-            MaskStateDetection::MASK_STATE_t mask_status;
-            mask_status = mask_state.is_on(); // blocking call for ~5s
-
-            if (mask_status == MaskStateDetection::ON)
+            if (_session.is_open())
             {
-                _logger->log(TRACE_INFO, "%s", "MASK ON");
+                _session.check(_next_task_state != MEASURE_RESPIRATION_RATE);
             }
-            else if (mask_status == MaskStateDetection::OFF)
-            {
-                _logger->log(TRACE_INFO, "%s", "MASK OFF");
-                _next_task_state = IDLE;
-                _next_mask_state = OFF_FACE;
-            }
-            else if (mask_status == MaskStateDetection::ERROR)
+            else
             {
                 _logger->log(TRACE_WARNING, "%s", "MASK DETECTION ERROR");
+                _event_log->record(EventLog::EVENT_SENSOR_ERROR, _next_task_state);
                 _next_task_state = IDLE; // don't run if we don't know
             }
         }
@@ -268,7 +444,20 @@ void FaceBitState::update_state()
     {
         _force_update = true;
 
-        _mask_state_change_ts = time(NULL);
+        _mask_state_change_ts = _time_base->monotonic_s();
+        _event_log->record(EventLog::EVENT_MASK, _next_mask_state);
+        _broadcaster.set_mask_state(_next_mask_state);
+
+        if (_next_mask_state != ON_FACE)
+        {
+            _session.close();
+            _collect_coughs();
+        }
+
+        if (_mask_state == ON_FACE && _next_mask_state == OFF_FACE)
+        {
+            _checkpoint->discard(_checkpoint->get_pending()); // a capture from before the mask came off is stale
+        }
 
         _new_mask_state = true;
         _mask_state = _next_mask_state;
@@ -282,161 +471,180 @@ void FaceBitState::update_state()
     }
 }
 
-bool FaceBitState::_get_imu_int()
-{
-    bool tmp = *_imu_interrupt;
-    *_imu_interrupt = false;
-    return tmp;
-}
-
-bool FaceBitState::_sync_data()
+/**
+ * @brief Act on the mask state from the task's check, and pick up the
+ * coughs detected while the task ran. Returns false if the task result
+ * should be thrown away. A checkpointed task may stop before the
+ * detection window is full; its resumed capture gets a check of its own.
+ */
+bool FaceBitState::_end_check(bool suspended)
 {
-    BLE &_ble = BLE::Instance();
-    GattServerProcess _ble_process(ble_queue, _ble);
-    _ble_process.on_init(callback(_smart_ppe_ble, &SmartPPEService::start));
-
-    _ble_thread.start(callback(&_ble_process, &GattServerProcess::run));
+    MaskStateDetection::MASK_STATE_t mask_status = _session.get_mask_state();
+    _collect_coughs();
 
-    if (data_buffer.size() == 0 && _force_update == false)
+    if (mask_status == MaskStateDetection::OFF)
     {
-        _logger->log(TRACE_DEBUG, "%s", "NO DATA TO SEND");
+        _logger->log(TRACE_INFO, "%s", "MASK OFF");
+        _next_mask_state = OFF_FACE;
         return false;
     }
+    else if (mask_status != MaskStateDetection::ON && !suspended)
+    {
+        // the task finished before the detection window did, or the barometer stopped responding
+        _logger->log(TRACE_WARNING, "%s", "MASK DETECTION ERROR");
+        _event_log->record(EventLog::EVENT_SENSOR_ERROR, _task_state);
+        return false; // don't trust the result if we don't know
+    }
 
-    _logger->log(TRACE_DEBUG, "%s", "BLE SYNC");
+    return true;
+}
 
-    // start ble
-    _ble_thread.flags_set(START_BLE);
+/**
+ * @brief Sleep for _sleep_duration or until the supercap crosses a
+ * threshold. With the sensor session open, its FIFO bursts wake us in
+ * between so the stream keeps up, and the crossing is checked on each.
+ */
+bool FaceBitState::_sleep(CapCalc *cap_calc)
+{
+    if (!_session.is_open())
+    {
+        return cap_calc->wait_for_crossing(_sleep_duration);
+    }
 
-    // wait for connection
-    LowPowerTimer ble_timeout;
-    ble_timeout.start();
-    while(!_ble_process.is_connected())
+    LowPowerTimer timer;
+    timer.start();
+    while (timer.elapsed_time() < _sleep_duration)
     {
-        Thread::State state = _ble_thread.get_state();
-        uint16_t size = _ble_process.event_queue_size;
-        // _logger->log(TRACE_TRACE, "Thread state = %u, equeue size = %u", state, size);
-        
-        if (ble_timeout.read_ms() > BLE_CONNECTION_TIMEOUT)
+        if (cap_calc->wait_for_crossing(0ms))
         {
-            _logger->log(TRACE_INFO, "%s", "TIMEOUT BEFORE BLE CONNECTION");
-            _ble_thread.flags_set(STOP_BLE);
-            system_reset();
+            return true;
         }
 
-        ThisThread::sleep_for(10ms);
+        _session.wait(duration_cast<milliseconds>(_sleep_duration - timer.elapsed_time()));
+        _collect_coughs();
     }
 
-    // set mask on characteristic based on state
-    _smart_ppe_ble->updateMaskOn(_mask_state_change_ts, _mask_state);
-    _smart_ppe_ble->updateDataReady(SmartPPEService::MASK_ON);
+    return cap_calc->wait_for_crossing(0ms);
+}
 
-    ble_timeout.reset();
-    ble_timeout.start();
-    while(1)
-    { 
-        SmartPPEService::data_ready_t data_ready =  _smart_ppe_ble->getDataReady();
-        if (data_ready == SmartPPEService::NO_DATA)
-        {
-            break;
-        }
-        
-        _smart_ppe_ble->updateDataReady(SmartPPEService::MASK_ON);
+void FaceBitState::_collect_coughs()
+{
+    CoughDetection::CoughEvent_t event;
+    while (_session.get_cough_event(event))
+    {
+        _logger->log(TRACE_INFO, "cough detected: peak = %u Pa, duration = %u0 ms, peaks = %u", event.peak, event.duration, event.peak_count);
+        _cough_buffer.push(event);
+    }
+}
 
-        if (ble_timeout.read_ms() > BLE_DRDY_TIMEOUT)
-        {
-            _logger->log(TRACE_INFO, "%s", "BLE DATA READY TIMEOUT (MASK ON)");
-            _ble_thread.flags_set(STOP_BLE);
-            system_reset();
-        }
+void FaceBitState::_record_capture(TASK_STATE_t task, uint32_t start_ms)
+{
+    uint32_t duration = (_state_timer.read_ms() - start_ms) / 100;
+    _event_log->record(EventLog::EVENT_CAPTURE, task, duration > 0xFFFF ? 0xFFFF : duration);
+}
 
-        ThisThread::sleep_for(500ms);
-    }
+void FaceBitState::_on_ble_init(BLE &ble, events::EventQueue &queue)
+{
+    _smart_ppe_ble->start(ble, queue);
+    _conn_manager.attach(ble, &_ble_process);
+    _conn_manager.on_disconnection(callback(_smart_ppe_ble, &SmartPPEService::onDisconnection));
+    _broadcaster.start(ble);
+}
+
+void FaceBitState::_store_record(const FaceBitData &data)
+{
+    _broadcaster.add_reading(data.data_type, data.value);
 
-    // sync timestamp
-    uint64_t new_time = _smart_ppe_ble->getTime();
-    if (new_time != 0)
+    if (!_records.append(data.data_type, data.timestamp, data.value))
     {
-        set_time(_smart_ppe_ble->getTime());
-        _logger->log(TRACE_INFO, "Time set to %lli", time(NULL));
+        _logger->log(TRACE_WARNING, "RECORD BUFFER FULL, %lu oldest dropped", _records.get_dropped_count());
     }
+}
 
-    if (data_buffer.size() == 0)
+bool FaceBitState::_get_imu_int()
+{
+    bool tmp = *_imu_interrupt;
+    *_imu_interrupt = false;
+    return tmp;
+}
+
+void FaceBitState::_start_streaming()
+{
+    // the window never closes, so the stack stays connectable for good
+    _smart_ppe_ble->resetConnection();
+    _start_ble();
+
+    WaveformStreamer::get_instance()->enable(_smart_ppe_ble, &ble_queue);
+}
+
+void FaceBitState::_start_ble()
+{
+    if (_ble_started)
     {
-        _logger->log(TRACE_DEBUG, "%s", "NO PHYSIO DATA TO SEND");
+        _conn_manager.open();
+        return;
     }
 
-    for (int i = 0; i < data_buffer.size(); i++)
-    {
-        _logger->log(TRACE_DEBUG, "DATA BUFFER HAS %u ELEMENTS", data_buffer.size());
+    // first sync brings the stack up; the BLE process starts advertising once it's initialised
+    _ble_process.on_init(callback(this, &FaceBitState::_on_ble_init));
+    _ble_thread.start(callback(&_ble_process, &GattServerProcess::run));
+    _ble_thread.flags_set(START_BLE);
+    _ble_started = true;
+}
 
-        FaceBitData next_data_point = data_buffer.at(i);
+void FaceBitState::_end_sync()
+{
+    _data_sync.close();
 
-        switch(next_data_point.data_type)
-        {
-            case HEART_RATE:
-            {
-                _logger->log(TRACE_DEBUG, "WRITING HR = %u, TS: %u", next_data_point.value, (_state_timer.read() - next_data_point.timestamp));
-                uint64_t data_ts = Utilities::round(_state_timer.read()) - next_data_point.timestamp;
-                _smart_ppe_ble->updateHeartRate(data_ts, next_data_point.value);
-                _smart_ppe_ble->updateDataReady(_smart_ppe_ble->HEART_RATE);
-                
-                ble_timeout.reset();
-                ble_timeout.start();
-                while(_smart_ppe_ble->getDataReady() != _smart_ppe_ble->NO_DATA)
-                {
-                    _smart_ppe_ble->updateDataReady(_smart_ppe_ble->HEART_RATE);
-                    if (ble_timeout.read_ms() > BLE_DRDY_TIMEOUT)
-                    {
-                        _logger->log(TRACE_INFO, "%s", "BLE DATA READY TIMEOUT (DATA)");
-                        _ble_thread.flags_set(STOP_BLE);
-                        return false;
-                    }
-                    ThisThread::sleep_for(1000ms);
-                }
-                break;
-            }
-            case RESPIRATORY_RATE:
-            {
-                _logger->log(TRACE_DEBUG, "WRITING RESP RATE = %u, TS: %u", next_data_point.value, (_state_timer.read() - next_data_point.timestamp));
-                uint64_t data_ts = Utilities::round(_state_timer.read()) - next_data_point.timestamp;
-                _smart_ppe_ble->updateRespiratoryRate(data_ts, next_data_point.value);
-                _smart_ppe_ble->updateDataReady(_smart_ppe_ble->RESPIRATORY_RATE);
-                ble_timeout.reset();
-                ble_timeout.start();
-                while(_smart_ppe_ble->getDataReady() != _smart_ppe_ble->NO_DATA)
-                {
-                    _smart_ppe_ble->updateDataReady(_smart_ppe_ble->RESPIRATORY_RATE);
-                    if (ble_timeout.read_ms() > BLE_DRDY_TIMEOUT)
-                    {
-                        _logger->log(TRACE_INFO, "%s", "BLE DATA READY TIMEOUT (DATA)");
-                        _ble_thread.flags_set(STOP_BLE);
-                        return false;
-                    }
-                    ThisThread::sleep_for(1000ms);
-                }
-                break;
-            }
-            case MASK_FIT:
-                // _smart_ppe_ble.updateRespiratoryRate(next_data_point.timestamp, next_data_point.value);
-                break;
-        }
+    uint32_t cycle_ms = _sync_cycle_timer.read_ms();
+    float joules = _sync_start_joules - CapCalc::get_instance()->calc_joules(); // net of whatever was harvested meanwhile
+    _sync_cycle_timer.stop();
+
+    _logger->log(TRACE_INFO, "SYNC CYCLE (%s): %lu ms, %0.2f mJ", _sync_cold ? "stack bring-up" : "warm", cycle_ms, joules * 1000);
+    _event_log->record(EventLog::EVENT_SYNC_CYCLE, _sync_cold ? 1 : 0, cycle_ms / 10 > 0xFFFF ? 0xFFFF : cycle_ms / 10);
+
+    _bus_control->log_rail_on_time();
+
+    if (_sync_cold)
+    {
+        _memory_stats->mark_startup(); // the BLE stack has made its allocations by now
     }
+    _memory_stats->log();
 
-    if (data_buffer.size())
+    _event_log->flush();
+    _logger->flush();
+}
+
+bool FaceBitState::_sync_data()
+{
+    if (_records.get_num_records() == 0 && _cough_buffer.empty() && _force_update == false)
     {
-        data_buffer.clear();
+        _logger->log(TRACE_DEBUG, "%s", "NO DATA TO SEND");
+        return false;
     }
 
-    _force_update = false;
+    _logger->log(TRACE_DEBUG, "%s", "BLE SYNC");
 
-    _ble_thread.flags_set(STOP_BLE);
+    _sync_cold = !_ble_started;
+    _sync_start_joules = CapCalc::get_instance()->calc_joules();
+    _sync_cycle_timer.reset();
+    _sync_cycle_timer.start();
+
+    // open the sync window
+    _smart_ppe_ble->resetConnection();
+    _start_ble();
+
+    bool synced = _data_sync.run(_mask_state, _mask_state_change_ts);
+    if (synced)
+    {
+        _force_update = false;
+    }
 
     // _store_time();
 
-    system_reset();
+    _end_sync();
 
-    return true;
+    return synced;
 }
 
 // bool FaceBitState::_store_data_buffer()
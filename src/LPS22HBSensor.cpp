@@ -380,6 +380,20 @@ int LPS22HBSensor::sw_reset(void)
   return 0;
 }
 
+/**
+ * @brief  Set LPS22HB low current mode. Only change it while the sensor is disabled
+ * @param  low_current true for low current mode, false for low noise mode
+ * @retval 0 in case of success, an error code otherwise
+ */
+int LPS22HBSensor::set_low_current(bool low_current)
+{
+  if(LPS22HB_Set_PowerMode( (void *)this, low_current ? LPS22HB_LowPower : LPS22HB_LowNoise) == LPS22HB_ERROR)
+  {
+    return 1;
+  }
+  return 0;
+}
+
 /**
  * @brief  Enable LPS22HB FIFO
  * @retval 0 in case of success, an error code otherwise
@@ -434,12 +448,13 @@ int LPS22HBSensor::set_interrupt_level(uint8_t intr)
 }
 
 /**
- * @brief  Enable LPS22HB FIFO watermark level use
+ * @brief  Enable or disable LPS22HB FIFO watermark level use (STOP_ON_FTH)
+ * @param  enable false lets the FIFO fill up to 32 samples again
  * @retval 0 in case of success, an error code otherwise
  */
-int LPS22HBSensor::enable_fifo_watermark(void)
+int LPS22HBSensor::enable_fifo_watermark(bool enable)
 {
-  if(LPS22HB_Set_FifoWatermarkLevelUse( (void *)this, LPS22HB_ENABLE) == LPS22HB_ERROR)
+  if(LPS22HB_Set_FifoWatermarkLevelUse( (void *)this, enable ? LPS22HB_ENABLE : LPS22HB_DISABLE) == LPS22HB_ERROR)
   {
     return 1;
   }
@@ -469,8 +484,8 @@ int LPS22HBSensor::get_fifo_watermark(uint8_t *level)
  */
 int LPS22HBSensor::set_fifo_watermark(uint8_t level)
 {
-  if(level > 15)
-    level = 15;
+  if(level > FIFO_LENGTH - 1)
+    level = FIFO_LENGTH - 1; // WTM is a 5 bit field
   if(LPS22HB_Set_FifoWatermarkLevel( (void *)this, level) == LPS22HB_ERROR)
   {
     return 1;
@@ -482,9 +497,9 @@ int LPS22HBSensor::set_fifo_watermark(uint8_t level)
  * @brief  Enable LPS22HB FIFO watermark interrupt
  * @retval 0 in case of success, an error code otherwise
  */
-int LPS22HBSensor::enable_fifo_watermark_interrupt(void)
+int LPS22HBSensor::enable_fifo_watermark_interrupt(bool enable)
 {
-  if(LPS22HB_Set_FIFO_FTH_Interrupt( (void *)this, LPS22HB_ENABLE) == LPS22HB_ERROR)
+  if(LPS22HB_Set_FIFO_FTH_Interrupt( (void *)this, enable ? LPS22HB_ENABLE : LPS22HB_DISABLE) == LPS22HB_ERROR)
   {
     return 1;
   }
@@ -613,9 +628,14 @@ int LPS22HBSensor::get_pressure_fifo(float *pfData)
   return 0;
 }
 
-int LPS22HBSensor::get_fifo(std::vector<uint16_t> &pressure_buffer, std::vector<uint16_t> &temperature_buffer)
+int LPS22HBSensor::get_fifo(uint16_t *pressure_buffer, uint16_t *temperature_buffer, uint8_t num_samples)
 {
-  for (int i = 0; i < FIFO_LENGTH; i++)
+  if (num_samples > FIFO_LENGTH)
+  {
+    num_samples = FIFO_LENGTH;
+  }
+
+  for (int i = 0; i < num_samples; i++)
   {
     int32_t pressure_data = 0;
     if (LPS22HB_Get_Pressure((void *)this, &pressure_data) == LPS22HB_ERROR)
@@ -625,7 +645,7 @@ int LPS22HBSensor::get_fifo(std::vector<uint16_t> &pressure_buffer, std::vector<
 
     uint16_t pressure_adj = pressure_data - 80000;
 
-    pressure_buffer.push_back(pressure_adj);
+    pressure_buffer[i] = pressure_adj;
 
     int16_t temp_data = 0;
     if (LPS22HB_Get_Temperature((void *)this, &temp_data) == LPS22HB_ERROR)
@@ -635,7 +655,7 @@ int LPS22HBSensor::get_fifo(std::vector<uint16_t> &pressure_buffer, std::vector<
 
     uint16_t temp_adj = temp_data;
 
-    temperature_buffer.push_back(temp_adj);
+    temperature_buffer[i] = temp_adj;
   }
   
   return 0;
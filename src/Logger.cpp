@@ -22,9 +22,61 @@
 
 #include "Logger.h"
 
+// #define LOGGER_PROFILING
+
 Logger* Logger::_instance = nullptr;
 Mutex Logger::_mutex;
 
+typedef enum
+{
+    ARG_NONE,   // literal %%
+    ARG_WORD,   // int, unsigned, char, pointer, string
+    ARG_WIDE,   // long long
+    ARG_DOUBLE  // float (promoted), double
+} arg_kind_t;
+
+/**
+ * @brief Parse the conversion starting at fmt (which points at '%'). Copies the
+ * full specifier into spec and returns the character after it.
+ */
+static const char* parse_conversion(const char* fmt, char* spec, size_t spec_size, arg_kind_t* kind)
+{
+    size_t len = 0;
+    const char* p = fmt;
+    spec[len++] = *p++; // '%'
+
+    while (*p != '\0' && strchr("-+ #0123456789.", *p) != nullptr)
+    {
+        if (len < spec_size - 2) spec[len++] = *p;
+        p++;
+    }
+
+    uint8_t longs = 0;
+    bool intmax = false;
+    while (*p != '\0' && strchr("hlLzjt", *p) != nullptr)
+    {
+        if (*p == 'l') longs++;
+        else if (*p == 'j') intmax = true;
+        if (len < spec_size - 2) spec[len++] = *p;
+        p++;
+    }
+
+    char conversion = *p;
+    if (conversion != '\0')
+    {
+        spec[len++] = conversion;
+        p++;
+    }
+    spec[len] = '\0';
+
+    if (conversion == '%' || conversion == '\0') *kind = ARG_NONE;
+    else if (strchr("fFeEgGaA", conversion) != nullptr) *kind = ARG_DOUBLE;
+    else if (longs >= 2 || intmax) *kind = ARG_WIDE;
+    else *kind = ARG_WORD;
+
+    return p;
+}
+
 Logger::Logger()
 {
 
@@ -63,6 +115,17 @@ void Logger::initialize(UnbufferedSerial* serial, trace_level_t trace_level)
     _initialized = true;
 }
 
+void Logger::initialize(UarteLogTransport* uarte, trace_level_t trace_level)
+{
+    _uarte = uarte;
+
+    _trace_level = trace_level;
+
+    _uart = true;
+
+    _initialized = true;
+}
+
 void Logger::initialize(SWO_Channel* swo, trace_level_t trace_level)
 {
     _swo = swo;
@@ -79,21 +142,269 @@ void Logger::log(trace_level_t level, const char *msg, ...)
     if (level < _trace_level) return;
     else if (!_initialized) return;
 
+    #ifdef LOGGER_PROFILING
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    uint32_t start_cycles = DWT->CYCCNT;
+    #endif // LOGGER_PROFILING
+
     va_list args;
     va_start (args, msg);
 
-    char buffer[200];
-    vsnprintf(buffer, 200, msg, args);
+    if (_deferred)
+    {
+        _record(level, msg, args);
+    }
+    else
+    {
+        char buffer[200];
+        vsnprintf(buffer, 200, msg, args);
+
+        char line[210];
+        int length = snprintf(line, sizeof(line), "[%c] // %s\r\n", _trace_char[level], buffer);
+        _write(line, length < (int)sizeof(line) ? length : sizeof(line) - 1);
+    }
+
     va_end(args);
 
-    if (_uart)
+    #ifdef LOGGER_PROFILING
+    {
+        _profile_cycles += DWT->CYCCNT - start_cycles;
+        _profile_lines++;
+    }
+    #endif // LOGGER_PROFILING
+}
+
+uint32_t Logger::get_dropped_count()
+{
+    uint32_t dropped = core_util_atomic_load_u32(&_dropped);
+
+    if (_uarte != nullptr) dropped += _uarte->get_dropped_writes();
+
+    return dropped;
+}
+
+uint32_t Logger::get_cycles_per_line()
+{
+    return _profile_lines ? _profile_cycles / _profile_lines : 0;
+}
+bool Logger::enable_deferred(bool binary)
+{
+    if (!_initialized) return false;
+
+    _binary = binary;
+
+    if (_drain_thread_handle == nullptr)
+    {
+#if FACEBIT_STATIC_MEMORY
+        MBED_ALIGN(8) static unsigned char drain_stack[LOGGER_DRAIN_STACK_SIZE];
+        _drain_thread_handle = new Thread(osPriorityLow, sizeof(drain_stack), drain_stack, "logger");
+#else
+        _drain_thread_handle = new Thread(osPriorityLow, LOGGER_DRAIN_STACK_SIZE, nullptr, "logger");
+#endif
+        if (_drain_thread_handle->start(callback(this, &Logger::_drain_thread)) != osOK)
+        {
+            delete _drain_thread_handle;
+            _drain_thread_handle = nullptr;
+            return false;
+        }
+    }
+
+    _deferred = true;
+
+    return true;
+}
+
+void Logger::flush()
+{
+    if (_deferred) _drain();
+
+    if (_uarte != nullptr) _uarte->flush();
+}
+
+void Logger::_record(trace_level_t level, const char* msg, va_list args)
+{
+    // reserve a slot without locking; safe from threads and interrupts
+    uint32_t head = core_util_atomic_load_u32(&_head);
+    do
+    {
+        if (head - core_util_atomic_load_u32(&_tail) >= LOGGER_QUEUE_SIZE)
+        {
+            core_util_atomic_incr_u32(&_dropped, 1);
+            return;
+        }
+    } while (!core_util_atomic_cas_u32(&_head, &head, head + 1));
+
+    LogRecord_t& record = _queue[head & (LOGGER_QUEUE_SIZE - 1)];
+    record.fmt = msg;
+    record.level = level;
+
+    uint8_t num_words = 0;
+    char spec[16];
+    const char* p = msg;
+    while (*p != '\0')
+    {
+        if (*p != '%')
+        {
+            p++;
+            continue;
+        }
+
+        arg_kind_t kind;
+        p = parse_conversion(p, spec, sizeof(spec), &kind);
+
+        if (kind == ARG_WORD)
+        {
+            if (num_words + 1 > LOGGER_MAX_ARG_WORDS) break;
+            record.words[num_words++] = va_arg(args, uint32_t);
+        }
+        else if (kind == ARG_WIDE || kind == ARG_DOUBLE)
+        {
+            if (num_words + 2 > LOGGER_MAX_ARG_WORDS) break;
+            uint64_t value;
+            if (kind == ARG_WIDE)
+            {
+                value = va_arg(args, uint64_t);
+            }
+            else
+            {
+                double d = va_arg(args, double);
+                memcpy(&value, &d, sizeof(value));
+            }
+            memcpy(&record.words[num_words], &value, sizeof(value));
+            num_words += 2;
+        }
+    }
+    record.num_words = num_words;
+
+    core_util_atomic_store_bool(&record.ready, true);
+
+    _drain_flags.set(DRAIN_FLAG);
+}
+
+void Logger::_drain_thread()
+{
+    while (true)
+    {
+        _drain_flags.wait_any(DRAIN_FLAG);
+        _drain();
+    }
+}
+
+void Logger::_drain()
+{
+    _drain_mutex.lock();
+
+    while (true)
+    {
+        LogRecord_t& record = _queue[_tail & (LOGGER_QUEUE_SIZE - 1)];
+        if (!core_util_atomic_load_bool(&record.ready)) break;
+
+        if (_binary) _emit_binary(record);
+        else _emit_text(record);
+
+        core_util_atomic_store_bool(&record.ready, false);
+        core_util_atomic_incr_u32(&_tail, 1);
+    }
+
+    _drain_mutex.unlock();
+}
+
+void Logger::_emit_text(const LogRecord_t& record)
+{
+    char buffer[200];
+    size_t pos = 0;
+    uint8_t word = 0;
+
+    const char* p = record.fmt;
+    while (*p != '\0' && pos < sizeof(buffer) - 1)
+    {
+        if (*p != '%')
+        {
+            buffer[pos++] = *p++;
+            continue;
+        }
+
+        char spec[16];
+        arg_kind_t kind;
+        p = parse_conversion(p, spec, sizeof(spec), &kind);
+
+        int written = 0;
+        size_t remaining = sizeof(buffer) - pos;
+        if (kind == ARG_NONE)
+        {
+            written = snprintf(&buffer[pos], remaining, "%s", spec[1] == '%' ? "%" : "");
+        }
+        else if (kind == ARG_WORD && word + 1 <= record.num_words)
+        {
+            written = snprintf(&buffer[pos], remaining, spec, record.words[word]);
+            word += 1;
+        }
+        else if ((kind == ARG_WIDE || kind == ARG_DOUBLE) && word + 2 <= record.num_words)
+        {
+            uint64_t value;
+            memcpy(&value, &record.words[word], sizeof(value));
+            if (kind == ARG_WIDE)
+            {
+                written = snprintf(&buffer[pos], remaining, spec, value);
+            }
+            else
+            {
+                double d;
+                memcpy(&d, &value, sizeof(d));
+                written = snprintf(&buffer[pos], remaining, spec, d);
+            }
+            word += 2;
+        }
+        else
+        {
+            written = snprintf(&buffer[pos], remaining, "?"); // argument did not fit the record
+        }
+
+        if (written < 0) break;
+        pos += (size_t)written < remaining ? (size_t)written : remaining - 1;
+    }
+    buffer[pos] = '\0';
+
+    char line[210];
+    int length = snprintf(line, sizeof(line), "[%c] // %s\r\n", _trace_char[record.level], buffer);
+    _write(line, length < (int)sizeof(line) ? length : sizeof(line) - 1);
+}
+
+void Logger::_emit_binary(const LogRecord_t& record)
+{
+    // frame: sync, level, word count, format address (LE), argument words (LE)
+    uint8_t frame[3 + 4 + 4 * LOGGER_MAX_ARG_WORDS];
+    size_t len = 0;
+    frame[len++] = BINARY_SYNC;
+    frame[len++] = record.level;
+    frame[len++] = record.num_words;
+
+    uint32_t address = reinterpret_cast<uint32_t>(record.fmt);
+    memcpy(&frame[len], &address, sizeof(address));
+    len += sizeof(address);
+
+    memcpy(&frame[len], record.words, 4 * record.num_words);
+    len += 4 * record.num_words;
+
+    _write(reinterpret_cast<const char*>(frame), len);
+}
+
+void Logger::_write(const char* data, size_t length)
+{
+    if (_uarte != nullptr)
+    {
+        _uarte->write(data, length);
+    }
+    else if (_uart)
     {
         _serial->enable_output(true);
-        printf("[%c] // %s\r\n", _trace_char[level], buffer);
+        _serial->write(data, length);
         _serial->enable_output(false);
     }
     else
     {
-        _swo->printf("[%c] // %s\r\n", _trace_char[level], buffer);
+        _swo->write(data, length);
+        _swo->sync(); // deferred frames don't end in a newline
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,143 @@
+/**
+ * @file MaskClassifier.cpp
+ * @author agent agent@local
+ * @brief Mask on/off decisions from the pressure and temperature traces
+ * @version 0.1
+ * @date 2026-10-19
+ * 
+ * @copyright Copyright (c) 2026 Ka Moamoa
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, version 3 of the license.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "MaskClassifier.h"
+#include "BreathFilter.h"
+
+MaskClassifier::Verdict_t MaskClassifier::classify_pressure(const uint16_t* pressure, uint16_t size)
+{
+    BreathFilter bpf;
+    bpf.prime(pressure[1]); // prime filter with initial value
+
+    for (int i = 1; i < size; i++)
+    {
+        // a whole breath, at most 30 breaths/min, with swings both ways
+        if (bpf.step(pressure[i]) && bpf.get_peak() > ON_THRESHOLD && bpf.get_trough() < (-1 * ON_THRESHOLD) && bpf.get_length() > BreathFilter::FREQUENCY * 2)
+        {
+            return ON;
+        }
+    }
+
+    return OFF;
+}
+
+void MaskClassifier::reset()
+{
+    _num_samples = 0;
+    _num_invalid = 0;
+    _mean = 0;
+    _slope = 0;
+    _amplitude = 0;
+    _crosses = 0;
+}
+
+/**
+ * @brief The pre-check only decides the easy cases: warm and oscillating
+ * with breath (ON), or cool and flat (OFF, with PRECHECK_TRUST_OFF).
+ * Anything in between is AMBIGUOUS and left to the barometer.
+ */
+MaskClassifier::Verdict_t MaskClassifier::add_temperature(int16_t tempx100)
+{
+    if (tempx100 < MIN_TEMPX100 || tempx100 > MAX_TEMPX100)
+    {
+        _num_invalid++;
+        return _num_invalid > MAX_INVALID ? AMBIGUOUS : UNDECIDED;
+    }
+
+    if (_num_samples >= PRECHECK_SAMPLES)
+    {
+        return AMBIGUOUS;
+    }
+
+    _samples[_num_samples++] = tempx100 / 100.0;
+    if (_num_samples < MIN_PRECHECK_SAMPLES)
+    {
+        return UNDECIDED;
+    }
+
+    _fit();
+
+    bool warm = _mean >= SKIN_TEMP_THRESHOLD || _slope >= WARMING_THRESHOLD;
+    bool breathing = _amplitude >= BREATH_AMPLITUDE_THRESHOLD && _crosses >= MIN_BREATH_CROSSES;
+
+    if (warm && breathing)
+    {
+        return ON;
+    }
+
+#ifdef PRECHECK_TRUST_OFF
+    if (_num_samples < PRECHECK_SAMPLES)
+    {
+        return UNDECIDED;
+    }
+
+    if (_mean < AMBIENT_TEMP_THRESHOLD && _slope < WARMING_THRESHOLD && _amplitude < FLAT_AMPLITUDE_THRESHOLD)
+    {
+        return OFF;
+    }
+
+    return AMBIGUOUS;
+#else
+    // only ON is trusted, and a mask that isn't warm won't get there
+    if (!warm || _num_samples >= PRECHECK_SAMPLES)
+    {
+        return AMBIGUOUS;
+    }
+
+    return UNDECIDED;
+#endif // PRECHECK_TRUST_OFF
+}
+
+void MaskClassifier::_fit()
+{
+    // least-squares trend, so warming/cooling isn't mistaken for breathing
+    float sum_x = 0, sum_y = 0, sum_xx = 0, sum_xy = 0;
+    for (int i = 0; i < _num_samples; i++)
+    {
+        float t = (float)i / PRECHECK_FREQUENCY;
+        sum_x += t;
+        sum_y += _samples[i];
+        sum_xx += t * t;
+        sum_xy += t * _samples[i];
+    }
+
+    _mean = sum_y / _num_samples;
+    _slope = (_num_samples * sum_xy - sum_x * sum_y) / (_num_samples * sum_xx - sum_x * sum_x);
+    float intercept = (sum_y - _slope * sum_x) / _num_samples;
+
+    float residual_max = -100;
+    float residual_min = 100;
+    float last_residual = 0;
+    _crosses = 0;
+    for (int i = 0; i < _num_samples; i++)
+    {
+        float residual = _samples[i] - (intercept + _slope * (float)i / PRECHECK_FREQUENCY);
+
+        if (residual > residual_max) residual_max = residual;
+        if (residual < residual_min) residual_min = residual;
+
+        if (last_residual > 0 && residual <= 0) _crosses++;
+        last_residual = residual;
+    }
+
+    _amplitude = residual_max - residual_min;
+}
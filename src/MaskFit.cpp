@@ -0,0 +1,122 @@
+/**
+ * @file MaskFit.cpp
+ * @author agent agent@local
+ * @brief Mask fit estimation from the breath pressure waveform
+ * @version 0.1
+ * @date 2026-10-19
+ * 
+ * @copyright Copyright (c) 2026 Ka Moamoa
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, version 3 of the license.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "MaskFit.hpp"
+#include "Utilites.h"
+#include "BreathFilter.h"
+
+using namespace std::chrono;
+
+MaskFit::MaskFit()
+{
+    _logger = Logger::get_instance();
+}
+
+MaskFit::~MaskFit()
+{
+}
+
+/**
+ * @brief Collect one fit window from the session's barometer stream and
+ * score the fit. The same window decides mask on/off, so no separate
+ * check is needed before this task.
+ * 
+ * @return fit score 0-100, or -1 if it couldn't be measured
+ */
+int8_t MaskFit::measure(SensorSession* session)
+{
+    _mask_state = MaskStateDetection::PENDING;
+
+    if (!session->is_open())
+    {
+        _mask_state = MaskStateDetection::ERROR;
+        return -1;
+    }
+
+    // a detection window is too short to hold two whole breaths at normal rates
+    session->check(false, FIT_WINDOW * SAMPLING_FREQUENCY);
+
+    LowPowerTimer timer;
+    timer.start();
+    while (session->get_mask_state() == MaskStateDetection::PENDING && timer.read() < FIT_WINDOW + 5) // timeout so we don't get stuck
+    {
+        session->wait(2s);
+    }
+
+    int8_t score = -1;
+
+    _mask_state = session->get_mask_state();
+    if (_mask_state == MaskStateDetection::ON)
+    {
+        score = _score(session->get_window(), session->get_window_size());
+    }
+    else if (_mask_state == MaskStateDetection::PENDING)
+    {
+        _mask_state = MaskStateDetection::ERROR; // barometer stopped responding
+    }
+
+    return score;
+}
+
+int8_t MaskFit::_score(uint16_t* pressure_buffer, uint16_t size)
+{
+    BreathFilter bpf;
+    bpf.prime(pressure_buffer[1]); // prime filter with initial value
+
+    BoundedVector<double, MAX_BREATHS> amplitudes;
+    BoundedVector<double, MAX_BREATHS> symmetries;
+    for (int i = 1; i < size; i++)
+    {
+        if (!bpf.step(pressure_buffer[i]))
+        {
+            continue;
+        }
+
+        float amplitude = bpf.get_peak() - bpf.get_trough();
+        if (amplitude > MIN_AMPLITUDE && amplitudes.size() < MAX_BREATHS)
+        {
+            // exhalation is the positive lobe, inhalation the negative one
+            float exhale = bpf.get_peak();
+            float inhale = -bpf.get_trough();
+            float symmetry = std::min(exhale, inhale) / std::max(exhale, inhale);
+
+            amplitudes.push_back(amplitude);
+            symmetries.push_back(symmetry);
+
+            LOG(_logger, TRACE_DEBUG, "breath: amplitude = %0.1f Pa, symmetry = %0.2f", amplitude, symmetry);
+        }
+    }
+
+    if (amplitudes.size() < MIN_BREATHS)
+    {
+        _logger->log(TRACE_WARNING, "Not enough breaths to estimate mask fit: %u breaths", amplitudes.size());
+        return -1;
+    }
+
+    float amplitude_score = std::min(Utilities::mean(amplitudes) / REFERENCE_AMPLITUDE, 1.0);
+    float symmetry_score = Utilities::mean(symmetries);
+    int8_t score = Utilities::round(100.0 * amplitude_score * symmetry_score);
+
+    _logger->log(TRACE_INFO, "Mask fit = %i (amplitude %0.2f, symmetry %0.2f)", score, amplitude_score, symmetry_score);
+
+    return score;
+}
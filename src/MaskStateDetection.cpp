@@ -22,104 +22,230 @@
 
 #include "MaskStateDetection.hpp"
 #include "BusControl.h"
-#include "../iir-filter-kit/BiQuad.h"
 
-MaskStateDetection::MaskStateDetection(Barometer* barometer)
+using namespace std::chrono;
+
+MaskStateDetection::MaskStateDetection(Barometer* barometer, Si7051* thermometer)
 {
     _logger = Logger::get_instance();
     _barometer = barometer;
+    _thermometer = thermometer;
 }
 
 MaskStateDetection::~MaskStateDetection()
 {
 }
 
+/**
+ * @brief Blocking. The thermometer pre-check starts first and the
+ * barometer's detection window joins after PRECHECK_DELAY, once the
+ * pre-check has enough samples to know whether the mask is warm. An
+ * undecided pre-check costs PRECHECK_DELAY over the barometer alone,
+ * and a quick ON from it cuts the barometer window short.
+ * 
+ * tools/host/mask_check_bench compares this with the other schedules.
+ */
 MaskStateDetection::MASK_STATE_t MaskStateDetection::is_on()
 {
-    MASK_STATE_t mask_state = OFF;
-
     _logger->log(TRACE_INFO, "%s", "CHECKING MASK ON");
 
     BusControl* _bus_control = BusControl::get_instance();
-    _bus_control->spi_power(true);
 
+    if (_thermometer != nullptr)
+    {
+        start_precheck();
+    }
+    bool barometer = false;
+
+    MASK_STATE_t mask_state = PENDING;
     LowPowerTimer timer;
-    
-    ThisThread::sleep_for(10ms);
+    timer.start();
+    while(mask_state == PENDING && timer.read() < PRECHECK_DELAY + DETECTION_WINDOW + 5) // timeout so we don't get stuck
+    {
+        if (!barometer && (!_precheck_running || timer.read() >= PRECHECK_DELAY))
+        {
+            _bus_control->power_up(BusControl::BAROMETER, callback(_barometer, &Barometer::is_ready));
+            barometer = true;
+
+            if (!start())
+            {
+                mask_state = ERROR;
+                break;
+            }
+        }
+
+        if (!barometer)
+        {
+            mask_state = update_precheck();
+            if (mask_state == PENDING)
+            {
+                ThisThread::sleep_for(milliseconds(1000 / MaskClassifier::PRECHECK_FREQUENCY / 4));
+            }
+            continue;
+        }
+
+        // sleep until the barometer interrupts with the next batch, or it's time to check for a thermometer sample
+        _barometer->wait_for_data(_precheck_running ? milliseconds(1000 / MaskClassifier::PRECHECK_FREQUENCY / 4) : milliseconds(2 * 1000 * BATCH_SIZE / SAMPLING_FREQUENCY));
 
-    /**
-     * @brief Init 2nd order bandpass (1/15-1 Hz) Butterworth filter
-     * 
-     * Documentation can be found in BiQuad.h. BiQuads were 
-     * generated with filter-designer.py assuming 10 Hz sampling frequency.
-     */
+        mask_state = poll(false);
+    }
 
-    BiQuadChain bpf;
-	BiQuad bq1( 0.06004382,  0.12008764,  0.06004382,  1.,         -1.21246615,  0.46367415);
- 	BiQuad bq2( 1.,         -2.,          1.,          1.,         -1.94162756,  0.94354483);
+    stop();
 
-	bpf.add( &bq1 ).add( &bq2 );
+    if (barometer)
+    {
+        _barometer->stop();
+        _bus_control->release(BusControl::BAROMETER);
+    }
 
-    if (!_barometer->initialize() || !_barometer->set_fifo_full_interrupt(true) || !_barometer->set_frequency(SAMPLING_FREQUENCY))
+    if (mask_state == PENDING)
+    {
+        mask_state = ERROR; // shouldn't end up here, unless barometer stops responding
+    }
+
+    return mask_state;
+}
+
+/**
+ * @brief Start the thermometer pre-check, for a detection window that
+ * isn't driven by is_on() (see SensorSession). Feed it with
+ * update_precheck(); it stops itself once it decides.
+ */
+void MaskStateDetection::start_precheck()
+{
+    if (_thermometer == nullptr || _precheck_running)
+    {
+        return;
+    }
+
+    BusControl::get_instance()->power_up(BusControl::THERMOMETER, callback(_thermometer, &Si7051::isReady));
+
+    _thermometer->setFrequency(MaskClassifier::PRECHECK_FREQUENCY);
+    _thermometer->initialize();
+    _thermometer->clearBuffer();
+    _classifier.reset();
+    _precheck_running = true;
+}
+
+void MaskStateDetection::_stop_precheck()
+{
+    if (!_precheck_running)
+    {
+        return;
+    }
+
+    _precheck_running = false;
+    _thermometer->stop();
+    _thermometer->clearBuffer();
+    BusControl::get_instance()->release(BusControl::THERMOMETER); // BusControl leaves the I2C rails up, see I2C_KEEP_ON
+}
+
+/**
+ * @brief Takes the thermometer sample if one is due. The pre-check
+ * stops itself once it decides; an ambiguous result leaves the
+ * decision to the barometer.
+ * 
+ * @return ON or OFF once the pre-check decides, PENDING otherwise
+ */
+MaskStateDetection::MASK_STATE_t MaskStateDetection::update_precheck()
+{
+    if (!_precheck_running || !_thermometer->update())
+    {
+        return PENDING;
+    }
+
+    int16_t sample = _thermometer->getBuffer()[_thermometer->getBufferSize() - 1];
+    _thermometer->clearBuffer();
+
+    MaskClassifier::Verdict_t verdict = _classifier.add_temperature(sample);
+    if (verdict == MaskClassifier::UNDECIDED)
+    {
+        return PENDING;
+    }
+
+    _logger->log(TRACE_DEBUG, "temp pre-check after %u samples: mean = %0.2f, slope = %0.3f, amplitude = %0.2f, crosses = %u, invalid = %u",
+        _classifier.get_num_samples(), _classifier.get_mean(), _classifier.get_slope(), _classifier.get_amplitude(), _classifier.get_crosses(), _classifier.get_num_invalid());
+
+    _stop_precheck();
+
+    switch (verdict)
+    {
+        case MaskClassifier::ON:
+            return ON;
+        case MaskClassifier::OFF:
+            return OFF;
+        default:
+            _logger->log(TRACE_DEBUG, "%s", "thermometer pre-check ambiguous, leaving it to the barometer");
+            return PENDING;
+    }
+}
+
+/**
+ * @brief Configure the (already powered) barometer for a detection
+ * window. Use poll() to collect the window and get the result.
+ */
+bool MaskStateDetection::start()
+{
+    if (!_barometer->initialize() || !_barometer->set_fifo_watermark_interrupt(BATCH_SIZE) || !_barometer->set_frequency(SAMPLING_FREQUENCY))
     {
         _logger->log(TRACE_WARNING, "%s", "barometer failed to initialize");
-        return ERROR;
+        return false;
     }
 
     _barometer->set_max_buffer_size(int(DETECTION_WINDOW * _barometer->get_frequency()));
 
-    timer.start();
-    while(timer.read() < DETECTION_WINDOW + 5) // timeout so we don't get stuck
-    {
-        uint32_t sleep_time = std::min((int)(32.0 / (float)_barometer->get_frequency() * 1000.0 + 10.0), (int)((DETECTION_WINDOW * 1000.0) - timer.read_ms() + 10));
-        _logger->log(TRACE_DEBUG, "sleep time = %lu", sleep_time);
-        ThisThread::sleep_for(sleep_time);
+    return true;
+}
+
+/**
+ * @brief Stops the thermometer pre-check if it's still running. The
+ * barometer is left to its owner.
+ */
+void MaskStateDetection::stop()
+{
+    _stop_precheck();
+}
 
-        _barometer->update(true);
+/**
+ * @brief Non-blocking. Reads any batch the barometer has ready and,
+ * once a full detection window has been collected, returns ON or OFF,
+ * unless a running pre-check decided first. Returns PENDING until then.
+ */
+MaskStateDetection::MASK_STATE_t MaskStateDetection::poll(bool read)
+{
+    MASK_STATE_t mask_state = update_precheck();
+    if (mask_state != PENDING)
+    {
+        return mask_state;
+    }
 
-        if(_barometer->get_buffer_full())
-        {
-            uint16_t* pressure_buffer = _barometer->get_pressure_array();
+    if (read)
+    {
+        _barometer->update();
+    }
 
-            for (int i = 0; i < SAMPLING_FREQUENCY * 200; i++)
-            {
-                bpf.step(pressure_buffer[1]); // prime filter with initial value
-            }
+    if (!_barometer->get_buffer_full())
+    {
+        return PENDING;
+    }
 
-            float peak_max = 0;
-            float trough_min = 4294967295;
-            uint32_t last_zc = 0;
-            float last_filtered_pressure = -1;
-            for (int i = 1; i < _barometer->get_pressure_buffer_size(); i++)
-            {
-                float filtered_pressure = bpf.step(pressure_buffer[i]);
-
-                if (filtered_pressure < trough_min) trough_min = filtered_pressure;
-                else if (filtered_pressure > peak_max) peak_max = filtered_pressure;
-
-                if (filtered_pressure < 0 && last_filtered_pressure > 0)
-                {
-                    if (peak_max > ON_THRESHOLD && trough_min < (-1 * ON_THRESHOLD) && last_zc != 0 && i - last_zc > SAMPLING_FREQUENCY * 2)
-                    {
-                        _logger->log(TRACE_DEBUG, "breath detected! mask on. peak max = %0.2f, peak min = %0.2f\n", peak_max, trough_min);
-                        mask_state = ON;
-                    }
-                    else
-                    {
-                        _logger->log(TRACE_DEBUG, "breath NOT detected! mask on. peak max = %0.2f, peak min = %0.2f\n", peak_max, trough_min);
-                    }
-                    last_zc = i;
-                }
-                last_filtered_pressure = filtered_pressure;
-            }
+    _stop_precheck(); // the barometer decides first
 
-            _barometer->clear_buffers();
+    mask_state = detect(_barometer->get_pressure_array(), _barometer->get_pressure_buffer_size());
+    _barometer->clear_buffers();
 
-            _bus_control->spi_power(false);
+    return mask_state;
+}
 
-            return mask_state;
-        }
+MaskStateDetection::MASK_STATE_t MaskStateDetection::detect(uint16_t* pressure_buffer, uint16_t size)
+{
+    if (size < 2)
+    {
+        return ERROR;
     }
 
-    return ERROR; // shouldn't end up here, unless barometer stops responding
+    MASK_STATE_t mask_state = MaskClassifier::classify_pressure(pressure_buffer, size) == MaskClassifier::ON ? ON : OFF;
+    LOG(_logger, TRACE_DEBUG, "barometer check over %u samples: mask %s", size, mask_state == ON ? "on" : "off");
+
+    return mask_state;
 }
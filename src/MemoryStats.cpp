@@ -0,0 +1,102 @@
+/**
+ * @file MemoryStats.cpp
+ * @author agent agent@local
+ * @brief Heap and thread stack high-water marks from the mbed stats hooks
+ * @version 0.1
+ * @date 2026-10-19
+ * 
+ * @copyright Copyright (c) 2026 Ka Moamoa
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, version 3 of the license.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "MemoryStats.h"
+
+MemoryStats* MemoryStats::_instance = nullptr;
+Mutex MemoryStats::_mutex;
+
+MemoryStats::MemoryStats()
+{
+    _logger = Logger::get_instance();
+}
+
+MemoryStats::~MemoryStats()
+{
+}
+
+MemoryStats* MemoryStats::get_instance()
+{
+    _mutex.lock();
+
+    if (_instance == nullptr)
+    {
+        _instance = new MemoryStats();
+    }
+
+    _mutex.unlock();
+
+    return _instance;
+}
+
+void MemoryStats::_update()
+{
+    mbed_stats_heap_get(&_heap);
+}
+
+void MemoryStats::mark_startup()
+{
+    _update();
+    _last_total_size = _heap.total_size;
+
+    _logger->log(TRACE_INFO, "Heap after startup: %lu B in %lu blocks, %lu B reserved",
+        _heap.current_size, _heap.alloc_cnt, _heap.reserved_size);
+}
+
+bool MemoryStats::log()
+{
+    bool ok = true;
+
+    _update();
+
+    _logger->log(TRACE_INFO, "Heap: %lu B now, %lu B max, %lu B reserved, %lu blocks, %lu failed",
+        _heap.current_size, _heap.max_size, _heap.reserved_size, _heap.alloc_cnt, _heap.alloc_fail_cnt);
+
+    if (_heap.alloc_fail_cnt > 0)
+    {
+        _logger->log(TRACE_WARNING, "%lu heap allocations have failed", _heap.alloc_fail_cnt);
+        ok = false;
+    }
+
+#if FACEBIT_STATIC_MEMORY
+    if (_heap.total_size != _last_total_size)
+    {
+        _logger->log(TRACE_WARNING, "%lu B allocated from the heap since the last check", _heap.total_size - _last_total_size);
+        ok = false;
+    }
+#endif
+
+    _last_total_size = _heap.total_size;
+
+    mbed_stats_thread_t threads[MAX_THREADS];
+    size_t count = mbed_stats_thread_get_each(threads, MAX_THREADS);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        // stack_space is the least free stack seen, from the watermark the kernel fills in at start
+        uint32_t used = threads[i].stack_size - threads[i].stack_space;
+        _logger->log(TRACE_INFO, "Thread %s: %lu/%lu B stack used",
+            threads[i].name ? threads[i].name : "?", used, threads[i].stack_size);
+    }
+
+    return ok;
+}
@@ -0,0 +1,188 @@
+/**
+ * @file RecordStream.cpp
+ * @author agent agent@local
+ * @brief Delta/varint packed stream of physiological readings
+ * @version 0.1
+ * @date 2026-10-19
+ * 
+ * @copyright Copyright (c) 2026 Ka Moamoa
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, version 3 of the license.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "RecordStream.h"
+#include <string.h>
+
+RecordStream::RecordStream()
+{
+}
+
+RecordStream::~RecordStream()
+{
+}
+
+bool RecordStream::append(uint8_t type, uint64_t timestamp, uint16_t value)
+{
+    if (type >= (1 << TYPE_BITS))
+    {
+        _dropped++;
+        return false;
+    }
+
+    bool evicted = false;
+    while (_num_bytes + MAX_RECORD_SIZE > CAPACITY)
+    {
+        // whole records from the head, so the next one's delta stays valid
+        uint64_t reference_ts = _base_ts;
+        Record_t oldest;
+        uint16_t size = read(0, reference_ts, oldest);
+        if (size == 0 || !consume(size))
+        {
+            _dropped += _num_records; // can't walk it, start again
+            clear();
+        }
+        else
+        {
+            _dropped++;
+        }
+
+        evicted = true;
+    }
+
+    if (_num_records == 0)
+    {
+        _base_ts = timestamp;
+        _last_ts = timestamp;
+    }
+
+    // readings are appended in order, but don't let a late one wrap the delta
+    uint64_t delta = timestamp > _last_ts ? timestamp - _last_ts : 0;
+    if (delta > (UINT32_MAX >> TYPE_BITS))
+    {
+        delta = UINT32_MAX >> TYPE_BITS;
+    }
+
+    _num_bytes += write_varint(((uint32_t)delta << TYPE_BITS) | type, &_bytes[_num_bytes]);
+    _num_bytes += write_varint(value, &_bytes[_num_bytes]);
+    _num_records++;
+    _last_ts += delta;
+
+    return !evicted;
+}
+
+void RecordStream::clear()
+{
+    _num_bytes = 0;
+    _num_records = 0;
+    _base_ts = 0;
+    _last_ts = 0;
+}
+
+bool RecordStream::consume(uint16_t num_bytes)
+{
+    uint64_t reference_ts = _base_ts;
+    uint16_t offset = 0;
+    uint16_t num_records = 0;
+
+    while (offset < num_bytes)
+    {
+        Record_t record;
+        uint16_t size = read(offset, reference_ts, record);
+        if (size == 0)
+        {
+            return false;
+        }
+
+        offset += size;
+        num_records++;
+    }
+
+    if (offset != num_bytes)
+    {
+        return false;
+    }
+
+    if (num_records == _num_records)
+    {
+        clear();
+        return true;
+    }
+
+    memmove(_bytes, &_bytes[num_bytes], _num_bytes - num_bytes);
+    _num_bytes -= num_bytes;
+    _num_records -= num_records;
+    _base_ts = reference_ts;
+
+    return true;
+}
+
+uint16_t RecordStream::read(uint16_t offset, uint64_t &reference_ts, Record_t &record)
+{
+    if (offset >= _num_bytes)
+    {
+        return 0;
+    }
+
+    uint32_t tagged_delta = 0;
+    uint32_t value = 0;
+
+    uint8_t tag_size = read_varint(&_bytes[offset], _num_bytes - offset, tagged_delta);
+    if (tag_size == 0)
+    {
+        return 0;
+    }
+
+    uint8_t value_size = read_varint(&_bytes[offset + tag_size], _num_bytes - offset - tag_size, value);
+    if (value_size == 0)
+    {
+        return 0;
+    }
+
+    reference_ts += tagged_delta >> TYPE_BITS;
+
+    record.type = tagged_delta & ((1 << TYPE_BITS) - 1);
+    record.timestamp = reference_ts;
+    record.value = value;
+
+    return tag_size + value_size;
+}
+
+uint8_t RecordStream::write_varint(uint32_t value, uint8_t* out)
+{
+    uint8_t size = 0;
+
+    while (value >= 0x80)
+    {
+        out[size++] = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    out[size++] = value;
+
+    return size;
+}
+
+uint8_t RecordStream::read_varint(const uint8_t* in, uint16_t length, uint32_t &value)
+{
+    value = 0;
+
+    for (uint8_t i = 0; i < length && i < 5; i++)
+    {
+        value |= (uint32_t)(in[i] & 0x7F) << (7 * i);
+        if ((in[i] & 0x80) == 0)
+        {
+            return i + 1;
+        }
+    }
+
+    return 0;
+}
@@ -34,6 +34,8 @@ _barometer(barometer)
 {
     _bus_control = BusControl::get_instance();
     _logger = Logger::get_instance();
+    _cap_calc = CapCalc::get_instance();
+    _checkpoint = Checkpoint::get_instance();
 }
 
 RespiratoryRate::~RespiratoryRate()
@@ -47,57 +49,65 @@ RespiratoryRate::RR_t RespiratoryRate::get_buffer_element()
     return tmp;
 }
 
-float RespiratoryRate::respiratory_rate(const uint8_t num_seconds, RespSource_t source)
+float RespiratoryRate::respiratory_rate(const uint8_t num_seconds, RespSource_t source, SensorSession* session)
 {
-	if (source == BAROMETER)
+	if (source == BAROMETER && session != nullptr)
 	{
-		// turn on SPI bus
-		_bus_control->spi_power(true);
+		// the session's stream already has the barometer, at its own rate
+		_logger->log(TRACE_WARNING, "%s", "barometer RR can't run alongside a sensor session");
+		return ERROR;
+	}
 
-		// give time for the chip to turn on
-		ThisThread::sleep_for(10ms);
+	if (source == BAROMETER)
+	{
+		// turn on the barometer
+		_bus_control->power_up(BusControl::BAROMETER, callback(&_barometer, &Barometer::is_ready));
 
 		if (!_barometer.initialize() || !_barometer.set_fifo_full_interrupt(true) || !_barometer.set_frequency(FREQUENCY))
 		{
 			_logger->log(TRACE_WARNING, "%s", "barometer failed to initialize");
+			_barometer.stop();
+			_bus_control->release(BusControl::BAROMETER);
 			return ERROR;
 		}
 	}
 	else if (source == THERMOMETER)
 	{
-		// turn on I2C bus
-		_bus_control->i2c_power(true);
-
-		// give time for the chip to turn on
-		ThisThread::sleep_for(10ms);
+		// turn on the thermometer
+		_bus_control->power_up(BusControl::THERMOMETER, callback(&_temp, &Si7051::isReady));
 
 		_temp.initialize();
 		_temp.setFrequency(FREQUENCY); // hz
 	}
 
-    /**
-     * @brief Init 2nd order bandpass (1/15-1 Hz) Butterworth filter
-     * 
-     * Documentation can be found in BiQuad.h. BiQuads were 
-     * generated with filter-designer.py assuming 10 Hz sampling frequency.
-     */
-
-    BiQuadChain bpf;
-	BiQuad bq1( 0.06004382,  0.12008764,  0.06004382,  1.,         -1.21246615,  0.46367415);
- 	BiQuad bq2( 1.,         -2.,          1.,          1.,         -1.94162756,  0.94354483);
-
-	bpf.add( &bq1 ).add( &bq2 );
+	BreathFilter bpf;
 
     // start timer
     LowPowerTimer timer;
     timer.start();
 
     // initialize variables
-    double last_sample = -1.0;
-    uint16_t sample_index = 0;
-    vector<uint16_t> zc_indices;
-	bool zc_initialized;
-	bool initialized = false;
+    BoundedVector<uint32_t, MAX_CROSSES> zc_indices; // indices into the source's sample clock
+	bool aborted = false;
+
+	SampleClock& clock = source == BAROMETER ? _barometer.get_sample_clock() : _temp.getSampleClock();
+
+	// breath periods from before a brownout, and how far the capture had got
+	BoundedVector<double, MAX_CROSSES> resumed_periods;
+	double elapsed_before = 0;
+
+	_suspended = false;
+
+	static State_t state; // too big for the main thread's stack; only one capture runs at a time
+	if (_checkpoint->get_pending() == Checkpoint::TASK_RESPIRATORY_RATE && _checkpoint->load(Checkpoint::TASK_RESPIRATORY_RATE, &state, sizeof(state)) && state.source == source)
+	{
+		bpf.restore(state.filter);
+
+		elapsed_before = state.elapsed_ms / 1000.0;
+		resumed_periods.assign(state.periods, state.periods + state.num_periods);
+
+		_logger->log(TRACE_INFO, "Resuming RR at %0.1fs with %u breaths", elapsed_before, resumed_periods.size());
+	}
 
 	#ifdef RESP_RATE_LOGGING
 	{
@@ -105,7 +115,7 @@ float RespiratoryRate::respiratory_rate(const uint8_t num_seconds, RespSource_t
 	}
 	#endif // RESP_RATE_LOGGING
 
-    while (timer.read() <= num_seconds)
+    while (timer.read() + elapsed_before <= num_seconds)
     {
 		uint16_t buffer_size = 0;
 
@@ -122,101 +132,125 @@ float RespiratoryRate::respiratory_rate(const uint8_t num_seconds, RespSource_t
 
         if (buffer_size >= (FREQUENCY * BUFFER))
         {
-			uint16_t* samples = NULL;
+			uint16_t* pressure_samples = NULL;
+			int16_t* temp_samples = NULL;
+			uint32_t start_index = 0;
 			if (source == BAROMETER)
 			{
-				samples = _barometer.get_pressure_array();
+				pressure_samples = _barometer.get_pressure_array();
+				start_index = _barometer.get_buffer_start_index();
 				_barometer.clear_buffers();
 			}
 			else if (source == THERMOMETER)
 			{
-            	samples = _temp.getBuffer();
+            	temp_samples = _temp.getBuffer();
+				start_index = _temp.getBufferStartIndex();
 				_temp.clearBuffer();
 			}
+
             
             for (int i = 0; i < buffer_size; i++)
             {
 				double sample = 0;
 				if (source == BAROMETER)
 				{
-					// sample = samples[i];
-					sample = _barometer.convert_to_hpa(samples[i]);
+					// sample = pressure_samples[i];
+					sample = _barometer.convert_to_hpa(pressure_samples[i]);
 				}
 				else if (source == THERMOMETER)
 				{
-					sample = (float)samples[i] / 100.0;
+					sample = (float)temp_samples[i] / 100.0;
 				}
 
-				if (!initialized)
+				if (!bpf.is_primed())
 				{
-					for (int i = 0; i < FREQUENCY * 200; i++)
-					{
-						bpf.step(sample); // prime filter with initial value
-					}
-
-					initialized = true;
+					bpf.prime(sample); // prime filter with initial value
 				}
 
-                // pass sample through bandpass filter
-                double filtered_sample = bpf.step(sample);
-
-                // look for zero-crosses
-				bool d_zc = false;
-				bool a_zc = false;
-                if (last_sample > 0 && filtered_sample < 0)
-                {
-					if (zc_initialized)
-					{
-                    	zc_indices.push_back(sample_index);
-						_logger->log(TRACE_DEBUG, "breath detected");
-					}
-					else
+                // pass sample through bandpass filter and look for zero-crosses
+				if (bpf.step(sample))
+				{
+					if (zc_indices.size() < MAX_CROSSES) // more would be over 60 breaths/min anyway
 					{
-						zc_initialized = true;
+						zc_indices.push_back(start_index + i);
 					}
-					d_zc = true;
-                }
-				else if (last_sample < 0 && filtered_sample > 0)
-				{
-					a_zc = true;
+					LOG(_logger, TRACE_DEBUG, "breath detected");
 				}
 
 				#ifdef RESP_RATE_LOGGING
 				{
-					_logger->log(TRACE_INFO, "%f, %f, %f, %i, %i", timer.read(), sample, filtered_sample, d_zc, a_zc);
+					_logger->log(TRACE_INFO, "%f, %f, %f, %i, %i", timer.read(), sample, bpf.get_value(), bpf.is_descending_cross(), bpf.is_ascending_cross());
 					wait_us(750);
 				}
 				#endif // RESP_RATE_LOGGING
-
-				last_sample = filtered_sample;
-                sample_index++;
             }
 
-			_barometer.clear_buffers();
+			if (source == BAROMETER)
+			{
+				_barometer.clear_buffers();
+			}
         }
 
+		if (session != nullptr && !session->update())
+		{
+			_logger->log(TRACE_INFO, "%s", "Mask off, stopping RR");
+			aborted = true;
+			break;
+		}
+
+		if (_cap_calc->is_energy_low())
+		{
+			bpf.save(state.filter);
+
+			BoundedVector<double, 2 * MAX_CROSSES> periods = resumed_periods;
+			_append_periods(periods, zc_indices, clock);
+
+			// keep the newest breaths if there are more than fit
+			state.num_periods = periods.size() < MAX_CROSSES ? periods.size() : MAX_CROSSES;
+			std::copy(periods.end() - state.num_periods, periods.end(), state.periods);
+
+			state.elapsed_ms = (elapsed_before + timer.read()) * 1000;
+			state.source = source;
+
+			_suspended = _checkpoint->save(Checkpoint::TASK_RESPIRATORY_RATE, &state, sizeof(state));
+			_logger->log(TRACE_INFO, "Energy low, %s RR at %0.1fs", _suspended ? "checkpointed" : "abandoned", state.elapsed_ms / 1000.0);
+
+			aborted = true; // the result comes from the resumed capture
+			break;
+		}
+
 		ThisThread::sleep_for(10ms);
     }
 
 	if (source == BAROMETER)
 	{
-		// turn off SPI bus
-		_bus_control->spi_power(false);
+		// turn off the barometer
+		_barometer.stop();
+		_bus_control->release(BusControl::BAROMETER);
 	}
 	else if (source == THERMOMETER)
 	{
 		// turn off I2C bus
 		_temp.stop();
-		// _bus_control->i2c_power(false); // commented out because turning off the bus actually results in _higher_ current consumption than leaving it on
+		_bus_control->release(BusControl::THERMOMETER); // BusControl leaves the I2C rails up, since turning them off actually results in _higher_ current consumption
 	}
 
-	// now calculate resp rate from the zero-crosses we've detected
-	vector<double> zc_ts(zc_indices.begin(), zc_indices.end()); // copy indices to new vector
+	if (!_suspended)
+	{
+		_checkpoint->discard(Checkpoint::TASK_RESPIRATORY_RATE); // finished (or abandoned), don't resume it again
+	}
 
-	Utilities::multiply(zc_ts, 1.0 / (float)FREQUENCY); // convert indices to timestamps
+	if (aborted)
+	{
+		return ERROR;
+	}
 
-	std::adjacent_difference(zc_ts.begin(), zc_ts.end(), zc_ts.begin());
-	zc_ts.erase(zc_ts.begin());
+	// now calculate resp rate from the zero-crosses we've detected
+	_logger->log(TRACE_DEBUG, "fitted sample frequency = %0.3f Hz (nominal %u Hz)", clock.get_frequency(), FREQUENCY);
+
+	// breath periods, with any from before a brownout
+	BoundedVector<double, 2 * MAX_CROSSES> zc_ts = resumed_periods;
+	_append_periods(zc_ts, zc_indices, clock);
 
 	Utilities::reciprocal(zc_ts); // get element-wise frequency
 	Utilities::multiply(zc_ts, 60.0); // get element-wise respiratory rate
@@ -225,10 +259,10 @@ float RespiratoryRate::respiratory_rate(const uint8_t num_seconds, RespSource_t
 
 	for (int i = 0; i < zc_ts.size(); i++)
 	{
-		_logger->log(TRACE_TRACE, "rr[%i] = %0.1f", zc_ts[i]);
+		LOG(_logger, TRACE_TRACE, "rr[%i] = %0.1f", i, zc_ts[i]);
 		if (zc_ts[i] < 4 || zc_ts[i] > 60) // these resp rates are out-of bounds for our filtering (and physiologically unlikely)
 		{
-			_logger->log(TRACE_DEBUG, "Deleting resp rate element %i: %0.1f breaths/min", zc_ts[i]);
+			LOG(_logger, TRACE_DEBUG, "Deleting resp rate element %i: %0.1f breaths/min", i, zc_ts[i]);
 			zc_ts.erase(zc_ts.begin() + i); 
 		}
 	}
@@ -252,3 +286,11 @@ float RespiratoryRate::respiratory_rate(const uint8_t num_seconds, RespSource_t
 	
 	return resp_rate;
 }
+
+void RespiratoryRate::_append_periods(BoundedVector<double, 2 * MAX_CROSSES> &periods, BoundedVector<uint32_t, MAX_CROSSES> &zc_indices, SampleClock &clock)
+{
+	for (int i = 1; i < zc_indices.size(); i++)
+	{
+		periods.push_back((clock.get_sample_time_ms(zc_indices[i]) - clock.get_sample_time_ms(zc_indices[i - 1])) / 1000.0);
+	}
+}
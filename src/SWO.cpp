@@ -36,7 +36,7 @@
 /** Create and SWO interface for debugging that supports Stream
   * @brief Currently works on nucleo ST-LINK using ST-Link Utility and other devices that support SWD/SWO using Segger SWO viewer
   */
-SWO_Channel::SWO_Channel (const char *name) : Stream(name) {
+SWO_Channel::SWO_Channel (const char *name) : Stream(name), _buffered(0) {
   //May want to add initialisation stuff here  
 }
  
@@ -48,12 +48,65 @@ SWO_Channel::SWO_Channel (const char *name) : Stream(name) {
   */
 int SWO_Channel::_putc(int value) {
   
-  //Use CMSIS_core_DebugFunctions. See core_cm3.h
-  ITM_SendChar(value);
+  char c = value;
+  write(&c, 1);
   
   return value;
 }
 
+/** Write a buffer through the line buffer, which goes out with word-wide
+  * ITM writes on newline or when full
+  *
+  * @param data bytes to be displayed
+  * @param length number of bytes
+  * @return length
+  */
+size_t SWO_Channel::write(const char *data, size_t length) {
+  lock();
+
+  for (size_t i = 0; i < length; i++) {
+    _buffer[_buffered++] = data[i];
+    if (data[i] == '\n' || _buffered == BUFFER_SIZE) {
+      _flush();
+    }
+  }
+
+  unlock();
+  return length;
+}
+
+/** Write a buffer (Stream implementation), so printf also goes through
+  * the line buffer
+  */
+ssize_t SWO_Channel::write(const void *buffer, size_t length) {
+  return write(static_cast<const char *>(buffer), length);
+}
+
+/** Send a partial line (FileHandle implementation)
+  * @return 0
+  */
+int SWO_Channel::sync() {
+  lock();
+  _flush();
+  unlock();
+  return 0;
+}
+
+void SWO_Channel::_flush() {
+  SWO_PrintBuffer(_buffer, _buffered);
+  _buffered = 0;
+}
+
+/** Serialise writers, as Serial does, so concurrent printf()s keep whole lines
+  */
+void SWO_Channel::lock() {
+  _mutex.lock();
+}
+
+void SWO_Channel::unlock() {
+  _mutex.unlock();
+}
+
 /** Get a single character (Stream implementation)
   * @return -1 Not supported
   */
@@ -235,9 +288,52 @@ void SWO_PrintChar(char c) {
  */
 void SWO_PrintString(const char *s) {
 
-  // Print out characters until \0
-  while (*s) {
-    SWO_PrintChar(*s++);
+  SWO_PrintBuffer(s, strlen(s));
+}
+
+/**
+ * SWO_PrintBuffer()
+ *
+ * @brief Print a buffer via SWO. Each stimulus write carries up to 4 bytes,
+ *   so the FIFO-ready poll is paid once per word instead of once per char.
+ *   The tail goes out as a halfword and/or byte write. Viewers reassemble
+ *   the payload little-endian, so the byte order is unchanged.
+ * @param *data The bytes to be printed.
+ * @param length Number of bytes.
+ */
+void SWO_PrintBuffer(const char *data, size_t length) {
+
+  // Same checks as ITM_SendChar: drop output if no debugger has enabled ITM port 0
+  if (((ITM->TCR & ITM_TCR_ITMENA_Msk) == 0) || ((ITM->TER & 1UL) == 0)) {
+    return;
+  }
+
+  size_t i = 0;
+  while (length - i >= 4) {
+    uint32_t word;
+    memcpy(&word, &data[i], sizeof(word));
+    while (ITM->PORT[0U].u32 == 0UL) {
+      __NOP();
+    }
+    ITM->PORT[0U].u32 = word;
+    i += 4;
+  }
+
+  if (length - i >= 2) {
+    uint16_t half;
+    memcpy(&half, &data[i], sizeof(half));
+    while (ITM->PORT[0U].u32 == 0UL) {
+      __NOP();
+    }
+    ITM->PORT[0U].u16 = half;
+    i += 2;
+  }
+
+  if (i < length) {
+    while (ITM->PORT[0U].u32 == 0UL) {
+      __NOP();
+    }
+    ITM->PORT[0U].u8 = (uint8_t)data[i];
   }
 }
 
@@ -0,0 +1,117 @@
+/**
+ * @file SampleClock.cpp
+ * @author agent agent@local
+ * @brief Reconstructs per-sample timestamps for batched sensor data
+ * @version 0.1
+ * @date 2026-10-19
+ * 
+ * @copyright Copyright (c) 2026 Ka Moamoa
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, version 3 of the license.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "SampleClock.h"
+#include <math.h>
+
+SampleClock::SampleClock(float nominal_frequency)
+{
+    set_nominal_frequency(nominal_frequency);
+}
+
+SampleClock::~SampleClock()
+{
+}
+
+void SampleClock::reset()
+{
+    _n = 0;
+    _x0 = 0;
+    _y0 = 0;
+    _sum_x = 0;
+    _sum_y = 0;
+    _sum_xx = 0;
+    _sum_xy = 0;
+}
+
+void SampleClock::set_nominal_frequency(float frequency)
+{
+    if (frequency <= 0) return;
+
+    _nominal_period_ms = 1000.0 / frequency;
+}
+
+/**
+ * @brief Add a (sample index, timestamp) pair, i.e. the time at which
+ * a given sample was known to be produced (a FIFO interrupt or a one-shot
+ * measurement).
+ */
+void SampleClock::add_point(uint32_t sample_index, uint64_t timestamp_ms)
+{
+    if (_n == 0)
+    {
+        _x0 = sample_index;
+        _y0 = timestamp_ms;
+    }
+
+    // work relative to the first point to keep the sums small
+    double x = (double)sample_index - (double)_x0;
+    double y = (double)timestamp_ms - (double)_y0;
+
+    _sum_x += x;
+    _sum_y += y;
+    _sum_xx += x * x;
+    _sum_xy += x * y;
+    _n++;
+}
+
+double SampleClock::get_sample_period_ms()
+{
+    if (_n < 2)
+    {
+        return _nominal_period_ms;
+    }
+
+    double denominator = _n * _sum_xx - _sum_x * _sum_x;
+    if (denominator <= 0)
+    {
+        return _nominal_period_ms;
+    }
+
+    double period = (_n * _sum_xy - _sum_x * _sum_y) / denominator;
+
+    if (fabs(period - _nominal_period_ms) > MAX_DRIFT * _nominal_period_ms)
+    {
+        return _nominal_period_ms;
+    }
+
+    return period;
+}
+
+/**
+ * @brief Time (in ms, on the clock the points were given in) at which
+ * sample_index was produced, according to the current fit.
+ */
+double SampleClock::get_sample_time_ms(uint32_t sample_index)
+{
+    double period = get_sample_period_ms();
+    double x = (double)sample_index - (double)_x0;
+
+    if (_n == 0)
+    {
+        return x * period;
+    }
+
+    double intercept = (_sum_y - period * _sum_x) / _n;
+
+    return (double)_y0 + intercept + period * x;
+}
@@ -0,0 +1,249 @@
+/**
+ * @file SensorSession.cpp
+ * @author agent agent@local
+ * @brief Owns the mask sensors and runs the barometer stream for cough detection and mask checks
+ * @version 0.1
+ * @date 2026-10-19
+ * 
+ * @copyright Copyright (c) 2026 Ka Moamoa
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, version 3 of the license.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "SensorSession.h"
+#include "TimeBase.h"
+#include "PinNames.h"
+
+// #define COUGH_PROFILING
+
+using namespace std::chrono;
+
+SensorSession::SensorSession(SPI *spi, I2C *i2c) :
+_barometer(spi, (PinName)BAR_CS, (PinName)BAR_DRDY),
+_thermometer(i2c),
+_mask_detection(&_barometer, &_thermometer)
+{
+    _bus_control = BusControl::get_instance();
+    _logger = Logger::get_instance();
+}
+
+SensorSession::~SensorSession()
+{
+    close();
+}
+
+/**
+ * @brief Start the stream. The barometer runs in low current mode at
+ * the cough detector's rate and interrupts on FIFO full, so the MCU
+ * wakes about 1.5 times a second for it.
+ */
+bool SensorSession::open()
+{
+    if (_open)
+    {
+        return true;
+    }
+
+    _mask_state = MaskStateDetection::PENDING;
+    _checking = false;
+
+    // hold the barometer on while the mask is, independent of the tasks' own devices
+    _bus_control->power_up(BusControl::BAROMETER, callback(&_barometer, &Barometer::is_ready));
+    _holding_power = true;
+
+    if (!_barometer.initialize(true) || !_barometer.set_fifo_full_interrupt(true) || !_barometer.set_frequency(CoughDetection::SAMPLING_FREQUENCY))
+    {
+        _logger->log(TRACE_WARNING, "%s", "unable to open sensor session");
+        close();
+        return false;
+    }
+
+    _cough.start(&_barometer.get_sample_clock(), TimeBase::get_instance()->monotonic_s());
+
+    _open = true;
+    return true;
+}
+
+void SensorSession::close()
+{
+    _mask_detection.stop();
+    _checking = false;
+
+    if (_holding_power)
+    {
+        _barometer.stop();
+        _bus_control->release(BusControl::BAROMETER);
+        _holding_power = false;
+    }
+
+    if (_num_overruns > 0)
+    {
+        _logger->log(TRACE_INFO, "barometer stream lost samples %lu times", _num_overruns);
+        _num_overruns = 0;
+    }
+
+    _open = false;
+}
+
+/**
+ * @brief Start a mask check on the next window_size decimated samples.
+ * With precheck, the thermometer pre-check runs alongside and can decide
+ * first; pass false when the task needs the thermometer itself.
+ */
+void SensorSession::check(bool precheck, uint16_t window_size)
+{
+    _mask_detection.stop();
+
+    _mask_state = MaskStateDetection::PENDING;
+    _checking = _open;
+    _window_size = 0;
+    _window_target = window_size;
+    if (_window_target > MAX_WINDOW_SIZE)
+    {
+        _window_target = MAX_WINDOW_SIZE;
+    }
+    _decimation_sum = 0;
+    _decimation_count = 0;
+
+    if (_checking && precheck)
+    {
+        _mask_detection.start_precheck();
+    }
+}
+
+/**
+ * @brief Call from the task's sampling loop. Reads any burst that's
+ * ready and, once the check's window is full, latches the mask state.
+ * Returns false once the mask has been detected off.
+ */
+bool SensorSession::update()
+{
+    if (!_open)
+    {
+        return true;
+    }
+
+    if (_barometer.update())
+    {
+        _process();
+    }
+
+    _update_check();
+
+    return _mask_state != MaskStateDetection::OFF;
+}
+
+/**
+ * @brief Sleep until the next burst (or timeout), then as update(). A
+ * running pre-check shortens the sleep to its sampling interval.
+ */
+bool SensorSession::wait(milliseconds timeout)
+{
+    if (!_open)
+    {
+        ThisThread::sleep_for(timeout);
+        return true;
+    }
+
+    if (_mask_detection.is_precheck_running())
+    {
+        timeout = std::min(timeout, milliseconds(1000 / MaskClassifier::PRECHECK_FREQUENCY / 4));
+    }
+
+    if (_barometer.wait_for_data(timeout))
+    {
+        _process();
+    }
+
+    _update_check();
+
+    return _mask_state != MaskStateDetection::OFF;
+}
+
+void SensorSession::_process()
+{
+    uint16_t* pressure = _barometer.get_pressure_array();
+    uint16_t size = _barometer.get_pressure_buffer_size();
+
+    if (_barometer.get_overrun_flag())
+    {
+        // the burst doesn't follow on from the last one, so neither do the features or the window
+        _barometer.clear_overrun_flag();
+        _num_overruns++;
+        _cough.restart();
+        _window_size = 0;
+        _decimation_sum = 0;
+        _decimation_count = 0;
+    }
+
+    #ifdef COUGH_PROFILING
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    uint32_t start_cycles = DWT->CYCCNT;
+    #endif // COUGH_PROFILING
+
+    _cough.process(pressure, size, _barometer.get_buffer_start_index());
+
+    #ifdef COUGH_PROFILING
+    {
+        uint32_t cycles = DWT->CYCCNT - start_cycles;
+        _logger->log(TRACE_INFO, "cough process: %lu cycles for %u samples (%lu cycles/sample)", cycles, size, size ? cycles / size : 0);
+    }
+    #endif // COUGH_PROFILING
+
+    for (int i = 0; i < size && _checking && _window_size < _window_target; i++)
+    {
+        _decimation_sum += pressure[i];
+        _decimation_count++;
+        if (_decimation_count >= DECIMATION)
+        {
+            _window[_window_size++] = _decimation_sum / DECIMATION;
+            _decimation_sum = 0;
+            _decimation_count = 0;
+        }
+    }
+
+    _barometer.clear_buffers();
+}
+
+void SensorSession::_update_check()
+{
+    if (!_checking)
+    {
+        return;
+    }
+
+    MaskStateDetection::MASK_STATE_t mask_state = _mask_detection.update_precheck();
+    if (mask_state == MaskStateDetection::PENDING && _window_size >= _window_target)
+    {
+        _mask_detection.stop(); // the barometer decides first
+        mask_state = _mask_detection.detect(_window, _window_size);
+    }
+
+    if (mask_state == MaskStateDetection::PENDING)
+    {
+        return;
+    }
+
+    _mask_state = mask_state;
+    _checking = false;
+
+    if (_mask_state == MaskStateDetection::ON)
+    {
+        _logger->log(TRACE_INFO, "%s", "MASK ON (session)");
+    }
+    else if (_mask_state == MaskStateDetection::OFF)
+    {
+        _logger->log(TRACE_INFO, "%s", "MASK OFF (session)");
+    }
+}
@@ -33,10 +33,12 @@ THE SOFTWARE.
 #include "I2C.h"
 #include "Logger.h"
 #include "Utilites.h"
+#include "WaveformStreamer.h"
 
 Si7051::Si7051(I2C *i2c, char address)
 {
 	_logger = Logger::get_instance();
+	_streamer = WaveformStreamer::get_instance();
 	_i2c = i2c;
 	_address = address;
 }
@@ -51,6 +53,12 @@ void Si7051::initialize() {
 
 	_timer.reset();
 	_timer.start();
+
+	_sample_clock.reset();
+	_sample_clock.set_nominal_frequency(_measurement_frequency_hz);
+	_samples_taken = 0;
+	_buffer_start_index = 0;
+	_tempx100_array.clear();
 }
 
 void Si7051::stop() {
@@ -96,6 +104,28 @@ uint8_t Si7051::readFirmwareVersion()
 	return fw_rev;
 }
 
+bool Si7051::isReady()
+{
+	// the sensor NACKs its address until it has powered up
+	_i2c->start();
+	bool ack = _i2c->write(_address | WRITE);
+	if (!ack)
+	{
+		_i2c->stop();
+		return false;
+	}
+
+	_i2c->write(READ_FW_REV[0]);
+	_i2c->write(READ_FW_REV[1]);
+
+	_i2c->start();
+	_i2c->write(_address | READ);
+	uint8_t fw_rev = _i2c->read(false);
+	_i2c->stop();
+
+	return fw_rev == FW_REV_1_0 || fw_rev == FW_REV_2_0;
+}
+
 void Si7051::setResolution(uint8_t resolution)
 {
 	SI7051_Register reg;
@@ -151,7 +181,7 @@ float Si7051::readTemperature()
 		ThisThread::sleep_for(10ms);
 		_i2c->start();
 		ack = _i2c->write(_address | READ);
-		if (!ack) { _logger->log(TRACE_DEBUG, "nack from temp sensor. waiting... %lli ms", std::chrono::duration_cast<std::chrono::milliseconds>(timeout.elapsed_time()).count()); }
+		if (!ack) { LOG(_logger, TRACE_DEBUG, "nack from temp sensor. waiting... %lli ms", std::chrono::duration_cast<std::chrono::milliseconds>(timeout.elapsed_time()).count()); }
 	}
 	timeout.stop();
 	if (ack == false)
@@ -179,17 +209,33 @@ bool Si7051::update()
 	if (ms_since_last_read >= measurement_period - 10) // 10 ms to perform measurement
 	{
 		float tempVal = readTemperature();
-		uint16_t tempValx100 = (uint16_t)Utilities::round(tempVal * 100.0);
+		if (tempVal < MIN_TEMPERATURE || tempVal > MAX_TEMPERATURE) // -999.999 if the read failed
+		{
+			_frequency_timer.reset(); // try again next period
+			return false;
+		}
+
+		int16_t tempValx100 = Utilities::round(tempVal * 100.0);
 		_tempx100_array.push_back(tempValx100);
 
 		if (_tempx100_array.size() > MAX_BUFFER_SIZE)
 		{
 			_tempx100_array.erase(_tempx100_array.begin());
+			_buffer_start_index++;
 		}
 
 		_relative_measurement_timestamp = _frequency_timer.read_ms();
 		_last_measurement_timestamp = _timer.read_ms();
+
+		// one-shot measurements carry their own timestamp; the fit smooths out our polling jitter
+		_sample_clock.add_point(_samples_taken, _last_measurement_timestamp);
+		_samples_taken++;
 		_frequency_timer.reset();
+
+		if (_streamer->is_enabled())
+		{
+			_streamer->push(WaveformStreamer::TEMPERATURE, _last_measurement_timestamp, _sample_clock.get_frequency(), (uint16_t*)&tempValx100, 1); // sent as two's complement
+		}
 		return true;
 	}
 	
@@ -0,0 +1,211 @@
+/**
+ * @file TimeBase.cpp
+ * @author agent agent@local
+ * @brief Monotonic and wall clock time that survive resets and brownouts
+ * @version 0.1
+ * @date 2026-10-19
+ * 
+ * @copyright Copyright (c) 2026 Ka Moamoa
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, version 3 of the license.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "TimeBase.h"
+
+TimeBase* TimeBase::_instance = nullptr;
+Mutex TimeBase::_mutex;
+MBED_SECTION(".noinit") TimeBase::State_t TimeBase::_retained;
+
+TimeBase::TimeBase()
+{
+    _logger = Logger::get_instance();
+}
+
+TimeBase::~TimeBase()
+{
+}
+
+TimeBase* TimeBase::get_instance()
+{
+    _mutex.lock();
+
+    if (_instance == nullptr)
+    {
+        _instance = new TimeBase();
+    }
+
+    _mutex.unlock();
+
+    return _instance;
+}
+
+bool TimeBase::initialize(FRAM* fram)
+{
+    _fram = fram;
+
+    State_t slots[2];
+    bool valid[2];
+
+    _fram->hold_power(true);
+    valid[0] = _read_slot(0, slots[0]);
+    valid[1] = _read_slot(1, slots[1]);
+    _fram->hold_power(false);
+
+    uint8_t newest = valid[0] && (!valid[1] || (int32_t)(slots[0].sequence - slots[1].sequence) > 0) ? 0 : 1;
+    _slot = valid[newest] ? newest : 1; // so the first save lands in slot 0
+
+    if (_valid(_retained))
+    {
+        // soft reset: RAM made it through, we only lost the time since the last checkpoint
+        _state = _retained;
+        _logger->log(TRACE_INFO, "Time base restored from RAM at %llu ms", _state.monotonic_ms);
+    }
+    else if (valid[newest])
+    {
+        // power was lost for an unknown time; carry on from FRAM but don't vouch for the wall time
+        _state = slots[newest];
+        _state.flags &= ~FLAG_TRUSTED;
+        _logger->log(TRACE_INFO, "Time base restored from FRAM at %llu ms, wall time untrusted", _state.monotonic_ms);
+    }
+    else
+    {
+        _state = {MAGIC, 0, 0, 0, 0, 0, 0};
+        _logger->log(TRACE_INFO, "%s", "Time base not initialized, starting from zero");
+    }
+
+    _base_ms = _state.monotonic_ms - _boot_ms();
+    _last_fram_ms = 0;
+
+    if (has_epoch())
+    {
+        set_time(get_epoch());
+    }
+
+    checkpoint(true);
+
+    return true;
+}
+
+uint64_t TimeBase::monotonic_ms()
+{
+    return _base_ms + _boot_ms();
+}
+
+uint64_t TimeBase::_boot_ms()
+{
+    return duration_cast<milliseconds>(Kernel::Clock::now().time_since_epoch()).count();
+}
+
+bool TimeBase::is_trusted()
+{
+    _time_mutex.lock();
+    bool trusted = (_state.flags & FLAG_TRUSTED) && monotonic_ms() - _state.set_ms < (uint64_t)TRUST_PERIOD.count();
+    _time_mutex.unlock();
+
+    return trusted;
+}
+
+time_t TimeBase::get_epoch()
+{
+    _time_mutex.lock();
+    time_t epoch = has_epoch() ? (monotonic_ms() + _state.epoch_offset_ms) / 1000 : 0;
+    _time_mutex.unlock();
+
+    return epoch;
+}
+
+uint32_t TimeBase::to_epoch_s(uint32_t monotonic_s)
+{
+    _time_mutex.lock();
+    int64_t epoch_ms = has_epoch() ? (int64_t)monotonic_s * 1000 + _state.epoch_offset_ms : (int64_t)monotonic_s * 1000;
+    _time_mutex.unlock();
+
+    return epoch_ms / 1000;
+}
+
+void TimeBase::set_epoch(time_t epoch)
+{
+    _time_mutex.lock();
+
+    uint64_t now = monotonic_ms();
+    _state.epoch_offset_ms = (int64_t)epoch * 1000 - now;
+    _state.set_ms = now;
+    _state.flags |= FLAG_EPOCH | FLAG_TRUSTED;
+
+    _time_mutex.unlock();
+
+    set_time(epoch);
+    checkpoint(true);
+}
+
+void TimeBase::checkpoint(bool force)
+{
+    _time_mutex.lock();
+
+    uint64_t now = monotonic_ms();
+    _state.monotonic_ms = now;
+    _state.crc = _crc(_state);
+    _retained = _state;
+
+    if (_fram != nullptr && (force || now - _last_fram_ms >= (uint64_t)FRAM_PERIOD.count()))
+    {
+        _write_fram();
+    }
+
+    _time_mutex.unlock();
+}
+
+bool TimeBase::_write_fram()
+{
+    uint8_t slot = _slot ^ 1; // never overwrite the newest valid slot
+
+    State_t state = _state;
+    state.sequence++;
+    state.crc = _crc(state);
+
+    if (!_fram->write_bytes(SLOTS_ADDR + slot * SLOT_SIZE, (const char*)&state, sizeof(state)))
+    {
+        _logger->log(TRACE_WARNING, "%s", "TIME BASE WRITE FAILED");
+        return false;
+    }
+
+    _state.sequence = state.sequence;
+    _state.crc = _crc(_state);
+    _retained = _state;
+    _slot = slot;
+    _last_fram_ms = state.monotonic_ms;
+    return true;
+}
+
+bool TimeBase::_read_slot(uint8_t slot, State_t &state)
+{
+    if (!_fram->read_bytes(SLOTS_ADDR + slot * SLOT_SIZE, (char*)&state, sizeof(state)))
+    {
+        return false;
+    }
+
+    return _valid(state);
+}
+
+bool TimeBase::_valid(const State_t &state)
+{
+    return state.magic == MAGIC && state.crc == _crc(state);
+}
+
+uint32_t TimeBase::_crc(const State_t &state)
+{
+    MbedCRC<POLY_32BIT_ANSI, 32> ct;
+    uint32_t crc = 0;
+    ct.compute(&state, offsetof(State_t, crc), &crc);
+    return crc;
+}
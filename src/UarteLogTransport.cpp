@@ -0,0 +1,166 @@
+/**
+ * @file UarteLogTransport.cpp
+ * @author agent agent@local
+ * @brief Buffered UARTE0 EasyDMA log and console output
+ * @version 0.1
+ * @date 2026-10-19
+ * 
+ * @copyright Copyright (c) 2026 Ka Moamoa
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, version 3 of the license.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "UarteLogTransport.h"
+
+UarteLogTransport::UarteLogTransport(PinName tx)
+{
+    _tx_pin = tx;
+
+    // keep the line idle-high while the peripheral is disabled
+    NRF_P0->OUTSET = (1UL << _tx_pin);
+    NRF_P0->DIRSET = (1UL << _tx_pin);
+}
+
+UarteLogTransport::~UarteLogTransport()
+{
+    flush();
+}
+
+/**
+ * @brief Queue bytes for the next burst. Whatever doesn't fit is dropped and
+ * counted rather than reported as a short write, which stdio would retry.
+ */
+ssize_t UarteLogTransport::write(const void* buffer, size_t size)
+{
+    core_util_critical_section_enter();
+
+    size_t space = BUFFER_SIZE - _fill_length;
+    size_t queued = size < space ? size : space;
+    memcpy(&_buffers[_fill_buffer][_fill_length], buffer, queued);
+    _fill_length += queued;
+
+    if (queued < size)
+    {
+        _dropped_bytes += size - queued;
+        _dropped_writes++;
+    }
+
+    if (!_busy && _fill_length > 0) _start();
+
+    core_util_critical_section_exit();
+
+    return size;
+}
+
+void UarteLogTransport::flush()
+{
+    while (_busy)
+    {
+        ThisThread::sleep_for(1ms);
+    }
+}
+
+/**
+ * @brief Hand the fill buffer to EasyDMA and start collecting into the other
+ * one. Called with interrupts masked or from the timeout callback.
+ */
+void UarteLogTransport::_start()
+{
+    uint8_t* tx_buffer = _buffers[_fill_buffer];
+    _tx_length = _fill_length;
+    _fill_buffer ^= 1;
+    _fill_length = 0;
+    _busy = true;
+
+    if (NRF_UARTE0->ENABLE != (UARTE_ENABLE_ENABLE_Enabled << UARTE_ENABLE_ENABLE_Pos))
+    {
+        NRF_UARTE0->PSEL.TXD = _tx_pin;
+        NRF_UARTE0->PSEL.RXD = 0xFFFFFFFF; // disconnected
+        NRF_UARTE0->PSEL.RTS = 0xFFFFFFFF;
+        NRF_UARTE0->PSEL.CTS = 0xFFFFFFFF;
+        NRF_UARTE0->BAUDRATE = UARTE_BAUDRATE_BAUDRATE_Baud115200 << UARTE_BAUDRATE_BAUDRATE_Pos;
+        NRF_UARTE0->CONFIG = 0;
+        NRF_UARTE0->ENABLE = UARTE_ENABLE_ENABLE_Enabled << UARTE_ENABLE_ENABLE_Pos;
+        _active_timer.reset();
+        _active_timer.start();
+    }
+
+    NRF_UARTE0->EVENTS_ENDTX = 0;
+    NRF_UARTE0->TXD.PTR = reinterpret_cast<uintptr_t>(tx_buffer);
+    NRF_UARTE0->TXD.MAXCNT = _tx_length;
+    NRF_UARTE0->TASKS_STARTTX = 1;
+
+    // 10 bits per byte on the wire, plus a little slack
+    uint32_t tx_time_us = (_tx_length * 10 * 1000000UL) / BAUD_RATE + 100;
+    _tx_timeout.attach(callback(this, &UarteLogTransport::_on_tx_timeout), std::chrono::microseconds(tx_time_us));
+}
+
+void UarteLogTransport::_on_tx_timeout()
+{
+    if (_stopping)
+    {
+        _on_tx_stopped();
+        return;
+    }
+
+    if (NRF_UARTE0->EVENTS_ENDTX == 0)
+    {
+        _tx_timeout.attach(callback(this, &UarteLogTransport::_on_tx_timeout), 1ms);
+        return;
+    }
+
+    NRF_UARTE0->EVENTS_ENDTX = 0;
+    _bytes_sent += _tx_length;
+
+    if (_fill_length > 0)
+    {
+        _start(); // the next burst was queued while this one was sending
+        return;
+    }
+
+    // the transmitter has to stop before the peripheral is disabled
+    NRF_UARTE0->EVENTS_TXSTOPPED = 0;
+    NRF_UARTE0->TASKS_STOPTX = 1;
+    _stopping = true;
+    _on_tx_stopped();
+}
+
+/**
+ * @brief Disable the peripheral once TXSTOPPED is in. It usually is by the
+ * time this first runs; if not, check again from the timeout rather than
+ * spinning in interrupt context.
+ */
+void UarteLogTransport::_on_tx_stopped()
+{
+    if (NRF_UARTE0->EVENTS_TXSTOPPED == 0)
+    {
+        _tx_timeout.attach(callback(this, &UarteLogTransport::_on_tx_timeout), 100us);
+        return;
+    }
+
+    NRF_UARTE0->EVENTS_TXSTOPPED = 0;
+    _stopping = false;
+
+    if (_fill_length > 0)
+    {
+        _start(); // queued while stopping; the peripheral is still enabled
+        return;
+    }
+
+    NRF_UARTE0->ENABLE = UARTE_ENABLE_ENABLE_Disabled << UARTE_ENABLE_ENABLE_Pos;
+
+    _active_timer.stop();
+    _active_time_us += std::chrono::duration_cast<std::chrono::microseconds>(_active_timer.elapsed_time()).count();
+
+    _busy = false;
+}
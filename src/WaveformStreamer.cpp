@@ -0,0 +1,272 @@
+/**
+ * @file WaveformStreamer.cpp
+ * @author agent agent@local
+ * @brief Streams raw pressure and temperature waveforms over BLE notifications
+ * @version 0.1
+ * @date 2026-10-19
+ * 
+ * @copyright Copyright (c) 2026 Ka Moamoa
+ *
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, version 3 of the license.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "WaveformStreamer.h"
+
+WaveformStreamer* WaveformStreamer::_instance = nullptr;
+Mutex WaveformStreamer::_mutex;
+
+WaveformStreamer::WaveformStreamer()
+{
+    _logger = Logger::get_instance();
+}
+
+WaveformStreamer::~WaveformStreamer()
+{
+}
+
+WaveformStreamer* WaveformStreamer::get_instance()
+{
+    _mutex.lock();
+
+    if (_instance == nullptr)
+    {
+        _instance = new WaveformStreamer();
+    }
+
+    _mutex.unlock();
+
+    return _instance;
+}
+
+void WaveformStreamer::enable(SmartPPEService *service, events::EventQueue *queue)
+{
+    _service = service;
+    _queue = queue;
+
+    for (int source = 0; source < SOURCE_LAST; source++)
+    {
+        _batches[source][0].num_samples = 0;
+        _batches[source][0].ready = false;
+        _batches[source][1].num_samples = 0;
+        _batches[source][1].ready = false;
+        _filling[source] = 0;
+        _next_sample[source] = 0;
+        _in_flight[source] = 0;
+    }
+
+    _sent = 0;
+    _dropped = 0;
+    _reported_dropped = 0;
+    _service->setNotifyCallback(callback(this, &WaveformStreamer::_on_notified));
+    _enabled = true;
+
+    _logger->log(TRACE_INFO, "%s", "Waveform streaming enabled");
+}
+
+void WaveformStreamer::disable()
+{
+    _enabled = false;
+    _schedule_send(); // counts whatever is still waiting as dropped
+    _logger->log(TRACE_INFO, "Waveform streaming disabled: %lu batches sent, %lu dropped", _sent, _dropped);
+}
+
+void WaveformStreamer::push(Source_t source, uint64_t timestamp_ms, float frequency, const uint16_t *samples, uint16_t num_samples)
+{
+    if (!_enabled || source >= SOURCE_LAST || frequency <= 0)
+    {
+        return;
+    }
+
+    while (num_samples > 0)
+    {
+        Batch_t &batch = _batches[source][_filling[source]];
+
+        if (batch.num_samples == 0)
+        {
+            batch.timestamp_ms = timestamp_ms;
+            batch.frequency = frequency;
+        }
+
+        uint16_t count = BATCH_SIZE - batch.num_samples;
+        if (count > num_samples)
+        {
+            count = num_samples;
+        }
+
+        memcpy(&batch.samples[batch.num_samples], samples, count * sizeof(uint16_t));
+        batch.num_samples += count;
+        samples += count;
+        num_samples -= count;
+        timestamp_ms += count * 1000.0 / frequency;
+
+        if (batch.num_samples < BATCH_SIZE)
+        {
+            break;
+        }
+
+        Batch_t &other = _batches[source][_filling[source] ^ 1];
+        if (core_util_atomic_load_bool(&other.ready))
+        {
+            // the radio hasn't caught up, drop this batch and refill it
+            core_util_atomic_incr_u32(&_dropped, 1);
+            batch.num_samples = 0;
+            _schedule_send(); // in case an earlier one didn't make it onto the queue
+            continue;
+        }
+
+        core_util_atomic_store_bool(&batch.ready, true);
+        _filling[source] ^= 1;
+        other.num_samples = 0;
+
+        _schedule_send();
+    }
+}
+
+void WaveformStreamer::_schedule_send()
+{
+    if (core_util_atomic_exchange_bool(&_send_pending, true))
+    {
+        return;
+    }
+
+    if (_queue->call(callback(this, &WaveformStreamer::_send)) == 0)
+    {
+        // the BLE queue is full; the next push tries again
+        core_util_atomic_store_bool(&_send_pending, false);
+    }
+}
+
+void WaveformStreamer::_send()
+{
+    core_util_atomic_store_bool(&_send_pending, false);
+
+    for (int source = 0; source < SOURCE_LAST; source++)
+    {
+        _send_next((Source_t)source);
+    }
+
+    _report_dropped();
+}
+
+void WaveformStreamer::_send_next(Source_t source)
+{
+    if (_in_flight[source] > 0)
+    {
+        return; // _on_notified() sends the next one
+    }
+
+    Batch_t *batch = _ready_batch(source);
+    if (batch == nullptr)
+    {
+        return;
+    }
+
+    if (!_enabled)
+    {
+        _finish(source, *batch, false);
+        return;
+    }
+
+    // as many samples as fit one notification at the negotiated MTU
+    uint8_t chunk = (_service->getMaxNotifyPayload(SmartPPEService::WAVEFORM_SIZE) - SmartPPEService::WAVEFORM_HEADER_SIZE) / 2;
+    if (chunk == 0)
+    {
+        chunk = 1;
+    }
+
+    uint8_t first = _next_sample[source];
+    uint8_t count = batch->num_samples - first < chunk ? batch->num_samples - first : chunk;
+    uint64_t timestamp = batch->timestamp_ms + first * 1000.0 / batch->frequency;
+    uint32_t frequencyx100 = batch->frequency * 100;
+
+    bool queued = source == PRESSURE ?
+        _service->updatePressure(timestamp, frequencyx100, &batch->samples[first], count) :
+        _service->updateTemperature(timestamp, frequencyx100, &batch->samples[first], count);
+
+    if (!queued)
+    {
+        // not subscribed or not connected; the rest of the batch won't get out either
+        _finish(source, *batch, false);
+        return;
+    }
+
+    _in_flight[source] = count;
+}
+
+void WaveformStreamer::_on_notified(SmartPPEService::data_ready_t type, bool sent)
+{
+    Source_t source = type == SmartPPEService::PRESSURE ? PRESSURE : TEMPERATURE;
+    Batch_t *batch = _ready_batch(source);
+    if (batch == nullptr || _in_flight[source] == 0)
+    {
+        return;
+    }
+
+    if (!sent)
+    {
+        _finish(source, *batch, false); // the link dropped with it in flight
+    }
+    else
+    {
+        _next_sample[source] += _in_flight[source];
+        _in_flight[source] = 0;
+
+        if (_next_sample[source] >= batch->num_samples)
+        {
+            _finish(source, *batch, true);
+        }
+    }
+
+    _send_next(source);
+    _report_dropped();
+}
+
+void WaveformStreamer::_finish(Source_t source, Batch_t &batch, bool sent)
+{
+    _next_sample[source] = 0;
+    _in_flight[source] = 0;
+
+    if (sent)
+    {
+        _sent++;
+    }
+    else
+    {
+        core_util_atomic_incr_u32(&_dropped, 1);
+    }
+
+    core_util_atomic_store_bool(&batch.ready, false); // back to the sensor thread
+}
+
+void WaveformStreamer::_report_dropped()
+{
+    if (_dropped != _reported_dropped)
+    {
+        _reported_dropped = _dropped;
+        _logger->log(TRACE_WARNING, "Streaming: %lu batches dropped, %lu sent", _reported_dropped, _sent);
+    }
+}
+
+WaveformStreamer::Batch_t* WaveformStreamer::_ready_batch(Source_t source)
+{
+    // push() hands over a batch only once the other is back, so there's at most one
+    for (int i = 0; i < 2; i++)
+    {
+        if (core_util_atomic_load_bool(&_batches[source][i].ready))
+        {
+            return &_batches[source][i];
+        }
+    }
+
+    return nullptr;
+}
@@ -34,7 +34,9 @@
 #include "FaceBitState.hpp"
 
 #define FACEBIT_UART
+// #define FACEBIT_UARTE // buffered EasyDMA output, peripheral off between bursts
 // #define FACEBIT_SWO
+// #define FACEBIT_DEFERRED_LOG // format and print logs from a low-priority thread
 #define TRACE_LEVEL TRACE_INFO
 
 // #include "mbed_mem_trace.h"
@@ -49,6 +51,13 @@ Logger* _logger;
 
 #if defined(FACEBIT_SWO)
 SWO_Channel swo("channel");
+#elif defined(FACEBIT_UARTE)
+UarteLogTransport uarte(STDIO_UART_TX);
+
+FileHandle *mbed::mbed_override_console(int fd)
+{
+    return &uarte; // mbed's console serial would claim the same pins
+}
 #elif defined(FACEBIT_UART)
 static UnbufferedSerial serial(STDIO_UART_TX, NC);
 
@@ -58,32 +67,26 @@ FileHandle *mbed::mbed_override_console(int fd)
 }
 #endif
 
-void blink()
-{
-    BusControl::get_instance()->set_led_blinks(1);
-    while(1)
-    {
-        BusControl::get_instance()->blink_led(10ms);
-        ThisThread::sleep_for(2s);
-    }
-}
-
 void imu_int_handler()
 {
     imu_interrupt = true;
 }
 
-Thread thread1(osPriorityNormal, 512);
-
 int main() {
     _logger = Logger::get_instance();
 
 #if defined(FACEBIT_SWO)
     _logger->initialize(&swo, TRACE_LEVEL);
+#elif defined(FACEBIT_UARTE)
+    _logger->initialize(&uarte, TRACE_LEVEL);
 #elif defined(FACEBIT_UART)
     _logger->initialize(&serial, TRACE_LEVEL);
 #endif
 
+#if defined(FACEBIT_DEFERRED_LOG)
+    _logger->enable_deferred();
+#endif
+
     NRF_POWER->DCDCEN = 1;
 
     _logger->log(TRACE_DEBUG, "START");
@@ -92,7 +95,8 @@ int main() {
  
     BusControl::get_instance()->init();
 
-    thread1.start(blink);
+    BusControl::get_instance()->set_led_blinks(1);
+    BusControl::get_instance()->start_indicator(2s, 10ms);
 
     facebit.run();
 
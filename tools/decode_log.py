@@ -0,0 +1,126 @@
+#!/usr/bin/env python3
+"""
+Decode FaceBit binary log captures.
+
+With Logger::enable_deferred(true) the firmware emits one frame per log call:
+
+    0xA5 | level (u8) | word count (u8) | format address (u32 LE) | words (u32 LE)...
+
+Format strings live in flash, so they are resolved from the firmware ELF that
+produced the capture (the same build, or the addresses will not match).
+
+usage: decode_log.py firmware.elf capture.bin
+
+Requires pyelftools (pip install pyelftools).
+"""
+
+import re
+import struct
+import sys
+
+from elftools.elf.elffile import ELFFile
+
+SYNC = 0xA5
+TRACE_CHARS = "TDIW"
+CONVERSION = re.compile(r"%([-+ #0]*[0-9]*(?:\.[0-9]+)?)(hh|h|ll|l|L|z|j|t)?([diouxXcsfFeEgGaAp%])")
+
+
+class Image:
+    def __init__(self, path):
+        self._segments = []
+        with open(path, "rb") as f:
+            elf = ELFFile(f)
+            for section in elf.iter_sections():
+                if section["sh_addr"] and section["sh_type"] == "SHT_PROGBITS":
+                    self._segments.append((section["sh_addr"], section.data()))
+
+    def string(self, address):
+        for base, data in self._segments:
+            if base <= address < base + len(data):
+                end = data.find(b"\0", address - base)
+                return data[address - base:end].decode("ascii", "replace")
+        return None
+
+
+def format_record(image, fmt, words):
+    out = []
+    pos = 0
+    index = 0
+    for match in CONVERSION.finditer(fmt):
+        out.append(fmt[pos:match.start()])
+        pos = match.end()
+        flags, length, conversion = match.groups()
+
+        if conversion == "%":
+            out.append("%")
+            continue
+
+        wide = conversion in "fFeEgGaA" or length in ("ll", "j")
+        needed = 2 if wide else 1
+        if index + needed > len(words):
+            out.append("?")  # argument did not fit the record
+            index = len(words)
+            continue
+
+        if wide:
+            raw = struct.pack("<II", words[index], words[index + 1])
+            if conversion in "fFeEgGaA":
+                value = struct.unpack("<d", raw)[0]
+            else:
+                value = struct.unpack("<q" if conversion in "di" else "<Q", raw)[0]
+        else:
+            value = words[index]
+            if conversion in "di":
+                value = struct.unpack("<i", struct.pack("<I", value))[0]
+        index += needed
+
+        if conversion == "s":
+            out.append(image.string(value) or "<0x%08x>" % value)
+        elif conversion == "p":
+            out.append("0x%08x" % value)
+        elif conversion == "c":
+            out.append(chr(value & 0xFF))
+        else:
+            out.append(("%" + flags + conversion) % value)
+
+    out.append(fmt[pos:])
+    return "".join(out)
+
+
+def decode(image, capture):
+    i = 0
+    while i + 7 <= len(capture):
+        if capture[i] != SYNC:
+            i += 1
+            continue
+
+        level, num_words = capture[i + 1], capture[i + 2]
+        (address,) = struct.unpack_from("<I", capture, i + 3)
+        end = i + 7 + 4 * num_words
+        fmt = image.string(address) if level < len(TRACE_CHARS) else None
+        if fmt is None or end > len(capture):
+            i += 1  # not a frame boundary, resynchronise
+            continue
+
+        words = struct.unpack_from("<%dI" % num_words, capture, i + 7)
+        yield "[%c] // %s" % (TRACE_CHARS[level], format_record(image, fmt, words))
+        i = end
+
+
+def main():
+    if len(sys.argv) != 3:
+        print(__doc__.strip(), file=sys.stderr)
+        return 1
+
+    image = Image(sys.argv[1])
+    with open(sys.argv[2], "rb") as f:
+        capture = f.read()
+
+    for line in decode(image, capture):
+        print(line)
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,544 @@
+/**
+ * Checkpoints on the host: the real Checkpoint against a stand-in FRAM
+ * whose power can be cut after any written byte, and BCG and RR
+ * captures cut short by a brownout and resumed from one.
+ *
+ *   checkpoint_bench [rounds]
+ *
+ * Power cuts: every cut point of a save and of a discard, then rounds
+ * (default 20000) of random saves, discards and cuts. After each cut the
+ * checkpoint is initialized again, as after a reboot, and must resume
+ * from the last save that returned true, byte for byte; a resume from
+ * anything else is "torn" and fails the run.
+ *
+ * Resumed captures: synthetic gyroscope (BCG) and pressure (RR) traces,
+ * cut at a random point, checkpointed through Checkpoint, and resumed
+ * after a random outage while the signal carries on. Their rates are
+ * compared with the same trace uninterrupted. The BiQuads are the
+ * stand-in in iir-filter-kit/, so RR's byte copy is checked against its
+ * layout, not the kit's own.
+ */
+
+#include "Checkpoint.h"
+#include "BCGFilter.h"
+#include "BreathFilter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace
+{
+
+const int TRIALS = 200; // per resumed capture scenario
+const double OUTAGE_MIN_S = 5;
+const double OUTAGE_MAX_S = 120;
+
+FRAM fram;
+Checkpoint* checkpoint = Checkpoint::get_instance();
+std::mt19937 rng(20261019);
+
+void reboot()
+{
+    fram.power_on();
+    checkpoint->initialize(&fram);
+}
+
+double uniform(double lo, double hi)
+{
+    return std::uniform_real_distribution<double>(lo, hi)(rng);
+}
+
+/**
+ * What the checkpoint should hold: the last save (or discard) that
+ * returned true.
+ */
+typedef struct
+{
+    Checkpoint::Task_t task;
+    std::vector<uint8_t> state;
+} Expected_t;
+
+typedef struct
+{
+    long cuts = 0;
+    long resumed_new = 0;
+    long resumed_old = 0;
+    long torn = 0;
+} PowerTally_t;
+
+std::vector<uint8_t> random_state(uint16_t length)
+{
+    std::vector<uint8_t> state(length);
+    for (auto &b : state) b = rng();
+    return state;
+}
+
+void check(const Expected_t &expected, PowerTally_t *tally, bool committed)
+{
+    Checkpoint::Task_t pending = checkpoint->get_pending();
+    bool ok = pending == expected.task;
+
+    if (ok && expected.task != Checkpoint::TASK_NONE)
+    {
+        std::vector<uint8_t> state(expected.state.size());
+        ok = checkpoint->load(expected.task, state.data(), state.size()) && state == expected.state;
+    }
+
+    if (!ok) tally->torn++;
+    else if (committed) tally->resumed_new++;
+    else tally->resumed_old++;
+}
+
+/**
+ * Cut a save of length bytes, that follows a committed save, after each
+ * of the bytes it writes; then the same for a discard.
+ */
+void every_cut(uint16_t length, PowerTally_t *tally)
+{
+    const long header = 16;
+
+    for (int discard = 0; discard < 2; discard++)
+    {
+        long total = discard ? header : length + header;
+        for (long cut = 0; cut <= total; cut++)
+        {
+            reboot();
+            Expected_t old = {Checkpoint::TASK_HEART_RATE, random_state(length)};
+            checkpoint->save(old.task, old.state.data(), length);
+
+            Expected_t next = {Checkpoint::TASK_NONE, {}};
+            fram.cut_after(cut);
+            bool committed;
+            if (discard)
+            {
+                committed = checkpoint->discard(old.task);
+            }
+            else
+            {
+                next = {Checkpoint::TASK_RESPIRATORY_RATE, random_state(length)};
+                committed = checkpoint->save(next.task, next.state.data(), length);
+            }
+            bool cut_short = fram.is_cut();
+
+            reboot();
+            if (cut_short)
+            {
+                tally->cuts++;
+                check(committed ? next : old, tally, committed);
+            }
+            else
+            {
+                // the last cut point is after the final byte: no cut, and the new save has to be there
+                PowerTally_t uncut;
+                check(next, &uncut, committed);
+                tally->torn += uncut.torn + !committed;
+            }
+        }
+    }
+}
+
+void random_cuts(long rounds, PowerTally_t *tally)
+{
+    const uint16_t lengths[] = {0, 1000, 700}; // by task
+    Expected_t expected = {Checkpoint::TASK_NONE, {}};
+
+    reboot();
+    checkpoint->discard(checkpoint->get_pending());
+    expected.task = checkpoint->get_pending();
+
+    for (long round = 0; round < rounds; round++)
+    {
+        bool cut = rng() % 3 == 0;
+        fram.cut_after(cut ? (long)(rng() % (lengths[1] + 32)) : -1);
+
+        bool committed;
+        Expected_t next = {Checkpoint::TASK_NONE, {}};
+        if (rng() % 4 == 0)
+        {
+            committed = checkpoint->discard(expected.task);
+        }
+        else
+        {
+            next.task = rng() % 2 ? Checkpoint::TASK_HEART_RATE : Checkpoint::TASK_RESPIRATORY_RATE;
+            next.state = random_state(lengths[next.task]);
+            committed = checkpoint->save(next.task, next.state.data(), next.state.size());
+        }
+
+        if (committed) expected = next;
+
+        if (fram.is_cut())
+        {
+            tally->cuts++;
+            reboot();
+            check(expected, tally, committed);
+        }
+    }
+
+    fram.power_on();
+}
+
+/**
+ * Synthetic BCG: each heartbeat knocks the head, a damped oscillation
+ * on all three gyroscope axes, over breathing and sensor noise.
+ */
+typedef struct
+{
+    std::vector<double> beats; // s
+    double axis[3];
+    double amplitude, noise; // deg/s
+    unsigned noise_seed; // the same noise for each capture of a trace
+} BCGTrace_t;
+
+std::mt19937 noise_rng;
+
+const double BEAT_HZ = 11.5; // in the 10-13 Hz band the axes are filtered to
+const double BEAT_DECAY_S = 0.12;
+
+BCGTrace_t bcg_trace(double hr, double seconds)
+{
+    BCGTrace_t trace;
+    double t = uniform(0, 60.0 / hr);
+    while (t < seconds)
+    {
+        trace.beats.push_back(t);
+        t += 60.0 / hr * uniform(0.95, 1.05);
+    }
+    trace.axis[0] = 1.0;
+    trace.axis[1] = uniform(0.3, 0.8);
+    trace.axis[2] = uniform(0.1, 0.4);
+    trace.amplitude = uniform(1.5, 3);
+    trace.noise = 0.3;
+    trace.noise_seed = rng();
+    return trace;
+}
+
+void bcg_sample(const BCGTrace_t &trace, double t, double gyr[3])
+{
+    double knock = 0;
+    auto next = std::upper_bound(trace.beats.begin(), trace.beats.end(), t);
+    for (auto beat = trace.beats.begin(); beat != next; beat++)
+    {
+        double dt = t - *beat;
+        if (dt < 6 * BEAT_DECAY_S)
+        {
+            knock += sin(2 * M_PI * BEAT_HZ * dt) * exp(-dt / BEAT_DECAY_S);
+        }
+    }
+
+    double breathing = 2 * sin(2 * M_PI * 0.25 * t);
+    std::normal_distribution<double> noise(0, trace.noise);
+    for (int i = 0; i < 3; i++)
+    {
+        gyr[i] = trace.amplitude * trace.axis[i] * knock + breathing + noise(noise_rng);
+    }
+}
+
+double true_rate(const std::vector<double> &beats, double from, double to)
+{
+    double sum = 0;
+    int n = 0;
+    for (size_t i = 1; i < beats.size(); i++)
+    {
+        if (beats[i - 1] >= from && beats[i] <= to)
+        {
+            sum += 60.0 / (beats[i] - beats[i - 1]);
+            n++;
+        }
+    }
+    return n ? sum / n : NAN;
+}
+
+// BCG::State_t's layout, which needs mbed to include
+typedef struct
+{
+    uint32_t elapsed_ms;
+    uint8_t num_rates;
+    double rates[40];
+} BCGState_t;
+
+/**
+ * Run a capture like BCG::bcg(), the capture time from 0 to seconds, the
+ * signal at wall-clock time. A cut at cut_s checkpoints and resumes after
+ * outage_s, with filters primed afresh on the first sample.
+ */
+std::vector<double> bcg_capture(const BCGTrace_t &trace, double seconds, double cut_s, double outage_s)
+{
+    const double period = 1.0 / BCGFilter::FREQUENCY;
+    std::vector<double> rates;
+    BCGFilter* filter = new BCGFilter();
+    double offset = 0;
+    noise_rng.seed(trace.noise_seed);
+
+    int n = 0;
+    for (double t = 0; t <= seconds; t = ++n * period)
+    {
+        if (t >= cut_s && outage_s >= 0)
+        {
+            static BCGState_t state;
+            state.elapsed_ms = t * 1000;
+            state.num_rates = std::min<size_t>(rates.size(), 40);
+            std::copy(rates.end() - state.num_rates, rates.end(), state.rates);
+            checkpoint->save(Checkpoint::TASK_HEART_RATE, &state, sizeof(state));
+            delete filter;
+
+            reboot();
+            memset(&state, 0, sizeof(state));
+            if (!checkpoint->load(Checkpoint::TASK_HEART_RATE, &state, sizeof(state)))
+            {
+                printf("BCG checkpoint didn't load\n");
+                exit(1);
+            }
+
+            filter = new BCGFilter();
+            rates.assign(state.rates, state.rates + state.num_rates);
+            offset = outage_s;
+            cut_s = seconds + 1;
+        }
+
+        double gyr[3];
+        bcg_sample(trace, t + offset, gyr);
+        if (filter->step(gyr[0], gyr[1], gyr[2], t))
+        {
+            rates.push_back(filter->get_rate());
+        }
+    }
+
+    delete filter;
+    return rates;
+}
+
+double mean(const std::vector<double> &v)
+{
+    if (v.empty()) return NAN;
+    double sum = 0;
+    for (double x : v) sum += x;
+    return sum / v.size();
+}
+
+typedef struct
+{
+    double abs_error = 0; // against the uninterrupted capture, BPM
+    double worst = 0;
+    int valid = 0; // trials with a rate both ways
+    int lost = 0; // trials with a rate uninterrupted but none resumed
+} ResumeTally_t;
+
+void resume_tally(ResumeTally_t *tally, double uninterrupted, double resumed)
+{
+    if (std::isnan(uninterrupted)) return;
+    if (std::isnan(resumed))
+    {
+        tally->lost++;
+        return;
+    }
+
+    double error = fabs(resumed - uninterrupted);
+    tally->abs_error += error;
+    tally->worst = std::max(tally->worst, error);
+    tally->valid++;
+}
+
+void print_resume(const char *name, const ResumeTally_t &tally)
+{
+    printf("  %-34s %6.2f %6.2f %5d %5d\n", name, tally.valid ? tally.abs_error / tally.valid : NAN, tally.worst, tally.valid, tally.lost);
+}
+
+void bcg_resumes()
+{
+    const double seconds = 15; // FaceBitState's HR capture
+    ResumeTally_t resumed;
+    double truth_error = 0;
+    int truth_n = 0;
+
+    for (int trial = 0; trial < TRIALS; trial++)
+    {
+        double hr = uniform(55, 100);
+        double cut_s = uniform(2, seconds - 2);
+        double outage_s = uniform(OUTAGE_MIN_S, OUTAGE_MAX_S);
+        BCGTrace_t trace = bcg_trace(hr, seconds + OUTAGE_MAX_S + 5);
+
+        double whole = mean(bcg_capture(trace, seconds, 0, -1));
+        if (!std::isnan(whole))
+        {
+            truth_error += fabs(whole - true_rate(trace.beats, 0, seconds));
+            truth_n++;
+        }
+
+        resume_tally(&resumed, whole, mean(bcg_capture(trace, seconds, cut_s, outage_s)));
+    }
+
+    printf("BCG, %d trials, %.0f s, outage %.0f-%.0f s (uninterrupted vs truth %.2f BPM)\n", TRIALS, seconds, OUTAGE_MIN_S, OUTAGE_MAX_S, truth_n ? truth_error / truth_n : NAN);
+    printf("  %-34s %6s %6s %5s %5s\n", "", "|err|", "worst", "valid", "lost");
+    print_resume("re-primed on resume (BCG::bcg)", resumed);
+    printf("\n");
+}
+
+/**
+ * Synthetic breathing at the barometer, 10 Hz like the RR capture.
+ */
+typedef struct
+{
+    std::vector<double> breaths; // s, start of each
+    double amplitude, noise; // hPa
+} RRTrace_t;
+
+RRTrace_t rr_trace(double rate, double seconds)
+{
+    RRTrace_t trace;
+    double t = 0;
+    while (t < seconds)
+    {
+        trace.breaths.push_back(t);
+        t += 60.0 / rate * uniform(0.9, 1.1);
+    }
+    trace.amplitude = uniform(0.05, 0.2);
+    trace.noise = 0.005;
+    return trace;
+}
+
+double rr_sample(const RRTrace_t &trace, double t)
+{
+    auto next = std::upper_bound(trace.breaths.begin(), trace.breaths.end(), t);
+    double start = *(next - 1);
+    double phase = (t - start) / (*next - start);
+    std::normal_distribution<double> noise(0, trace.noise);
+    return 1000 + 0.02 * t / 60 + trace.amplitude * sin(2 * M_PI * phase) + noise(rng);
+}
+
+// RespiratoryRate::State_t's layout
+typedef struct
+{
+    BreathFilter::State_t filter;
+    uint32_t elapsed_ms;
+    uint8_t source;
+    uint16_t num_periods;
+    double periods[64];
+} RRState_t;
+
+/**
+ * respiratory_rate()'s periods; across_outage differences the crosses in
+ * capture time across the cut instead, as the crosses were once saved.
+ */
+std::vector<double> rr_capture(const RRTrace_t &trace, double seconds, double cut_s, double outage_s, bool across_outage)
+{
+    const double period = 1.0 / BreathFilter::FREQUENCY;
+    std::vector<double> periods;
+    std::vector<double> crosses; // this segment's, capture time
+    double last_before = NAN;
+    BreathFilter* filter = new BreathFilter();
+    double offset = 0;
+
+    int n = 0;
+    for (double t = 0; t <= seconds; t = ++n * period)
+    {
+        if (t >= cut_s && outage_s >= 0)
+        {
+            static RRState_t state;
+            filter->save(state.filter);
+            for (size_t i = 1; i < crosses.size(); i++) periods.push_back(crosses[i] - crosses[i - 1]);
+            state.num_periods = std::min<size_t>(periods.size(), 64);
+            std::copy(periods.end() - state.num_periods, periods.end(), state.periods);
+            checkpoint->save(Checkpoint::TASK_RESPIRATORY_RATE, &state, sizeof(state));
+            delete filter;
+
+            reboot();
+            memset(&state, 0, sizeof(state));
+            if (!checkpoint->load(Checkpoint::TASK_RESPIRATORY_RATE, &state, sizeof(state)))
+            {
+                printf("RR checkpoint didn't load\n");
+                exit(1);
+            }
+
+            filter = new BreathFilter();
+            filter->restore(state.filter);
+            periods.assign(state.periods, state.periods + state.num_periods);
+            if (!crosses.empty()) last_before = crosses.back();
+            crosses.clear();
+            offset = outage_s;
+            cut_s = seconds + 1;
+        }
+
+        double sample = rr_sample(trace, t + offset);
+        if (!filter->is_primed()) filter->prime(sample);
+        if (filter->step(sample))
+        {
+            if (across_outage && crosses.empty() && !std::isnan(last_before))
+            {
+                periods.push_back(t - last_before);
+            }
+            crosses.push_back(t);
+        }
+    }
+
+    for (size_t i = 1; i < crosses.size(); i++) periods.push_back(crosses[i] - crosses[i - 1]);
+    delete filter;
+
+    std::vector<double> rates;
+    for (double p : periods)
+    {
+        double rate = 60.0 / p;
+        if (rate >= 4 && rate <= 60) rates.push_back(rate);
+    }
+    return rates;
+}
+
+void rr_resumes()
+{
+    const double seconds = 30;
+    ResumeTally_t periods, across;
+    double truth_error = 0;
+    int truth_n = 0;
+
+    for (int trial = 0; trial < TRIALS; trial++)
+    {
+        double rate = uniform(8, 25);
+        double cut_s = uniform(5, seconds - 5);
+        double outage_s = uniform(OUTAGE_MIN_S, OUTAGE_MAX_S);
+        RRTrace_t trace = rr_trace(rate, seconds + OUTAGE_MAX_S + 10);
+
+        double whole = mean(rr_capture(trace, seconds, 0, -1, false));
+        if (!std::isnan(whole))
+        {
+            truth_error += fabs(whole - true_rate(trace.breaths, 0, seconds));
+            truth_n++;
+        }
+
+        resume_tally(&periods, whole, mean(rr_capture(trace, seconds, cut_s, outage_s, false)));
+        resume_tally(&across, whole, mean(rr_capture(trace, seconds, cut_s, outage_s, true)));
+    }
+
+    printf("RR, %d trials, %.0f s, outage %.0f-%.0f s (uninterrupted vs truth %.2f BPM)\n", TRIALS, seconds, OUTAGE_MIN_S, OUTAGE_MAX_S, truth_n ? truth_error / truth_n : NAN);
+    printf("  %-34s %6s %6s %5s %5s\n", "", "|err|", "worst", "valid", "lost");
+    print_resume("periods (respiratory_rate)", periods);
+    print_resume("crosses differenced across outage", across);
+    printf("\n");
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    long rounds = argc > 1 ? atol(argv[1]) : 20000;
+
+    PowerTally_t every, random;
+    every_cut(1000, &every);
+    every_cut(1, &every);
+    random_cuts(rounds, &random);
+
+    printf("Power cuts: resumed from the new save / the previous one / torn\n");
+    printf("  every byte of a save and a discard: %ld cuts, %ld / %ld / %ld\n", every.cuts, every.resumed_new, every.resumed_old, every.torn);
+    printf("  %ld random rounds: %ld cuts, %ld / %ld / %ld\n\n", rounds, random.cuts, random.resumed_new, random.resumed_old, random.torn);
+
+    bcg_resumes();
+    rr_resumes();
+
+    printf("|err|: mean absolute difference from the same trace uninterrupted, BPM. lost: the\n");
+    printf("uninterrupted capture had a rate and the resumed one didn't.\n");
+
+    return every.torn + random.torn ? 1 : 0;
+}
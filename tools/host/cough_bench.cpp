@@ -0,0 +1,451 @@
+/**
+ * Cough detection on the host: runs 50 Hz barometer traces through
+ * CoughDetection a FIFO burst at a time, as SensorSession does, and
+ * reports detections against the ground truth and the cost per sample.
+ * It fails if a synthetic scenario falls below MIN_RECALL or above
+ * MAX_FALSE_PER_HOUR.
+ *
+ * The traces are synthetic scenarios, plus any recorded traces given on
+ * the command line:
+ *
+ *   cough_bench [trace.csv ...]
+ *
+ * A recorded trace has one sample per line, "<raw pressure>" (Pa above
+ * 800 hPa, as in the barometer buffer) at 50 Hz, and "# cough <s>"
+ * lines for the coughs in it, if they're known.
+ *
+ * Cycles per sample are host cycles (rdtsc); build the firmware with
+ * COUGH_PROFILING for the Cortex-M4's.
+ */
+
+#include "CoughDetection.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_RDTSC
+#endif
+
+namespace
+{
+
+const int FREQUENCY = CoughDetection::SAMPLING_FREQUENCY;
+const int BURST = 32; // LPS22HB FIFO, read when full
+const double TRACE_SECONDS = 60;
+const int TRIALS = 50; // per synthetic scenario
+const int TIMING_RUNS = 20; // passes over all the traces for the cycle count
+const double MATCH_S = 1.0; // an event this close to a cough's onset finds it
+
+// what each synthetic scenario must reach for the bench to pass, so the thresholds can't drift back
+const double MIN_RECALL = 0.8;
+const double MAX_FALSE_PER_HOUR = 6;
+
+/**
+ * Current model, datasheet typicals, as in mask_check_bench. It's here
+ * to compare the continuous stream with the cough task it replaced,
+ * not to predict battery life.
+ */
+const double MCU_RUN_A = 3.7e-3; // nRF52832 64 MHz from flash, DC/DC
+const double MCU_HZ = 64e6;
+const double BAROMETER_LOW_NOISE_A_PER_HZ = 12e-6; // LPS22HB, 12 uA at 1 Hz, scaled with ODR
+const double BAROMETER_LOW_CURRENT_A_PER_HZ = 3e-6; // 3 uA at 1 Hz with LC_EN
+const double BURST_AWAKE_S = 1.0e-3; // FIFO interrupt, 32 samples over SPI
+const double M4_CYCLES_PER_SAMPLE = 100; // estimate from the op count, single precision FPU; check with COUGH_PROFILING
+
+// the rotation the cough task ran in: RR and HR with a 10 Hz session each, then the cough task
+const double RR_TASK_S = 30;
+const double HR_TASK_S = 15;
+const double COUGH_TASK_S = 30;
+const double SESSION_FREQUENCY = 10;
+
+typedef struct
+{
+    std::string name;
+    std::vector<uint16_t> pressure; // FREQUENCY from t = 0
+    std::vector<double> coughs; // s, onsets
+} Trace_t;
+
+/**
+ * Synthetic scenarios. Pressure swings are peak-to-peak at the LPS22HB
+ * inside the mask. A cough is a fast rise to its peak and a decay, with
+ * up to two smaller follow-on bursts; talking is a burst of 4-8 Hz
+ * syllables.
+ */
+typedef struct
+{
+    const char* name;
+    double breath_lo, breath_hi; // Pa peak-to-peak
+    double bpm_lo, bpm_hi;
+    int coughs; // per trace
+    double cough_lo, cough_hi; // Pa, peak above baseline
+    int talking; // bursts per trace
+    double movement; // Pa, 1.5-2.5 Hz disturbance (walking)
+} Scenario_t;
+
+const Scenario_t SCENARIOS[] =
+{
+    // name                     breath      bpm        coughs  peak         talk  move
+    {"breathing",               20,  60,    10,  20,   0,      0,    0,     0,    0},
+    {"breathing, coughs",       20,  60,    10,  20,   6,      60,   250,   0,    0},
+    {"breathing, weak coughs",  20,  60,    10,  20,   6,      30,   60,    0,    0},
+    {"heavy breathing",         100, 200,   25,  40,   0,      0,    0,     0,    0},
+    {"heavy breathing, coughs", 100, 200,   25,  40,   6,      60,   250,   0,    0},
+    {"talking",                 20,  60,    10,  20,   0,      0,    0,     6,    0},
+    {"talking, coughs",         20,  60,    10,  20,   6,      60,   250,   6,    0},
+    {"walking, coughs",         20,  60,    15,  25,   6,      60,   250,   0,    8},
+};
+
+double uniform(std::mt19937 &rng, double lo, double hi)
+{
+    return std::uniform_real_distribution<double>(lo, hi)(rng);
+}
+
+// a cough's pressure at t s after its onset
+double cough_shape(double t, double peak, double rise, double decay)
+{
+    if (t < 0)
+    {
+        return 0;
+    }
+    if (t < rise)
+    {
+        return peak * t / rise;
+    }
+    return peak * std::exp(-(t - rise) / decay);
+}
+
+Trace_t synthesize(const Scenario_t &scenario, std::mt19937 &rng)
+{
+    std::normal_distribution<double> noise(0, 1.5); // low current mode, modeled
+
+    Trace_t trace;
+    trace.name = scenario.name;
+
+    double bpm = uniform(rng, scenario.bpm_lo, scenario.bpm_hi);
+    double breath = uniform(rng, scenario.breath_lo, scenario.breath_hi);
+    double phase = uniform(rng, 0, 2 * M_PI);
+    double movement_hz = uniform(rng, 1.5, 2.5);
+    double drift = uniform(rng, -0.5, 0.5); // Pa/s, weather and altitude
+    double base_pressure = uniform(rng, 18000, 23000); // raw, 980-1030 hPa
+
+    // events spread over the trace, at least 4 s apart
+    int num_events = scenario.coughs + scenario.talking;
+    double slot = TRACE_SECONDS / (num_events + 1);
+
+    typedef struct
+    {
+        double start;
+        bool cough;
+        double peak[3], rise, decay, gap;
+        int bursts;
+        double length, syllable_hz;
+    } Event_t;
+
+    std::vector<Event_t> events;
+    std::vector<int> kinds(num_events);
+    for (int i = 0; i < num_events; i++)
+    {
+        kinds[i] = i < scenario.coughs;
+    }
+    std::shuffle(kinds.begin(), kinds.end(), rng);
+
+    for (int i = 0; i < num_events; i++)
+    {
+        Event_t event;
+        event.start = slot * (i + 1) + uniform(rng, -0.2, 0.2) * slot;
+        event.cough = kinds[i];
+        event.peak[0] = uniform(rng, scenario.cough_lo, scenario.cough_hi);
+        event.bursts = std::uniform_int_distribution<int>(1, 3)(rng);
+        event.peak[1] = event.peak[0] * uniform(rng, 0.4, 0.8);
+        event.peak[2] = event.peak[1] * uniform(rng, 0.4, 0.8);
+        event.rise = uniform(rng, 0.05, 0.12);
+        event.decay = uniform(rng, 0.06, 0.12);
+        event.gap = uniform(rng, 0.2, 0.3);
+        event.length = uniform(rng, 1.0, 3.0);
+        event.syllable_hz = uniform(rng, 4, 8);
+        events.push_back(event);
+
+        if (event.cough)
+        {
+            trace.coughs.push_back(event.start);
+        }
+    }
+
+    for (int i = 0; i < TRACE_SECONDS * FREQUENCY; i++)
+    {
+        double t = (double)i / FREQUENCY;
+        double pressure = base_pressure + drift * t + noise(rng);
+        pressure += 0.5 * breath * std::sin(2 * M_PI * bpm / 60 * t + phase);
+        pressure += scenario.movement * std::sin(2 * M_PI * movement_hz * t);
+
+        for (const Event_t &event : events)
+        {
+            double dt = t - event.start;
+            if (event.cough)
+            {
+                for (int b = 0; b < event.bursts; b++)
+                {
+                    pressure += cough_shape(dt - b * event.gap, event.peak[b], event.rise, event.decay);
+                }
+            }
+            else if (dt >= 0 && dt < event.length)
+            {
+                // syllables: positive pulses, 20-50 Pa
+                double syllable = std::sin(2 * M_PI * event.syllable_hz * dt);
+                pressure += 35 * std::max(syllable, 0.0);
+            }
+        }
+
+        trace.pressure.push_back((uint16_t)std::lround(pressure));
+    }
+
+    return trace;
+}
+
+bool load(const char* path, Trace_t* trace)
+{
+    FILE* file = fopen(path, "r");
+    if (file == NULL)
+    {
+        return false;
+    }
+
+    trace->name = path;
+
+    char line[128];
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        double onset;
+        if (sscanf(line, "# cough %lf", &onset) == 1)
+        {
+            trace->coughs.push_back(onset);
+            continue;
+        }
+
+        long value;
+        if (line[0] != '#' && sscanf(line, "%ld", &value) == 1)
+        {
+            trace->pressure.push_back((uint16_t)value);
+        }
+    }
+
+    fclose(file);
+    return !trace->pressure.empty();
+}
+
+typedef struct
+{
+    int coughs = 0;
+    int found = 0;
+    int false_events = 0;
+    int events = 0;
+    uint32_t candidates = 0;
+    double seconds = 0;
+} Tally_t;
+
+/**
+ * Feeds the trace through a detector in FIFO bursts and matches its
+ * events to the coughs.
+ */
+void tally(const Trace_t &trace, Tally_t* t)
+{
+    CoughDetection detector;
+    detector.start(nullptr, 0);
+
+    std::vector<CoughDetection::CoughEvent_t> events;
+    for (size_t i = 0; i < trace.pressure.size(); i += BURST)
+    {
+        uint16_t size = std::min((size_t)BURST, trace.pressure.size() - i);
+        detector.process(&trace.pressure[i], size, i);
+
+        CoughDetection::CoughEvent_t event;
+        while (detector.get_event(event))
+        {
+            events.push_back(event);
+        }
+    }
+
+    std::vector<bool> matched(trace.coughs.size(), false);
+    for (const CoughDetection::CoughEvent_t &event : events)
+    {
+        bool found = false;
+        for (size_t c = 0; c < trace.coughs.size(); c++)
+        {
+            if (!matched[c] && std::fabs(event.timestamp - trace.coughs[c]) <= MATCH_S)
+            {
+                matched[c] = true;
+                found = true;
+                break;
+            }
+        }
+        t->false_events += !found;
+    }
+
+    t->coughs += trace.coughs.size();
+    t->found += std::count(matched.begin(), matched.end(), true);
+    t->events += events.size();
+    t->candidates += detector.get_num_candidates();
+    t->seconds += (double)trace.pressure.size() / FREQUENCY;
+}
+
+void print_tally(const std::string &name, const Tally_t &t)
+{
+    printf("  %-26s %6d %6d %6.0f%% %8.2f %8.1f\n", name.c_str(), t.coughs, t.found, t.coughs ? 100.0 * t.found / t.coughs : 100.0,
+        60 * 60 * t.false_events / t.seconds, 60 * t.candidates / t.seconds);
+}
+
+/**
+ * Time just the detector over all the traces, in bursts as above. The
+ * first pass warms the caches and isn't counted.
+ */
+void time_detector(const std::vector<Trace_t> &traces)
+{
+    double samples = 0;
+    double ns = 0;
+    double cycles = 0;
+
+    for (int run = 0; run <= TIMING_RUNS; run++)
+    {
+        for (const Trace_t &trace : traces)
+        {
+            CoughDetection detector;
+            detector.start(nullptr, 0);
+
+            auto start = std::chrono::steady_clock::now();
+#ifdef HAVE_RDTSC
+            uint64_t start_cycles = __rdtsc();
+#endif
+            for (size_t i = 0; i < trace.pressure.size(); i += BURST)
+            {
+                uint16_t size = std::min((size_t)BURST, trace.pressure.size() - i);
+                detector.process(&trace.pressure[i], size, i);
+            }
+#ifdef HAVE_RDTSC
+            uint64_t end_cycles = __rdtsc();
+#endif
+            auto end = std::chrono::steady_clock::now();
+
+            CoughDetection::CoughEvent_t event;
+            while (detector.get_event(event)) {}
+
+            if (run == 0)
+            {
+                continue;
+            }
+
+            samples += trace.pressure.size();
+            ns += std::chrono::duration<double, std::nano>(end - start).count();
+#ifdef HAVE_RDTSC
+            cycles += end_cycles - start_cycles;
+#endif
+        }
+    }
+
+    printf("host: %.1f ns/sample", ns / samples);
+#ifdef HAVE_RDTSC
+    printf(", %.1f cycles/sample (rdtsc)", cycles / samples);
+#endif
+    printf(" over %.0f samples\n\n", samples);
+}
+
+void print_energy_model()
+{
+    double burst_hz = (double)FREQUENCY / BURST;
+
+    double stream_barometer = BAROMETER_LOW_CURRENT_A_PER_HZ * FREQUENCY;
+    double stream_wake = MCU_RUN_A * BURST_AWAKE_S * burst_hz;
+    double stream_process = MCU_RUN_A * M4_CYCLES_PER_SAMPLE * FREQUENCY / MCU_HZ;
+
+    double rotation = RR_TASK_S + HR_TASK_S + COUGH_TASK_S;
+    double task_barometer = (BAROMETER_LOW_NOISE_A_PER_HZ * SESSION_FREQUENCY * (RR_TASK_S + HR_TASK_S)
+        + BAROMETER_LOW_NOISE_A_PER_HZ * FREQUENCY * COUGH_TASK_S) / rotation;
+    double task_wake = MCU_RUN_A * BURST_AWAKE_S * burst_hz * COUGH_TASK_S / rotation; // the 10 Hz sessions' wake-ups count in both
+    double task_process = stream_process * COUGH_TASK_S / rotation;
+
+    printf("modeled average current while the mask is on (uA)\n");
+    printf("  %-28s %10s %10s %10s %10s %9s\n", "", "barometer", "wake-ups", "detector", "total", "coverage");
+    printf("  %-28s %10.1f %10.1f %10.1f %10.1f %8.0f%%\n", "cough task in the rotation", 1e6 * task_barometer, 1e6 * task_wake,
+        1e6 * task_process, 1e6 * (task_barometer + task_wake + task_process), 100 * COUGH_TASK_S / rotation);
+    printf("  %-28s %10.1f %10.1f %10.1f %10.1f %8.0f%%\n", "continuous stream", 1e6 * stream_barometer, 1e6 * stream_wake,
+        1e6 * stream_process, 1e6 * (stream_barometer + stream_wake + stream_process), 100.0);
+    printf("\n");
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    std::vector<std::string> names;
+    std::vector<Tally_t> tallies;
+    std::vector<Trace_t> traces;
+    Tally_t total;
+
+    std::mt19937 rng(2022);
+    for (const Scenario_t &scenario : SCENARIOS)
+    {
+        Tally_t t;
+        for (int i = 0; i < TRIALS; i++)
+        {
+            Trace_t trace = synthesize(scenario, rng);
+            tally(trace, &t);
+            tally(trace, &total);
+            traces.push_back(trace);
+        }
+        names.push_back(scenario.name);
+        tallies.push_back(t);
+    }
+
+    for (int i = 1; i < argc; i++)
+    {
+        Trace_t trace;
+        if (!load(argv[i], &trace))
+        {
+            fprintf(stderr, "%s: can't read it\n", argv[i]);
+            return 1;
+        }
+
+        Tally_t t;
+        tally(trace, &t);
+        tally(trace, &total);
+        traces.push_back(trace);
+        names.push_back(argv[i]);
+        tallies.push_back(t);
+    }
+
+    printf("  %-26s %6s %6s %7s %8s %8s\n", "", "coughs", "found", "recall", "false/h", "cand/min");
+    for (size_t i = 0; i < names.size(); i++)
+    {
+        print_tally(names[i], tallies[i]);
+    }
+    print_tally("all", total);
+    printf("\n");
+
+    time_detector(traces);
+    print_energy_model();
+
+    printf("found: coughs with an event within %.0f s of their onset. false/h: events that matched no\n", MATCH_S);
+    printf("cough, per hour. cand/min: candidates that reached the checks in _end_event(), per minute.\n");
+
+    int failed = 0;
+    for (size_t i = 0; i < sizeof(SCENARIOS) / sizeof(SCENARIOS[0]); i++)
+    {
+        const Tally_t &t = tallies[i];
+        double false_per_hour = 60 * 60 * t.false_events / t.seconds;
+        if ((t.coughs && t.found < MIN_RECALL * t.coughs) || false_per_hour > MAX_FALSE_PER_HOUR)
+        {
+            printf("FAIL: %s, want %.0f%% recall and at most %.0f false/h\n", names[i].c_str(), 100 * MIN_RECALL, MAX_FALSE_PER_HOUR);
+            failed++;
+        }
+    }
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,62 @@
+/**
+ * Host stand-in for iir-filter-kit's BiQuad.h, for the tools/host
+ * harnesses. Same interface and the same transposed direct form II
+ * arithmetic, so filtered values match the firmware's.
+ */
+
+#ifndef BIQUAD_H
+#define BIQUAD_H
+
+#include <vector>
+
+class BiQuad
+{
+public:
+    BiQuad(double b0, double b1, double b2, double a0, double a1, double a2)
+    {
+        B[0] = b0 / a0;
+        B[1] = b1 / a0;
+        B[2] = b2 / a0;
+        A[0] = a1 / a0;
+        A[1] = a2 / a0;
+        wz[0] = 0;
+        wz[1] = 0;
+    }
+
+    double step(double x)
+    {
+        double y = B[0] * x + wz[0];
+        wz[0] = B[1] * x - A[0] * y + wz[1];
+        wz[1] = B[2] * x - A[1] * y;
+        return y;
+    }
+
+private:
+    double B[3];
+    double A[2];
+    double wz[2];
+};
+
+class BiQuadChain
+{
+public:
+    BiQuadChain &add(BiQuad *bq)
+    {
+        biquads.push_back(bq);
+        return *this;
+    }
+
+    double step(double x)
+    {
+        for (BiQuad *bq : biquads)
+        {
+            x = bq->step(x);
+        }
+        return x;
+    }
+
+private:
+    std::vector<BiQuad*> biquads;
+};
+
+#endif // BIQUAD_H
@@ -0,0 +1,56 @@
+/**
+ * Host stand-in for FRAM.h: 128 KiB in RAM, with a power cut that can
+ * be armed to land after a given number of written bytes. Writes go
+ * byte by byte, the worst case for a torn write; once the power is cut
+ * nothing more is written until power_on().
+ */
+
+#ifndef FRAM_H_
+#define FRAM_H_
+
+#include <stdint.h>
+#include <string.h>
+
+class FRAM
+{
+public:
+    static const uint32_t SIZE = 0x20000;
+
+    bool write_bytes(uint32_t address, const char *tx_buffer, int tx_bytes)
+    {
+        for (int i = 0; i < tx_bytes; i++)
+        {
+            if (_budget == 0)
+            {
+                _cut = true;
+                return false;
+            }
+            if (_budget > 0) _budget--;
+
+            _memory[(address + i) % SIZE] = tx_buffer[i];
+        }
+        return true;
+    }
+
+    uint8_t read_bytes(uint32_t address, char *rx_buffer, int rx_bytes)
+    {
+        for (int i = 0; i < rx_bytes; i++)
+        {
+            rx_buffer[i] = _memory[(address + i) % SIZE];
+        }
+        return true;
+    }
+
+    void hold_power(bool hold) {}
+
+    void cut_after(long bytes) { _budget = bytes; _cut = false; } // -1 never
+    void power_on() { _budget = -1; _cut = false; }
+    bool is_cut() { return _cut; }
+
+private:
+    uint8_t _memory[SIZE] = {0};
+    long _budget = -1;
+    bool _cut = false;
+};
+
+#endif // FRAM_H_
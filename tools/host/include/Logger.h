@@ -0,0 +1,35 @@
+/**
+ * Host stand-in for Logger.h. log() prints when HOST_LOGGING is set in
+ * the environment, and is silent otherwise.
+ */
+
+#ifndef LOGGER_H_
+#define LOGGER_H_
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "LogLevel.h"
+
+class Logger
+{
+public:
+    static Logger* get_instance()
+    {
+        static Logger instance;
+        return &instance;
+    }
+
+    void log(trace_level_t level, const char *msg, ...)
+    {
+        if (getenv("HOST_LOGGING") == nullptr) return;
+
+        va_list args;
+        va_start(args, msg);
+        vprintf(msg, args);
+        va_end(args);
+        printf("\n");
+    }
+};
+
+#endif // LOGGER_H_
@@ -0,0 +1,15 @@
+/**
+ * Host stand-in for TARGET_SMARTPPE/PinNames.h: the pins the host
+ * harnesses' drivers name, with the board's numbers.
+ */
+
+#ifndef MBED_PINNAMES_H
+#define MBED_PINNAMES_H
+
+#include "nrf52.h"
+
+const PinName VCAP = 3;
+const PinName VCAP_ENABLE = 5;
+const PinName STDIO_UART_TX = 6;
+
+#endif // MBED_PINNAMES_H
@@ -0,0 +1,479 @@
+/**
+ * Host fake of the parts of mbed's BLE API that SmartPPEService and
+ * ConnectionManager use: Gap, GattServer and GattClient, with the
+ * characteristic and event types they take. Use with the nrf52.h
+ * stand-in, for its simulated time and mbed::Callback.
+ *
+ * The device side behaves as the API does: GattServer keeps each
+ * characteristic's value, write() notifies a subscribed phone, read()
+ * returns what the phone last wrote. Nothing happens over the air on its
+ * own; the phone's side is the harness. It hooks the device's requests
+ * (on_write, on_advertising, on_disconnect, on_update, on_negotiate_mtu)
+ * and answers through the client_* and *_complete calls, which run the
+ * stack's event handlers as the BLE thread would.
+ */
+
+#ifndef BLE_H_FAKE
+#define BLE_H_FAKE
+
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+enum ble_error_t
+{
+    BLE_ERROR_NONE = 0,
+    BLE_ERROR_INVALID_STATE = 6,
+    BLE_ERROR_OPERATION_NOT_PERMITTED = 9
+};
+
+namespace ble
+{
+    typedef uint16_t connection_handle_t;
+    typedef uint8_t advertising_handle_t;
+
+    const advertising_handle_t LEGACY_ADVERTISING_HANDLE = 0;
+
+    // link layer units: 1.25 ms, connection events, 10 ms
+    template <typename Tag>
+    class LinkValue
+    {
+    public:
+        explicit LinkValue(uint16_t value = 0) : _value(value) {}
+        uint16_t value() const { return _value; }
+
+    private:
+        uint16_t _value;
+    };
+
+    typedef LinkValue<struct conn_interval_tag> conn_interval_t;
+    typedef LinkValue<struct slave_latency_tag> slave_latency_t;
+    typedef LinkValue<struct supervision_timeout_tag> supervision_timeout_t;
+
+    struct phy_t
+    {
+        uint8_t value = 1;
+    };
+
+    struct local_disconnection_reason_t
+    {
+        enum type
+        {
+            USER_TERMINATION = 0x13
+        };
+
+        local_disconnection_reason_t(type value) : value(value) {}
+        type value;
+    };
+
+    class ConnectionCompleteEvent
+    {
+    public:
+        ConnectionCompleteEvent(ble_error_t status, connection_handle_t handle, conn_interval_t interval, slave_latency_t latency, supervision_timeout_t timeout) :
+        _status(status), _handle(handle), _interval(interval), _latency(latency), _timeout(timeout) {}
+
+        ble_error_t getStatus() const { return _status; }
+        connection_handle_t getConnectionHandle() const { return _handle; }
+        conn_interval_t getConnectionInterval() const { return _interval; }
+        slave_latency_t getConnectionLatency() const { return _latency; }
+        supervision_timeout_t getSupervisionTimeout() const { return _timeout; }
+
+    private:
+        ble_error_t _status;
+        connection_handle_t _handle;
+        conn_interval_t _interval;
+        slave_latency_t _latency;
+        supervision_timeout_t _timeout;
+    };
+
+    class DisconnectionCompleteEvent
+    {
+    public:
+        DisconnectionCompleteEvent(connection_handle_t handle) : _handle(handle) {}
+        connection_handle_t getConnectionHandle() const { return _handle; }
+
+    private:
+        connection_handle_t _handle;
+    };
+
+    class ConnectionParametersUpdateCompleteEvent
+    {
+    public:
+        ConnectionParametersUpdateCompleteEvent(ble_error_t status, connection_handle_t handle, conn_interval_t interval, slave_latency_t latency, supervision_timeout_t timeout) :
+        _status(status), _handle(handle), _interval(interval), _latency(latency), _timeout(timeout) {}
+
+        ble_error_t getStatus() const { return _status; }
+        connection_handle_t getConnectionHandle() const { return _handle; }
+        conn_interval_t getConnectionInterval() const { return _interval; }
+        slave_latency_t getSlaveLatency() const { return _latency; }
+        supervision_timeout_t getSupervisionTimeout() const { return _timeout; }
+
+    private:
+        ble_error_t _status;
+        connection_handle_t _handle;
+        conn_interval_t _interval;
+        slave_latency_t _latency;
+        supervision_timeout_t _timeout;
+    };
+
+    class UpdateConnectionParametersRequestEvent {};
+    class AdvertisingEndEvent {};
+
+    class Gap
+    {
+    public:
+        class EventHandler
+        {
+        public:
+            virtual ~EventHandler() {}
+            virtual void onConnectionComplete(const ConnectionCompleteEvent &event) {}
+            virtual void onDisconnectionComplete(const DisconnectionCompleteEvent &event) {}
+            virtual void onConnectionParametersUpdateComplete(const ConnectionParametersUpdateCompleteEvent &event) {}
+            virtual void onUpdateConnectionParametersRequest(const UpdateConnectionParametersRequestEvent &event) {}
+            virtual void onDataLengthChange(connection_handle_t connectionHandle, uint16_t txSize, uint16_t rxSize) {}
+            virtual void onPhyUpdateComplete(ble_error_t status, connection_handle_t connectionHandle, phy_t txPhy, phy_t rxPhy) {}
+            virtual void onReadPhy(ble_error_t status, connection_handle_t connectionHandle, phy_t txPhy, phy_t rxPhy) {}
+            virtual void onAdvertisingEnd(const AdvertisingEndEvent &event) {}
+        };
+
+        void setEventHandler(EventHandler *handler) { _handler = handler; }
+
+        bool isAdvertisingActive(advertising_handle_t handle) { return _advertising; }
+
+        ble_error_t startAdvertising(advertising_handle_t handle)
+        {
+            _set_advertising(true);
+            return BLE_ERROR_NONE;
+        }
+
+        ble_error_t stopAdvertising(advertising_handle_t handle)
+        {
+            _set_advertising(false);
+            return BLE_ERROR_NONE;
+        }
+
+        ble_error_t disconnect(connection_handle_t handle, local_disconnection_reason_t reason)
+        {
+            if (!_connected) return BLE_ERROR_INVALID_STATE;
+            if (on_disconnect) on_disconnect();
+            return BLE_ERROR_NONE;
+        }
+
+        ble_error_t updateConnectionParameters(connection_handle_t handle, conn_interval_t min_interval, conn_interval_t max_interval, slave_latency_t latency, supervision_timeout_t timeout)
+        {
+            if (!_connected) return BLE_ERROR_INVALID_STATE;
+            return on_update ? on_update(min_interval.value(), max_interval.value(), latency.value(), timeout.value()) : BLE_ERROR_NONE;
+        }
+
+        // the phone's side
+
+        bool is_connected() { return _connected; }
+
+        // a connection stops advertising, as it does for a legacy connectable set
+        void connection_complete(connection_handle_t handle, uint16_t interval, uint16_t latency, uint16_t timeout)
+        {
+            _connected = true;
+            _set_advertising(false);
+            if (_handler) _handler->onConnectionComplete(ConnectionCompleteEvent(BLE_ERROR_NONE, handle, conn_interval_t(interval), slave_latency_t(latency), supervision_timeout_t(timeout)));
+        }
+
+        void disconnection_complete(connection_handle_t handle)
+        {
+            _connected = false;
+            if (_handler) _handler->onDisconnectionComplete(DisconnectionCompleteEvent(handle));
+        }
+
+        void update_complete(ble_error_t status, connection_handle_t handle, uint16_t interval, uint16_t latency, uint16_t timeout)
+        {
+            if (_handler) _handler->onConnectionParametersUpdateComplete(ConnectionParametersUpdateCompleteEvent(status, handle, conn_interval_t(interval), slave_latency_t(latency), supervision_timeout_t(timeout)));
+        }
+
+        std::function<void(bool)> on_advertising;
+        std::function<void()> on_disconnect;
+        std::function<ble_error_t(uint16_t, uint16_t, uint16_t, uint16_t)> on_update; // min, max interval, latency, timeout
+
+    private:
+        void _set_advertising(bool advertising)
+        {
+            if (_advertising == advertising) return;
+            _advertising = advertising;
+            if (on_advertising) on_advertising(advertising);
+        }
+
+        EventHandler *_handler = nullptr;
+        bool _advertising = false;
+        bool _connected = false;
+    };
+}
+
+class UUID
+{
+public:
+    UUID(const char *uuid) : _uuid(uuid) {}
+    bool operator==(const char *uuid) const { return strcasecmp(_uuid.c_str(), uuid) == 0; }
+
+private:
+    std::string _uuid;
+};
+
+class GattAttribute
+{
+public:
+    typedef uint16_t Handle_t;
+    static const Handle_t INVALID_HANDLE = 0;
+};
+
+enum GattAuthCallbackReply_t
+{
+    AUTH_CALLBACK_REPLY_SUCCESS = 0
+};
+
+struct GattReadAuthCallbackParams
+{
+    ble::connection_handle_t connHandle;
+    GattAttribute::Handle_t handle;
+    uint16_t offset;
+    uint16_t len;
+    uint8_t *data;
+    GattAuthCallbackReply_t authorizationReply;
+};
+
+struct GattWriteCallbackParams
+{
+    ble::connection_handle_t connHandle;
+    GattAttribute::Handle_t handle;
+    uint16_t offset;
+    uint16_t len;
+    const uint8_t *data;
+};
+
+struct GattUpdatesEnabledCallbackParams
+{
+    ble::connection_handle_t connHandle;
+    GattAttribute::Handle_t attHandle;
+};
+
+struct GattDataSentCallbackParams
+{
+    ble::connection_handle_t connHandle;
+    GattAttribute::Handle_t attHandle;
+};
+
+class GattCharacteristic
+{
+public:
+    enum
+    {
+        BLE_GATT_CHAR_PROPERTIES_NONE = 0x00,
+        BLE_GATT_CHAR_PROPERTIES_READ = 0x02,
+        BLE_GATT_CHAR_PROPERTIES_WRITE = 0x08,
+        BLE_GATT_CHAR_PROPERTIES_NOTIFY = 0x10
+    };
+
+    GattCharacteristic(const UUID &uuid, const void *initial, uint16_t initial_length, uint16_t max_length, uint8_t properties) :
+    uuid(uuid), properties(properties), max_length(max_length), value((const uint8_t *)initial, (const uint8_t *)initial + initial_length)
+    {
+        value.resize(max_length);
+    }
+
+    GattAttribute::Handle_t getValueHandle() const { return handle; }
+
+    template <typename T>
+    void setReadAuthorizationCallback(T *object, void (T::*member)(GattReadAuthCallbackParams *))
+    {
+        read_authorization = [object, member](GattReadAuthCallbackParams *params) { (object->*member)(params); };
+    }
+
+    UUID uuid;
+    uint8_t properties;
+    uint16_t max_length;
+    std::vector<uint8_t> value;
+    bool subscribed = false;
+    GattAttribute::Handle_t handle = GattAttribute::INVALID_HANDLE;
+    std::function<void(GattReadAuthCallbackParams *)> read_authorization;
+};
+
+template <typename T, unsigned N>
+class ReadOnlyArrayGattCharacteristic : public GattCharacteristic
+{
+public:
+    ReadOnlyArrayGattCharacteristic(const UUID &uuid, T *initial, uint8_t properties = BLE_GATT_CHAR_PROPERTIES_NONE) :
+    GattCharacteristic(uuid, initial, sizeof(T), sizeof(T) * N, BLE_GATT_CHAR_PROPERTIES_READ | properties) {}
+};
+
+template <typename T>
+class ReadWriteGattCharacteristic : public GattCharacteristic
+{
+public:
+    ReadWriteGattCharacteristic(const UUID &uuid, T *initial, uint8_t properties = BLE_GATT_CHAR_PROPERTIES_NONE) :
+    GattCharacteristic(uuid, initial, sizeof(T), sizeof(T), BLE_GATT_CHAR_PROPERTIES_READ | BLE_GATT_CHAR_PROPERTIES_WRITE | properties) {}
+};
+
+class GattService
+{
+public:
+    GattService(const UUID &uuid, GattCharacteristic *characteristics[], unsigned count) :
+    characteristics(characteristics, characteristics + count) {}
+
+    std::vector<GattCharacteristic *> characteristics;
+};
+
+namespace ble
+{
+    class GattServer
+    {
+    public:
+        class EventHandler
+        {
+        public:
+            virtual ~EventHandler() {}
+            virtual void onAttMtuChange(connection_handle_t connectionHandle, uint16_t attMtuSize) {}
+            virtual void onUpdatesEnabled(const GattUpdatesEnabledCallbackParams &params) {}
+            virtual void onDataWritten(const GattWriteCallbackParams &params) {}
+            virtual void onDataSent(const GattDataSentCallbackParams &params) {}
+        };
+
+        // handles go declaration, value, CCCD, as a stack lays them out
+        ble_error_t addService(GattService &service)
+        {
+            for (GattCharacteristic *characteristic : service.characteristics)
+            {
+                characteristic->handle = _next_handle + 1;
+                _next_handle += 3;
+                _characteristics.push_back(characteristic);
+            }
+            return BLE_ERROR_NONE;
+        }
+
+        void setEventHandler(EventHandler *handler) { _handler = handler; }
+
+        ble_error_t write(GattAttribute::Handle_t handle, const uint8_t *data, uint16_t length, bool localOnly = false)
+        {
+            GattCharacteristic *characteristic = find(handle);
+            if (characteristic == nullptr || length > characteristic->max_length) return BLE_ERROR_OPERATION_NOT_PERMITTED;
+
+            characteristic->value.assign(data, data + length);
+            bool notified = characteristic->subscribed && (characteristic->properties & GattCharacteristic::BLE_GATT_CHAR_PROPERTIES_NOTIFY);
+            if (on_write) on_write(handle, notified);
+            return BLE_ERROR_NONE;
+        }
+
+        ble_error_t read(GattAttribute::Handle_t handle, uint8_t *data, uint16_t *length)
+        {
+            GattCharacteristic *characteristic = find(handle);
+            if (characteristic == nullptr) return BLE_ERROR_OPERATION_NOT_PERMITTED;
+
+            if (*length > characteristic->value.size()) *length = characteristic->value.size();
+            memcpy(data, characteristic->value.data(), *length);
+            return BLE_ERROR_NONE;
+        }
+
+        ble_error_t areUpdatesEnabled(const GattCharacteristic &characteristic, bool *enabled)
+        {
+            *enabled = characteristic.subscribed;
+            return BLE_ERROR_NONE;
+        }
+
+        // the phone's side
+
+        GattCharacteristic *find(GattAttribute::Handle_t handle)
+        {
+            for (GattCharacteristic *characteristic : _characteristics)
+            {
+                if (characteristic->handle == handle) return characteristic;
+            }
+            return nullptr;
+        }
+
+        GattCharacteristic *find(const char *uuid)
+        {
+            for (GattCharacteristic *characteristic : _characteristics)
+            {
+                if (characteristic->uuid == uuid) return characteristic;
+            }
+            return nullptr;
+        }
+
+        // a whole value, as the phone gets it with a read and read blobs
+        std::vector<uint8_t> client_read(connection_handle_t connection, GattAttribute::Handle_t handle)
+        {
+            GattCharacteristic *characteristic = find(handle);
+            if (characteristic->read_authorization)
+            {
+                GattReadAuthCallbackParams params = {connection, handle, 0, 0, nullptr, AUTH_CALLBACK_REPLY_SUCCESS};
+                characteristic->read_authorization(&params);
+            }
+            return characteristic->value;
+        }
+
+        void client_write(connection_handle_t connection, GattAttribute::Handle_t handle, const uint8_t *data, uint16_t length)
+        {
+            GattCharacteristic *characteristic = find(handle);
+            characteristic->value.assign(data, data + length);
+            if (_handler) _handler->onDataWritten({connection, handle, 0, length, data});
+        }
+
+        void client_subscribe(connection_handle_t connection, GattAttribute::Handle_t handle, bool subscribed)
+        {
+            find(handle)->subscribed = subscribed;
+            if (subscribed && _handler) _handler->onUpdatesEnabled({connection, handle});
+        }
+
+        // the phone has the notification the device queued on handle
+        void data_sent(connection_handle_t connection, GattAttribute::Handle_t handle)
+        {
+            if (_handler) _handler->onDataSent({connection, handle});
+        }
+
+        void att_mtu_changed(connection_handle_t connection, uint16_t mtu)
+        {
+            if (_handler) _handler->onAttMtuChange(connection, mtu);
+        }
+
+        // subscriptions don't outlive the link
+        void disconnected()
+        {
+            for (GattCharacteristic *characteristic : _characteristics) characteristic->subscribed = false;
+        }
+
+        std::function<void(GattAttribute::Handle_t, bool)> on_write; // handle, notified
+
+    private:
+        std::vector<GattCharacteristic *> _characteristics;
+        EventHandler *_handler = nullptr;
+        GattAttribute::Handle_t _next_handle = 0;
+    };
+
+    class GattClient
+    {
+    public:
+        ble_error_t negotiateAttMtu(connection_handle_t connection)
+        {
+            if (on_negotiate_mtu) on_negotiate_mtu();
+            return BLE_ERROR_NONE;
+        }
+
+        std::function<void()> on_negotiate_mtu;
+    };
+
+    class BLE
+    {
+    public:
+        Gap &gap() { return _gap; }
+        GattServer &gattServer() { return _server; }
+        GattClient &gattClient() { return _client; }
+
+    private:
+        Gap _gap;
+        GattServer _server;
+        GattClient _client;
+    };
+}
+
+using ble::BLE;
+using ble::GattServer;
+
+#endif // BLE_H_FAKE
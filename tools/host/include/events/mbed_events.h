@@ -0,0 +1,30 @@
+/**
+ * Host stand-in for mbed's EventQueue, on the nrf52.h simulated time.
+ * call() runs the callback as the next thing at the current time, once
+ * the calling code sleeps or waits, as the BLE thread picks it up on
+ * target.
+ */
+
+#ifndef MBED_EVENTS_H
+#define MBED_EVENTS_H
+
+#include <functional>
+
+namespace events
+{
+    class EventQueue
+    {
+    public:
+        template <typename F>
+        int call(F f)
+        {
+            sim::schedule(sim::now_us(), this, std::function<void()>(f));
+            return ++_id;
+        }
+
+    private:
+        int _id = 0;
+    };
+}
+
+#endif // MBED_EVENTS_H
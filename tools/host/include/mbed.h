@@ -0,0 +1,112 @@
+/**
+ * Host stand-in for the parts of mbed.h the tools/host harnesses
+ * compile against: MbedCRC (CRC-32 as mbed computes it), CircularBuffer
+ * and Mutex.
+ */
+
+#ifndef MBED_H
+#define MBED_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <cstring>
+#include <chrono>
+
+enum crc_polynomial
+{
+    POLY_32BIT_ANSI = 0x04C11DB7
+};
+
+template <uint32_t polynomial, int width>
+class MbedCRC
+{
+public:
+    int compute(const void *buffer, size_t size, uint32_t *crc)
+    {
+        compute_partial_start(crc);
+        compute_partial(buffer, size, crc);
+        return compute_partial_stop(crc);
+    }
+
+    int compute_partial_start(uint32_t *crc)
+    {
+        *crc = 0xFFFFFFFF;
+        return 0;
+    }
+
+    // reflected, like the table mbed uses for POLY_32BIT_ANSI
+    int compute_partial(const void *buffer, size_t size, uint32_t *crc)
+    {
+        const uint8_t *data = (const uint8_t *)buffer;
+        for (size_t i = 0; i < size; i++)
+        {
+            *crc ^= data[i];
+            for (int bit = 0; bit < 8; bit++)
+            {
+                *crc = (*crc >> 1) ^ (0xEDB88320 & -(*crc & 1));
+            }
+        }
+        return 0;
+    }
+
+    int compute_partial_stop(uint32_t *crc)
+    {
+        *crc ^= 0xFFFFFFFF;
+        return 0;
+    }
+};
+
+// push() over a full buffer drops the oldest, as mbed's does
+template <typename T, uint32_t BufferSize>
+class CircularBuffer
+{
+public:
+    void push(const T &data)
+    {
+        _pool[(_head + _size) % BufferSize] = data;
+        if (_size < BufferSize) _size++;
+        else _head = (_head + 1) % BufferSize;
+    }
+
+    bool pop(T &data)
+    {
+        if (_size == 0) return false;
+        data = _pool[_head];
+        _head = (_head + 1) % BufferSize;
+        _size--;
+        return true;
+    }
+
+    bool peek(T &data) const
+    {
+        if (_size == 0) return false;
+        data = _pool[_head];
+        return true;
+    }
+
+    bool empty() const { return _size == 0; }
+    bool full() const { return _size == BufferSize; }
+    uint32_t size() const { return _size; }
+    void reset() { _head = 0; _size = 0; }
+
+private:
+    T _pool[BufferSize];
+    uint32_t _head = 0;
+    uint32_t _size = 0;
+};
+
+namespace rtos
+{
+    class Mutex // the harnesses are single threaded
+    {
+    public:
+        void lock() {}
+        void unlock() {}
+    };
+}
+
+using namespace rtos;
+
+#endif // MBED_H
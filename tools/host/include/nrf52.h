@@ -0,0 +1,474 @@
+/**
+ * Host stand-ins for the nRF52832 peripheral registers and the mbed timers,
+ * pins and event flags that firmware drivers in src/ use, for harnesses
+ * that force-include this header. Time is simulated: sim::run_until(),
+ * ThisThread::sleep_for(), wait_us() and EventFlags waits advance it,
+ * firing LowPowerTimeout callbacks in order. Before time moves, each
+ * registered peripheral model gets to act on the tasks the code under test
+ * triggered, so a model sees a register write at the simulated time it was
+ * made. Interrupt handlers installed with NVIC_SetVector() are for the
+ * models to call.
+ *
+ * AnalogIn reads go through sim_analog_read(), which the harness using
+ * them defines.
+ */
+
+#ifndef NRF52_H
+#define NRF52_H
+
+#include "mbed.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <chrono>
+#include <functional>
+#include <vector>
+
+using namespace std::chrono_literals;
+
+typedef uint32_t PinName;
+
+namespace sim
+{
+    struct Event
+    {
+        uint64_t due_us;
+        uint64_t seq;
+        const void* owner;
+        bool timer; // a LowPowerTimeout firing, i.e. an interrupt on target
+        std::function<void()> fn;
+    };
+
+    struct State
+    {
+        uint64_t now_us = 0;
+        uint64_t seq = 0;
+        uint32_t timer_fires = 0;
+        uint32_t critical_sections = 0;
+        std::vector<Event> events;
+        std::vector<std::function<void()>> models;
+    };
+
+    inline State& state()
+    {
+        static State s;
+        return s;
+    }
+
+    inline uint64_t now_us() { return state().now_us; }
+
+    inline void schedule(uint64_t due_us, const void* owner, std::function<void()> fn, bool timer = false)
+    {
+        state().events.push_back({due_us, state().seq++, owner, timer, fn});
+    }
+
+    inline void cancel(const void* owner)
+    {
+        std::vector<Event>& events = state().events;
+        for (size_t i = 0; i < events.size();)
+        {
+            if (events[i].owner == owner) events.erase(events.begin() + i);
+            else i++;
+        }
+    }
+
+    inline void run_models()
+    {
+        for (auto& model : state().models) model();
+    }
+
+    // fire the next event due by t and return true, or move the clock to t
+    inline bool run_one(uint64_t t)
+    {
+        State& s = state();
+        run_models();
+
+        size_t next = s.events.size();
+        for (size_t i = 0; i < s.events.size(); i++)
+        {
+            const Event& e = s.events[i];
+            if (e.due_us > t) continue;
+            if (next == s.events.size() || e.due_us < s.events[next].due_us
+                || (e.due_us == s.events[next].due_us && e.seq < s.events[next].seq))
+            {
+                next = i;
+            }
+        }
+
+        if (next == s.events.size())
+        {
+            if (t > s.now_us) s.now_us = t;
+            run_models();
+            return false;
+        }
+
+        Event e = s.events[next];
+        s.events.erase(s.events.begin() + next);
+        if (e.due_us > s.now_us) s.now_us = e.due_us;
+        if (e.timer) s.timer_fires++;
+        e.fn();
+        return true;
+    }
+
+    // fire everything due up to and including t, then leave the clock at t
+    inline void run_until(uint64_t t)
+    {
+        while (run_one(t));
+    }
+
+    inline uint32_t* gpio_out()
+    {
+        static uint32_t pins[48] = {0};
+        return pins;
+    }
+}
+
+inline void core_util_critical_section_enter() { sim::state().critical_sections++; }
+inline void core_util_critical_section_exit() {}
+
+namespace mbed
+{
+    template <typename F>
+    using Callback = std::function<F>;
+}
+
+template <typename T, typename M>
+std::function<void()> callback(T* obj, void (M::*method)())
+{
+    return [obj, method]() { (obj->*method)(); };
+}
+
+class LowPowerTimeout
+{
+public:
+    ~LowPowerTimeout() { detach(); }
+
+    void attach(std::function<void()> fn, std::chrono::microseconds delay)
+    {
+        detach();
+        sim::schedule(sim::now_us() + delay.count(), this, fn, true);
+    }
+
+    void detach() { sim::cancel(this); }
+};
+
+class LowPowerTimer
+{
+public:
+    void start()
+    {
+        if (!_running) _started_us = sim::now_us();
+        _running = true;
+    }
+
+    void stop()
+    {
+        if (_running) _elapsed_us += sim::now_us() - _started_us;
+        _running = false;
+    }
+
+    void reset()
+    {
+        _elapsed_us = 0;
+        _started_us = sim::now_us();
+    }
+
+    std::chrono::microseconds elapsed_time()
+    {
+        return std::chrono::microseconds(_elapsed_us + (_running ? sim::now_us() - _started_us : 0));
+    }
+
+private:
+    bool _running = false;
+    uint64_t _started_us = 0;
+    uint64_t _elapsed_us = 0;
+};
+
+inline void wait_us(int us)
+{
+    sim::run_until(sim::now_us() + us);
+}
+
+#define MBED_ASSERT(expr) ((void)(expr))
+
+namespace Kernel
+{
+    struct Clock
+    {
+        typedef std::chrono::milliseconds duration;
+        typedef std::chrono::duration<uint32_t, std::milli> duration_u32;
+        typedef std::chrono::time_point<Clock, duration> time_point;
+
+        static time_point now() { return time_point(duration(sim::now_us() / 1000)); }
+    };
+}
+
+inline void set_time(time_t t) {} // time(NULL) stays the host's
+
+#define MBED_SECTION(name)
+
+#define osFlagsError 0x80000000U
+#define osFlagsErrorTimeout 0xFFFFFFFEU
+
+class EventFlags
+{
+public:
+    uint32_t set(uint32_t flags)
+    {
+        _flags |= flags;
+        return _flags;
+    }
+
+    uint32_t clear(uint32_t flags = 0x7fffffff)
+    {
+        uint32_t old = _flags;
+        _flags &= ~flags;
+        return old;
+    }
+
+    uint32_t get() const { return _flags; }
+
+    uint32_t wait_any_for(uint32_t flags, Kernel::Clock::duration_u32 timeout, bool clear = true)
+    {
+        uint64_t deadline = sim::now_us() + std::chrono::duration_cast<std::chrono::microseconds>(timeout).count();
+        while ((_flags & flags) == 0)
+        {
+            if (sim::now_us() >= deadline) return osFlagsErrorTimeout;
+            sim::run_one(deadline);
+        }
+
+        uint32_t result = _flags;
+        if (clear) _flags &= ~flags;
+        return result;
+    }
+
+private:
+    volatile uint32_t _flags = 0;
+};
+
+class DigitalOut
+{
+public:
+    DigitalOut(PinName pin, int value = 0) : _pin(pin) { write(value); }
+
+    void write(int value) { sim::gpio_out()[_pin] = value; }
+    int read() { return sim::gpio_out()[_pin]; }
+    DigitalOut& operator=(int value) { write(value); return *this; }
+    operator int() { return read(); }
+
+private:
+    PinName _pin;
+};
+
+float sim_analog_read(PinName pin); // volts at the pin, defined by the harness
+
+class AnalogIn
+{
+public:
+    AnalogIn(PinName pin, float vref = 3.3f) : _pin(pin), _vref(vref) {}
+
+    void set_reference_voltage(float vref) { _vref = vref; }
+
+    // 12-bit conversion, as mbed's nRF52 AnalogIn
+    float read_voltage()
+    {
+        float v = sim_analog_read(_pin);
+        if (v < 0) v = 0;
+        if (v > _vref) v = _vref;
+        return (int)(v / _vref * 4095 + 0.5f) * _vref / 4095;
+    }
+
+private:
+    PinName _pin;
+    float _vref;
+};
+
+namespace ThisThread
+{
+    template <typename Rep, typename Period>
+    void sleep_for(std::chrono::duration<Rep, Period> duration)
+    {
+        sim::run_until(sim::now_us() + std::chrono::duration_cast<std::chrono::microseconds>(duration).count());
+    }
+}
+
+namespace mbed
+{
+    class FileHandle
+    {
+    public:
+        virtual ~FileHandle() {}
+        virtual ssize_t read(void* buffer, size_t size) = 0;
+        virtual ssize_t write(const void* buffer, size_t size) = 0;
+        virtual off_t seek(off_t offset, int whence = SEEK_SET) = 0;
+        virtual int close() = 0;
+        virtual int sync() { return 0; }
+        virtual int isatty() { return false; }
+    };
+}
+
+using namespace mbed;
+
+// POWER
+
+typedef struct
+{
+    volatile uint32_t RESETREAS;
+} NRF_POWER_Type;
+
+inline NRF_POWER_Type* nrf_power()
+{
+    static NRF_POWER_Type power;
+    return &power;
+}
+
+#define NRF_POWER (nrf_power())
+
+// GPIO
+
+typedef struct
+{
+    volatile uint32_t OUTSET;
+    volatile uint32_t DIRSET;
+} NRF_GPIO_Type;
+
+inline NRF_GPIO_Type* nrf_p0()
+{
+    static NRF_GPIO_Type p0;
+    return &p0;
+}
+
+#define NRF_P0 (nrf_p0())
+
+// UARTE, with TXD.PTR wide enough for a host pointer
+
+typedef struct
+{
+    volatile uint32_t TASKS_STARTTX;
+    volatile uint32_t TASKS_STOPTX;
+    volatile uint32_t EVENTS_ENDTX;
+    volatile uint32_t EVENTS_TXSTOPPED;
+    volatile uint32_t ENABLE;
+    struct
+    {
+        volatile uint32_t RTS;
+        volatile uint32_t TXD;
+        volatile uint32_t CTS;
+        volatile uint32_t RXD;
+    } PSEL;
+    volatile uint32_t BAUDRATE;
+    struct
+    {
+        volatile uintptr_t PTR;
+        volatile uint32_t MAXCNT;
+    } TXD;
+    volatile uint32_t CONFIG;
+} NRF_UARTE_Type;
+
+inline NRF_UARTE_Type* nrf_uarte0()
+{
+    static NRF_UARTE_Type uarte;
+    return &uarte;
+}
+
+#define NRF_UARTE0 (nrf_uarte0())
+
+#define UARTE_ENABLE_ENABLE_Pos (0UL)
+#define UARTE_ENABLE_ENABLE_Disabled (0UL)
+#define UARTE_ENABLE_ENABLE_Enabled (8UL)
+#define UARTE_BAUDRATE_BAUDRATE_Pos (0UL)
+#define UARTE_BAUDRATE_BAUDRATE_Baud115200 (0x01D60000UL)
+
+// NVIC
+
+typedef enum
+{
+    COMP_LPCOMP_IRQn = 19
+} IRQn_Type;
+
+inline uintptr_t* nvic_vectors()
+{
+    static uintptr_t vectors[32] = {0};
+    return vectors;
+}
+
+inline bool* nvic_enabled()
+{
+    static bool enabled[32] = {false};
+    return enabled;
+}
+
+inline void NVIC_SetVector(IRQn_Type irq, uintptr_t vector) { nvic_vectors()[irq] = vector; }
+inline void NVIC_ClearPendingIRQ(IRQn_Type irq) {}
+inline void NVIC_EnableIRQ(IRQn_Type irq) { nvic_enabled()[irq] = true; }
+inline void NVIC_DisableIRQ(IRQn_Type irq) { nvic_enabled()[irq] = false; }
+
+// LPCOMP, with INTENSET/INTENCLR folded into INTEN
+
+typedef struct NRF_LPCOMP_Type
+{
+    struct SetReg
+    {
+        volatile uint32_t* reg;
+        void operator=(uint32_t mask) { *reg |= mask; }
+    };
+
+    struct ClearReg
+    {
+        volatile uint32_t* reg;
+        void operator=(uint32_t mask) { *reg &= ~mask; }
+    };
+
+    volatile uint32_t TASKS_START = 0;
+    volatile uint32_t TASKS_STOP = 0;
+    volatile uint32_t EVENTS_UP = 0;
+    volatile uint32_t EVENTS_DOWN = 0;
+    volatile uint32_t INTEN = 0;
+    SetReg INTENSET = {&INTEN};
+    ClearReg INTENCLR = {&INTEN};
+    volatile uint32_t ENABLE = 0;
+    volatile uint32_t PSEL = 0;
+    volatile uint32_t REFSEL = 0;
+    volatile uint32_t HYST = 0;
+    volatile uint32_t ANADETECT = 0;
+} NRF_LPCOMP_Type;
+
+inline NRF_LPCOMP_Type* nrf_lpcomp()
+{
+    static NRF_LPCOMP_Type lpcomp;
+    return &lpcomp;
+}
+
+#define NRF_LPCOMP (nrf_lpcomp())
+
+#define LPCOMP_INTENSET_UP_Msk (1UL << 2)
+#define LPCOMP_INTENSET_DOWN_Msk (1UL << 1)
+#define LPCOMP_INTENCLR_UP_Msk (1UL << 2)
+#define LPCOMP_INTENCLR_DOWN_Msk (1UL << 1)
+#define LPCOMP_ENABLE_ENABLE_Pos (0UL)
+#define LPCOMP_ENABLE_ENABLE_Disabled (0UL)
+#define LPCOMP_ENABLE_ENABLE_Enabled (1UL)
+#define LPCOMP_PSEL_PSEL_Pos (0UL)
+#define LPCOMP_PSEL_PSEL_AnalogInput1 (1UL)
+#define LPCOMP_HYST_HYST_Pos (0UL)
+#define LPCOMP_HYST_HYST_Hyst50mV (1UL)
+#define LPCOMP_ANADETECT_ANADETECT_Up (1UL)
+#define LPCOMP_ANADETECT_ANADETECT_Down (2UL)
+
+// SAADC, the register the drivers read directly; conversions are in nrfx_saadc.h
+
+typedef struct
+{
+    volatile uint32_t RESOLUTION = 1; // 10 bit, as mbed leaves it
+} NRF_SAADC_Type;
+
+inline NRF_SAADC_Type* nrf_saadc()
+{
+    static NRF_SAADC_Type saadc;
+    return &saadc;
+}
+
+#define NRF_SAADC (nrf_saadc())
+
+#endif // NRF52_H
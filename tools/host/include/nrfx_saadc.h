@@ -0,0 +1,43 @@
+/**
+ * Host stand-in for the nrfx SAADC driver calls that CapCalc makes. The
+ * functions are declared here and defined by the harness that models the
+ * converter.
+ */
+
+#ifndef NRFX_SAADC_H__
+#define NRFX_SAADC_H__
+
+#include <stdint.h>
+
+typedef uint32_t ret_code_t;
+typedef int16_t nrf_saadc_value_t;
+
+#define NRFX_SUCCESS 0
+#define NRFX_ERROR_INVALID_STATE 8
+
+typedef enum { NRF_SAADC_RESISTOR_DISABLED } nrf_saadc_resistor_t;
+typedef enum { NRF_SAADC_GAIN1_6, NRF_SAADC_GAIN1_5, NRF_SAADC_GAIN1_4 } nrf_saadc_gain_t;
+typedef enum { NRF_SAADC_REFERENCE_INTERNAL, NRF_SAADC_REFERENCE_VDD4 } nrf_saadc_reference_t;
+typedef enum { NRF_SAADC_ACQTIME_10US } nrf_saadc_acqtime_t;
+typedef enum { NRF_SAADC_MODE_SINGLE_ENDED } nrf_saadc_mode_t;
+typedef enum { NRF_SAADC_BURST_DISABLED } nrf_saadc_burst_t;
+typedef enum { NRF_SAADC_INPUT_DISABLED, NRF_SAADC_INPUT_AIN0, NRF_SAADC_INPUT_AIN1, NRF_SAADC_INPUT_VDD = 9 } nrf_saadc_input_t;
+
+typedef struct
+{
+    nrf_saadc_resistor_t resistor_p;
+    nrf_saadc_resistor_t resistor_n;
+    nrf_saadc_gain_t gain;
+    nrf_saadc_reference_t reference;
+    nrf_saadc_acqtime_t acq_time;
+    nrf_saadc_mode_t mode;
+    nrf_saadc_burst_t burst;
+    nrf_saadc_input_t pin_p;
+    nrf_saadc_input_t pin_n;
+} nrf_saadc_channel_config_t;
+
+ret_code_t nrfx_saadc_channel_init(uint8_t channel, nrf_saadc_channel_config_t const* config);
+ret_code_t nrfx_saadc_channel_uninit(uint8_t channel);
+ret_code_t nrfx_saadc_sample_convert(uint8_t channel, nrf_saadc_value_t* value);
+
+#endif // NRFX_SAADC_H__
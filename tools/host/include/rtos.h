@@ -0,0 +1,5 @@
+/**
+ * Host stand-in for rtos.h; Mutex is in the mbed.h stand-in.
+ */
+
+#include "mbed.h"
@@ -0,0 +1,66 @@
+/**
+ * Checks that LOG() calls below FACEBIT_LOG_LEVEL cost nothing: their
+ * arguments aren't evaluated and the logger isn't called. run.sh builds
+ * this once per level and also checks that the format strings of the
+ * removed calls are absent from the object file.
+ */
+
+#include "LogLevel.h"
+
+#include <cstdio>
+
+namespace
+{
+
+class CountingLogger
+{
+public:
+    int calls[TRACE_LAST] = {0};
+    const char* volatile last_msg = nullptr; // keeps the format strings of compiled-in calls
+
+    void log(trace_level_t level, const char *msg, ...)
+    {
+        calls[level]++;
+        last_msg = msg;
+    }
+};
+
+int evaluated[TRACE_LAST] = {0};
+
+int argument(trace_level_t level)
+{
+    return ++evaluated[level];
+}
+
+} // namespace
+
+int main()
+{
+    CountingLogger logger;
+    CountingLogger* _logger = &logger;
+    (void)_logger; // unused when every level is compiled out
+    (void)argument;
+
+    for (int i = 0; i < 10; i++) // as in a sample loop
+    {
+        LOG(_logger, TRACE_TRACE, "LOGCHECK_TRACE %i", argument(TRACE_TRACE));
+        LOG(_logger, TRACE_DEBUG, "LOGCHECK_DEBUG %i", argument(TRACE_DEBUG));
+        LOG(_logger, TRACE_INFO, "LOGCHECK_INFO %i", argument(TRACE_INFO));
+        LOG(_logger, TRACE_WARNING, "LOGCHECK_WARNING %i", argument(TRACE_WARNING));
+    }
+
+    const char* names[TRACE_LAST] = {"TRACE", "DEBUG", "INFO", "WARNING"};
+    int failures = 0;
+
+    printf("FACEBIT_LOG_LEVEL %d:", FACEBIT_LOG_LEVEL);
+    for (int level = 0; level < TRACE_LAST; level++)
+    {
+        int expected = level >= FACEBIT_LOG_LEVEL ? 10 : 0;
+        bool ok = logger.calls[level] == expected && evaluated[level] == expected;
+        failures += !ok;
+        printf(" %s %d calls, %d evaluated%s;", names[level], logger.calls[level], evaluated[level], ok ? "" : " (FAIL)");
+    }
+    printf("\n");
+
+    return failures ? 1 : 0;
+}
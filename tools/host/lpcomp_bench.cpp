@@ -0,0 +1,429 @@
+/**
+ * The supercap monitor on the host: runs the real CapCalc.cpp against
+ * models of the LPCOMP and SAADC (include/nrf52.h, include/nrfx_saadc.h)
+ * and a harvester charging the 3000 uF supercap through a divider, in
+ * simulated time.
+ *
+ * The loop below sleeps in wait_for_crossing() as FaceBitState::run()
+ * does. For each scenario it checks that:
+ *  - the comparator reference armed through REFSEL matches what
+ *    get_low_threshold()/get_high_threshold() report;
+ *  - every crossing of the band wakes the loop once, with is_energy_low()
+ *    right, and nothing else does;
+ *  - nothing is sampled while the loop sleeps.
+ * It also compares get_charge_rate() with the harvester's dV/dt.
+ *
+ * The crossings are worked out from the voltage trace, not from the
+ * comparator model, using the 50 mV hysteresis of the datasheet.
+ */
+
+#include "CapCalc.h"
+#include "nrfx_saadc.h"
+#include "PinNames.h"
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace
+{
+
+const double CAPACITANCE_F = 3000e-6;
+const double DIVIDER_RATIO = 2.80;
+const double HYSTERESIS_V = 0.050; // at the comparator input, +/- half of it
+const uint64_t TICK_US = 1000; // comparator model resolution
+
+const float ENERGY_LOW_THRESHOLD = 2.4; // as FaceBitState
+const float ENERGY_OK_THRESHOLD = 3.0;
+
+struct Segment
+{
+    double seconds;
+    double net_ua; // harvest less load
+};
+
+struct Scenario
+{
+    const char* name;
+    double vdd;
+    double v0;
+    std::vector<Segment> segments;
+    double pulse_ma; // load pulses on top, e.g. BLE events
+};
+
+/**
+ * The supercap, the VCAP divider (only driving the pin while VCAP_ENABLE
+ * is high), VDD, and the LPCOMP sampling the divider every TICK_US.
+ */
+class Harvester
+{
+public:
+    const Scenario* scenario = nullptr;
+    uint64_t start_us = 0; // of the scenario
+    double v = 0;
+    uint32_t samples = 0; // SAADC and AnalogIn conversions
+
+    double divider_out()
+    {
+        return sim::gpio_out()[VCAP_ENABLE] ? v / DIVIDER_RATIO : 0;
+    }
+
+    double net_current(uint64_t now_us)
+    {
+        uint64_t t_us = now_us - start_us;
+        double net = 0;
+        double since_change = 0;
+        segment_at(t_us / 1e6, net, since_change);
+
+        // a 5 ms pulse every 2 s
+        if (scenario->pulse_ma > 0 && t_us % 2000000 < 5000) net -= scenario->pulse_ma * 1e-3;
+
+        return net;
+    }
+
+    // net current (A) of the segment at t, and how long it has been running
+    void segment_at(double t, double& net, double& since_change)
+    {
+        for (const Segment& s : scenario->segments)
+        {
+            net = s.net_ua * 1e-6;
+            since_change = t;
+            if (t < s.seconds) break;
+            t -= s.seconds;
+        }
+    }
+
+    double seconds_steady()
+    {
+        double net = 0;
+        double since_change = 0;
+        segment_at((sim::now_us() - start_us) / 1e6, net, since_change);
+        return since_change;
+    }
+
+    void tick()
+    {
+        v += net_current(sim::now_us()) * (TICK_US / 1e6) / CAPACITANCE_F;
+        if (v < 0) v = 0;
+        sim::schedule(sim::now_us() + TICK_US, this, [this]() { tick(); });
+    }
+
+    // the REFSEL table from the datasheet, in sixteenths of VDD
+    static int refsel_sixteenths(uint32_t refsel)
+    {
+        return refsel < 7 ? 2 * (refsel + 1) : refsel >= 8 ? 2 * (refsel - 8) + 1 : -1;
+    }
+
+    void comparator()
+    {
+        NRF_LPCOMP_Type* lpcomp = NRF_LPCOMP;
+
+        if (lpcomp->TASKS_STOP)
+        {
+            lpcomp->TASKS_STOP = 0;
+            _running = false;
+        }
+
+        bool enabled = lpcomp->ENABLE == (LPCOMP_ENABLE_ENABLE_Enabled << LPCOMP_ENABLE_ENABLE_Pos);
+        if (lpcomp->TASKS_START)
+        {
+            lpcomp->TASKS_START = 0;
+            if (enabled)
+            {
+                _running = true;
+                _above = divider_out() > reference();
+            }
+        }
+
+        if (!enabled) _running = false;
+        if (!_running || lpcomp->PSEL != LPCOMP_PSEL_PSEL_AnalogInput1) return;
+
+        double half = lpcomp->HYST ? HYSTERESIS_V / 2 : 0;
+        double in = divider_out();
+        if (_above && in < reference() - half)
+        {
+            _above = false;
+            lpcomp->EVENTS_DOWN = 1;
+        }
+        else if (!_above && in > reference() + half)
+        {
+            _above = true;
+            lpcomp->EVENTS_UP = 1;
+        }
+        else
+        {
+            return;
+        }
+
+        bool pending = (lpcomp->EVENTS_DOWN && (lpcomp->INTEN & LPCOMP_INTENSET_DOWN_Msk))
+            || (lpcomp->EVENTS_UP && (lpcomp->INTEN & LPCOMP_INTENSET_UP_Msk));
+        if (pending && nvic_enabled()[COMP_LPCOMP_IRQn] && nvic_vectors()[COMP_LPCOMP_IRQn])
+        {
+            reinterpret_cast<void (*)()>(nvic_vectors()[COMP_LPCOMP_IRQn])();
+        }
+    }
+
+    double reference()
+    {
+        return refsel_sixteenths(NRF_LPCOMP->REFSEL) * scenario->vdd / 16;
+    }
+
+private:
+    bool _running = false;
+    bool _above = false;
+};
+
+Harvester harvester;
+
+nrf_saadc_channel_config_t channels[8];
+bool channel_used[8] = {false};
+
+} // namespace
+
+float sim_analog_read(PinName pin)
+{
+    harvester.samples++;
+    return pin == VCAP ? harvester.divider_out() : 0;
+}
+
+ret_code_t nrfx_saadc_channel_init(uint8_t channel, nrf_saadc_channel_config_t const* config)
+{
+    channels[channel] = *config;
+    channel_used[channel] = true;
+    return NRFX_SUCCESS;
+}
+
+ret_code_t nrfx_saadc_channel_uninit(uint8_t channel)
+{
+    channel_used[channel] = false;
+    return NRFX_SUCCESS;
+}
+
+ret_code_t nrfx_saadc_sample_convert(uint8_t channel, nrf_saadc_value_t* value)
+{
+    if (!channel_used[channel]) return NRFX_ERROR_INVALID_STATE;
+
+    const nrf_saadc_channel_config_t& c = channels[channel];
+    double gain = c.gain == NRF_SAADC_GAIN1_6 ? 1.0 / 6 : c.gain == NRF_SAADC_GAIN1_5 ? 1.0 / 5 : 1.0 / 4;
+    double full_scale = c.reference == NRF_SAADC_REFERENCE_INTERNAL ? 0.6 / gain : harvester.scenario->vdd / 4 / gain;
+    double in = c.pin_p == NRF_SAADC_INPUT_VDD ? harvester.scenario->vdd : c.pin_p == NRF_SAADC_INPUT_AIN1 ? harvester.divider_out() : 0;
+
+    int bits = 8 + 2 * NRF_SAADC->RESOLUTION;
+    int counts = (int)(in / full_scale * (1 << bits) + 0.5);
+    *value = counts < (1 << bits) ? counts : (1 << bits) - 1;
+
+    harvester.samples++;
+    return NRFX_SUCCESS;
+}
+
+namespace
+{
+
+struct Crossing
+{
+    double t; // s
+    bool low;
+};
+
+/**
+ * Where the band is crossed, from the trace alone: below the low
+ * threshold less the comparator's half-hysteresis, or back above the
+ * high threshold plus it, alternately.
+ */
+std::vector<Crossing> expected_crossings(const std::vector<double>& trace, double start_s, bool low, double low_v, double high_v)
+{
+    std::vector<Crossing> crossings;
+    double half = HYSTERESIS_V / 2 * DIVIDER_RATIO;
+    for (size_t i = 0; i < trace.size(); i++)
+    {
+        double t = start_s + i * (TICK_US / 1e6);
+        if (!low && trace[i] < low_v - half)
+        {
+            low = true;
+            crossings.push_back({t, low});
+        }
+        else if (low && trace[i] > high_v + half)
+        {
+            low = false;
+            crossings.push_back({t, low});
+        }
+    }
+
+    return crossings;
+}
+
+struct Result
+{
+    bool refs_ok = false;
+    size_t expected = 0;
+    size_t woken = 0;
+    size_t matched = 0;
+    size_t spurious = 0;
+    double worst_latency_ms = 0;
+    uint32_t sleep_samples = 0;
+    double threshold_err_mv = 0; // reported threshold less the one REFSEL selects, at the cap
+    double rate_err = -1; // mean |charge rate - dV/dt|, V/s, once dV/dt has been steady a while
+};
+
+Result run(const Scenario& scenario)
+{
+    harvester.scenario = &scenario;
+    harvester.start_us = sim::now_us();
+    harvester.v = scenario.v0;
+
+    sim::state().events.clear();
+    sim::state().models.clear();
+    sim::state().models.push_back([]() { harvester.comparator(); });
+    harvester.tick();
+
+    CapCalc* cap_calc = CapCalc::get_instance();
+    Result result;
+
+    double total_s = 0;
+    for (const Segment& s : scenario.segments) total_s += s.seconds;
+
+    if (!cap_calc->start_monitor(ENERGY_LOW_THRESHOLD, ENERGY_OK_THRESHOLD))
+    {
+        printf("%s: monitor not armed\n", scenario.name);
+        return result;
+    }
+
+    /**
+     * The thresholds are k/16 of VDD at the comparator. The driver picks k
+     * from a VDD it measures with the SAADC, so what it reports is off by
+     * that measurement; the sixteenths themselves must match REFSEL.
+     */
+    double start_s = sim::now_us() / 1e6;
+    bool low = cap_calc->is_energy_low();
+    double step = scenario.vdd / 16;
+    double low_ref = round(cap_calc->get_low_threshold() / DIVIDER_RATIO / step) * step;
+    double high_ref = round(cap_calc->get_high_threshold() / DIVIDER_RATIO / step) * step;
+    result.refs_ok = fabs(harvester.reference() - (low ? high_ref : low_ref)) < 1e-6;
+    result.threshold_err_mv = fmax(fabs(cap_calc->get_low_threshold() - low_ref * DIVIDER_RATIO),
+        fabs(cap_calc->get_high_threshold() - high_ref * DIVIDER_RATIO)) * 1e3;
+
+    // the loop, and the trace it ran over
+    std::vector<double> trace;
+    sim::state().models.push_back([&trace, start_s]() {
+        size_t i = (size_t)((sim::now_us() / 1e6 - start_s) / (TICK_US / 1e6) + 0.5);
+        while (trace.size() <= i) trace.push_back(harvester.v);
+    });
+
+    std::vector<Crossing> woken;
+    uint64_t last_rate_read_us = sim::now_us();
+    double rate_err = 0;
+    int rate_reads = 0;
+
+    while ((sim::now_us() - harvester.start_us) / 1e6 < total_s)
+    {
+        bool before = cap_calc->is_energy_low();
+        uint32_t samples = harvester.samples;
+        bool crossed = cap_calc->wait_for_crossing(10s);
+        result.sleep_samples += harvester.samples - samples;
+
+        // crossings flip the armed edge: the reference moves to the other threshold
+        if (fabs(harvester.reference() - (cap_calc->is_energy_low() ? high_ref : low_ref)) > 1e-6) result.refs_ok = false;
+
+        if (crossed)
+        {
+            woken.push_back({sim::now_us() / 1e6, cap_calc->is_energy_low()});
+            if (cap_calc->is_energy_low() == before) result.spurious++;
+            cap_calc->read_voltage();
+        }
+
+        // every 10 s, as often as anything reads the capacitor when the mask is on
+        if (sim::now_us() - last_rate_read_us >= 10000000)
+        {
+            cap_calc->read_voltage();
+            last_rate_read_us = sim::now_us();
+
+            // the EWMA has had 6 reads at this slope
+            if (harvester.seconds_steady() >= 60 && scenario.pulse_ma == 0)
+            {
+                double slope = harvester.net_current(sim::now_us()) / CAPACITANCE_F;
+                rate_err += fabs(cap_calc->get_charge_rate() - slope);
+                rate_reads++;
+            }
+        }
+    }
+
+    cap_calc->stop_monitor();
+
+    std::vector<Crossing> expected = expected_crossings(trace, start_s, low, low_ref * DIVIDER_RATIO, high_ref * DIVIDER_RATIO);
+    result.expected = expected.size();
+    result.woken = woken.size();
+
+    size_t j = 0;
+    for (const Crossing& e : expected)
+    {
+        while (j < woken.size() && woken[j].t < e.t - 0.002) j++;
+        if (j < woken.size() && woken[j].low == e.low && woken[j].t - e.t < 0.010)
+        {
+            result.matched++;
+            result.worst_latency_ms = fmax(result.worst_latency_ms, (woken[j].t - e.t) * 1e3);
+            j++;
+        }
+    }
+
+    if (rate_reads)
+    {
+        result.rate_err = rate_err / rate_reads;
+    }
+
+    return result;
+}
+
+} // namespace
+
+int main()
+{
+    const Scenario scenarios[] = {
+        {"drain, then sun", 3.0, 3.3, {{120, -40}, {240, 60}}, 0},
+        {"clouds passing", 3.0, 2.9, {{60, -60}, {60, 40}, {30, -60}, {90, 80}, {120, -30}, {60, 90}}, 0},
+        {"pulses at the low edge", 3.0, 2.66, {{600, -0.3}}, 8},
+        {"BLE pulses on a slow drain", 3.0, 3.2, {{400, -15}, {300, 50}}, 8},
+        {"VDD 3.3 V, drain, then sun", 3.3, 3.4, {{150, -40}, {300, 60}}, 0},
+        {"never leaves the band", 3.0, 2.8, {{300, 1}}, 0},
+    };
+
+    int failures = 0;
+
+    printf("%-28s %5s %7s %7s %7s %7s %7s %7s %9s\n", "", "refs", "err mV", "crosses", "woken", "matched",
+        "late ms", "sampled", "rate err");
+    for (const Scenario& s : scenarios)
+    {
+        // a process per scenario, for a CapCalc singleton with no history
+        fflush(stdout);
+        pid_t pid = fork();
+        if (pid != 0)
+        {
+            int status = 0;
+            waitpid(pid, &status, 0);
+            failures += !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+            continue;
+        }
+
+        Result r = run(s);
+        bool ok = r.refs_ok && r.matched == r.expected && r.woken == r.expected && r.spurious == 0 && r.sleep_samples == 0;
+
+        char rate[32] = "-";
+        if (r.rate_err >= 0) snprintf(rate, sizeof(rate), "%.2f", r.rate_err * 1e3);
+
+        printf("%-28s %5s %7.1f %7zu %7zu %7zu %7.1f %7u %9s%s\n", s.name, r.refs_ok ? "ok" : "BAD",
+            r.threshold_err_mv, r.expected, r.woken, r.matched, r.worst_latency_ms, r.sleep_samples, rate,
+            ok ? "" : "  FAIL");
+        fflush(stdout);
+        _exit(ok ? 0 : 1);
+    }
+
+    printf("\nrefs: the REFSEL the driver armed selects the k/16 VDD step it reports, before and\n"
+        "after every crossing. err mV: reported thresholds less those steps, from the SAADC's\n"
+        "VDD reading. crosses: of the armed band, from the voltage trace with the comparator's\n"
+        "hysteresis. woken: wait_for_crossing() returned early. matched: woken within 10 ms with\n"
+        "is_energy_low() right. sampled: conversions while asleep. rate err: mean |get_charge_rate()\n"
+        "- dV/dt| in mV/s, reading every 10 s, once dV/dt has held for 60 s.\n");
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,422 @@
+/**
+ * Mask on/off check on the host: runs traces through MaskClassifier and
+ * compares ways of scheduling the check.
+ *
+ *   barometer   the barometer's 10 s detection window on its own
+ *   sequential  thermometer pre-check first, barometer window only if
+ *               the pre-check is ambiguous (how is_on() used to work)
+ *   concurrent  both from the start, the pre-check can only cut the
+ *               window short
+ *   staggered   the barometer joins once the pre-check has
+ *               MIN_PRECHECK_SAMPLES (how is_on() works now)
+ *
+ * For each it reports agreement with the ground truth and with the
+ * barometer on its own, time to decide, and energy per decision from
+ * the current model below.
+ *
+ * The traces are synthetic scenarios, plus any recorded traces given on
+ * the command line:
+ *
+ *   mask_check_bench [trace.csv ...]
+ *
+ * A recorded trace starts with "# on" or "# off", then one sample per
+ * line: "<ms>,p,<raw pressure>" (Pa above 800 hPa, as in the barometer
+ * buffer) or "<ms>,t,<temperature x100>". Build it with
+ * -DPRECHECK_TRUST_OFF to see how often a trusted OFF would be wrong.
+ */
+
+#include "MaskClassifier.h"
+#include "BreathFilter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+const double DETECTION_WINDOW = 10.0; // s, MaskStateDetection::DETECTION_WINDOW
+const int PRESSURE_FREQUENCY = BreathFilter::FREQUENCY;
+const int BATCH_SIZE = 10; // barometer samples per FIFO interrupt
+const int TRIALS = 200; // per synthetic scenario
+
+/**
+ * Current model, datasheet typicals. None of it is measured on a
+ * FaceBit; it's here to compare schedules, not to predict battery life.
+ */
+const double SUPPLY_V = 3.0;
+const double MCU_SLEEP_A = 1.9e-6; // nRF52832 System ON, RTC running
+const double MCU_RUN_A = 3.7e-3; // nRF52832 64 MHz from flash, DC/DC
+const double MCU_HZ = 64e6;
+const double BAROMETER_A_PER_HZ = 12e-6; // LPS22HB low-noise mode, 12 uA at 1 Hz, scaled with ODR
+const double BATCH_AWAKE_S = 0.4e-3; // FIFO interrupt, 10 samples over SPI
+const double THERMOMETER_A = 90e-6; // Si7051 during a conversion
+const double CONVERSION_S = 7e-3; // Si7051 14 bit conversion
+const double SAMPLE_AWAKE_S = 0.5e-3; // two I2C transactions at 100 kHz
+const double FILTER_CYCLES_PER_STEP = 900; // both BiQuads in software double on the Cortex-M4F
+const double FIT_CYCLES_PER_SAMPLE = 60; // pre-check refit, per sample held, single precision FPU
+
+typedef struct
+{
+    std::string name;
+    bool on;
+    std::vector<uint16_t> pressure; // 10 Hz from t = 0
+    std::vector<int16_t> temperature; // PRECHECK_FREQUENCY from t = 1 / PRECHECK_FREQUENCY
+} Trace_t;
+
+typedef struct
+{
+    MaskClassifier::Verdict_t verdict;
+    double seconds;
+    double joules;
+    bool precheck; // decided by the pre-check
+} Result_t;
+
+double barometer_joules(double seconds, bool window_done)
+{
+    double charge = BAROMETER_A_PER_HZ * PRESSURE_FREQUENCY * seconds;
+    charge += MCU_RUN_A * BATCH_AWAKE_S * std::floor(seconds * PRESSURE_FREQUENCY / BATCH_SIZE);
+    if (window_done)
+    {
+        double steps = 200 * BreathFilter::FREQUENCY + DETECTION_WINDOW * PRESSURE_FREQUENCY;
+        charge += MCU_RUN_A * steps * FILTER_CYCLES_PER_STEP / MCU_HZ;
+    }
+    return charge * SUPPLY_V;
+}
+
+double thermometer_joules(int samples)
+{
+    double charge = 0;
+    for (int i = 1; i <= samples; i++)
+    {
+        charge += THERMOMETER_A * CONVERSION_S + MCU_RUN_A * SAMPLE_AWAKE_S;
+        charge += MCU_RUN_A * FIT_CYCLES_PER_SAMPLE * std::min(i, (int)MaskClassifier::PRECHECK_SAMPLES) / MCU_HZ;
+    }
+    return charge * SUPPLY_V;
+}
+
+double sleep_joules(double seconds)
+{
+    return MCU_SLEEP_A * seconds * SUPPLY_V;
+}
+
+MaskClassifier::Verdict_t barometer_verdict(const Trace_t &trace)
+{
+    size_t size = std::min(trace.pressure.size(), (size_t)(DETECTION_WINDOW * PRESSURE_FREQUENCY));
+    if (size < 2)
+    {
+        return MaskClassifier::AMBIGUOUS;
+    }
+    return MaskClassifier::classify_pressure(trace.pressure.data(), size);
+}
+
+Result_t run_barometer(const Trace_t &trace)
+{
+    Result_t result;
+    result.verdict = barometer_verdict(trace);
+    result.seconds = DETECTION_WINDOW;
+    result.joules = barometer_joules(DETECTION_WINDOW, true) + sleep_joules(DETECTION_WINDOW);
+    result.precheck = false;
+    return result;
+}
+
+/**
+ * Runs the pre-check until it decides, or runs out of samples or time.
+ * Returns the verdict (UNDECIDED if it never got one) and how many
+ * samples it took.
+ */
+MaskClassifier::Verdict_t run_precheck(const Trace_t &trace, double limit_s, int* samples)
+{
+    MaskClassifier classifier;
+    classifier.reset();
+
+    *samples = 0;
+    for (size_t i = 0; i < trace.temperature.size(); i++)
+    {
+        if ((i + 1.0) / MaskClassifier::PRECHECK_FREQUENCY > limit_s)
+        {
+            break;
+        }
+
+        (*samples)++;
+        MaskClassifier::Verdict_t verdict = classifier.add_temperature(trace.temperature[i]);
+        if (verdict != MaskClassifier::UNDECIDED)
+        {
+            return verdict;
+        }
+    }
+
+    return MaskClassifier::UNDECIDED;
+}
+
+/**
+ * The pre-check runs from t = 0 and the barometer window starts at
+ * barometer_start, or when the pre-check gives up if that's sooner
+ * (sequential: barometer_start is never).
+ */
+Result_t run_schedule(const Trace_t &trace, double barometer_start)
+{
+    int samples = 0;
+    MaskClassifier::Verdict_t verdict = run_precheck(trace, barometer_start + DETECTION_WINDOW, &samples);
+    double precheck_s = (double)samples / MaskClassifier::PRECHECK_FREQUENCY;
+
+    Result_t result;
+    result.joules = thermometer_joules(samples);
+    result.precheck = verdict == MaskClassifier::ON || verdict == MaskClassifier::OFF;
+    if (result.precheck)
+    {
+        result.verdict = verdict;
+        result.seconds = precheck_s;
+        result.joules += barometer_joules(std::max(precheck_s - barometer_start, 0.0), false);
+    }
+    else
+    {
+        result.verdict = barometer_verdict(trace);
+        result.seconds = std::min(precheck_s, barometer_start) + DETECTION_WINDOW;
+        result.joules += barometer_joules(DETECTION_WINDOW, true);
+    }
+    result.joules += sleep_joules(result.seconds);
+    return result;
+}
+
+/**
+ * Synthetic scenarios. Temperatures are what the Si7051 sees inside
+ * the mask; pressure swings are peak-to-peak at the LPS22HB.
+ */
+typedef struct
+{
+    const char* name;
+    bool on;
+    double mean_lo, mean_hi; // C, start of the capture
+    double settle_to; // C the temperature is heading to (NAN for none)
+    double tau; // s, time constant heading there
+    double temp_swing_lo, temp_swing_hi; // C peak-to-peak with breathing
+    double pressure_swing_lo, pressure_swing_hi; // Pa peak-to-peak with breathing
+    double bpm_lo, bpm_hi;
+    double movement; // Pa, 1.5-2.5 Hz disturbance (walking, handling)
+    double dropped; // fraction of failed thermometer reads, which Si7051::update() skips
+} Scenario_t;
+
+const Scenario_t SCENARIOS[] =
+{
+    // name                         on     mean        settle  tau  temp swing   pressure swing  bpm       move  drop
+    {"on, steady",                  true,  32.0, 34.5, NAN,    0,   0.3,  1.0,   20,   60,       10,  20,  0,    0},
+    {"on, just put on",             true,  22.0, 25.0, 33.0,   60,  0.2,  0.6,   20,   60,       10,  20,  0,    0},
+    {"on, shallow and slow",        true,  31.0, 33.0, NAN,    0,   0.1,  0.2,   15,   25,       8,   11,  0,    0},
+    {"on, cold outside",            true,  23.0, 26.5, NAN,    0,   0.5,  1.5,   20,   60,       12,  20,  0,    0},
+    {"on, walking",                 true,  32.0, 34.5, NAN,    0,   0.3,  1.0,   20,   60,       15,  25,  8,    0},
+    {"on, failed reads",            true,  32.0, 34.5, NAN,    0,   0.3,  1.0,   20,   60,       10,  20,  0,    0.15},
+    {"off, desk",                   false, 19.0, 25.0, NAN,    0,   0,    0,     0,    0,        0,   0,   0,    0},
+    {"off, just taken off",         false, 31.0, 33.0, 22.0,   90,  0,    0,     0,    0,        0,   0,   0,    0},
+    {"off, in a pocket",            false, 30.0, 33.0, NAN,    0,   0,    0,     0,    0,        0,   0,   8,    0},
+    {"off, hot car",                false, 35.0, 42.0, 45.0,   600, 0,    0,     0,    0,        0,   0,   0,    0},
+    {"off, below freezing",         false, -12.0, -2.0, NAN,   0,   0,    0,     0,    0,        0,   0,   0,    0},
+};
+
+double uniform(std::mt19937 &rng, double lo, double hi)
+{
+    return std::uniform_real_distribution<double>(lo, hi)(rng);
+}
+
+Trace_t synthesize(const Scenario_t &scenario, std::mt19937 &rng)
+{
+    std::normal_distribution<double> temp_noise(0, 0.02);
+    std::normal_distribution<double> pressure_noise(0, 2.0);
+
+    Trace_t trace;
+    trace.name = scenario.name;
+    trace.on = scenario.on;
+
+    double start = uniform(rng, scenario.mean_lo, scenario.mean_hi);
+    double bpm = scenario.on ? uniform(rng, scenario.bpm_lo, scenario.bpm_hi) : 0;
+    double phase = uniform(rng, 0, 2 * M_PI);
+    double temp_swing = uniform(rng, scenario.temp_swing_lo, scenario.temp_swing_hi);
+    double pressure_swing = uniform(rng, scenario.pressure_swing_lo, scenario.pressure_swing_hi);
+    double movement_hz = uniform(rng, 1.5, 2.5);
+    double drift = uniform(rng, -0.5, 0.5); // Pa/s, weather and altitude
+    double base_pressure = uniform(rng, 18000, 23000); // raw, 980-1030 hPa
+
+    double seconds = 2 * DETECTION_WINDOW;
+    for (int i = 0; i < seconds * PRESSURE_FREQUENCY; i++)
+    {
+        double t = (double)i / PRESSURE_FREQUENCY;
+        double pressure = base_pressure + drift * t + pressure_noise(rng);
+        pressure += 0.5 * pressure_swing * std::sin(2 * M_PI * bpm / 60 * t + phase);
+        pressure += scenario.movement * std::sin(2 * M_PI * movement_hz * t);
+        trace.pressure.push_back((uint16_t)std::lround(pressure));
+    }
+
+    for (int i = 1; i <= seconds * MaskClassifier::PRECHECK_FREQUENCY; i++)
+    {
+        if (uniform(rng, 0, 1) < scenario.dropped)
+        {
+            continue;
+        }
+
+        double t = (double)i / MaskClassifier::PRECHECK_FREQUENCY;
+        double temp = start;
+        if (!std::isnan(scenario.settle_to))
+        {
+            temp = scenario.settle_to + (start - scenario.settle_to) * std::exp(-t / scenario.tau);
+        }
+        // warm exhaled air raises the temperature as pressure rises
+        temp += 0.5 * temp_swing * std::sin(2 * M_PI * bpm / 60 * t + phase) + temp_noise(rng);
+        trace.temperature.push_back((int16_t)std::lround(temp * 100.0)); // as Si7051::update() stores it
+    }
+
+    return trace;
+}
+
+bool load(const char* path, Trace_t* trace)
+{
+    FILE* file = fopen(path, "r");
+    if (file == NULL)
+    {
+        return false;
+    }
+
+    trace->name = path;
+    trace->on = false;
+
+    char line[128];
+    bool labelled = false;
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        if (line[0] == '#')
+        {
+            labelled = strncmp(line, "# on", 4) == 0 || strncmp(line, "# off", 5) == 0;
+            trace->on = strncmp(line, "# on", 4) == 0;
+            continue;
+        }
+
+        unsigned long ms;
+        char sensor;
+        long value;
+        if (sscanf(line, "%lu,%c,%ld", &ms, &sensor, &value) != 3)
+        {
+            continue;
+        }
+
+        if (sensor == 'p')
+        {
+            trace->pressure.push_back((uint16_t)value);
+        }
+        else if (sensor == 't')
+        {
+            trace->temperature.push_back((int16_t)value);
+        }
+    }
+
+    fclose(file);
+    return labelled;
+}
+
+typedef struct
+{
+    int trials = 0;
+    int correct = 0;
+    int agree = 0;
+    int precheck = 0;
+    double seconds = 0;
+    double worst_seconds = 0;
+    double joules = 0;
+} Tally_t;
+
+const int NUM_SCHEDULES = 4;
+const char* SCHEDULES[NUM_SCHEDULES] = {"barometer", "sequential", "concurrent", "staggered"};
+
+void tally(const Trace_t &trace, Tally_t* t)
+{
+    Result_t results[NUM_SCHEDULES] =
+    {
+        run_barometer(trace),
+        run_schedule(trace, 1e9),
+        run_schedule(trace, 0),
+        run_schedule(trace, (double)MaskClassifier::MIN_PRECHECK_SAMPLES / MaskClassifier::PRECHECK_FREQUENCY),
+    };
+    MaskClassifier::Verdict_t truth = trace.on ? MaskClassifier::ON : MaskClassifier::OFF;
+
+    for (int i = 0; i < NUM_SCHEDULES; i++)
+    {
+        t[i].trials++;
+        t[i].correct += results[i].verdict == truth;
+        t[i].agree += results[i].verdict == results[0].verdict;
+        t[i].precheck += results[i].precheck;
+        t[i].seconds += results[i].seconds;
+        t[i].worst_seconds = std::max(t[i].worst_seconds, results[i].seconds);
+        t[i].joules += results[i].joules;
+    }
+}
+
+void print_tally(const std::string &name, const Tally_t &t)
+{
+    double n = t.trials;
+    printf("  %-24s %5d %5.0f%% %5.0f%% %5.0f%% %6.1f %6.1f %8.3f\n", name.c_str(), t.trials, 100 * t.correct / n, 100 * t.agree / n,
+        100 * t.precheck / n, t.seconds / n, t.worst_seconds, 1000 * t.joules / n);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+#ifdef PRECHECK_TRUST_OFF
+    printf("PRECHECK_TRUST_OFF: a cool, flat pre-check decides OFF\n\n");
+#else
+    printf("pre-check decides ON only\n\n");
+#endif
+
+    std::vector<std::string> names;
+    std::vector<std::vector<Tally_t>> tallies; // per trace set, per schedule
+    std::vector<Tally_t> total(NUM_SCHEDULES);
+
+    std::mt19937 rng(2022);
+    for (const Scenario_t &scenario : SCENARIOS)
+    {
+        std::vector<Tally_t> t(NUM_SCHEDULES);
+        for (int i = 0; i < TRIALS; i++)
+        {
+            Trace_t trace = synthesize(scenario, rng);
+            tally(trace, t.data());
+            tally(trace, total.data());
+        }
+        names.push_back(scenario.name);
+        tallies.push_back(t);
+    }
+
+    for (int i = 1; i < argc; i++)
+    {
+        Trace_t trace;
+        if (!load(argv[i], &trace))
+        {
+            fprintf(stderr, "%s: can't read it, or no \"# on\"/\"# off\" label\n", argv[i]);
+            return 1;
+        }
+
+        std::vector<Tally_t> t(NUM_SCHEDULES);
+        tally(trace, t.data());
+        tally(trace, total.data());
+        names.push_back(argv[i]);
+        tallies.push_back(t);
+    }
+
+    for (int s = 0; s < NUM_SCHEDULES; s++)
+    {
+        printf("%s\n", SCHEDULES[s]);
+        printf("  %-24s %5s %6s %6s %6s %6s %6s %8s\n", "", "n", "right", "agree", "pre", "mean s", "max s", "mJ");
+        for (size_t i = 0; i < names.size(); i++)
+        {
+            print_tally(names[i], tallies[i][s]);
+        }
+        print_tally("all", total[s]);
+        printf("\n");
+    }
+
+    printf("right: matches the ground truth. agree: matches the barometer alone. pre: decided by the\n");
+    printf("thermometer pre-check. mJ: modeled energy per decision.\n");
+
+    return 0;
+}
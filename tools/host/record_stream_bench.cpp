@@ -0,0 +1,258 @@
+/**
+ * The record stream on the host: the real RecordStream, fed a synthetic
+ * session and sliced into RECORDS packets the way
+ * FaceBitState::_send_records() does.
+ *
+ *   record_stream_bench [output directory]
+ *
+ * Syncs: the session is appended and, whenever the stream is three
+ * quarters full, sent in packets of each payload size (23-byte MTU, a
+ * typical phone, 247-byte MTU) and consumed. Every reading must come out
+ * once, in order, with its own timestamp. The packets go to
+ * record_stream.bin and the readings to record_stream.txt in the output
+ * directory, for `tools/records.py check` to decode on its own.
+ *
+ * Overflow: the session is appended with no phone, and the stream must
+ * hold the newest readings that fit, the rest counted as dropped.
+ */
+
+#include "RecordStream.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+const uint8_t PAYLOAD_SIZES[] = {15, 64, 241}; // see SmartPPEService::getRecordsPayload()
+const int SESSION_READINGS = 5000;
+const uint64_t SESSION_START = 1760000000; // seconds since the epoch, as the phone gets them
+const uint16_t SYNC_AT = RecordStream::CAPACITY * 3 / 4; // bytes
+
+const int LEGACY_WIRE_SIZE = 10; // u64 timestamp + u16 value
+const int LEGACY_RAM_SIZE = 16; // FaceBitData with padding
+const int PACKET_HEADER_SIZE = 5; // reference timestamp + length
+
+typedef RecordStream::Record_t Record_t;
+
+std::mt19937 rng(20261019);
+int failures = 0;
+
+int pick(int lo, int hi)
+{
+    return std::uniform_int_distribution<int>(lo, hi)(rng);
+}
+
+/**
+ * Readings as the tasks make them: a BCG capture reports several heart
+ * rates at once, a failed one reports 1, and a mask fit check with no
+ * result 0xFFFF.
+ */
+std::vector<Record_t> synthetic_session(int num_readings)
+{
+    static const int GAPS[] = {1, 2, 3, 5, 40, 120};
+    std::vector<Record_t> readings;
+    uint64_t t = SESSION_START;
+
+    while ((int)readings.size() < num_readings)
+    {
+        t += GAPS[pick(0, 5)];
+        int kind = pick(0, 3);
+        if (kind <= 1)
+        {
+            for (int i = pick(1, 3); i > 0; i--)
+            {
+                readings.push_back({0, t, (uint16_t)(pick(0, 3) ? pick(55, 110) : 1)});
+            }
+        }
+        else if (kind == 2)
+        {
+            readings.push_back({1, t, (uint16_t)(pick(0, 3) ? pick(80, 300) : 1)});
+        }
+        else
+        {
+            readings.push_back({2, t, (uint16_t)(pick(0, 3) ? pick(0, 100) : 0xFFFF)});
+        }
+    }
+
+    readings.resize(num_readings);
+    return readings;
+}
+
+bool same(const Record_t &a, const Record_t &b)
+{
+    return a.type == b.type && a.timestamp == b.timestamp && a.value == b.value;
+}
+
+void check(bool ok, const char* what)
+{
+    if (!ok)
+    {
+        printf("FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+/**
+ * Send everything in the stream, a packet at a time, as
+ * FaceBitState::_send_records() does: whole records up to the payload
+ * size, decoded as the phone would from the packet alone, then consumed.
+ */
+void sync(RecordStream &stream, uint8_t payload_size, FILE* packets, std::vector<Record_t> &received, long &wire_bytes, long &num_packets)
+{
+    while (stream.get_num_bytes() > 0)
+    {
+        uint64_t packet_reference_ts = stream.get_base_timestamp();
+        uint64_t reference_ts = packet_reference_ts;
+        uint16_t offset = 0;
+
+        Record_t record;
+        while (true)
+        {
+            uint64_t next_ts = reference_ts;
+            uint16_t size = stream.read(offset, next_ts, record);
+            if (size == 0 || offset + size > payload_size)
+            {
+                break;
+            }
+
+            offset += size;
+            reference_ts = next_ts;
+            received.push_back(record);
+        }
+
+        if (offset == 0)
+        {
+            check(false, "record stream corrupt");
+            stream.clear();
+            return;
+        }
+
+        uint8_t header[PACKET_HEADER_SIZE] = {
+            (uint8_t)packet_reference_ts, (uint8_t)(packet_reference_ts >> 8),
+            (uint8_t)(packet_reference_ts >> 16), (uint8_t)(packet_reference_ts >> 24),
+            (uint8_t)offset};
+        fwrite(header, 1, sizeof(header), packets);
+        fwrite(stream.get_bytes(), 1, offset, packets);
+        wire_bytes += sizeof(header) + offset;
+        num_packets++;
+
+        // a cut inside a record is refused, and leaves the stream as it was
+        uint16_t num_bytes = stream.get_num_bytes();
+        check(!stream.consume(1), "consume() accepted a cut inside a record");
+        check(stream.get_num_bytes() == num_bytes, "refused consume() changed the stream");
+
+        check(stream.consume(offset), "consume() refused a packet's worth");
+    }
+
+    check(stream.get_num_records() == 0, "records left after the stream emptied");
+}
+
+void syncs(const std::vector<Record_t> &readings, const std::string &directory)
+{
+    FILE* packets = fopen((directory + "/record_stream.bin").c_str(), "wb");
+    FILE* expected = fopen((directory + "/record_stream.txt").c_str(), "w");
+    if (packets == nullptr || expected == nullptr)
+    {
+        printf("can't write to %s\n", directory.c_str());
+        exit(1);
+    }
+
+    printf("Syncs, %zu readings, sent at %u bytes\n", readings.size(), SYNC_AT);
+    printf("  %-8s %7s %10s %9s\n", "payload", "packets", "wire bytes", "vs legacy");
+
+    for (uint8_t payload_size : PAYLOAD_SIZES)
+    {
+        RecordStream stream;
+        std::vector<Record_t> received;
+        long wire_bytes = 0;
+        long num_packets = 0;
+
+        for (const Record_t &reading : readings)
+        {
+            check(stream.append(reading.type, reading.timestamp, reading.value), "append() dropped a reading before the stream filled");
+            fprintf(expected, "%u %llu %u\n", reading.type, (unsigned long long)reading.timestamp, reading.value);
+
+            if (stream.get_num_bytes() >= SYNC_AT)
+            {
+                sync(stream, payload_size, packets, received, wire_bytes, num_packets);
+            }
+        }
+        sync(stream, payload_size, packets, received, wire_bytes, num_packets);
+
+        bool all = received.size() == readings.size();
+        for (size_t i = 0; all && i < readings.size(); i++)
+        {
+            all = same(received[i], readings[i]);
+        }
+        check(all, "the phone didn't get the session back as it went in");
+        check(stream.get_dropped_count() == 0, "readings dropped with a phone in reach");
+
+        printf("  %-8u %7ld %10ld %8.1fx\n", payload_size, num_packets, wire_bytes, (double)LEGACY_WIRE_SIZE * readings.size() / wire_bytes);
+    }
+
+    fclose(packets);
+    fclose(expected);
+    printf("\n");
+}
+
+void overflow(const std::vector<Record_t> &readings)
+{
+    RecordStream stream;
+    long refused = 0;
+
+    for (const Record_t &reading : readings)
+    {
+        if (!stream.append(reading.type, reading.timestamp, reading.value))
+        {
+            refused++;
+        }
+    }
+
+    // the stream holds the newest readings, the oldest counted as dropped
+    size_t kept = stream.get_num_records();
+    check(kept > 0 && kept < readings.size(), "overflow kept everything or nothing");
+    check(stream.get_dropped_count() == readings.size() - kept, "dropped count doesn't match the readings lost");
+    check(refused > 0, "append() never reported the stream full");
+
+    uint64_t reference_ts = stream.get_base_timestamp();
+    uint16_t offset = 0;
+    size_t i = readings.size() - kept;
+    bool newest = true;
+    Record_t record;
+    while (uint16_t size = stream.read(offset, reference_ts, record))
+    {
+        newest = newest && i < readings.size() && same(record, readings[i++]);
+        offset += size;
+    }
+    check(newest && i == readings.size(), "overflow didn't keep the newest readings");
+
+    // a type that doesn't fit the tag is refused and counted
+    uint32_t dropped = stream.get_dropped_count();
+    check(!stream.append(1 << RecordStream::TYPE_BITS, readings.back().timestamp, 0), "append() took a type that doesn't fit");
+    check(stream.get_num_records() == kept && stream.get_dropped_count() == dropped + 1, "refused type changed the stream or wasn't counted");
+
+    printf("Overflow, %zu readings with no phone: kept the newest %zu in %u bytes (%.2f bytes/reading), %lu dropped\n",
+        readings.size(), kept, stream.get_num_bytes(), (double)stream.get_num_bytes() / kept, (unsigned long)dropped);
+    printf("  the old %d-byte entries would have kept %d in the same %u bytes\n\n",
+        LEGACY_RAM_SIZE, RecordStream::CAPACITY / LEGACY_RAM_SIZE, RecordStream::CAPACITY);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    std::string directory = argc > 1 ? argv[1] : ".";
+    std::vector<Record_t> readings = synthetic_session(SESSION_READINGS);
+
+    syncs(readings, directory);
+    overflow(readings);
+
+    printf("vs legacy: the %d-byte characteristic writes the same readings would have taken, one per reading.\n", LEGACY_WIRE_SIZE);
+    printf("wire bytes include each packet's %d-byte header.\n", PACKET_HEADER_SIZE);
+
+    return failures ? 1 : 0;
+}
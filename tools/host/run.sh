@@ -0,0 +1,116 @@
+#!/bin/sh
+#
+# Builds and runs the host harnesses in this directory against the
+# firmware sources in inc/ and src/.
+#
+#   tools/host/run.sh [harness ...]
+#
+# With no arguments, runs all of them. iir-filter-kit/ holds a stand-in
+# for the submodule of the same name, found through the firmware's
+# "../iir-filter-kit/BiQuad.h" includes. include/ holds stand-ins for
+# mbed.h and rtos.h, and for inc/ headers that need mbed, which a harness
+# force-includes (-include) so their include guards hide the originals.
+# Binaries go to tools/host/build/.
+
+set -e
+
+HOST=$(cd "$(dirname "$0")" && pwd)
+ROOT=$(cd "$HOST/../.." && pwd)
+BUILD="$HOST/build"
+CXX=${CXX:-g++}
+CXXFLAGS="-std=gnu++14 -O2 -Wall -I$HOST/include -I$ROOT/inc -I$HOST/iir-filter-kit"
+
+mkdir -p "$BUILD"
+
+build()
+{
+    name=$1
+    shift
+    echo "== $name"
+    $CXX $CXXFLAGS -o "$BUILD/$name" "$@"
+}
+
+mask_check_bench()
+{
+    build mask_check_bench "$HOST/mask_check_bench.cpp" "$ROOT/src/MaskClassifier.cpp" "$ROOT/src/BreathFilter.cpp"
+    "$BUILD/mask_check_bench"
+    build mask_check_bench_trust_off -DPRECHECK_TRUST_OFF "$HOST/mask_check_bench.cpp" "$ROOT/src/MaskClassifier.cpp" "$ROOT/src/BreathFilter.cpp"
+    "$BUILD/mask_check_bench_trust_off"
+}
+
+cough_bench()
+{
+    build cough_bench "$HOST/cough_bench.cpp" "$ROOT/src/CoughDetection.cpp" "$ROOT/src/SampleClock.cpp"
+    "$BUILD/cough_bench"
+}
+
+checkpoint_bench()
+{
+    build checkpoint_bench -include "$HOST/include/FRAM.h" -include "$HOST/include/Logger.h" "$HOST/checkpoint_bench.cpp" "$ROOT/src/Checkpoint.cpp" "$ROOT/src/BCGFilter.cpp" "$ROOT/src/BreathFilter.cpp"
+    "$BUILD/checkpoint_bench"
+}
+
+log_level_check()
+{
+    for level in 0 1 2 3 4
+    do
+        obj="$BUILD/log_level_check_$level.o"
+        $CXX $CXXFLAGS -DFACEBIT_LOG_LEVEL=$level -c -o "$obj" "$HOST/log_level_check.cpp"
+        build log_level_check_$level "$obj"
+        "$BUILD/log_level_check_$level"
+
+        # the format strings of removed calls mustn't be in the object either
+        i=0
+        for name in TRACE DEBUG INFO WARNING
+        do
+            if grep -q -a "LOGCHECK_$name " "$obj"
+            then
+                present=1
+            else
+                present=0
+            fi
+            if [ $present -ne $((i >= level)) ]
+            then
+                echo "LOGCHECK_$name string present=$present at level $level"
+                exit 1
+            fi
+            i=$((i + 1))
+        done
+        echo "  format strings below level $level absent from the object"
+    done
+}
+
+uarte_bench()
+{
+    build uarte_bench -include "$HOST/include/nrf52.h" "$HOST/uarte_bench.cpp" "$ROOT/src/UarteLogTransport.cpp"
+    "$BUILD/uarte_bench"
+}
+
+lpcomp_bench()
+{
+    build lpcomp_bench -Wno-reorder -include "$HOST/include/nrf52.h" "$HOST/lpcomp_bench.cpp" "$ROOT/src/CapCalc.cpp"
+    "$BUILD/lpcomp_bench"
+}
+
+record_stream_bench()
+{
+    build record_stream_bench "$HOST/record_stream_bench.cpp" "$ROOT/src/RecordStream.cpp"
+    "$BUILD/record_stream_bench" "$BUILD"
+    # and the phone's side, from the packets alone
+    python3 "$ROOT/tools/records.py" check "$BUILD/record_stream.bin" "$BUILD/record_stream.txt"
+}
+
+sync_bench()
+{
+    build sync_bench -include "$HOST/include/nrf52.h" -include "$HOST/include/FRAM.h" -include "$HOST/include/Logger.h" \
+        "$HOST/sync_bench.cpp" "$ROOT/src/DataSync.cpp" "$ROOT/src/ConnectionManager.cpp" \
+        "$ROOT/src/TimeBase.cpp" "$ROOT/src/EventLog.cpp" "$ROOT/src/RecordStream.cpp"
+    "$BUILD/sync_bench"
+}
+
+HARNESSES="mask_check_bench cough_bench checkpoint_bench log_level_check uarte_bench lpcomp_bench record_stream_bench sync_bench"
+
+for harness in ${@:-$HARNESSES}
+do
+    $harness
+done
@@ -0,0 +1,931 @@
+/**
+ * Syncs on the host: the real DataSync, SmartPPEService,
+ * ConnectionManager, TimeBase, EventLog and RecordStream, on the fake
+ * stack in include/ble/BLE.h, against phones scripted here.
+ *
+ *   sync_bench
+ *
+ * Each sync runs as FaceBitState runs one with the stack up: open the
+ * window, DataSync::run(), DataSync::close(). The phone connects a while
+ * after advertising starts, exchanges MTUs if it does, subscribes to
+ * DATA_READY, and answers each notification as the app does: read
+ * DATA_READY back (unless it doesn't), read the payload, set the time if
+ * the device published none or a wrong one, and write NO_DATA. Phones
+ * differ in MTU, the shortest interval they accept, how long they take
+ * over a payload, whether they stall or drop the link part way, and
+ * whether they connect as the window closes or straight after it.
+ *
+ * The link is modelled coarsely. Each ATT request and its response, and
+ * each notification, take a connection event; a parameter update applies
+ * UPDATE_EVENTS events after the phone takes it; with slave latency the
+ * phone waits half the skipped events on average before the device
+ * hears it. Air bytes are ATT PDUs plus the L2CAP header. Connection
+ * events are counted over the time connected, at the interval and
+ * latency in use.
+ *
+ * Checked after every sync: the link is down and advertising is off. A
+ * sync that completes has delivered every reading, cough and event
+ * logged before it, once, with wall timestamps on the clock of the phone
+ * that last set the time; the phone has written the time only if the
+ * device published none or one off by more than TIME_TOLERANCE_S. A sync
+ * that fails loses nothing, and the next one sends what it didn't.
+ *
+ * Then the sync cycle, warm (the stack kept up, as here) against cold
+ * (brought up for the sync), in charge from the link counts and assumed
+ * per-event figures; see cycles().
+ */
+
+#include "DataSync.h"
+
+#include <stdlib.h>
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <random>
+#include <set>
+#include <tuple>
+#include <vector>
+
+namespace
+{
+
+const uint64_t PHONE_EPOCH = 1760000000; // s, the phone's clock at simulated time 0
+const uint64_t ADVERTISING_INTERVAL_US = 100000; // assumed, as mbed's GattServer example
+const int UPDATE_EVENTS = 6; // from the phone taking a parameter update to its instant
+const int L2CAP_HEADER = 4;
+const uint16_t MAX_ATT_MTU = 247; // cordio.desired-att-mtu in mbed_app.json
+const uint16_t BULK_INTERVAL = 12; // 1.25 ms units, ConnectionManager's BULK_MAX_INTERVAL
+const uint16_t SUPERVISION_TIMEOUT = 400; // 10 ms units
+const ble::connection_handle_t HANDLE = 1;
+const int TIME_TOLERANCE_S = 2; // the app leaves a published time this close alone
+const uint64_t MAX_TO_BULK_US = 500000; // one update at the connect interval, not one queued behind idle
+
+// charge per sync cycle, nRF52832 at 3 V with the DC/DC on; assumed, not measured
+const double ADVERTISING_EVENT_UC = 12; // connectable on 3 channels: ~1.5 ms of radio at ~5.3 mA, plus the CPU
+const double CONNECTION_EVENT_UC = 6; // empty PDUs each way: ~0.6 ms of radio, plus the CPU waking for it
+const double AIR_BYTE_UC = 0.043; // 8 us at ~5.4 mA
+const double STACK_BRINGUP_MS = 100; // BLE::init() to advertising, the CPU busy throughout
+const double CPU_MA = 3.7; // running from flash at 64 MHz
+
+// the app knows the service by these
+const char* DATA_READY_UUID = "0F1F34A3-4567-484C-ACA2-CC8F662E8783";
+const char* ON_UUID = "0F1F34A3-4567-484C-ACA2-CC8F662E8786";
+const char* TIME_UUID = "0F1F34A3-4567-484C-ACA2-CC8F662E8787";
+const char* COUGH_UUID = "0F1F34A3-4567-484C-ACA2-CC8F662E8788";
+const char* EVENT_LOG_UUID = "0F1F34A3-4567-484C-ACA2-CC8F662E878A";
+const char* RECORDS_UUID = "0F1F34A3-4567-484C-ACA2-CC8F662E878B";
+
+std::mt19937 rng(20261019);
+int failures = 0;
+
+int pick(int lo, int hi)
+{
+    return std::uniform_int_distribution<int>(lo, hi)(rng);
+}
+
+void check(bool ok, const char* scenario, const char* what)
+{
+    if (!ok)
+    {
+        printf("FAILED: %s: %s\n", scenario, what);
+        failures++;
+    }
+}
+
+struct Phone
+{
+    const char* name;
+    uint16_t mtu; // the most it takes, 23 if it can't go higher
+    bool exchanges_mtu; // on connecting; otherwise only when the device asks
+    uint16_t connect_interval; // 1.25 ms units
+    uint16_t min_interval; // the shortest it accepts
+    bool rejects_updates;
+    uint32_t scan_ms; // from advertising starting to its connect request
+    uint32_t think_ms; // from a notification to acting on it
+    bool confirms; // reads DATA_READY back before acting on a notification
+    int64_t clock_error_s;
+    int stall_after; // acknowledgements before it stops answering, -1 never
+    int drop_after; // acknowledgements before it drops the link after reading the next payload, -1 never
+    bool reconnects; // stays when the device disconnects, and connects again as soon as it hears it
+};
+
+Phone phone(const char* name)
+{
+    return {name, MAX_ATT_MTU, true, 24, 12, false, 300, 20, true, 0, -1, -1, false};
+}
+
+// what the phone got, decoded from the payloads alone
+struct Delivered
+{
+    std::vector<RecordStream::Record_t> records; // wall timestamps
+    std::vector<std::pair<uint64_t, uint16_t>> coughs; // wall timestamp, peak
+    std::vector<uint32_t> events; // indices
+    uint16_t mask_state = 0xFFFF;
+};
+
+/**
+ * The air and the phone. Hooks the device's requests on the fake stack
+ * and answers them on simulated time, through the same events the BLE
+ * thread would get.
+ */
+class Link
+{
+public:
+    struct Stats
+    {
+        uint32_t air_bytes = 0;
+        uint32_t round_trips = 0;
+        uint32_t notifications = 0;
+        uint32_t redundant_reads = 0; // payloads read again unchanged
+        uint32_t time_writes = 0;
+        uint32_t advertising_events = 0;
+        uint32_t connection_events = 0;
+        uint16_t mtu = SmartPPEService::DEFAULT_ATT_MTU;
+        uint16_t interval = 0; // the last in use, 1.25 ms units
+        uint64_t to_bulk_us = 0; // from connecting to the bulk interval applying, 0 if it never did
+    };
+
+    Link(BLE &ble) : _ble(ble), _server(ble.gattServer())
+    {
+        _ble.gap().on_advertising = [this](bool advertising) { _on_advertising(advertising); };
+        _ble.gap().on_disconnect = [this]() {
+            // LL_TERMINATE_IND goes out on the next event
+            sim::schedule(sim::now_us() + _interval_us(), &_air, [this]() { _link_down(false); });
+        };
+        _ble.gap().on_update = [this](uint16_t min, uint16_t max, uint16_t latency, uint16_t timeout) {
+            return _on_update(min, max, latency, timeout);
+        };
+        _server.on_write = [this](GattAttribute::Handle_t handle, bool notified) {
+            if (notified) _on_notification(handle);
+        };
+        _ble.gattClient().on_negotiate_mtu = [this]() { _exchange_mtu(); };
+    }
+
+    // the phone is in range and looking for the device from now
+    void begin(const Phone &phone, Delivered &delivered)
+    {
+        _phone = phone;
+        _delivered = &delivered;
+        _present = true;
+        _stats = Stats();
+        _acks = 0;
+        _busy = false;
+        _stalled = false;
+        _last_read.clear();
+
+        _data_ready = _server.find(DATA_READY_UUID)->getValueHandle();
+        _mask_on = _server.find(ON_UUID)->getValueHandle();
+        _time = _server.find(TIME_UUID)->getValueHandle();
+        _cough = _server.find(COUGH_UUID)->getValueHandle();
+        _event_log = _server.find(EVENT_LOG_UUID)->getValueHandle();
+        _records = _server.find(RECORDS_UUID)->getValueHandle();
+
+        if (_ble.gap().isAdvertisingActive(ble::LEGACY_ADVERTISING_HANDLE))
+        {
+            _advertising_since = sim::now_us();
+            _scan();
+        }
+    }
+
+    // and gone
+    Stats end()
+    {
+        if (_ble.gap().isAdvertisingActive(ble::LEGACY_ADVERTISING_HANDLE))
+        {
+            _count_advertising();
+        }
+        _count_connection_events();
+        _present = false;
+        sim::cancel(&_scanner);
+
+        _stats.interval = _interval;
+        return _stats;
+    }
+
+private:
+    uint64_t _interval_us() { return _interval * 1250ULL; }
+
+    void _at(uint64_t delay_us, std::function<void()> fn)
+    {
+        sim::schedule(sim::now_us() + delay_us, &_phone_actions, fn);
+    }
+
+    // one request and its response, each in its own PDU; returns the time it takes
+    uint64_t _exchange(uint16_t request_bytes, uint16_t response_bytes)
+    {
+        _stats.air_bytes += request_bytes + response_bytes + 2 * L2CAP_HEADER;
+        _stats.round_trips++;
+        if (_latency > 0)
+        {
+            _stats.connection_events++; // one the device would have slept through
+        }
+        return _interval_us();
+    }
+
+    void _count_advertising()
+    {
+        _stats.advertising_events += (sim::now_us() - _advertising_since) / ADVERTISING_INTERVAL_US + 1;
+        _advertising_since = sim::now_us();
+    }
+
+    void _count_connection_events()
+    {
+        if (_connected)
+        {
+            _stats.connection_events += (sim::now_us() - _events_since) / (_interval_us() * (1 + _latency));
+        }
+        _events_since = sim::now_us();
+    }
+
+    void _on_advertising(bool advertising)
+    {
+        if (advertising)
+        {
+            _advertising_since = sim::now_us();
+            if (_present && !_connecting && !_connected)
+            {
+                _scan();
+            }
+        }
+        else
+        {
+            _count_advertising();
+            sim::cancel(&_scanner); // a connect request not yet sent
+        }
+    }
+
+    /**
+     * The phone sends its connect request on the first advertising event
+     * it hears, scan_ms after advertising starts. Events are an interval
+     * apart from the start, the first an interval in, so advertising
+     * stopped in the same instant it started never takes a connection.
+     */
+    void _scan()
+    {
+        uint64_t events = std::max<uint64_t>(1, (_phone.scan_ms * 1000ULL + ADVERTISING_INTERVAL_US - 1) / ADVERTISING_INTERVAL_US);
+        sim::schedule(sim::now_us() + events * ADVERTISING_INTERVAL_US, &_scanner, [this]() { _connect(); });
+    }
+
+    // once the request is out the connection is made, whatever the device does meanwhile
+    void _connect()
+    {
+        _connecting = true;
+        _interval = _phone.connect_interval;
+        _latency = 0;
+        sim::schedule(sim::now_us() + _interval_us(), &_air, [this]() { _link_up(); });
+    }
+
+    void _link_up()
+    {
+        _connecting = false;
+        _connected = true;
+        _connected_at = sim::now_us();
+        _events_since = sim::now_us();
+        _mtu = SmartPPEService::DEFAULT_ATT_MTU;
+        _ble.gap().connection_complete(HANDLE, _interval, _latency, SUPERVISION_TIMEOUT);
+
+        uint64_t t = 0;
+        if (_phone.exchanges_mtu)
+        {
+            t += _exchange(3, 3);
+            _at(t, [this]() { _mtu_changed(); });
+        }
+        t += _exchange(5, 1); // DATA_READY's CCCD
+        _at(t, [this]() { _server.client_subscribe(HANDLE, _data_ready, true); });
+    }
+
+    void _link_down(bool by_phone)
+    {
+        _count_connection_events();
+        _connected = false;
+        _busy = false;
+        _stalled = false;
+        _present = _phone.reconnects && !by_phone; // otherwise it comes back for the next sync
+        sim::cancel(&_phone_actions);
+        sim::cancel(&_air);
+
+        _server.disconnected();
+        _ble.gap().disconnection_complete(HANDLE);
+    }
+
+    void _exchange_mtu()
+    {
+        _at(_exchange(3, 3), [this]() { _mtu_changed(); });
+    }
+
+    void _mtu_changed()
+    {
+        _mtu = std::min(_phone.mtu, MAX_ATT_MTU);
+        _stats.mtu = _mtu;
+        _server.att_mtu_changed(HANDLE, _mtu);
+    }
+
+    ble_error_t _on_update(uint16_t min, uint16_t max, uint16_t latency, uint16_t timeout)
+    {
+        uint64_t t = _exchange(16, 6); // L2CAP connection parameter update request and response
+        if (_phone.rejects_updates)
+        {
+            sim::schedule(sim::now_us() + t, &_air, [this, timeout]() {
+                _ble.gap().update_complete(BLE_ERROR_OPERATION_NOT_PERMITTED, HANDLE, _interval, _latency, timeout);
+            });
+            return BLE_ERROR_NONE;
+        }
+
+        // the shortest the phone takes in the range asked for, or its shortest at all
+        uint16_t interval = std::max(min, _phone.min_interval);
+        sim::schedule(sim::now_us() + t + UPDATE_EVENTS * _interval_us(), &_air, [this, interval, latency, timeout]() {
+            _count_connection_events();
+            _interval = interval;
+            _latency = latency;
+            if (interval <= BULK_INTERVAL && _stats.to_bulk_us == 0)
+            {
+                _stats.to_bulk_us = sim::now_us() - _connected_at;
+            }
+            _ble.gap().update_complete(BLE_ERROR_NONE, HANDLE, interval, latency, timeout);
+        });
+        return BLE_ERROR_NONE;
+    }
+
+    void _on_notification(GattAttribute::Handle_t handle)
+    {
+        std::vector<uint8_t> value = _server.find(handle)->value;
+        _stats.notifications++;
+        _stats.air_bytes += 3 + value.size() + L2CAP_HEADER;
+
+        sim::schedule(sim::now_us() + _interval_us(), &_phone_actions, [this, handle, value]() {
+            _server.data_sent(HANDLE, handle);
+            if (handle == _data_ready && !_busy && !_stalled)
+            {
+                _busy = true;
+                uint64_t notified_clock = _phone_clock();
+                _at(_phone.think_ms * 1000ULL + _latency * _interval_us() / 2, [this, value, notified_clock]() { _answer(value[0], notified_clock); });
+            }
+        });
+    }
+
+    // what the app does with a notification, which came in at notified_clock
+    void _answer(uint8_t kind, uint64_t notified_clock)
+    {
+        uint64_t t = 0;
+        if (_phone.confirms)
+        {
+            t += _exchange(3, 2);
+            kind = _server.client_read(HANDLE, _data_ready)[0];
+            if (kind == SmartPPEService::NO_DATA)
+            {
+                _at(t, [this]() { _busy = false; });
+                return;
+            }
+        }
+
+        if (_phone.stall_after >= 0 && _acks >= _phone.stall_after)
+        {
+            _stalled = true;
+            return;
+        }
+
+        GattAttribute::Handle_t payload = GattAttribute::INVALID_HANDLE;
+        switch (kind)
+        {
+            case SmartPPEService::MASK_ON: payload = _mask_on; break;
+            case SmartPPEService::RECORDS: payload = _records; break;
+            case SmartPPEService::COUGH_SAMPLE: payload = _cough; break;
+            case SmartPPEService::EVENT_LOG: payload = _event_log; break;
+        }
+
+        if (payload != GattAttribute::INVALID_HANDLE)
+        {
+            _decode(kind, _read(payload, t));
+        }
+
+        if (kind == SmartPPEService::MASK_ON)
+        {
+            _set_time(t, notified_clock);
+        }
+
+        if (_phone.drop_after >= 0 && _acks >= _phone.drop_after)
+        {
+            _at(t, [this]() { _link_down(true); });
+            return;
+        }
+
+        t += _exchange(4, 1);
+        _acks++;
+        _at(t, [this]() {
+            uint8_t no_data = SmartPPEService::NO_DATA;
+            _server.client_write(HANDLE, _data_ready, &no_data, 1);
+            _busy = false;
+        });
+    }
+
+    // a read, and read blobs while the responses come back full
+    std::vector<uint8_t> _read(GattAttribute::Handle_t handle, uint64_t &t)
+    {
+        std::vector<uint8_t> value = _server.client_read(HANDLE, handle);
+
+        uint16_t chunk = _mtu - 1;
+        uint16_t offset = 0;
+        while (true)
+        {
+            uint16_t size = std::min<uint16_t>(chunk, value.size() - offset);
+            t += _exchange(offset == 0 ? 3 : 5, 1 + size);
+            offset += size;
+            if (size < chunk)
+            {
+                break;
+            }
+        }
+
+        if (_last_read.count(handle) && _last_read[handle] == value)
+        {
+            _stats.redundant_reads++;
+        }
+        _last_read[handle] = value;
+
+        return value;
+    }
+
+    // zero asks for the time; anything else is the device's as of the MASK_ON announcement, left alone unless it's off
+    void _set_time(uint64_t &t, uint64_t notified_clock)
+    {
+        std::vector<uint8_t> value = _read(_time, t);
+        uint64_t published = 0;
+        memcpy(&published, value.data(), 8);
+
+        int64_t error = (int64_t)(published - notified_clock);
+        if (published != 0 && llabs(error) <= TIME_TOLERANCE_S)
+        {
+            return;
+        }
+
+        t += _exchange(3 + 8, 1);
+        _stats.time_writes++;
+        _at(t, [this]() {
+            uint64_t now = _phone_clock();
+            _server.client_write(HANDLE, _time, (const uint8_t *)&now, 8);
+        });
+    }
+
+    uint64_t _phone_clock()
+    {
+        return PHONE_EPOCH + _phone.clock_error_s + sim::now_us() / 1000000;
+    }
+
+    void _decode(uint8_t kind, const std::vector<uint8_t> &value)
+    {
+        if (kind == SmartPPEService::MASK_ON)
+        {
+            memcpy(&_delivered->mask_state, &value[8], 2);
+        }
+        else if (kind == SmartPPEService::RECORDS)
+        {
+            // reference (u32) | length (u8) | records, see SmartPPEService::updateRecords()
+            uint32_t reference = 0;
+            memcpy(&reference, &value[0], 4);
+            uint64_t timestamp = reference;
+            const uint8_t *records = &value[5];
+            uint16_t length = value[4];
+            uint16_t offset = 0;
+            while (offset < length)
+            {
+                uint32_t head = 0;
+                uint32_t reading = 0;
+                uint8_t size = RecordStream::read_varint(records + offset, length - offset, head);
+                uint8_t value_size = size ? RecordStream::read_varint(records + offset + size, length - offset - size, reading) : 0;
+                if (value_size == 0)
+                {
+                    check(false, _phone.name, "RECORDS packet cut inside a record");
+                    return;
+                }
+                offset += size + value_size;
+                timestamp += head >> RecordStream::TYPE_BITS;
+                _delivered->records.push_back({(uint8_t)(head & ((1 << RecordStream::TYPE_BITS) - 1)), timestamp, (uint16_t)reading});
+            }
+        }
+        else if (kind == SmartPPEService::COUGH_SAMPLE)
+        {
+            uint64_t timestamp = 0;
+            uint16_t peak = 0;
+            memcpy(&timestamp, &value[0], 8);
+            memcpy(&peak, &value[8], 2);
+            _delivered->coughs.push_back({timestamp, peak});
+        }
+        else if (kind == SmartPPEService::EVENT_LOG)
+        {
+            uint32_t first = 0;
+            memcpy(&first, &value[0], 4);
+            for (uint8_t i = 0; i < value[4]; i++)
+            {
+                _delivered->events.push_back(first + i);
+            }
+        }
+    }
+
+    BLE &_ble;
+    GattServer &_server;
+    Phone _phone = phone("");
+    Delivered *_delivered = nullptr;
+    Stats _stats;
+
+    // owners of what's scheduled, cancelled on their own
+    char _air = 0; // link layer: connection, parameter updates, disconnection
+    char _scanner = 0; // a connect request not yet sent
+    char _phone_actions = 0;
+
+    bool _present = false;
+    bool _connecting = false;
+    bool _connected = false;
+    bool _busy = false; // answering a notification
+    bool _stalled = false;
+    int _acks = 0;
+    uint16_t _interval = 24;
+    uint16_t _latency = 0;
+    uint16_t _mtu = SmartPPEService::DEFAULT_ATT_MTU;
+    uint64_t _connected_at = 0;
+    uint64_t _events_since = 0;
+    uint64_t _advertising_since = 0;
+    std::map<GattAttribute::Handle_t, std::vector<uint8_t>> _last_read;
+
+    GattAttribute::Handle_t _data_ready = 0;
+    GattAttribute::Handle_t _mask_on = 0;
+    GattAttribute::Handle_t _time = 0;
+    GattAttribute::Handle_t _cough = 0;
+    GattAttribute::Handle_t _event_log = 0;
+    GattAttribute::Handle_t _records = 0;
+};
+
+// GattServerProcess, as far as the manager sees it: advertising comes back whenever the link goes down
+class BLEProcess : public ble::Gap::EventHandler
+{
+public:
+    BLEProcess(BLE &ble) : _ble(ble) {}
+
+    void onDisconnectionComplete(const ble::DisconnectionCompleteEvent &event) override
+    {
+        _ble.gap().startAdvertising(ble::LEGACY_ADVERTISING_HANDLE);
+    }
+
+private:
+    BLE &_ble;
+};
+
+// the device, as FaceBitState holds it
+struct Device
+{
+    Device() :
+    conn_manager(queue),
+    data_sync(&service, conn_manager, records, coughs),
+    process(ble),
+    link(ble)
+    {
+    }
+
+    FRAM fram;
+    BLE ble;
+    events::EventQueue queue;
+    SmartPPEService service;
+    ConnectionManager conn_manager;
+    RecordStream records;
+    DataSync::CoughBuffer_t coughs;
+    DataSync data_sync;
+    BLEProcess process;
+    Link link;
+    int times_set = 0;
+};
+
+typedef std::tuple<uint8_t, uint16_t, uint32_t> Reading_t; // type, value, monotonic s
+typedef std::pair<uint16_t, uint32_t> Cough_t; // peak, monotonic s
+
+// what the device has logged, and what of it the phone has
+struct Ledger
+{
+    std::multiset<Reading_t> pending_readings;
+    std::multiset<Reading_t> delivered_readings;
+    std::multiset<Cough_t> pending_coughs;
+    std::multiset<Cough_t> delivered_coughs;
+    std::vector<int> events_seen; // by index
+};
+
+struct Scenario
+{
+    Phone phone;
+    int num_readings;
+    int num_coughs;
+    int num_events;
+    uint32_t idle_s; // before logging this sync's readings
+    bool completes;
+    bool sets_time; // the phone writes the time
+    bool duplicates; // payloads read but not acknowledged last time come again
+};
+
+/**
+ * Readings as the tasks log them, monotonic timestamps, then time moves on
+ * past the last of them.
+ */
+void log_readings(Device &device, Ledger &ledger, const Scenario &scenario)
+{
+    TimeBase *time_base = TimeBase::get_instance();
+    EventLog *event_log = EventLog::get_instance();
+    static const int GAPS[] = {1, 2, 3, 5, 40, 120};
+
+    sim::run_until(sim::now_us() + scenario.idle_s * 1000000ULL);
+    uint32_t t = time_base->monotonic_s();
+
+    for (int i = 0; i < scenario.num_readings; i++)
+    {
+        t += GAPS[pick(0, 5)];
+        uint8_t type = pick(0, DataSync::RECORD_TYPE_LAST - 1);
+        uint16_t value = type == DataSync::RECORD_HEART_RATE ? pick(55, 110) : type == DataSync::RECORD_RESPIRATORY_RATE ? pick(80, 300) : pick(0, 100);
+        device.records.append(type, t, value);
+        ledger.pending_readings.insert(Reading_t(type, value, t));
+    }
+
+    for (int i = 0; i < scenario.num_coughs; i++)
+    {
+        t += pick(5, 60);
+        CoughDetection::CoughEvent_t cough = {t, (uint16_t)pick(20, 400), (uint8_t)pick(10, 40), (uint8_t)pick(1, 3)};
+        device.coughs.push(cough);
+        ledger.pending_coughs.insert(Cough_t(cough.peak, t));
+    }
+
+    for (int i = 0; i < scenario.num_events; i++)
+    {
+        event_log->record(EventLog::EVENT_TASK, i % 8);
+    }
+    event_log->flush();
+
+    sim::run_until((t + 10) * 1000000ULL);
+}
+
+// find a delivered item among the wall-timestamped ones, to the second the epoch offset loses
+template <typename T, typename F>
+bool take(std::multiset<T> &from, F make, int64_t monotonic)
+{
+    for (int64_t d : {0, -1, 1})
+    {
+        auto found = from.find(make(monotonic + d));
+        if (found != from.end())
+        {
+            from.erase(found);
+            return true;
+        }
+    }
+    return false;
+}
+
+// tally the phone's haul; returns the duplicates, and counts anything that matches nothing
+int reconcile(Ledger &ledger, const Delivered &delivered, int64_t offset, int &unknown)
+{
+    int duplicates = 0;
+    unknown = 0;
+
+    for (const RecordStream::Record_t &record : delivered.records)
+    {
+        auto make = [&](int64_t t) { return Reading_t(record.type, record.value, (uint32_t)t); };
+        int64_t monotonic = (int64_t)record.timestamp - offset;
+        if (take(ledger.pending_readings, make, monotonic))
+        {
+            ledger.delivered_readings.insert(make(monotonic));
+        }
+        else if (ledger.delivered_readings.count(make(monotonic)) || ledger.delivered_readings.count(make(monotonic - 1)) || ledger.delivered_readings.count(make(monotonic + 1)))
+        {
+            duplicates++;
+        }
+        else
+        {
+            unknown++;
+        }
+    }
+
+    for (const auto &cough : delivered.coughs)
+    {
+        auto make = [&](int64_t t) { return Cough_t(cough.second, (uint32_t)t); };
+        int64_t monotonic = (int64_t)cough.first - offset;
+        if (take(ledger.pending_coughs, make, monotonic))
+        {
+            ledger.delivered_coughs.insert(make(monotonic));
+        }
+        else
+        {
+            duplicates++;
+        }
+    }
+
+    for (uint32_t index : delivered.events)
+    {
+        if (index >= ledger.events_seen.size())
+        {
+            unknown++;
+            continue;
+        }
+        if (ledger.events_seen[index]++ > 0)
+        {
+            duplicates++;
+        }
+    }
+
+    return duplicates;
+}
+
+struct Cycle
+{
+    uint64_t cycle_us;
+    Link::Stats stats;
+};
+
+double charge_uc(const Link::Stats &stats)
+{
+    return stats.advertising_events * ADVERTISING_EVENT_UC + stats.connection_events * CONNECTION_EVENT_UC + stats.air_bytes * AIR_BYTE_UC;
+}
+
+Cycle sync(Device &device, Ledger &ledger, const Scenario &scenario, bool print = true)
+{
+    TimeBase *time_base = TimeBase::get_instance();
+    EventLog *event_log = EventLog::get_instance();
+    const char *name = scenario.phone.name;
+
+    log_readings(device, ledger, scenario);
+    uint32_t events_before = event_log->get_count();
+    ledger.events_seen.resize(events_before, 0);
+    int times_set = device.times_set;
+
+    Delivered delivered;
+    device.link.begin(scenario.phone, delivered);
+
+    // as FaceBitState::_sync_data() with the stack up
+    uint64_t start_us = sim::now_us();
+    device.service.resetConnection();
+    device.conn_manager.open();
+    bool synced = device.data_sync.run(0x01, time_base->monotonic_s());
+    device.data_sync.close();
+    uint64_t cycle_us = sim::now_us() - start_us;
+
+    // whatever the BLE thread still had queued
+    sim::run_until(sim::now_us() + 1000000);
+
+    Link::Stats stats = device.link.end();
+    bool closed = !device.ble.gap().is_connected() && !device.ble.gap().isAdvertisingActive(ble::LEGACY_ADVERTISING_HANDLE);
+
+    int64_t offset = (int64_t)time_base->get_epoch() - time_base->monotonic_s(); // to the second
+    int unknown = 0;
+    int duplicates = reconcile(ledger, delivered, offset, unknown);
+
+    bool all_readings = ledger.pending_readings.empty() && ledger.pending_coughs.empty();
+    bool all_events = true;
+    for (uint32_t i = 0; i < events_before; i++)
+    {
+        all_events = all_events && ledger.events_seen[i] > 0;
+    }
+
+    int64_t clock_error = (int64_t)time_base->get_epoch() - (int64_t)(PHONE_EPOCH + scenario.phone.clock_error_s + sim::now_us() / 1000000);
+
+    check(closed, name, "link up or advertising after close()");
+    check(synced == scenario.completes, name, scenario.completes ? "sync failed" : "sync completed");
+    check(unknown == 0, name, "the phone got readings or events that were never logged, or on the wrong time");
+    check(scenario.duplicates || duplicates == 0, name, "the phone got something twice");
+    check(device.records.get_dropped_count() == 0, name, "readings evicted; the scenario logs too many");
+    check(!scenario.completes || scenario.phone.rejects_updates || scenario.phone.min_interval > BULK_INTERVAL || (stats.to_bulk_us > 0 && stats.to_bulk_us <= MAX_TO_BULK_US),
+        name, "bulk interval late, or never, for a phone that takes it");
+    if (synced)
+    {
+        check(all_readings, name, "readings or coughs logged before the sync didn't reach the phone");
+        check(all_events, name, "events logged before the sync didn't reach the phone");
+        check(delivered.mask_state == 0x01, name, "MASK_ON didn't reach the phone");
+        check((stats.time_writes > 0) == scenario.sets_time, name, scenario.sets_time ? "the phone didn't set the time" : "the phone wrote a time the device had right");
+        check(device.times_set - times_set == (scenario.sets_time ? 1 : 0), name, "the device took a new time a different number of times than the phone gave one");
+        check(llabs(clock_error) <= 1, name, "the device's time is off the phone's");
+    }
+
+    char to_bulk[24] = "-";
+    if (stats.to_bulk_us)
+    {
+        snprintf(to_bulk, sizeof(to_bulk), "%llu", (unsigned long long)(stats.to_bulk_us / 1000));
+    }
+
+    if (print) printf("  %-22s %-4s %6llu %7s %8.2f %4u %6u %6u %7u %5u %5d %4s\n",
+        name, synced ? "ok" : "FAIL", (unsigned long long)(cycle_us / 1000), to_bulk, stats.interval * 1.25, stats.mtu,
+        stats.air_bytes, stats.round_trips, stats.notifications, stats.redundant_reads, duplicates, stats.time_writes ? "set" : "-");
+
+    return {cycle_us, stats};
+}
+
+/**
+ * What keeping the stack up between syncs saves. A warm cycle is the
+ * sync as run here; a cold one brings the stack up first, so it's the
+ * same sync STACK_BRINGUP_MS later, with the CPU busy for that long.
+ * The charges come from the link counts and the assumed figures above.
+ */
+void cycles(Device &device, Ledger &ledger)
+{
+    Scenario readings = {phone("110 readings"), 110, 5, 40, 600, true, false, false};
+    Scenario quiet = {phone("last sync's event only"), 0, 0, 0, 600, true, false, false};
+    double bringup_uc = STACK_BRINGUP_MS * CPU_MA;
+
+    printf("\nSync cycle, modelled: charge from the link counts, at 3 V with the DC/DC on\n");
+    printf("  %-30s %6s %6s %7s %6s %7s\n", "sync", "ms", "adv ev", "conn ev", "air B", "uC");
+
+    for (const Scenario &scenario : {readings, quiet})
+    {
+        Cycle cycle = sync(device, ledger, scenario, false);
+        double warm_uc = charge_uc(cycle.stats);
+        double cold_uc = warm_uc + bringup_uc;
+
+        for (bool cold : {false, true})
+        {
+            char name[48];
+            snprintf(name, sizeof(name), "%s, %s", cold ? "cold" : "warm", scenario.phone.name);
+            printf("  %-30s %6.0f %6u %7u %6u %7.0f\n", name, cycle.cycle_us / 1000.0 + (cold ? STACK_BRINGUP_MS : 0),
+                cycle.stats.advertising_events, cycle.stats.connection_events, cycle.stats.air_bytes, cold ? cold_uc : warm_uc);
+        }
+        printf("  keeping the stack up saves %.0f ms and %.0f uC, %.0f%% of the cold cycle\n", STACK_BRINGUP_MS, bringup_uc, 100 * bringup_uc / cold_uc);
+    }
+
+    printf("\nAssumed, not measured: %.0f uC an advertising event, %.0f uC a connection event, %.3f uC a byte\n",
+        ADVERTISING_EVENT_UC, CONNECTION_EVENT_UC, AIR_BYTE_UC);
+    printf("on air, and a %.0f ms stack bring-up at %.1f mA. The reboot the old flow added after every sync\n", STACK_BRINGUP_MS, CPU_MA);
+    printf("isn't counted. SYNC CYCLE in the firmware log has the figures on target.\n");
+}
+
+} // namespace
+
+int main()
+{
+    static Device device;
+    device.fram.power_on();
+    TimeBase::get_instance()->initialize(&device.fram);
+    EventLog::get_instance()->initialize(&device.fram);
+
+    // as FaceBitState::_on_ble_init()
+    device.service.start(device.ble, device.queue);
+    device.conn_manager.attach(device.ble, &device.process);
+    device.conn_manager.on_disconnection(callback(&device.service, &SmartPPEService::onDisconnection));
+    device.data_sync.on_time_set([]() { device.times_set++; });
+
+    Phone fast = phone("MTU 247, 15 ms");
+    Phone mtu_23 = phone("MTU 23, no exchange");
+    mtu_23.mtu = 23;
+    mtu_23.exchanges_mtu = false;
+    Phone ios = phone("MTU 185, 30 ms min");
+    ios.mtu = 185;
+    ios.min_interval = 24;
+    Phone slow = phone("slow app, 45 ms min");
+    slow.think_ms = 1500;
+    slow.min_interval = 36;
+    Phone unconfirmed = phone("doesn't confirm");
+    unconfirmed.confirms = false;
+    Phone rejects = phone("rejects updates");
+    rejects.rejects_updates = true;
+    Phone ahead = phone("clock 30 s ahead");
+    ahead.clock_error_s = 30;
+    Phone right = phone("clock right again");
+    Phone stalls = phone("stalls after 2 acks");
+    stalls.stall_after = 2;
+    Phone drops = phone("drops after 3 acks");
+    drops.drop_after = 3;
+    Phone next = phone("next sync");
+    Phone at_close = phone("connects as it closes");
+    at_close.scan_ms = device.data_sync.CONNECTION_TIMEOUT.count(); // its request goes out on the event at the deadline
+    Phone autoconnect = phone("reconnects at once");
+    autoconnect.reconnects = true;
+    Phone day_later = phone("a day later");
+
+    const Scenario scenarios[] = {
+        // phone, readings, coughs, events, idle s, completes, sets time, duplicates
+        {fast, 110, 5, 40, 60, true, true, false},
+        {mtu_23, 110, 5, 40, 600, true, false, false},
+        {ios, 110, 5, 40, 600, true, false, false},
+        {slow, 110, 5, 40, 600, true, false, false},
+        {unconfirmed, 110, 5, 40, 600, true, false, false},
+        {rejects, 110, 5, 40, 600, true, false, false},
+        {ahead, 110, 5, 40, 600, true, true, false},
+        {right, 20, 1, 5, 600, true, true, false},
+        {stalls, 60, 5, 40, 600, false, false, false},
+        {next, 0, 0, 0, 600, true, false, false},
+        {drops, 60, 5, 40, 600, false, false, false},
+        {next, 0, 0, 0, 600, true, false, true},
+        {at_close, 20, 1, 5, 600, false, false, false},
+        {next, 0, 0, 0, 600, true, false, false},
+        {autoconnect, 20, 1, 5, 600, true, false, false},
+        {day_later, 110, 5, 40, 25 * 3600, true, true, false},
+    };
+
+    printf("Syncs, the device's stack up, one phone each\n");
+    printf("  %-22s %-4s %6s %7s %8s %4s %6s %6s %7s %5s %5s %4s\n",
+        "phone", "", "ms", "to bulk", "interval", "MTU", "air B", "trips", "notify", "reread", "dup", "time");
+
+    Ledger ledger;
+    for (const Scenario &scenario : scenarios)
+    {
+        sync(device, ledger, scenario);
+    }
+
+    printf("\nms: from opening the window to the link down. to bulk: from connecting to the bulk interval\n");
+    printf("applying. interval: at the end, ms. air B: ATT PDUs and L2CAP headers both ways. trips: request\n");
+    printf("and response pairs. reread: payloads read again unchanged. dup: readings, coughs or events the\n");
+    printf("phone already had. time: the phone wrote the time.\n");
+
+    cycles(device, ledger);
+
+    return failures ? 1 : 0;
+}
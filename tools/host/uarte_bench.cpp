@@ -0,0 +1,224 @@
+/**
+ * The UARTE log transport on the host: runs the real UarteLogTransport
+ * against a model of UARTE0 (include/nrf52.h) in simulated time, checks
+ * that what reaches the wire is what was queued, in order, less what was
+ * counted as dropped, and compares the modeled cost with the polled
+ * UnbufferedSerial output the Logger uses by default.
+ *
+ * Everything below "modeled" comes from the constants here, not from a
+ * measurement: the CPU cost of write() and of a timer interrupt are
+ * estimates for the Cortex-M4, and polled serial keeps the CPU awake for
+ * the whole time its bytes are on the wire. Build the firmware with
+ * LOGGER_PROFILING and read UarteLogTransport::get_active_time_us() for
+ * the target's numbers.
+ */
+
+#include "UarteLogTransport.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+const uint32_t BAUD_RATE = 115200;
+const uint64_t TXSTOPPED_DELAY_US = 1; // after STOPTX; never seen on the first check
+const double RUN_SECONDS = 60;
+
+const double MCU_HZ = 64e6;
+const double MCU_RUN_A = 3.7e-3; // nRF52832 64 MHz from flash, DC/DC
+const double UART_ACTIVE_A = 0.3e-3; // UART(E) TX plus the HF clock it holds, estimate
+const double WRITE_CYCLES = 80; // write(): critical section, bookkeeping, starting a burst
+const double WRITE_CYCLES_PER_BYTE = 1; // memcpy
+const double TIMER_IRQ_CYCLES = 300; // RTC interrupt, ticker queue, callback
+
+/**
+ * UARTE0 transmit: STARTTX sends TXD.MAXCNT bytes from TXD.PTR and raises
+ * ENDTX once the last one is on the wire; STOPTX raises TXSTOPPED shortly
+ * after. The bytes are read from RAM as they'd be sent, so a transport that
+ * touched the buffer mid-burst would show up as corrupted output.
+ */
+class UarteModel
+{
+public:
+    std::string wire;
+    uint64_t enabled_us = 0;
+    uint32_t bursts = 0;
+    uint32_t errors = 0;
+
+    void step()
+    {
+        NRF_UARTE_Type* uarte = NRF_UARTE0;
+        uint64_t now = sim::now_us();
+
+        bool enabled = uarte->ENABLE == (UARTE_ENABLE_ENABLE_Enabled << UARTE_ENABLE_ENABLE_Pos);
+        if (_enabled) enabled_us += now - _since_us;
+        _enabled = enabled;
+        _since_us = now;
+
+        if (uarte->TASKS_STARTTX)
+        {
+            uarte->TASKS_STARTTX = 0;
+            if (!enabled || _sending) errors++;
+
+            const uint8_t* ptr = reinterpret_cast<const uint8_t*>(uarte->TXD.PTR);
+            uint32_t count = uarte->TXD.MAXCNT;
+            uint64_t wire_us = (count * 10 * 1000000ULL + BAUD_RATE - 1) / BAUD_RATE;
+            _sending = true;
+            bursts++;
+
+            sim::schedule(now + wire_us, this, [this, ptr, count]() {
+                wire.append(reinterpret_cast<const char*>(ptr), count);
+                _sending = false;
+                NRF_UARTE0->EVENTS_ENDTX = 1;
+            });
+        }
+
+        if (uarte->TASKS_STOPTX)
+        {
+            uarte->TASKS_STOPTX = 0;
+            sim::schedule(now + TXSTOPPED_DELAY_US, this, []() { NRF_UARTE0->EVENTS_TXSTOPPED = 1; });
+        }
+    }
+
+private:
+    bool _enabled = false;
+    bool _sending = false;
+    uint64_t _since_us = 0;
+};
+
+struct Workload
+{
+    const char* name;
+    double period_s; // between bursts of lines
+    int lines; // per burst
+    int line_bytes;
+};
+
+struct Result
+{
+    uint32_t written = 0;
+    uint32_t dropped = 0;
+    uint32_t dropped_writes = 0;
+    uint32_t writes = 0;
+    uint32_t timer_fires = 0;
+    uint64_t enabled_us = 0;
+    uint64_t transport_active_us = 0;
+    bool wire_ok = false;
+};
+
+Result run(const Workload& w)
+{
+    sim::state() = sim::State();
+    *NRF_UARTE0 = NRF_UARTE_Type();
+
+    UarteModel model;
+    sim::state().models.push_back([&model]() { model.step(); });
+
+    Result result;
+    std::string expected;
+    {
+        UarteLogTransport uarte(6);
+
+        int num_bursts = (int)(RUN_SECONDS / w.period_s + 0.5);
+        for (int burst = 0; burst < num_bursts; burst++)
+        {
+            sim::run_until((uint64_t)(burst * w.period_s * 1e6));
+
+            for (int i = 0; i < w.lines; i++)
+            {
+                char line[256];
+                int n = snprintf(line, sizeof(line), "[I] // burst %d line %d ", burst, i);
+                for (; n < w.line_bytes - 2; n++) line[n] = 'a' + (burst + i + n) % 26;
+                line[n++] = '\r';
+                line[n++] = '\n';
+
+                uint32_t dropped = uarte.get_dropped_count();
+                uarte.write(line, n);
+                uint32_t lost = uarte.get_dropped_count() - dropped;
+                expected.append(line, n - lost); // a write loses its tail
+                result.written += n;
+                result.writes++;
+            }
+        }
+
+        uarte.flush();
+
+        result.dropped = uarte.get_dropped_count();
+        result.dropped_writes = uarte.get_dropped_writes();
+        result.transport_active_us = uarte.get_active_time_us();
+        if (uarte.get_bytes_sent() != model.wire.size()) model.errors++;
+    }
+
+    sim::run_until(sim::now_us() + 1000);
+
+    result.timer_fires = sim::state().timer_fires;
+    result.enabled_us = model.enabled_us;
+    result.wire_ok = model.errors == 0 && model.wire == expected
+        && result.written == model.wire.size() + result.dropped
+        && result.transport_active_us == model.enabled_us
+        && NRF_UARTE0->ENABLE == (UARTE_ENABLE_ENABLE_Disabled << UARTE_ENABLE_ENABLE_Pos);
+
+    sim::state().models.clear();
+    return result;
+}
+
+} // namespace
+
+int main()
+{
+    const Workload workloads[] = {
+        {"status line every 1 s", 1.0, 1, 48},
+        {"10 lines/s", 0.1, 1, 48},
+        {"3 lines every 1 s", 1.0, 3, 64},
+        {"burst of 8 every 2 s", 2.0, 8, 48},
+        {"100 lines/s", 0.01, 1, 48},
+    };
+
+    int failures = 0;
+
+    printf("%-24s %7s %7s %7s %6s %5s\n", "", "bytes", "sent", "dropped", "lines", "wire");
+    std::vector<Result> results;
+    for (const Workload& w : workloads)
+    {
+        Result r = run(w);
+        results.push_back(r);
+        failures += !r.wire_ok;
+        printf("%-24s %7u %7u %7u %6u %5s\n", w.name, r.written, r.written - r.dropped, r.dropped,
+            r.dropped_writes, r.wire_ok ? "ok" : "FAIL");
+    }
+
+    printf("\nmodeled, per second of logging\n");
+    printf("%-24s %11s %9s %9s %7s %9s\n", "", "", "cycles", "cpu ms", "uart ms", "avg uA");
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const Result& r = results[i];
+
+        // polled serial: the CPU waits out every byte with the peripheral on
+        double serial_s = (r.written * 10.0 / BAUD_RATE) / RUN_SECONDS;
+        double serial_cycles = serial_s * MCU_HZ;
+        double serial_ua = serial_s * (MCU_RUN_A + UART_ACTIVE_A) * 1e6;
+
+        double uarte_cycles = (r.writes * WRITE_CYCLES + r.written * WRITE_CYCLES_PER_BYTE
+            + r.timer_fires * TIMER_IRQ_CYCLES) / RUN_SECONDS;
+        double uarte_cpu_s = uarte_cycles / MCU_HZ;
+        double uarte_enabled_s = r.enabled_us / 1e6 / RUN_SECONDS;
+        double uarte_ua = (uarte_cpu_s * MCU_RUN_A + uarte_enabled_s * UART_ACTIVE_A) * 1e6;
+
+        printf("%-24s %11s %9.0f %9.2f %7.2f %9.1f\n", workloads[i].name, "serial", serial_cycles,
+            serial_s * 1e3, serial_s * 1e3, serial_ua);
+        printf("%-24s %11s %9.0f %9.2f %7.2f %9.1f\n", "", "uarte", uarte_cycles,
+            uarte_cpu_s * 1e3, uarte_enabled_s * 1e3, uarte_ua);
+    }
+
+    printf("\nsent: bytes on the modeled wire; wire: they match what was queued, in order, less\n"
+        "the counted drops, UARTE0 ends disabled and get_active_time_us() agrees. lines: writes\n"
+        "that lost bytes. cycles and cpu ms: CPU awake time, from the estimates in uarte_bench.cpp;\n"
+        "serial waits out each byte at %u baud. uart ms: peripheral (and HF clock) enabled.\n"
+        "avg uA: of both.\n",
+        BAUD_RATE);
+
+    return failures ? 1 : 0;
+}
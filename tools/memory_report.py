@@ -0,0 +1,163 @@
+#!/usr/bin/env python3
+"""
+Report the static RAM budget of a FaceBit firmware ELF.
+
+Lists the writable sections (.data, .bss, .noinit, ...), the largest objects
+in them, and the thread stacks and event buffers placed there. Built with
+"static-memory": true, every buffer the firmware uses after startup should
+appear here, so the total is the worst case and anything left of RAM is
+only for the startup singletons and the BLE stack's own allocations.
+
+usage: memory_report.py firmware.elf [count] [ram bytes]
+
+count defaults to 20 symbols, ram to the nRF52832's 64 KiB.
+
+Needs only the standard library; names are demangled with c++filt when it
+is on the PATH.
+"""
+
+import shutil
+import struct
+import subprocess
+import sys
+
+RAM_SIZE = 64 * 1024
+STACK_HINTS = ("stack", "queue_buffer", "_stk")
+
+SHT_SYMTAB = 2
+SHF_WRITE = 0x1
+SHF_ALLOC = 0x2
+STT_OBJECT = 1
+
+
+class Section:
+    def __init__(self, name, type, flags, addr, offset, size, link):
+        self.name = name
+        self.type = type
+        self.flags = flags
+        self.addr = addr
+        self.offset = offset
+        self.size = size
+        self.link = link
+
+
+def read_elf(data):
+    """Return the sections and (name, value, size, type) symbols of an ELF32 or ELF64 image."""
+    if data[:4] != b"\x7fELF":
+        raise ValueError("not an ELF file")
+
+    wide = {1: False, 2: True}[data[4]]
+    order = {1: "<", 2: ">"}[data[5]]
+
+    if wide:
+        shoff, = struct.unpack_from(order + "Q", data, 0x28)
+        shentsize, shnum, shstrndx = struct.unpack_from(order + "HHH", data, 0x3A)
+        header = order + "IIQQQQIIQQ"
+    else:
+        shoff, = struct.unpack_from(order + "I", data, 0x20)
+        shentsize, shnum, shstrndx = struct.unpack_from(order + "HHH", data, 0x2E)
+        header = order + "IIIIIIIIII"
+
+    raw = []
+    for i in range(shnum):
+        name, type, flags, addr, offset, size, link = struct.unpack_from(header, data, shoff + i * shentsize)[:7]
+        raw.append((name, type, flags, addr, offset, size, link))
+
+    names = raw[shstrndx]
+    sections = [Section(c_string(data, names[4] + r[0]), *r[1:]) for r in raw]
+
+    symbols = []
+    for section in sections:
+        if section.type != SHT_SYMTAB:
+            continue
+        strtab = sections[section.link]
+        entry = 24 if wide else 16
+        for offset in range(section.offset, section.offset + section.size, entry):
+            if wide:
+                name, info, _, _, value, size = struct.unpack_from(order + "IBBHQQ", data, offset)
+            else:
+                name, value, size, info, _, _ = struct.unpack_from(order + "IIIBBH", data, offset)
+            symbols.append((c_string(data, strtab.offset + name), value, size, info & 0xF))
+
+    return sections, symbols
+
+
+def c_string(data, offset):
+    return data[offset:data.index(b"\0", offset)].decode("ascii", "replace")
+
+
+def ram_sections(sections):
+    return [s for s in sections if s.flags & SHF_ALLOC and s.flags & SHF_WRITE and s.size]
+
+
+def ram_objects(symbols, sections):
+    ranges = [(s.addr, s.addr + s.size, s.name) for s in sections]
+
+    objects = []
+    for name, address, size, type in symbols:
+        if type != STT_OBJECT or not size:
+            continue
+        for start, end, section in ranges:
+            if start <= address < end:
+                objects.append((size, name, section))
+                break
+    return objects
+
+
+def demangler(names):
+    """Map each name to its demangled form, with one c++filt run for all of them."""
+    tool = shutil.which("arm-none-eabi-c++filt") or shutil.which("c++filt")
+    if tool is None or not names:
+        return {}
+    try:
+        out = subprocess.run([tool], input="\n".join(names), capture_output=True, text=True, check=True).stdout
+    except (OSError, subprocess.CalledProcessError):
+        return {}
+    return dict(zip(names, out.splitlines()))
+
+
+def main():
+    if not 2 <= len(sys.argv) <= 4:
+        print(__doc__.strip(), file=sys.stderr)
+        return 1
+
+    count = int(sys.argv[2]) if len(sys.argv) > 2 else 20
+    ram = int(sys.argv[3], 0) if len(sys.argv) > 3 else RAM_SIZE
+
+    try:
+        with open(sys.argv[1], "rb") as f:
+            sections, symbols = read_elf(f.read())
+    except (OSError, ValueError) as e:
+        print("%s: %s" % (sys.argv[1], e), file=sys.stderr)
+        return 1
+    sections = ram_sections(sections)
+    objects = ram_objects(symbols, sections)
+    names = demangler(sorted({o[1] for o in objects}))
+
+    def demangle(name):
+        return names.get(name, name)
+
+    total = 0
+    print("Sections:")
+    for section in sections:
+        print("  %-16s %7d B" % (section.name, section.size))
+        total += section.size
+    print("  %-16s %7d B of %d (%.1f%%), %d B left" % ("total", total, ram, 100.0 * total / ram, ram - total))
+
+    objects.sort(reverse=True)
+    print("\nLargest objects:")
+    for size, name, section in objects[:count]:
+        print("  %7d B  %-8s %s" % (size, section, demangle(name)))
+
+    stacks = [o for o in objects if any(hint in o[1].lower() for hint in STACK_HINTS)]
+    if stacks:
+        print("\nThread stacks and event buffers:")
+        for size, name, section in stacks:
+            print("  %7d B  %-8s %s" % (size, section, demangle(name)))
+        print("  %7d B  total" % sum(o[0] for o in stacks))
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
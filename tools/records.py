@@ -0,0 +1,139 @@
+#!/usr/bin/env python3
+"""
+Decode FaceBit record streams (see inc/RecordStream.h).
+
+A RECORDS characteristic packet is:
+
+    reference timestamp (u32 LE) | length (u8) | records
+
+and each record is two unsigned LEB128 varints:
+
+    (timestamp delta << 2) | type,  value
+
+Timestamps are seconds since the epoch, or seconds of device on-time (well
+before 2020) if the phone never gave the device a time. The reference is
+the record before the packet (the first record itself for the first
+packet); add each delta to the running timestamp to get the record's own.
+
+The broadcast (see inc/Broadcaster.h) carries the same records in its
+manufacturer specific data:
+
+    company ID (u16 LE) | version (u8) | sequence (u8) | mask state (u8) | reference timestamp (u32 LE) | records
+
+where the reference is the oldest record itself.
+
+usage: records.py decode packet.bin [packet.bin ...]
+       records.py advert <manufacturer data as hex>
+       records.py check packets.bin readings.txt
+
+`check` decodes packets written back to back, as tools/host/run.sh's
+record_stream_bench writes them from the firmware's RecordStream, and
+compares them with the readings that went in, one "type timestamp value"
+per line.
+"""
+
+import struct
+import sys
+import time
+
+TYPE_BITS = 2
+TYPES = ["HEART_RATE", "RESPIRATORY_RATE", "MASK_FIT"]
+
+EPOCH_2020 = 1577836800
+
+
+def read_varint(data, pos):
+    value = 0
+    for i in range(5):
+        if pos + i >= len(data):
+            break
+        value |= (data[pos + i] & 0x7F) << (7 * i)
+        if not data[pos + i] & 0x80:
+            return value, pos + i + 1
+    raise ValueError("truncated varint at %d" % pos)
+
+
+def decode(data, reference):
+    """Yields (type, timestamp, value), timestamps counted from reference."""
+    pos = 0
+    while pos < len(data):
+        tagged, pos = read_varint(data, pos)
+        value, pos = read_varint(data, pos)
+        reference += tagged >> TYPE_BITS
+        yield tagged & ((1 << TYPE_BITS) - 1), reference, value
+
+
+def decode_packet(packet):
+    """Yields (type, timestamp, value)."""
+    reference, length = struct.unpack_from("<IB", packet)
+    return decode(packet[5:5 + length], reference)
+
+
+def split_packets(data):
+    """Yields the packets in data, written back to back."""
+    pos = 0
+    while pos < len(data):
+        if pos + 5 > len(data):
+            raise ValueError("truncated packet header at %d" % pos)
+        length = data[pos + 4]
+        if pos + 5 + length > len(data):
+            raise ValueError("truncated packet at %d" % pos)
+        yield data[pos:pos + 5 + length]
+        pos += 5 + length
+
+
+def format_timestamp(timestamp):
+    if timestamp < EPOCH_2020:
+        return "%d s on-time" % timestamp
+    return time.strftime("%Y-%m-%d %H:%M:%S", time.gmtime(timestamp))
+
+
+def decode_advert(data):
+    """Returns (sequence, mask state, [(type, timestamp, value)])."""
+    company, version, sequence, mask_state, reference = struct.unpack_from("<HBBBI", data)
+    if version != 2:
+        raise ValueError("unknown broadcast version %d" % version)
+    return sequence, mask_state, list(decode(data[9:], reference))
+
+
+def check(packets_path, readings_path):
+    with open(packets_path, "rb") as f:
+        decoded = [reading for packet in split_packets(f.read()) for reading in decode_packet(packet)]
+    with open(readings_path) as f:
+        expected = [tuple(int(field) for field in line.split()) for line in f if line.strip()]
+
+    for i, (got, want) in enumerate(zip(decoded, expected)):
+        if got != want:
+            print("reading %d: decoded %s, expected %s" % (i, got, want))
+            return 1
+    if len(decoded) != len(expected):
+        print("decoded %d readings, expected %d" % (len(decoded), len(expected)))
+        return 1
+
+    print("%d readings decoded from %s as they went in" % (len(decoded), packets_path))
+    return 0
+
+
+def main(argv):
+    if len(argv) == 4 and argv[1] == "check":
+        return check(argv[2], argv[3])
+    elif len(argv) == 3 and argv[1] == "advert":
+        sequence, mask_state, readings = decode_advert(bytes.fromhex(argv[2]))
+        print("sequence %d, mask state %d" % (sequence, mask_state))
+        for kind, timestamp, value in readings:
+            name = TYPES[kind] if kind < len(TYPES) else str(kind)
+            print("%-16s %19s  %u" % (name, format_timestamp(timestamp), value))
+    elif len(argv) >= 3 and argv[1] == "decode":
+        for path in argv[2:]:
+            with open(path, "rb") as f:
+                for kind, timestamp, value in decode_packet(f.read()):
+                    name = TYPES[kind] if kind < len(TYPES) else str(kind)
+                    print("%-16s %19s  %u" % (name, format_timestamp(timestamp), value))
+    else:
+        sys.stderr.write(__doc__)
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))